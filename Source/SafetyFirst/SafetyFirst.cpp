@@ -1,9 +1,75 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
 #include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPreload.h"
+#include "SafetyFirstTelemetry.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, SafetyFirst, "SafetyFirst" );
+DEFINE_STAT(STAT_SafetyFirst_LiveProjectiles);
+DEFINE_STAT(STAT_SafetyFirst_ThrownWeapons);
+DEFINE_STAT(STAT_SafetyFirst_Pickups);
+
+CSV_DEFINE_CATEGORY(SafetyFirst, true);
+
+namespace SafetyFirstCounters
+{
+	static int32 s_iLiveProjectiles = 0;
+	static int32 s_iThrownWeapons = 0;
+	static int32 s_iPickups = 0;
+
+	void AddLiveProjectiles(int32 _iDelta)
+	{
+		s_iLiveProjectiles += _iDelta;
+		INC_DWORD_STAT_BY(STAT_SafetyFirst_LiveProjectiles, _iDelta);
+	}
+
+	void AddThrownWeapons(int32 _iDelta)
+	{
+		s_iThrownWeapons += _iDelta;
+		INC_DWORD_STAT_BY(STAT_SafetyFirst_ThrownWeapons, _iDelta);
+	}
+
+	void AddPickup()
+	{
+		++s_iPickups;
+		INC_DWORD_STAT(STAT_SafetyFirst_Pickups);
+	}
+
+	/** Stat counters reset themselves each frame, the CSV ones are written here */
+	static void OnEndFrame()
+	{
+		CSV_CUSTOM_STAT(SafetyFirst, LiveProjectiles, s_iLiveProjectiles, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(SafetyFirst, ThrownWeapons, s_iThrownWeapons, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(SafetyFirst, Pickups, s_iPickups, ECsvCustomStatOp::Set);
+		s_iPickups = 0;
+	}
+}
+
+class FSafetyFirstModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		m_EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&SafetyFirstCounters::OnEndFrame);
+		SafetyFirstPreload::Startup();
+		SafetyFirstMemory::Startup();
+		SafetyFirstTelemetry::Startup();
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FCoreDelegates::OnEndFrame.Remove(m_EndFrameHandle);
+		SafetyFirstPreload::Shutdown();
+		SafetyFirstMemory::Shutdown();
+		SafetyFirstTelemetry::Shutdown();
+	}
+
+private:
+	FDelegateHandle m_EndFrameHandle;
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FSafetyFirstModule, SafetyFirst, "SafetyFirst" );
 
 DEFINE_LOG_CATEGORY(LogSafetyFirst)
- 
\ No newline at end of file
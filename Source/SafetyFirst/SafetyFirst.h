@@ -3,5 +3,37 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogSafetyFirst, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("SafetyFirst"), STATGROUP_SafetyFirst, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live projectiles"), STAT_SafetyFirst_LiveProjectiles, STATGROUP_SafetyFirst, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Thrown weapons"), STAT_SafetyFirst_ThrownWeapons, STATGROUP_SafetyFirst, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pickups"), STAT_SafetyFirst_Pickups, STATGROUP_SafetyFirst, );
+
+CSV_DECLARE_CATEGORY_EXTERN(SafetyFirst);
+
+/**
+ * Times a scope in the stat group, in the SafetyFirst CSV category and as a named event for external profilers.
+ * _Stat must be declared with DECLARE_CYCLE_STAT, _Name is the CSV stat and event name.
+ */
+#define SAFETYFIRST_SCOPE_CYCLE(_Stat, _Name) \
+	SCOPE_CYCLE_COUNTER(_Stat); \
+	CSV_SCOPED_TIMING_STAT(SafetyFirst, _Name); \
+	SCOPED_NAMED_EVENT(SafetyFirst_##_Name, FColor::Orange)
+
+/** Gameplay counters, mirrored in the stat group and written once per frame to the CSV profiler */
+namespace SafetyFirstCounters
+{
+	/** Projectile actors in flight plus bulk bullets */
+	void AddLiveProjectiles(int32 _iDelta);
+
+	/** Weapons recoiling after a throw */
+	void AddThrownWeapons(int32 _iDelta);
+
+	/** Counts a weapon picked up this frame */
+	void AddPickup();
+}
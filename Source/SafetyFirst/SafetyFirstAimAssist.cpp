@@ -0,0 +1,160 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstAimAssist.h"
+#include "SafetyFirst.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/VectorRegister.h"
+
+DECLARE_CYCLE_STAT(TEXT("Aim assist query"), STAT_SafetyFirst_AimAssist, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommand GBenchAimAssistCmd(
+	TEXT("SafetyFirst.AimAssist.Bench"),
+	TEXT("Measures the cost of one aim assist query. Arguments: [Targets] [Queries]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& _Args)
+	{
+		const int32 iTargets = _Args.Num() > 0 ? FCString::Atoi(*_Args[0]) : 1000;
+		const int32 iQueries = _Args.Num() > 1 ? FCString::Atoi(*_Args[1]) : 1000;
+		const FSafetyFirstAimCost cost = FSafetyFirstAimTargets::MeasureQueryCost(iTargets, iQueries);
+		UE_LOG(LogSafetyFirst, Display, TEXT("Aim assist: %d targets, %d queries at %.3f us each"),
+			cost.m_iTargets, cost.m_iQueries, cost.m_fQueryMicroseconds);
+	}));
+
+/** Location of the padding targets, out of any range */
+static const float PaddingLocation = 1.0e18f;
+
+void FSafetyFirstAimTargets::Reset()
+{
+	m_X.Reset();
+	m_Y.Reset();
+	m_iNum = 0;
+}
+
+int32 FSafetyFirstAimTargets::Add(const FVector& _vLocation)
+{
+	// Drops the padding of a previous Finish
+	m_X.SetNum(m_iNum, /*bAllowShrinking*/false);
+	m_Y.SetNum(m_iNum, /*bAllowShrinking*/false);
+	m_X.Add(_vLocation.X);
+	m_Y.Add(_vLocation.Y);
+	return m_iNum++;
+}
+
+void FSafetyFirstAimTargets::Finish()
+{
+	while (m_X.Num() % 4 != 0)
+	{
+		m_X.Add(PaddingLocation);
+		m_Y.Add(PaddingLocation);
+	}
+}
+
+int32 FSafetyFirstAimTargets::FindBest(const FVector2D& _vOrigin, const FVector2D& _vDirection, float _fCosHalfAngle, float _fMaxRange, float _fDistanceWeight) const
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_AimAssist, AimAssist);
+	check(m_X.Num() % 4 == 0);
+
+	if (m_iNum == 0 || _fMaxRange <= 0.0f)
+	{
+		return INDEX_NONE;
+	}
+
+	const float* targetX = m_X.GetData();
+	const float* targetY = m_Y.GetData();
+
+	const float fCosHalfAngle = FMath::Max(_fCosHalfAngle, 0.0f);
+	const VectorRegister vOriginX = VectorSetFloat1(_vOrigin.X);
+	const VectorRegister vOriginY = VectorSetFloat1(_vOrigin.Y);
+	const VectorRegister vDirX = VectorSetFloat1(_vDirection.X);
+	const VectorRegister vDirY = VectorSetFloat1(_vDirection.Y);
+	const VectorRegister vCosSq = VectorSetFloat1(fCosHalfAngle * fCosHalfAngle);
+	const VectorRegister vRangeSq = VectorSetFloat1(_fMaxRange * _fMaxRange);
+	const VectorRegister vDistanceScale = VectorSetFloat1(_fDistanceWeight / _fMaxRange);
+	const VectorRegister vMinDistSq = VectorSetFloat1(1.0f);
+	const VectorRegister vFour = VectorSetFloat1(4.0f);
+
+	// Best score and index of each lane, indices are floats so they can go through VectorSelect
+	VectorRegister vBestScore = VectorSetFloat1(-BIG_NUMBER);
+	VectorRegister vBestIndex = VectorSetFloat1(-1.0f);
+	VectorRegister vIndex = MakeVectorRegister(0.0f, 1.0f, 2.0f, 3.0f);
+
+	const int32 iEnd = m_X.Num();
+	for (int32 i = 0; i < iEnd; i += 4)
+	{
+		const VectorRegister vDX = VectorSubtract(VectorLoadAligned(targetX + i), vOriginX);
+		const VectorRegister vDY = VectorSubtract(VectorLoadAligned(targetY + i), vOriginY);
+		const VectorRegister vDistSq = VectorMultiplyAdd(vDX, vDX, VectorMultiply(vDY, vDY));
+		const VectorRegister vAlong = VectorMultiplyAdd(vDX, vDirX, VectorMultiply(vDY, vDirY));
+
+		// In front, within the angle and within the range, with no square root
+		const VectorRegister vInCone = VectorBitwiseAnd(
+			VectorBitwiseAnd(VectorCompareGT(vAlong, VectorZero()), VectorCompareGE(VectorMultiply(vAlong, vAlong), VectorMultiply(vCosSq, vDistSq))),
+			VectorBitwiseAnd(VectorCompareGT(vRangeSq, vDistSq), VectorCompareGT(vDistSq, vMinDistSq)));
+
+		if (VectorMaskBits(vInCone) != 0)
+		{
+			const VectorRegister vInvDist = VectorReciprocalSqrt(vDistSq);
+			const VectorRegister vScore = VectorSubtract(VectorMultiply(vAlong, vInvDist), VectorMultiply(VectorMultiply(vDistSq, vInvDist), vDistanceScale));
+			const VectorRegister vBetter = VectorBitwiseAnd(vInCone, VectorCompareGT(vScore, vBestScore));
+			vBestScore = VectorSelect(vBetter, vScore, vBestScore);
+			vBestIndex = VectorSelect(vBetter, vIndex, vBestIndex);
+		}
+
+		vIndex = VectorAdd(vIndex, vFour);
+	}
+
+	MS_ALIGN(16) float bestScore[4] GCC_ALIGN(16);
+	MS_ALIGN(16) float bestIndex[4] GCC_ALIGN(16);
+	VectorStoreAligned(vBestScore, bestScore);
+	VectorStoreAligned(vBestIndex, bestIndex);
+
+	int32 iBest = INDEX_NONE;
+	float fBestScore = -BIG_NUMBER;
+	for (int32 iLane = 0; iLane < 4; ++iLane)
+	{
+		if (bestIndex[iLane] >= 0.0f && bestScore[iLane] > fBestScore)
+		{
+			fBestScore = bestScore[iLane];
+			iBest = (int32)bestIndex[iLane];
+		}
+	}
+	return iBest;
+}
+
+FSafetyFirstAimCost FSafetyFirstAimTargets::MeasureQueryCost(int32 _iTargets, int32 _iQueries)
+{
+	FSafetyFirstAimCost cost;
+	cost.m_iTargets = FMath::Max(_iTargets, 0);
+	cost.m_iQueries = FMath::Max(_iQueries, 1);
+
+	// Targets spread in an arena the size of the example map, players aim from anywhere in it
+	FRandomStream random(0x5AFE);
+	FSafetyFirstAimTargets targets;
+	for (int32 i = 0; i < cost.m_iTargets; ++i)
+	{
+		targets.Add(FVector(random.FRandRange(-3000.0f, 3000.0f), random.FRandRange(-3000.0f, 3000.0f), 0.0f));
+	}
+	targets.Finish();
+
+	TArray<FVector2D> origins;
+	TArray<FVector2D> directions;
+	for (int32 q = 0; q < cost.m_iQueries; ++q)
+	{
+		origins.Add(FVector2D(random.FRandRange(-3000.0f, 3000.0f), random.FRandRange(-3000.0f, 3000.0f)));
+		const float fYaw = random.FRandRange(0.0f, 2.0f * PI);
+		directions.Add(FVector2D(FMath::Cos(fYaw), FMath::Sin(fYaw)));
+	}
+
+	const float fCosHalfAngle = FMath::Cos(FMath::DegreesToRadians(15.0f));
+	int32 iFound = 0;
+	const double fStart = FPlatformTime::Seconds();
+	for (int32 q = 0; q < cost.m_iQueries; ++q)
+	{
+		iFound += targets.FindBest(origins[q], directions[q], fCosHalfAngle, 1500.0f, 0.5f) != INDEX_NONE ? 1 : 0;
+	}
+	const double fSeconds = FPlatformTime::Seconds() - fStart;
+
+	UE_LOG(LogSafetyFirst, Verbose, TEXT("Aim assist bench: %d of %d queries found a target"), iFound, cost.m_iQueries);
+
+	cost.m_fQueryMicroseconds = (float)(fSeconds * 1000000.0 / cost.m_iQueries);
+	return cost;
+}
@@ -0,0 +1,46 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Average cost of one aim assist query, measured by FSafetyFirstAimTargets::MeasureQueryCost */
+struct FSafetyFirstAimCost
+{
+	int32 m_iTargets = 0;
+	int32 m_iQueries = 0;
+	float m_fQueryMicroseconds = 0.0f;
+};
+
+/**
+ * Positions of the aim assist targets on the play plane, packed as structure of arrays and padded to groups of four.
+ * FindBest tests four targets per instruction against a cone, without touching the actors.
+ */
+class FSafetyFirstAimTargets
+{
+public:
+	void Reset();
+
+	/** Returns the index of the target, the one FindBest returns */
+	int32 Add(const FVector& _vLocation);
+
+	/** Pads the last group of four, to call once every target is added */
+	void Finish();
+
+	int32 Num() const { return m_iNum; }
+	FVector2D GetLocation(int32 _iIndex) const { return FVector2D(m_X[_iIndex], m_Y[_iIndex]); }
+
+	/**
+	 * Returns the target inside the cone of _vDirection and _fMaxRange with the best score, INDEX_NONE if none.
+	 * The score is the cosine of the angle to the direction, minus _fDistanceWeight times the distance over the range.
+	 */
+	int32 FindBest(const FVector2D& _vOrigin, const FVector2D& _vDirection, float _fCosHalfAngle, float _fMaxRange, float _fDistanceWeight) const;
+
+	/** Times _iQueries queries from random origins over _iTargets random targets */
+	static FSafetyFirstAimCost MeasureQueryCost(int32 _iTargets, int32 _iQueries);
+
+private:
+	TArray<float, TAlignedHeapAllocator<16>> m_X;
+	TArray<float, TAlignedHeapAllocator<16>> m_Y;
+	int32 m_iNum = 0;
+};
@@ -0,0 +1,548 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstAnimationBudget.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "SafetyFirstWorldManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Animation budget"), STAT_SafetyFirst_AnimationBudget, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Animation evaluations"), STAT_SafetyFirst_AnimationEvaluations, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Animation evaluations skipped"), STAT_SafetyFirst_AnimationSkipped, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Animation followers"), STAT_SafetyFirst_AnimationFollowers, STATGROUP_SafetyFirst);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Animation estimated (ms)"), STAT_SafetyFirst_AnimationEstimatedMs, STATGROUP_SafetyFirst);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Animation saved (ms)"), STAT_SafetyFirst_AnimationSavedMs, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpAnimationBudgetStatsCmd(
+	TEXT("SafetyFirst.Animation.Stats"),
+	TEXT("Logs the update rates, the shared poses and the evaluations skipped by the animation budget"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstAnimationBudget* budget = ASafetyFirstAnimationBudget::Get(_World))
+		{
+			budget->DumpStats();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld GCalibrateAnimationBudgetCmd(
+	TEXT("SafetyFirst.Animation.Calibrate"),
+	TEXT("Times the evaluation of up to 32 enemy meshes and uses the average as the estimated cost of an evaluation"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstAnimationBudget* budget = ASafetyFirstAnimationBudget::Get(_World))
+		{
+			budget->Calibrate(32);
+		}
+	}));
+
+ASafetyFirstAnimationBudget::ASafetyFirstAnimationBudget()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// After the meshes ticked, so the skips read are the ones of this frame and the new rates apply to the next one
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+}
+
+ASafetyFirstAnimationBudget* ASafetyFirstAnimationBudget::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstAnimationBudget>(_World);
+}
+
+void ASafetyFirstAnimationBudget::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	for (FEntry& entry : m_Entries)
+	{
+		Release(entry);
+		entry.m_Agent->m_iAnimationIndex = INDEX_NONE;
+	}
+	m_Entries.Empty();
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstAnimationBudget::Register(ASafetyFirstCrowdAgent* _Agent)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Agent == nullptr || _Agent->m_iAnimationIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	USkeletalMeshComponent* mesh = nullptr;
+	TInlineComponentArray<USkeletalMeshComponent*> meshes(_Agent);
+	for (USkeletalMeshComponent* candidate : meshes)
+	{
+		if (candidate->SkeletalMesh != nullptr)
+		{
+			mesh = candidate;
+			break;
+		}
+	}
+	if (mesh == nullptr)
+	{
+		return;
+	}
+
+	// The update rate paces the mesh, a tick interval from the significance on top of it would slow it down twice
+	if (_Agent->m_SignificanceManager.IsValid())
+	{
+		_Agent->m_SignificanceManager->ReleaseTick(_Agent, mesh);
+	}
+
+	FEntry entry;
+	entry.m_Agent = _Agent;
+	entry.m_Mesh = mesh;
+	entry.m_iRate = 0;
+	entry.m_bIsLeader = false;
+	entry.m_bHasDefaults = false;
+	entry.m_bDefaultEnableUpdateRateOptimizations = mesh->bEnableUpdateRateOptimizations;
+	entry.m_bDefaultShouldUseLodMap = false;
+	entry.m_iDefaultNonRenderedUpdateRate = 1;
+	entry.m_iDefaultMaxEvalRateForInterpolation = 1;
+	entry.m_fScreenSize = 0.0f;
+	entry.m_fDistance = 0.0f;
+	entry.m_bRendered = true;
+
+	// The engine only creates the update rate parameters of the meshes registered with the optimizations on
+	if (!mesh->bEnableUpdateRateOptimizations)
+	{
+		mesh->bEnableUpdateRateOptimizations = true;
+		if (mesh->IsRegistered() && mesh->AnimUpdateRateParams == nullptr)
+		{
+			mesh->ReregisterComponent();
+		}
+	}
+
+	_Agent->m_iAnimationIndex = m_Entries.Add(entry);
+}
+
+void ASafetyFirstAnimationBudget::Unregister(ASafetyFirstCrowdAgent* _Agent)
+{
+	if (_Agent == nullptr || !m_Entries.IsValidIndex(_Agent->m_iAnimationIndex) || m_Entries[_Agent->m_iAnimationIndex].m_Agent != _Agent)
+	{
+		return;
+	}
+
+	Release(m_Entries[_Agent->m_iAnimationIndex]);
+	RemoveEntry(_Agent->m_iAnimationIndex);
+}
+
+void ASafetyFirstAnimationBudget::RemoveEntry(int32 _iIndex)
+{
+	// Whoever copied the pose of the mesh evaluates its own again until the next update picks a new leader
+	if (USkeletalMeshComponent* mesh = m_Entries[_iIndex].m_Mesh.Get())
+	{
+		for (FEntry& entry : m_Entries)
+		{
+			if (entry.m_Leader.Get() == mesh)
+			{
+				SetLeader(entry, nullptr);
+			}
+		}
+	}
+
+	m_Entries[_iIndex].m_Agent->m_iAnimationIndex = INDEX_NONE;
+	m_Entries.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	if (m_Entries.IsValidIndex(_iIndex))
+	{
+		m_Entries[_iIndex].m_Agent->m_iAnimationIndex = _iIndex;
+	}
+}
+
+uint8 ASafetyFirstAnimationBudget::GetState(const FEntry& _Entry) const
+{
+	const float fSpeed = _Entry.m_Agent->GetCrowdVelocity().Size2D();
+	if (fSpeed < m_fWalkSpeed)
+	{
+		return 0;
+	}
+	return fSpeed < m_fRunSpeed ? 1 : 2;
+}
+
+void ASafetyFirstAnimationBudget::SetLeader(FEntry& _Entry, USkeletalMeshComponent* _Leader)
+{
+	if (_Entry.m_Leader.Get() == _Leader)
+	{
+		return;
+	}
+
+	_Entry.m_Leader = _Leader;
+	if (USkeletalMeshComponent* mesh = _Entry.m_Mesh.Get())
+	{
+		mesh->SetMasterPoseComponent(_Leader);
+	}
+}
+
+void ASafetyFirstAnimationBudget::ApplyRate(FEntry& _Entry, int32 _iRate)
+{
+	USkeletalMeshComponent* mesh = _Entry.m_Mesh.Get();
+	FAnimUpdateRateParameters* params = mesh != nullptr ? mesh->AnimUpdateRateParams : nullptr;
+	if (params == nullptr || _Entry.m_iRate == _iRate)
+	{
+		return;
+	}
+
+	if (!_Entry.m_bHasDefaults)
+	{
+		_Entry.m_bHasDefaults = true;
+		_Entry.m_bDefaultShouldUseLodMap = params->bShouldUseLodMap;
+		_Entry.m_iDefaultNonRenderedUpdateRate = params->BaseNonRenderedUpdateRate;
+		_Entry.m_iDefaultMaxEvalRateForInterpolation = params->MaxEvalRateForInterpolation;
+		_Entry.m_DefaultThresholds = params->BaseVisibleDistanceFactorThesholds;
+	}
+
+	// Without the LOD map, a visible mesh evaluates once every 1 + (thresholds above its distance factor) frames,
+	// so as many thresholds as impossible to reach as frames to skip force the rate
+	params->bShouldUseLodMap = false;
+	params->BaseVisibleDistanceFactorThesholds.Init(MAX_flt, FMath::Max(_iRate - 1, 0));
+	params->BaseNonRenderedUpdateRate = _iRate > 1 ? FMath::Max(m_iOffscreenUpdateRate, 1) : 1;
+	params->MaxEvalRateForInterpolation = m_iMaxInterpolatedRate;
+	_Entry.m_iRate = _iRate;
+}
+
+void ASafetyFirstAnimationBudget::Release(FEntry& _Entry)
+{
+	SetLeader(_Entry, nullptr);
+
+	USkeletalMeshComponent* mesh = _Entry.m_Mesh.Get();
+	if (mesh == nullptr)
+	{
+		return;
+	}
+
+	FAnimUpdateRateParameters* params = mesh->AnimUpdateRateParams;
+	if (params != nullptr && _Entry.m_bHasDefaults)
+	{
+		params->bShouldUseLodMap = _Entry.m_bDefaultShouldUseLodMap;
+		params->BaseVisibleDistanceFactorThesholds = _Entry.m_DefaultThresholds;
+		params->BaseNonRenderedUpdateRate = _Entry.m_iDefaultNonRenderedUpdateRate;
+		params->MaxEvalRateForInterpolation = _Entry.m_iDefaultMaxEvalRateForInterpolation;
+	}
+	mesh->bEnableUpdateRateOptimizations = _Entry.m_bDefaultEnableUpdateRateOptimizations;
+	_Entry.m_iRate = 0;
+}
+
+void ASafetyFirstAnimationBudget::Score(FEntry& _Entry, const TSafetyFirstFrameArray<FVector>& _PawnLocations, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const
+{
+	const USkeletalMeshComponent* mesh = _Entry.m_Mesh.Get();
+	const FVector vLocation = mesh->Bounds.Origin;
+	const float fRadius = mesh->Bounds.SphereRadius;
+
+	float fDistanceSquared = MAX_flt;
+	for (const FVector& vPawn : _PawnLocations)
+	{
+		fDistanceSquared = FMath::Min(fDistanceSquared, FVector::DistSquared2D(vLocation, vPawn));
+	}
+
+	_Entry.m_fScreenSize = 0.0f;
+	for (const FSafetyFirstView& view : _Views)
+	{
+		const FVector vToMesh = vLocation - view.m_vLocation;
+		const float fViewDistance = vToMesh.Size();
+		if (_PawnLocations.Num() == 0)
+		{
+			fDistanceSquared = FMath::Min(fDistanceSquared, fViewDistance * fViewDistance);
+		}
+		if ((vToMesh | view.m_vDirection) + fRadius >= view.m_fCosHalfAngle * fViewDistance)
+		{
+			_Entry.m_fScreenSize = FMath::Max(_Entry.m_fScreenSize, fRadius / FMath::Max(fViewDistance * view.m_fTanHalfAngle, KINDA_SMALL_NUMBER));
+		}
+	}
+
+	_Entry.m_fDistance = FMath::Sqrt(fDistanceSquared);
+	_Entry.m_bRendered = mesh->WasRecentlyRendered();
+}
+
+int32 ASafetyFirstAnimationBudget::GetDesiredRate(const FEntry& _Entry) const
+{
+	const int32 iMaxRate = FMath::Max(m_iMaxUpdateRate, 1);
+	if (_Entry.m_fDistance < m_fFullRateDistance || _Entry.m_fScreenSize >= m_fFullRateScreenSize)
+	{
+		return 1;
+	}
+	if (!_Entry.m_bRendered || _Entry.m_fScreenSize <= 0.0f)
+	{
+		return iMaxRate;
+	}
+
+	// Halving the size on screen halves the rate
+	const int32 iRatio = FMath::CeilToInt(FMath::Min(m_fFullRateScreenSize / _Entry.m_fScreenSize, (float)iMaxRate));
+	return FMath::Min((int32)FMath::RoundUpToPowerOfTwo(iRatio), iMaxRate);
+}
+
+float ASafetyFirstAnimationBudget::FitBudget(TSafetyFirstFrameArray<int32>& _Rates) const
+{
+	const float fOffscreenRate = (float)FMath::Max(m_iOffscreenUpdateRate, 1);
+	const int32 iMaxRate = FMath::Max(m_iMaxUpdateRate, 1);
+
+	float fEstimatedUs = 0.0f;
+	TSafetyFirstFrameArray<int32> candidates;
+	for (int32 iEntry = 0; iEntry < m_Entries.Num(); ++iEntry)
+	{
+		const FEntry& entry = m_Entries[iEntry];
+		if (_Rates[iEntry] == 0)
+		{
+			continue;
+		}
+		if (!entry.m_bRendered)
+		{
+			fEstimatedUs += m_fEvaluationMicroseconds / fOffscreenRate;
+			continue;
+		}
+
+		fEstimatedUs += m_fEvaluationMicroseconds / _Rates[iEntry];
+		if (entry.m_fDistance >= m_fFullRateDistance && _Rates[iEntry] < iMaxRate)
+		{
+			candidates.Add(iEntry);
+		}
+	}
+
+	const float fBudgetUs = m_fBudgetMs * 1000.0f;
+	if (fEstimatedUs <= fBudgetUs)
+	{
+		return fEstimatedUs / 1000.0f;
+	}
+
+	// Halve the rate of the smallest meshes on screen first, a pass at a time, until the estimate fits or nothing can slow down
+	candidates.Sort([this](int32 _iA, int32 _iB) { return m_Entries[_iA].m_fScreenSize < m_Entries[_iB].m_fScreenSize; });
+	bool bChanged = true;
+	while (fEstimatedUs > fBudgetUs && bChanged)
+	{
+		bChanged = false;
+		for (int32 iEntry : candidates)
+		{
+			if (_Rates[iEntry] >= iMaxRate)
+			{
+				continue;
+			}
+
+			fEstimatedUs -= m_fEvaluationMicroseconds / _Rates[iEntry];
+			_Rates[iEntry] = FMath::Min(_Rates[iEntry] * 2, iMaxRate);
+			fEstimatedUs += m_fEvaluationMicroseconds / _Rates[iEntry];
+			bChanged = true;
+			if (fEstimatedUs <= fBudgetUs)
+			{
+				break;
+			}
+		}
+	}
+
+	return fEstimatedUs / 1000.0f;
+}
+
+void ASafetyFirstAnimationBudget::UpdateSharing()
+{
+	// Current leaders keep their state, so their followers do not switch pose while the state does not change
+	TMap<FShareKey, USkeletalMeshComponent*, TInlineSetAllocator<16>> leaders;
+	for (const FEntry& entry : m_Entries)
+	{
+		USkeletalMeshComponent* mesh = entry.m_Mesh.Get();
+		if (!entry.m_bIsLeader || IsFollower(entry))
+		{
+			continue;
+		}
+
+		const FShareKey key = { mesh->SkeletalMesh, mesh->AnimClass.Get(), GetState(entry) };
+		if (!leaders.Contains(key))
+		{
+			leaders.Add(key, mesh);
+		}
+	}
+
+	for (FEntry& entry : m_Entries)
+	{
+		USkeletalMeshComponent* mesh = entry.m_Mesh.Get();
+		if (!m_bShareInstances || entry.m_fDistance < m_fShareDistance)
+		{
+			SetLeader(entry, nullptr);
+			continue;
+		}
+
+		const FShareKey key = { mesh->SkeletalMesh, mesh->AnimClass.Get(), GetState(entry) };
+		USkeletalMeshComponent*& leader = leaders.FindOrAdd(key);
+		if (leader == nullptr)
+		{
+			leader = mesh;
+		}
+		SetLeader(entry, leader != mesh ? leader : nullptr);
+	}
+
+	m_iLeaders = 0;
+	m_iFollowers = 0;
+	for (FEntry& entry : m_Entries)
+	{
+		const USkeletalMeshComponent* mesh = entry.m_Mesh.Get();
+		entry.m_bIsLeader = false;
+		for (const TPair<FShareKey, USkeletalMeshComponent*>& leader : leaders)
+		{
+			if (leader.Value == mesh)
+			{
+				entry.m_bIsLeader = true;
+				++m_iLeaders;
+				break;
+			}
+		}
+		m_iFollowers += IsFollower(entry) ? 1 : 0;
+	}
+}
+
+void ASafetyFirstAnimationBudget::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_AnimationBudget, AnimationBudget);
+
+	UWorld* world = GetWorld();
+
+	TSafetyFirstFrameArray<FVector> pawnLocations;
+	for (TActorIterator<ASafetyFirstPawn> it(world); it; ++it)
+	{
+		pawnLocations.Add(it->GetActorLocation());
+	}
+
+	TSafetyFirstFrameArray<FSafetyFirstView> views;
+	GatherLocalViews(world, 0.0f, views);
+
+	// What the engine did with the rates of the last frame, before they change
+	m_iEvaluated = 0;
+	m_iSkipped = 0;
+	for (int32 iEntry = m_Entries.Num() - 1; iEntry >= 0; --iEntry)
+	{
+		FEntry& entry = m_Entries[iEntry];
+		const USkeletalMeshComponent* mesh = entry.m_Mesh.Get();
+		if (mesh == nullptr)
+		{
+			RemoveEntry(iEntry);
+			continue;
+		}
+
+		// Meshes whose pose did not tick, hidden or parked, neither evaluated nor skipped anything
+		if (IsFollower(entry))
+		{
+			++m_iSkipped;
+		}
+		else if (mesh->PoseTickedThisFrame())
+		{
+			if (mesh->AnimUpdateRateParams != nullptr && mesh->AnimUpdateRateParams->ShouldSkipEvaluation())
+			{
+				++m_iSkipped;
+			}
+			else
+			{
+				++m_iEvaluated;
+			}
+		}
+
+		Score(entry, pawnLocations, views);
+	}
+
+	UpdateSharing();
+
+	TSafetyFirstFrameArray<int32> rates;
+	rates.AddUninitialized(m_Entries.Num());
+	for (int32 iEntry = 0; iEntry < m_Entries.Num(); ++iEntry)
+	{
+		rates[iEntry] = IsFollower(m_Entries[iEntry]) ? 0 : GetDesiredRate(m_Entries[iEntry]);
+	}
+
+	m_fEstimatedMs = FitBudget(rates);
+	for (int32 iEntry = 0; iEntry < m_Entries.Num(); ++iEntry)
+	{
+		if (rates[iEntry] > 0)
+		{
+			ApplyRate(m_Entries[iEntry], rates[iEntry]);
+		}
+	}
+
+	++m_iFrames;
+	m_iOverBudgetFrames += m_fEstimatedMs > m_fBudgetMs ? 1 : 0;
+	m_iTotalEvaluated += m_iEvaluated;
+	m_iTotalSkipped += m_iSkipped;
+
+	const float fSavedMs = m_iSkipped * m_fEvaluationMicroseconds / 1000.0f;
+	SET_DWORD_STAT(STAT_SafetyFirst_AnimationEvaluations, m_iEvaluated);
+	SET_DWORD_STAT(STAT_SafetyFirst_AnimationSkipped, m_iSkipped);
+	SET_DWORD_STAT(STAT_SafetyFirst_AnimationFollowers, m_iFollowers);
+	SET_FLOAT_STAT(STAT_SafetyFirst_AnimationEstimatedMs, m_fEstimatedMs);
+	SET_FLOAT_STAT(STAT_SafetyFirst_AnimationSavedMs, fSavedMs);
+
+	CSV_CUSTOM_STAT(SafetyFirst, AnimationEvaluations, m_iEvaluated, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AnimationSkipped, m_iSkipped, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AnimationEstimatedMs, m_fEstimatedMs, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AnimationSavedMs, fSavedMs, ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstAnimationBudget::Calibrate(int32 _iMeshes)
+{
+	const float fDt = GetWorld()->GetDeltaSeconds();
+
+	double fSeconds = 0.0;
+	int32 iSamples = 0;
+	for (const FEntry& entry : m_Entries)
+	{
+		USkeletalMeshComponent* mesh = entry.m_Mesh.Get();
+		if (iSamples >= _iMeshes)
+		{
+			break;
+		}
+		// Meshes skipping this frame would time nothing
+		if (mesh == nullptr || IsFollower(entry) || mesh->GetAnimInstance() == nullptr
+			|| (mesh->AnimUpdateRateParams != nullptr && mesh->AnimUpdateRateParams->ShouldSkipEvaluation()))
+		{
+			continue;
+		}
+
+		// Without a tick function the evaluation runs here rather than on a worker
+		const double fStart = FPlatformTime::Seconds();
+		mesh->TickAnimation(fDt, false);
+		mesh->RefreshBoneTransforms();
+		fSeconds += FPlatformTime::Seconds() - fStart;
+		++iSamples;
+	}
+
+	if (iSamples == 0)
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Animation: no mesh evaluating this frame to calibrate, the estimate stays at %.1f us"), m_fEvaluationMicroseconds);
+		return;
+	}
+
+	m_fEvaluationMicroseconds = (float)(fSeconds * 1000000.0 / iSamples);
+	m_iCalibrationSamples = iSamples;
+	UE_LOG(LogSafetyFirst, Display, TEXT("Animation: %.1f us per evaluation over %d meshes"), m_fEvaluationMicroseconds, iSamples);
+}
+
+void ASafetyFirstAnimationBudget::DumpStats() const
+{
+	static const int32 Rates[] = { 1, 2, 4, 8, 16 };
+	int32 counts[ARRAY_COUNT(Rates) + 1] = {};
+	for (const FEntry& entry : m_Entries)
+	{
+		if (IsFollower(entry))
+		{
+			continue;
+		}
+
+		int32 iBucket = 0;
+		while (iBucket < ARRAY_COUNT(Rates) && Rates[iBucket] < entry.m_iRate)
+		{
+			++iBucket;
+		}
+		++counts[iBucket];
+	}
+
+	const int64 iTotal = FMath::Max<int64>(m_iTotalEvaluated + m_iTotalSkipped, 1);
+	UE_LOG(LogSafetyFirst, Display, TEXT("Animation: %d agents, %d leaders, %d followers, %.2f of %.2f ms estimated at %.1f us per evaluation (%s)"),
+		m_Entries.Num(), m_iLeaders, m_iFollowers, m_fEstimatedMs, m_fBudgetMs, m_fEvaluationMicroseconds,
+		m_iCalibrationSamples > 0 ? *FString::Printf(TEXT("calibrated on %d meshes"), m_iCalibrationSamples) : TEXT("not calibrated"));
+	UE_LOG(LogSafetyFirst, Display, TEXT("  rate 1: %d  2: %d  4: %d  8: %d  16: %d  slower: %d"),
+		counts[0], counts[1], counts[2], counts[3], counts[4], counts[5]);
+	UE_LOG(LogSafetyFirst, Display, TEXT("  last frame %d evaluated, %d skipped, %.2f ms saved"),
+		m_iEvaluated, m_iSkipped, m_iSkipped * m_fEvaluationMicroseconds / 1000.0f);
+	UE_LOG(LogSafetyFirst, Display, TEXT("  since start %lld of %lld evaluations skipped (%.0f%%), %.1f ms saved, %d of %d frames over budget"),
+		m_iTotalSkipped, m_iTotalEvaluated + m_iTotalSkipped, 100.0 * m_iTotalSkipped / iTotal,
+		m_iTotalSkipped * m_fEvaluationMicroseconds / 1000.0f, m_iOverBudgetFrames, m_iFrames);
+}
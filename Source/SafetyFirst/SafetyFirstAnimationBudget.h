@@ -0,0 +1,168 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "SafetyFirstAnimationBudget.generated.h"
+
+class ASafetyFirstCrowdAgent;
+class USkeletalMeshComponent;
+
+/**
+ * Keeps the animation of the ASafetyFirstCrowdAgent skeletal meshes under a per frame budget.
+ * Each mesh gets an update rate from its distance to the pawns and its size on screen, applied through the update rate
+ * optimization of the engine, which interpolates the frames it skips. When the estimated cost of the visible meshes
+ * is over m_fBudgetMs, the smallest ones on screen are slowed down first, up to m_iMaxUpdateRate.
+ * Far agents in the same state (mesh, animation class and speed) share the pose of one of them, their leader, and do
+ * not evaluate at all.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstAnimationBudget : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstAnimationBudget();
+
+	/** Returns the animation budget of the world, spawning it if needed */
+	static ASafetyFirstAnimationBudget* Get(UWorld* _World);
+
+	/** Budgets the animation of the agent. The engine keeps one update rate per actor, its first skeletal mesh decides it for all */
+	void Register(ASafetyFirstCrowdAgent* _Agent);
+
+	/** Gives the agent back its own animation at full rate */
+	void Unregister(ASafetyFirstCrowdAgent* _Agent);
+
+	/** Times full evaluations of the registered meshes on the game thread, and uses the average as the estimated cost */
+	void Calibrate(int32 _iMeshes);
+
+	void DumpStats() const;
+
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	/** Estimated animation work allowed per frame, game thread and workers together */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fBudgetMs = 2.0f;
+
+	/** Estimated cost of one full evaluation of a mesh, SafetyFirst.Animation.Calibrate measures it */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fEvaluationMicroseconds = 40.0f;
+
+	/** Closer to a pawn than this, a mesh evaluates every frame whatever the budget */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fFullRateDistance = 1500.0f;
+
+	/** Screen size, as the bounds radius over the half width of the view, above which a mesh evaluates every frame */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fFullRateScreenSize = 0.15f;
+
+	/** Slowest update rate of a visible mesh, in frames */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxUpdateRate = 8;
+
+	/** Update rate of the meshes nobody saw recently */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iOffscreenUpdateRate = 16;
+
+	/** Skipped frames are interpolated up to this update rate, slower meshes hold their pose */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxInterpolatedRate = 4;
+
+	/** Agents further than this from every pawn share the pose of a leader in the same state */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	bool m_bShareInstances = true;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ", meta = (EditCondition = "m_bShareInstances"))
+	float m_fShareDistance = 3000.0f;
+
+	/** Speeds separating idle, walking and running agents, which never share a pose */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ", meta = (EditCondition = "m_bShareInstances"))
+	float m_fWalkSpeed = 10.0f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ", meta = (EditCondition = "m_bShareInstances"))
+	float m_fRunSpeed = 250.0f;
+
+private:
+	struct FEntry
+	{
+		ASafetyFirstCrowdAgent* m_Agent;
+		TWeakObjectPtr<USkeletalMeshComponent> m_Mesh;
+		/** Update rate applied, 0 before the first one */
+		int32 m_iRate;
+		/** Mesh whose pose this one copies, null when it evaluates its own */
+		TWeakObjectPtr<USkeletalMeshComponent> m_Leader;
+		/** Other agents in the same state copy its pose */
+		bool m_bIsLeader;
+
+		/** Update rate parameters of the engine before the first rate, Release puts them back */
+		bool m_bHasDefaults;
+		bool m_bDefaultEnableUpdateRateOptimizations;
+		bool m_bDefaultShouldUseLodMap;
+		int32 m_iDefaultNonRenderedUpdateRate;
+		int32 m_iDefaultMaxEvalRateForInterpolation;
+		TArray<float> m_DefaultThresholds;
+
+		// Scratch of the current frame
+		float m_fScreenSize;
+		float m_fDistance;
+		bool m_bRendered;
+	};
+
+
+	/** Agents in the same state evaluate the same pose */
+	struct FShareKey
+	{
+		const UObject* m_Mesh;
+		const UClass* m_AnimClass;
+		uint8 m_uState;
+
+		bool operator==(const FShareKey& _Other) const
+		{
+			return m_Mesh == _Other.m_Mesh && m_AnimClass == _Other.m_AnimClass && m_uState == _Other.m_uState;
+		}
+
+		friend uint32 GetTypeHash(const FShareKey& _Key)
+		{
+			return HashCombine(HashCombine(::GetTypeHash(_Key.m_Mesh), ::GetTypeHash(_Key.m_AnimClass)), _Key.m_uState);
+		}
+	};
+
+	/** Distance to the closest pawn and largest screen size of the entry */
+	void Score(FEntry& _Entry, const TSafetyFirstFrameArray<FVector>& _PawnLocations, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const;
+
+	/** Update rate from the distance and the screen size alone */
+	int32 GetDesiredRate(const FEntry& _Entry) const;
+
+	/** Slows the least visible meshes down until the estimate fits the budget, returns the estimated ms */
+	float FitBudget(TSafetyFirstFrameArray<int32>& _Rates) const;
+
+	/** Far agents follow the leader of their state, near ones get their own animation back */
+	void UpdateSharing();
+	void SetLeader(FEntry& _Entry, USkeletalMeshComponent* _Leader);
+	void ApplyRate(FEntry& _Entry, int32 _iRate);
+	/** Gives the entry its own animation at full rate */
+	void Release(FEntry& _Entry);
+	void RemoveEntry(int32 _iIndex);
+	uint8 GetState(const FEntry& _Entry) const;
+	bool IsFollower(const FEntry& _Entry) const { return _Entry.m_Leader.IsValid(); }
+
+	TArray<FEntry> m_Entries;
+
+	// Last frame
+	int32 m_iEvaluated = 0;
+	int32 m_iSkipped = 0;
+	int32 m_iFollowers = 0;
+	int32 m_iLeaders = 0;
+	float m_fEstimatedMs = 0.0f;
+
+	// Since play started
+	int32 m_iFrames = 0;
+	int32 m_iOverBudgetFrames = 0;
+	int64 m_iTotalEvaluated = 0;
+	int64 m_iTotalSkipped = 0;
+	int32 m_iCalibrationSamples = 0;
+};
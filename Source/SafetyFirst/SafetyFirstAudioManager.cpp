@@ -0,0 +1,238 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstAudioManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Sound/SoundBase.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio voices played"), STAT_SafetyFirst_AudioPlayed, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio voices culled"), STAT_SafetyFirst_AudioCulled, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio voices merged"), STAT_SafetyFirst_AudioMerged, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio voices stolen"), STAT_SafetyFirst_AudioStolen, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpAudioStatsCmd(
+	TEXT("SafetyFirst.Audio.Stats"),
+	TEXT("Logs the voices played, culled, merged and stolen per second by the audio manager"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstAudioManager* manager = ASafetyFirstAudioManager::Get(_World))
+		{
+			manager->DumpStats();
+		}
+	}));
+
+ASafetyFirstAudioManager::ASafetyFirstAudioManager()
+{
+	// Only reports the rates
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickInterval = 1.0f;
+}
+
+ASafetyFirstAudioManager* ASafetyFirstAudioManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstAudioManager>(_World);
+}
+
+void ASafetyFirstAudioManager::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Audio);
+	Super::BeginPlay();
+
+	// A dedicated server never plays sounds, it keeps an empty pool
+	const int32 iPoolSize = GetNetMode() != NM_DedicatedServer ? FMath::Max(m_iPoolSize, 1) : 0;
+	m_Components.Reserve(iPoolSize);
+	m_Voices.SetNum(iPoolSize);
+	for (int32 i = 0; i < iPoolSize; ++i)
+	{
+		UAudioComponent* component = NewObject<UAudioComponent>(this);
+		component->bAutoActivate = false;
+		component->bAutoDestroy = false;
+		component->RegisterComponent();
+		m_Components.Add(component);
+	}
+
+	m_fReportTime = GetWorld()->GetTimeSeconds();
+}
+
+void ASafetyFirstAudioManager::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	for (UAudioComponent* component : m_Components)
+	{
+		if (component != nullptr)
+		{
+			component->Stop();
+		}
+	}
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstAudioManager::Play(USoundBase* _Sound, const FVector& _vLocation)
+{
+	SAFETYFIRST_LLM_SCOPE(Audio);
+	if (_Sound == nullptr || m_Components.Num() == 0)
+	{
+		return;
+	}
+
+	GatherListeners();
+	if (!IsAudible(_Sound, _vLocation))
+	{
+		++m_iCulled;
+		INC_DWORD_STAT(STAT_SafetyFirst_AudioCulled);
+		return;
+	}
+
+	const float fTime = GetWorld()->GetTimeSeconds();
+	const float fMergeRadiusSq = m_fMergeRadius * m_fMergeRadius;
+	int32 iFree = INDEX_NONE;
+	int32 iOldest = INDEX_NONE;
+	int32 iOldestSameSound = INDEX_NONE;
+	int32 iSameSound = 0;
+	for (int32 i = 0; i < m_Voices.Num(); ++i)
+	{
+		if (!m_Components[i]->IsPlaying())
+		{
+			iFree = iFree == INDEX_NONE ? i : iFree;
+			continue;
+		}
+
+		FVoice& voice = m_Voices[i];
+		if (voice.m_Sound.Get() == _Sound)
+		{
+			// A burst of identical shots reads as one louder shot
+			if (fTime - voice.m_fStartTime <= m_fMergeWindow && FVector::DistSquared(voice.m_vLocation, _vLocation) <= fMergeRadiusSq)
+			{
+				voice.m_fVolume = FMath::Min(voice.m_fVolume + m_fMergeVolumeStep, m_fMaxMergedVolume);
+				m_Components[i]->SetVolumeMultiplier(voice.m_fVolume);
+				++m_iMerged;
+				INC_DWORD_STAT(STAT_SafetyFirst_AudioMerged);
+				return;
+			}
+
+			++iSameSound;
+			if (iOldestSameSound == INDEX_NONE || voice.m_fStartTime < m_Voices[iOldestSameSound].m_fStartTime)
+			{
+				iOldestSameSound = i;
+			}
+		}
+
+		if (iOldest == INDEX_NONE || voice.m_fStartTime < m_Voices[iOldest].m_fStartTime)
+		{
+			iOldest = i;
+		}
+	}
+
+	// Over the limit of the sound, or out of voices: the oldest one gives way
+	const int32 iVoice = (iSameSound >= FMath::Max(m_iMaxVoicesPerSound, 1)) ? iOldestSameSound : (iFree != INDEX_NONE ? iFree : iOldest);
+	if (iVoice != iFree)
+	{
+		++m_iStolen;
+		INC_DWORD_STAT(STAT_SafetyFirst_AudioStolen);
+	}
+
+	StartVoice(iVoice, _Sound, _vLocation, fTime);
+	++m_iPlayed;
+	INC_DWORD_STAT(STAT_SafetyFirst_AudioPlayed);
+}
+
+void ASafetyFirstAudioManager::StartVoice(int32 _iVoice, USoundBase* _Sound, const FVector& _vLocation, float _fTime)
+{
+	UAudioComponent* component = m_Components[_iVoice];
+	if (component->IsPlaying())
+	{
+		component->Stop();
+	}
+
+	component->SetSound(_Sound);
+	component->SetWorldLocation(_vLocation);
+	component->SetVolumeMultiplier(1.0f);
+	component->Play();
+
+	FVoice& voice = m_Voices[_iVoice];
+	voice.m_Sound = _Sound;
+	voice.m_vLocation = _vLocation;
+	voice.m_fStartTime = _fTime;
+	voice.m_fVolume = 1.0f;
+}
+
+void ASafetyFirstAudioManager::GatherListeners()
+{
+	if (m_uListenersFrame == GFrameCounter)
+	{
+		return;
+	}
+
+	m_uListenersFrame = GFrameCounter;
+	m_Listeners.Reset();
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		APlayerController* controller = it->Get();
+		if (controller != nullptr && controller->IsLocalController())
+		{
+			FVector vLocation;
+			FVector vFront;
+			FVector vRight;
+			controller->GetAudioListenerPosition(vLocation, vFront, vRight);
+			m_Listeners.Add(vLocation);
+		}
+	}
+}
+
+bool ASafetyFirstAudioManager::IsAudible(USoundBase* _Sound, const FVector& _vLocation) const
+{
+	const float fMaxDistance = FMath::Min(m_fMaxDistance, _Sound->GetMaxAudibleDistance());
+	const float fMaxDistanceSq = fMaxDistance * fMaxDistance;
+	for (const FVector& vListener : m_Listeners)
+	{
+		if (FVector::DistSquared(vListener, _vLocation) <= fMaxDistanceSq)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ASafetyFirstAudioManager::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+
+	const float fTime = GetWorld()->GetTimeSeconds();
+	const float fElapsed = fTime - m_fReportTime;
+	if (fElapsed <= 0.0f)
+	{
+		return;
+	}
+
+	m_fPlayedPerSecond = m_iPlayed / fElapsed;
+	m_fCulledPerSecond = m_iCulled / fElapsed;
+	m_fMergedPerSecond = m_iMerged / fElapsed;
+	m_fStolenPerSecond = m_iStolen / fElapsed;
+	m_iPlayed = 0;
+	m_iCulled = 0;
+	m_iMerged = 0;
+	m_iStolen = 0;
+	m_fReportTime = fTime;
+
+	CSV_CUSTOM_STAT(SafetyFirst, AudioPlayedPerSecond, m_fPlayedPerSecond, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AudioCulledPerSecond, m_fCulledPerSecond, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AudioMergedPerSecond, m_fMergedPerSecond, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, AudioStolenPerSecond, m_fStolenPerSecond, ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstAudioManager::DumpStats() const
+{
+	int32 iPlaying = 0;
+	for (const UAudioComponent* component : m_Components)
+	{
+		iPlaying += component->IsPlaying() ? 1 : 0;
+	}
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Audio: %d/%d voices playing, per second %.1f played, %.1f culled, %.1f merged, %.1f stolen"),
+		iPlaying, m_Components.Num(), m_fPlayedPerSecond, m_fCulledPerSecond, m_fMergedPerSecond, m_fStolenPerSecond);
+}
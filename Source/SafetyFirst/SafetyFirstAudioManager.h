@@ -0,0 +1,96 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstAudioManager.generated.h"
+
+class UAudioComponent;
+class USoundBase;
+
+/**
+ * Plays the one shot gameplay sounds (weapon fire) on a fixed pool of audio components.
+ * A request is culled when every listener is out of range, merged into a voice of the same sound started a moment
+ * ago close by, or takes over the oldest voice of its sound once the sound reaches its concurrency limit.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstAudioManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstAudioManager();
+
+	/** Returns the audio manager of the world, spawning it if needed */
+	static ASafetyFirstAudioManager* Get(UWorld* _World);
+
+	/** Plays the sound at the location, or culls or merges it */
+	void Play(USoundBase* _Sound, const FVector& _vLocation);
+
+	void DumpStats() const;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	/** Audio components created up front, nothing is allocated afterwards */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iPoolSize = 32;
+
+	/** Voices of one sound playing at the same time */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxVoicesPerSound = 6;
+
+	/** Sounds further than this from every listener are not played, the attenuation of the sound may cull closer */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxDistance = 5000.0f;
+
+	/** A sound started within this time and radius of a voice of the same sound is merged into it */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMergeWindow = 0.03f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMergeRadius = 300.0f;
+
+	/** Volume added to a voice for each merged sound, up to m_fMaxMergedVolume */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMergeVolumeStep = 0.1f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxMergedVolume = 1.5f;
+
+private:
+	struct FVoice
+	{
+		TWeakObjectPtr<USoundBase> m_Sound;
+		FVector m_vLocation = FVector::ZeroVector;
+		float m_fStartTime = -MAX_flt;
+		float m_fVolume = 1.0f;
+	};
+
+	void GatherListeners();
+	bool IsAudible(USoundBase* _Sound, const FVector& _vLocation) const;
+	void StartVoice(int32 _iVoice, USoundBase* _Sound, const FVector& _vLocation, float _fTime);
+
+	/** Pool, indexed like m_Voices */
+	UPROPERTY()
+	TArray<UAudioComponent*> m_Components;
+
+	TArray<FVoice> m_Voices;
+
+	/** Listener locations, gathered once per frame */
+	TArray<FVector> m_Listeners;
+	uint64 m_uListenersFrame = MAX_uint64;
+
+	// Counts since the last report, and the rates of the last report
+	int32 m_iPlayed = 0;
+	int32 m_iCulled = 0;
+	int32 m_iMerged = 0;
+	int32 m_iStolen = 0;
+	float m_fReportTime = 0.0f;
+	float m_fPlayedPerSecond = 0.0f;
+	float m_fCulledPerSecond = 0.0f;
+	float m_fMergedPerSecond = 0.0f;
+	float m_fStolenPerSecond = 0.0f;
+};
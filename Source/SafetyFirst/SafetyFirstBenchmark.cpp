@@ -0,0 +1,363 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstBenchmark.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstAimAssist.h"
+#include "SafetyFirstBulkProjectileManager.h"
+#include "SafetyFirstCollision2D.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstLagCompensation.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstProjectile.h"
+#include "SafetyFirstProjectilePool.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "SafetyFirstTelemetry.h"
+#include "SafetyFirstWeapon.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+bool FSafetyFirstBenchmarkSettings::ParseCommandLine(const TCHAR* _CommandLine)
+{
+	if (!FParse::Param(_CommandLine, TEXT("SafetyFirstBench")))
+	{
+		return false;
+	}
+
+	FParse::Value(_CommandLine, TEXT("BenchDuration="), m_fDuration);
+	FParse::Value(_CommandLine, TEXT("BenchWarmup="), m_fWarmup);
+	FParse::Value(_CommandLine, TEXT("BenchAI="), m_iNumAI);
+	FParse::Value(_CommandLine, TEXT("BenchProjectiles="), m_iNumProjectiles);
+	FParse::Value(_CommandLine, TEXT("BenchWeapons="), m_iNumWeapons);
+	FParse::Value(_CommandLine, TEXT("BenchAIClass="), m_AIClassPath);
+	FParse::Value(_CommandLine, TEXT("BenchCsv="), m_CsvPath);
+	FParse::Value(_CommandLine, TEXT("BenchBaseline="), m_BaselinePath);
+	FParse::Value(_CommandLine, TEXT("BenchThreshold="), m_fRegressionThreshold);
+	FParse::Value(_CommandLine, TEXT("BenchSeed="), m_iSeed);
+
+	if (m_CsvPath.IsEmpty())
+	{
+		m_CsvPath = FPaths::ProjectSavedDir() / TEXT("Profiling") / TEXT("SafetyFirstBench") / (FDateTime::Now().ToString() + TEXT(".csv"));
+	}
+	return true;
+}
+
+ASafetyFirstBenchmark::ASafetyFirstBenchmark()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+void ASafetyFirstBenchmark::StartFromCommandLine(UWorld* _World)
+{
+	FSafetyFirstBenchmarkSettings settings;
+	if (_World == nullptr || !settings.ParseCommandLine(FCommandLine::Get()))
+	{
+		return;
+	}
+
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.ObjectFlags |= RF_Transient;
+	if (ASafetyFirstBenchmark* benchmark = _World->SpawnActor<ASafetyFirstBenchmark>(spawnInfo))
+	{
+		benchmark->m_Settings = settings;
+		benchmark->m_Random.Initialize(settings.m_iSeed);
+		UE_LOG(LogSafetyFirst, Display, TEXT("Benchmark started: %.0f s, %d AI, %d projectiles, %d weapons, csv %s"),
+			settings.m_fDuration, settings.m_iNumAI, settings.m_iNumProjectiles, settings.m_iNumWeapons, *settings.m_CsvPath);
+	}
+}
+
+void ASafetyFirstBenchmark::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+
+	if (m_bFinished)
+	{
+		return;
+	}
+
+	if (!m_bLoadSpawned)
+	{
+		SpawnLoad();
+	}
+
+	m_fElapsed += _fDt;
+	DriveBot(m_fElapsed, _fDt);
+	KeepProjectilesAlive();
+	KeepWeaponsFlying();
+
+	if (m_fElapsed > m_Settings.m_fWarmup)
+	{
+		Record(_fDt);
+	}
+
+	if (m_fElapsed >= m_Settings.m_fWarmup + m_Settings.m_fDuration)
+	{
+		Finish();
+	}
+}
+
+void ASafetyFirstBenchmark::SpawnLoad()
+{
+	m_bLoadSpawned = true;
+	UWorld* world = GetWorld();
+
+	m_Bot = Cast<ASafetyFirstPawn>(UGameplayStatics::GetPlayerPawn(world, 0));
+	const FVector vCenter = m_Bot.IsValid() ? m_Bot->GetActorLocation() : FVector::ZeroVector;
+
+	// The player controller must read our input after we wrote it
+	if (APlayerController* controller = UGameplayStatics::GetPlayerController(world, 0))
+	{
+		controller->AddTickPrerequisiteActor(this);
+	}
+
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	UClass* aiClass = LoadClass<AActor>(nullptr, *m_Settings.m_AIClassPath);
+	if (aiClass == nullptr)
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Benchmark: could not load AI class %s, using ASafetyFirstCrowdAgent"), *m_Settings.m_AIClassPath);
+		aiClass = ASafetyFirstCrowdAgent::StaticClass();
+	}
+
+	// Same significance handling as the enemies of the spawn director
+	ASafetyFirstSignificanceManager* significanceManager = ASafetyFirstSignificanceManager::Get(world);
+	for (int32 i = 0; i < m_Settings.m_iNumAI; ++i)
+	{
+		const FVector vOffset = m_Random.GetUnitVector().GetSafeNormal2D() * m_Random.FRandRange(1000.0f, 3000.0f);
+		if (AActor* ai = world->SpawnActor<AActor>(aiClass, vCenter + vOffset, FRotator::ZeroRotator, spawnInfo))
+		{
+			m_AI.Add(ai);
+			if (significanceManager != nullptr)
+			{
+				significanceManager->Register(ai, ESafetyFirstSignificanceType::Enemy);
+			}
+		}
+	}
+
+	UClass* weaponClass = (m_Bot.IsValid() && m_Bot->m_WeaponClass != nullptr) ? m_Bot->m_WeaponClass.Get() : ASafetyFirstWeapon::StaticClass();
+	for (int32 i = 0; i < m_Settings.m_iNumWeapons; ++i)
+	{
+		const FVector vOffset = FVector(m_Random.FRandRange(-2000.0f, 2000.0f), m_Random.FRandRange(-2000.0f, 2000.0f), 0.0f);
+		if (ASafetyFirstWeapon* weapon = world->SpawnActor<ASafetyFirstWeapon>(weaponClass, vCenter + vOffset, FRotator::ZeroRotator, spawnInfo))
+		{
+			m_Weapons.Add(weapon);
+			if (m_ProjectileClass == nullptr)
+			{
+				m_ProjectileClass = weapon->GetProjectileClass();
+			}
+		}
+	}
+	if (m_ProjectileClass == nullptr)
+	{
+		m_ProjectileClass = ASafetyFirstProjectile::StaticClass();
+	}
+}
+
+void ASafetyFirstBenchmark::DriveBot(float _fTime, float _fDt)
+{
+	if (!m_Bot.IsValid())
+	{
+		return;
+	}
+
+	// Fed to the pawn directly, so the run does not depend on the input bindings of the project
+	FSafetyFirstRecordedInput input;
+
+	// Wander in a slowly turning loop while the aim sweeps around
+	input.m_Axes[FSafetyFirstRecordedInput::MoveForward] = FMath::Sin(_fTime * 0.7f);
+	input.m_Axes[FSafetyFirstRecordedInput::MoveRight] = FMath::Cos(_fTime * 0.7f) * 0.8f;
+	input.m_Axes[FSafetyFirstRecordedInput::FireForward] = -FMath::Sin(_fTime * 2.0f);
+	input.m_Axes[FSafetyFirstRecordedInput::FireRight] = FMath::Cos(_fTime * 2.0f);
+
+	// Pull the trigger half a second out of every second, tap pickup in between
+	const float fPhase = FMath::Fmod(_fTime, 1.0f);
+	input.m_Axes[FSafetyFirstRecordedInput::Fire] = fPhase < 0.5f ? 1.0f : 0.0f;
+
+	const float fPreviousPhase = FMath::Fmod(_fTime - _fDt, 1.0f);
+	input.m_bPickUpPressed = fPreviousPhase < 0.6f && fPhase >= 0.6f;
+	input.m_bPickUpReleased = fPreviousPhase < 0.7f && fPhase >= 0.7f;
+
+	m_Bot->SetScriptedInput(input);
+}
+
+void ASafetyFirstBenchmark::KeepProjectilesAlive()
+{
+	ASafetyFirstProjectilePool* pool = ASafetyFirstProjectilePool::Get(GetWorld());
+	if (pool == nullptr || m_ProjectileClass == nullptr)
+	{
+		return;
+	}
+
+	const FVector vCenter = m_Bot.IsValid() ? m_Bot->GetActorLocation() : FVector::ZeroVector;
+	const int32 iMissing = m_Settings.m_iNumProjectiles - pool->GetStats(m_ProjectileClass).m_iActive;
+	for (int32 i = 0; i < iMissing; ++i)
+	{
+		const FVector vLocation = vCenter + FVector(m_Random.FRandRange(-2500.0f, 2500.0f), m_Random.FRandRange(-2500.0f, 2500.0f), 50.0f);
+		pool->Acquire(m_ProjectileClass, vLocation, FRotator(0.0f, m_Random.FRandRange(0.0f, 360.0f), 0.0f));
+	}
+}
+
+void ASafetyFirstBenchmark::KeepWeaponsFlying()
+{
+	for (ASafetyFirstWeapon* weapon : m_Weapons)
+	{
+		if (weapon != nullptr && !weapon->IsRecoiling() && weapon->GetWeaponOwner() == nullptr)
+		{
+			weapon->RecoilLauncher(m_Random.GetUnitVector().GetSafeNormal2D());
+		}
+	}
+}
+
+void ASafetyFirstBenchmark::Record(float _fDt)
+{
+	UWorld* world = GetWorld();
+
+	FFrameSample sample;
+	sample.m_fFrameMs = _fDt * 1000.0f;
+	sample.m_fGameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	sample.m_iTickingActors = 0;
+	sample.m_iActors = 0;
+	for (FActorIterator it(world); it; ++it)
+	{
+		++sample.m_iActors;
+		sample.m_iTickingActors += it->PrimaryActorTick.IsTickFunctionEnabled() ? 1 : 0;
+	}
+
+	ASafetyFirstProjectilePool* pool = ASafetyFirstProjectilePool::Get(world);
+	ASafetyFirstBulkProjectileManager* bulk = ASafetyFirstBulkProjectileManager::Get(world);
+	sample.m_iProjectiles = (pool != nullptr ? pool->GetStats(m_ProjectileClass).m_iActive : 0) + (bulk != nullptr ? bulk->GetNumLiveBullets() : 0);
+	sample.m_iAI = m_AI.Num();
+	sample.m_iThrownWeapons = 0;
+	for (ASafetyFirstWeapon* weapon : m_Weapons)
+	{
+		sample.m_iThrownWeapons += (weapon != nullptr && weapon->IsRecoiling()) ? 1 : 0;
+	}
+
+	m_Samples.Add(sample);
+}
+
+static float Percentile(TArray<float>& _SortedValues, float _fPercentile)
+{
+	if (_SortedValues.Num() == 0)
+	{
+		return 0.0f;
+	}
+	const int32 iIndex = FMath::Clamp(FMath::CeilToInt(_fPercentile * _SortedValues.Num()) - 1, 0, _SortedValues.Num() - 1);
+	return _SortedValues[iIndex];
+}
+
+void ASafetyFirstBenchmark::Finish()
+{
+	m_bFinished = true;
+
+	FString csv = TEXT("frame,frame_ms,game_thread_ms,ticking_actors,actors,projectiles,ai,thrown_weapons\n");
+	TArray<float> frameMs;
+	TArray<float> gameThreadMs;
+	for (int32 i = 0; i < m_Samples.Num(); ++i)
+	{
+		const FFrameSample& sample = m_Samples[i];
+		csv += FString::Printf(TEXT("%d,%.3f,%.3f,%d,%d,%d,%d,%d\n"), i, sample.m_fFrameMs, sample.m_fGameThreadMs,
+			sample.m_iTickingActors, sample.m_iActors, sample.m_iProjectiles, sample.m_iAI, sample.m_iThrownWeapons);
+		frameMs.Add(sample.m_fFrameMs);
+		gameThreadMs.Add(sample.m_fGameThreadMs);
+	}
+	frameMs.Sort();
+	gameThreadMs.Sort();
+
+	TMap<FString, float> summary;
+	summary.Add(TEXT("frames"), (float)m_Samples.Num());
+	const float percentiles[] = { 0.5f, 0.9f, 0.95f, 0.99f, 1.0f };
+	const TCHAR* percentileNames[] = { TEXT("p50"), TEXT("p90"), TEXT("p95"), TEXT("p99"), TEXT("max") };
+	for (int32 i = 0; i < ARRAY_COUNT(percentiles); ++i)
+	{
+		summary.Add(FString::Printf(TEXT("frame_ms_%s"), percentileNames[i]), Percentile(frameMs, percentiles[i]));
+		summary.Add(FString::Printf(TEXT("game_thread_ms_%s"), percentileNames[i]), Percentile(gameThreadMs, percentiles[i]));
+	}
+
+	// Cost of one move through the 2D solver against the sweeps it replaces, with as many movers as AI
+	const FSafetyFirstMoveCost moveCost = ASafetyFirstCollision2D::MeasureMoveCost(GetWorld(), m_Settings.m_iNumAI, 20);
+	summary.Add(TEXT("move_2d_us"), moveCost.m_fSolverMicroseconds);
+	summary.Add(TEXT("move_sweep_us"), moveCost.m_fSweepMicroseconds);
+
+	// Server side rewind with as many agents as AI and a full game of 8 players
+	const FSafetyFirstRewindCost rewindCost = ASafetyFirstLagCompensation::MeasureRewindCost(m_Settings.m_iNumAI, 8, 10);
+	summary.Add(TEXT("rewind_sweep_us"), rewindCost.m_fQueryMicroseconds);
+	summary.Add(TEXT("rewind_record_us"), rewindCost.m_fRecordMicroseconds);
+	summary.Add(TEXT("rewind_memory_kb"), rewindCost.m_uMemoryBytes / 1024.0f);
+
+	// Aim assist at the horde size it is budgeted for, whatever the scenario spawned
+	const FSafetyFirstAimCost aimCost = FSafetyFirstAimTargets::MeasureQueryCost(1000, 1000);
+	summary.Add(TEXT("aim_assist_us"), aimCost.m_fQueryMicroseconds);
+
+	// Telemetry records pushed from as many threads as the hot paths can run on
+	summary.Add(TEXT("telemetry_record_ns"), SafetyFirstTelemetry::MeasureRecordCost(1000000, 4));
+
+	const bool bPassed = m_Settings.m_BaselinePath.IsEmpty() || CompareToBaseline(summary);
+
+	FString summaryCsv = TEXT("metric,value\n");
+	for (const TPair<FString, float>& pair : summary)
+	{
+		summaryCsv += FString::Printf(TEXT("%s,%.3f\n"), *pair.Key, pair.Value);
+	}
+	summaryCsv += FString::Printf(TEXT("result,%s\n"), bPassed ? TEXT("PASS") : TEXT("FAIL"));
+
+	const FString summaryPath = FPaths::ChangeExtension(m_Settings.m_CsvPath, TEXT("summary.csv"));
+	FFileHelper::SaveStringToFile(csv, *m_Settings.m_CsvPath);
+	FFileHelper::SaveStringToFile(summaryCsv, *summaryPath);
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Benchmark done: %d frames, game thread p50 %.2f ms p95 %.2f ms p99 %.2f ms, written to %s"),
+		m_Samples.Num(), summary[TEXT("game_thread_ms_p50")], summary[TEXT("game_thread_ms_p95")], summary[TEXT("game_thread_ms_p99")], *m_Settings.m_CsvPath);
+	if (!bPassed)
+	{
+		UE_LOG(LogSafetyFirst, Error, TEXT("Benchmark FAILED: regression beyond %.1f%% against %s"), m_Settings.m_fRegressionThreshold, *m_Settings.m_BaselinePath);
+	}
+
+	FPlatformMisc::RequestExit(/*Force*/false);
+}
+
+bool ASafetyFirstBenchmark::CompareToBaseline(const TMap<FString, float>& _Summary) const
+{
+	TArray<FString> lines;
+	if (!FFileHelper::LoadFileToStringArray(lines, *m_Settings.m_BaselinePath))
+	{
+		UE_LOG(LogSafetyFirst, Error, TEXT("Benchmark: could not read baseline %s"), *m_Settings.m_BaselinePath);
+		return false;
+	}
+
+	TMap<FString, float> baseline;
+	for (const FString& line : lines)
+	{
+		FString key;
+		FString value;
+		if (line.Split(TEXT(","), &key, &value) && value.IsNumeric())
+		{
+			baseline.Add(key, FCString::Atof(*value));
+		}
+	}
+
+	// Compare the stable percentiles only, max is too noisy to gate on
+	static const TCHAR* GatedMetrics[] = { TEXT("game_thread_ms_p50"), TEXT("game_thread_ms_p95"), TEXT("game_thread_ms_p99"), TEXT("frame_ms_p95") };
+	const float fAllowed = 1.0f + m_Settings.m_fRegressionThreshold * 0.01f;
+	bool bPassed = true;
+	for (const TCHAR* metric : GatedMetrics)
+	{
+		const float* fBase = baseline.Find(metric);
+		const float* fCurrent = _Summary.Find(metric);
+		if (fBase == nullptr || fCurrent == nullptr)
+		{
+			continue;
+		}
+
+		const bool bRegressed = *fCurrent > *fBase * fAllowed;
+		bPassed &= !bRegressed;
+		UE_LOG(LogSafetyFirst, Display, TEXT("  %s: %.3f vs baseline %.3f (%+.1f%%)%s"), metric, *fCurrent, *fBase,
+			*fBase > 0.0f ? (*fCurrent / *fBase - 1.0f) * 100.0f : 0.0f, bRegressed ? TEXT(" REGRESSION") : TEXT(""));
+	}
+	return bPassed;
+}
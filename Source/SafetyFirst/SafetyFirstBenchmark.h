@@ -0,0 +1,92 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstBenchmark.generated.h"
+
+class ASafetyFirstPawn;
+class ASafetyFirstWeapon;
+
+/** Settings of a benchmark run, read from the command line */
+struct FSafetyFirstBenchmarkSettings
+{
+	float m_fDuration = 30.0f;
+	float m_fWarmup = 2.0f;
+	int32 m_iNumAI = 200;
+	int32 m_iNumProjectiles = 300;
+	int32 m_iNumWeapons = 50;
+	FString m_AIClassPath = TEXT("/Game/AI/BP_SimpleFollowAI.BP_SimpleFollowAI_C");
+	FString m_CsvPath;
+	FString m_BaselinePath;
+	/** Allowed slowdown against the baseline, in percent */
+	float m_fRegressionThreshold = 10.0f;
+	int32 m_iSeed = 0x5AFE;
+
+	/** Fills the settings from the command line, returns false if the benchmark was not requested */
+	bool ParseCommandLine(const TCHAR* _CommandLine);
+};
+
+/**
+ * Reproducible gameplay benchmark. Started by the game mode when the command line has -SafetyFirstBench, e.g.:
+ *   UE4Editor SafetyFirst.uproject /Game/TwinStickCPP/Maps/TwinStickExampleMap -game -nullrhi -unattended -benchmark -fps=60
+ *     -SafetyFirstBench -BenchDuration=60 -BenchAI=500 -BenchProjectiles=1000 -BenchWeapons=200
+ *     -BenchCsv=Saved/Profiling/run.csv -BenchBaseline=Saved/Profiling/baseline.summary.csv -BenchThreshold=10
+ * Spawns the synthetic load, drives the first player pawn with scripted axes and pickup presses, fed to it in place of
+ * the input bindings, records one CSV row per frame and writes percentile summaries next to it, along with the cost of a move
+ * through ASafetyFirstCollision2D and through PhysX sweeps, then quits.
+ */
+UCLASS(notplaceable, Transient)
+class ASafetyFirstBenchmark : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstBenchmark();
+
+	/** Spawns the benchmark if the command line asks for it */
+	static void StartFromCommandLine(UWorld* _World);
+
+	virtual void Tick(float _fDt) override;
+
+private:
+	struct FFrameSample
+	{
+		float m_fFrameMs;
+		float m_fGameThreadMs;
+		int32 m_iTickingActors;
+		int32 m_iActors;
+		int32 m_iProjectiles;
+		int32 m_iAI;
+		int32 m_iThrownWeapons;
+	};
+
+	void SpawnLoad();
+	void DriveBot(float _fTime, float _fDt);
+	void KeepProjectilesAlive();
+	void KeepWeaponsFlying();
+	void Record(float _fDt);
+	void Finish();
+	bool CompareToBaseline(const TMap<FString, float>& _Summary) const;
+
+	FSafetyFirstBenchmarkSettings m_Settings;
+	FRandomStream m_Random;
+
+	float m_fElapsed = 0.0f;
+	bool m_bLoadSpawned = false;
+	bool m_bFinished = false;
+
+	TWeakObjectPtr<ASafetyFirstPawn> m_Bot;
+
+	UPROPERTY()
+	TArray<AActor*> m_AI;
+
+	UPROPERTY()
+	TArray<ASafetyFirstWeapon*> m_Weapons;
+
+	UPROPERTY()
+	UClass* m_ProjectileClass = nullptr;
+
+	TArray<FFrameSample> m_Samples;
+};
@@ -0,0 +1,352 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstBulkProjectileManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstProjectile.h"
+#include "SafetyFirstWeapon.h"
+#include "SafetyFirstDamageManager.h"
+#include "SafetyFirstFixedStep.h"
+#include "SafetyFirstImpactEffects.h"
+#include "SafetyFirstLagCompensation.h"
+#include "SafetyFirstTelemetry.h"
+#include "SafetyFirstWorldManager.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/VectorRegister.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Bulk projectiles live"), STAT_SafetyFirst_BulkLive, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bulk projectile hits"), STAT_SafetyFirst_BulkHits, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Bulk projectiles tick"), STAT_SafetyFirst_BulkTick, STATGROUP_SafetyFirst);
+
+static int32 GSafetyFirstForceBulkProjectiles = 0;
+static FAutoConsoleVariableRef CVarSafetyFirstForceBulkProjectiles(
+	TEXT("SafetyFirst.BulkProjectiles"),
+	GSafetyFirstForceBulkProjectiles,
+	TEXT("1 makes every weapon fire bulk projectiles, 0 leaves the choice to each weapon"),
+	ECVF_Default);
+
+/** The Projectile object channel declared in DefaultEngine.ini */
+static const ECollisionChannel ProjectileChannel = ECC_GameTraceChannel1;
+
+ASafetyFirstBulkProjectileManager::ASafetyFirstBulkProjectileManager()
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	m_InstancedMeshComponent = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("BulletInstances"));
+	m_InstancedMeshComponent->SetCollisionProfileName("NoCollision");
+	m_InstancedMeshComponent->SetGenerateOverlapEvents(false);
+	m_InstancedMeshComponent->SetMobility(EComponentMobility::Movable);
+	RootComponent = m_InstancedMeshComponent;
+
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+ASafetyFirstBulkProjectileManager* ASafetyFirstBulkProjectileManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstBulkProjectileManager>(_World);
+}
+
+bool ASafetyFirstBulkProjectileManager::IsForcedOn()
+{
+	return GSafetyFirstForceBulkProjectiles != 0;
+}
+
+bool ASafetyFirstBulkProjectileManager::Fire(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass, const FVector& _vLocation, const FRotator& _Rotation, AActor* _Owner)
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	if (_ProjectileClass == nullptr || m_PosX.Num() >= m_iMaxBullets)
+	{
+		return false;
+	}
+
+	const ASafetyFirstProjectile* defaults = _ProjectileClass->GetDefaultObject<ASafetyFirstProjectile>();
+	const UStaticMeshComponent* meshComponent = defaults->GetProjectileMesh();
+	UStaticMesh* mesh = defaults->GetMeshAsset();
+
+	if (m_InstancedMeshComponent->GetStaticMesh() == nullptr && mesh != nullptr)
+	{
+		m_InstancedMeshComponent->SetStaticMesh(mesh);
+		m_vMeshScale = meshComponent->RelativeScale3D;
+	}
+
+	const float fRadius = mesh != nullptr ? mesh->GetBounds().SphereRadius * meshComponent->RelativeScale3D.GetAbsMax() : 1.0f;
+	const FVector vVelocity = _Rotation.Vector() * defaults->GetProjectileMovement()->InitialSpeed;
+
+	m_PosX.Add(_vLocation.X);
+	m_PosY.Add(_vLocation.Y);
+	m_PosZ.Add(_vLocation.Z);
+	m_VelX.Add(vVelocity.X);
+	m_VelY.Add(vVelocity.Y);
+	m_VelZ.Add(vVelocity.Z);
+	m_LifeLeft.Add(defaults->InitialLifeSpan > 0.0f ? defaults->InitialLifeSpan : BIG_NUMBER);
+	m_Radius.Add(fRadius);
+	m_Damage.Add(defaults->m_fDamage);
+	m_Rotation.Add(vVelocity.ToOrientationQuat());
+	m_Owner.Add(_Owner);
+	m_Trace.Add(FTraceHandle());
+	m_Dead.Add(false);
+
+	INC_DWORD_STAT(STAT_SafetyFirst_BulkLive);
+	SafetyFirstCounters::AddLiveProjectiles(1);
+	return true;
+}
+
+void ASafetyFirstBulkProjectileManager::Tick(float _fDt)
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_BulkTick, BulkProjectiles);
+
+	// Traces submitted last frame are ready now, even when this frame runs no step
+	ResolveTraces();
+
+	if (!m_FixedStep.IsValid())
+	{
+		m_FixedStep = ASafetyFirstFixedStep::Get(GetWorld());
+	}
+	ASafetyFirstFixedStep* fixedStep = m_FixedStep.Get();
+	const int32 iSteps = fixedStep != nullptr ? fixedStep->GetNumSteps() : 1;
+	const float fStepSeconds = fixedStep != nullptr ? fixedStep->GetStepSeconds() : _fDt;
+
+	for (int32 iStep = 0; iStep < iSteps; ++iStep)
+	{
+		for (int32 i = m_PosX.Num() - 1; i >= 0; --i)
+		{
+			m_LifeLeft[i] -= fStepSeconds;
+			if (m_Dead[i] || m_LifeLeft[i] <= 0.0f)
+			{
+				RemoveBullet(i);
+			}
+		}
+
+		Integrate(fStepSeconds);
+	}
+
+	// One sweep over the steps of the frame
+	if (iSteps > 0)
+	{
+		SubmitTraces(iSteps * fStepSeconds);
+	}
+
+	const float fAlpha = fixedStep != nullptr ? fixedStep->GetAlpha() : 1.0f;
+	UpdateInstances((1.0f - fAlpha) * fStepSeconds);
+}
+
+void ASafetyFirstBulkProjectileManager::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	DEC_DWORD_STAT_BY(STAT_SafetyFirst_BulkLive, m_PosX.Num());
+	SafetyFirstCounters::AddLiveProjectiles(-m_PosX.Num());
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstBulkProjectileManager::ResolveTraces()
+{
+	UWorld* world = GetWorld();
+	FTraceDatum datum;
+	for (int32 i = 0; i < m_Trace.Num(); ++i)
+	{
+		if (!m_Trace[i].IsValid())
+		{
+			continue;
+		}
+
+		if (world->QueryTraceData(m_Trace[i], datum))
+		{
+			const FHitResult* traceHit = datum.OutHits.FindByPredicate([](const FHitResult& _Hit) { return _Hit.bBlockingHit; });
+			FHitResult rewoundHit;
+			if (RewindTrace(i, datum, traceHit, rewoundHit))
+			{
+				HandleHit(i, rewoundHit);
+			}
+			else if (traceHit != nullptr)
+			{
+				HandleHit(i, *traceHit);
+			}
+		}
+		m_Trace[i] = FTraceHandle();
+	}
+}
+
+bool ASafetyFirstBulkProjectileManager::RewindTrace(int32 _iIndex, const FTraceDatum& _Datum, const FHitResult*& _InOutTraceHit, FHitResult& _OutHit)
+{
+	ASafetyFirstWeapon* weapon = Cast<ASafetyFirstWeapon>(m_Owner[_iIndex].Get());
+	const APawn* shooter = weapon != nullptr ? Cast<APawn>(weapon->GetWeaponOwner()) : nullptr;
+	if (shooter == nullptr)
+	{
+		return false;
+	}
+
+	if (!m_LagCompensation.IsValid())
+	{
+		m_LagCompensation = ASafetyFirstLagCompensation::Get(GetWorld());
+	}
+
+	float fRewindTime;
+	if (!m_LagCompensation.IsValid() || !m_LagCompensation->GetRewindTime(shooter, fRewindTime))
+	{
+		return false;
+	}
+
+	// Compensated actors are only hit where the remote shooter saw them, the rest of the world where it is now
+	if (_InOutTraceHit != nullptr && m_LagCompensation->IsCompensated(_InOutTraceHit->GetActor()))
+	{
+		_InOutTraceHit = nullptr;
+	}
+
+	float fFraction;
+	AActor* actor = m_LagCompensation->RewindSweep(fRewindTime, _Datum.Start, _Datum.End, m_Radius[_iIndex], shooter, fFraction);
+	if (actor == nullptr || (_InOutTraceHit != nullptr && _InOutTraceHit->Time < fFraction))
+	{
+		return false;
+	}
+
+	const FVector vLocation = FMath::Lerp(_Datum.Start, _Datum.End, fFraction);
+	const FVector vNormal = -(_Datum.End - _Datum.Start).GetSafeNormal();
+	_OutHit = FHitResult(actor, Cast<UPrimitiveComponent>(actor->GetRootComponent()), vLocation, vNormal);
+	_OutHit.Time = fFraction;
+	_OutHit.bBlockingHit = true;
+	_OutHit.TraceStart = _Datum.Start;
+	_OutHit.TraceEnd = _Datum.End;
+	return true;
+}
+
+void ASafetyFirstBulkProjectileManager::Integrate(float _fDt)
+{
+	const int32 iNum = m_PosX.Num();
+	const int32 iNumVectorized = iNum & ~3;
+
+	float* RESTRICT posX = m_PosX.GetData();
+	float* RESTRICT posY = m_PosY.GetData();
+	float* RESTRICT posZ = m_PosZ.GetData();
+	const float* RESTRICT velX = m_VelX.GetData();
+	const float* RESTRICT velY = m_VelY.GetData();
+	const float* RESTRICT velZ = m_VelZ.GetData();
+
+	// Four bullets per register, position += velocity * dt
+	const VectorRegister dt = VectorSetFloat1(_fDt);
+	for (int32 i = 0; i < iNumVectorized; i += 4)
+	{
+		VectorStore(VectorMultiplyAdd(VectorLoad(velX + i), dt, VectorLoad(posX + i)), posX + i);
+		VectorStore(VectorMultiplyAdd(VectorLoad(velY + i), dt, VectorLoad(posY + i)), posY + i);
+		VectorStore(VectorMultiplyAdd(VectorLoad(velZ + i), dt, VectorLoad(posZ + i)), posZ + i);
+	}
+
+	for (int32 i = iNumVectorized; i < iNum; ++i)
+	{
+		posX[i] += velX[i] * _fDt;
+		posY[i] += velY[i] * _fDt;
+		posZ[i] += velZ[i] * _fDt;
+	}
+}
+
+void ASafetyFirstBulkProjectileManager::SubmitTraces(float _fDt)
+{
+	UWorld* world = GetWorld();
+	for (int32 i = 0; i < m_PosX.Num(); ++i)
+	{
+		const FVector vEnd(m_PosX[i], m_PosY[i], m_PosZ[i]);
+		const FVector vStart = vEnd - FVector(m_VelX[i], m_VelY[i], m_VelZ[i]) * _fDt;
+
+		FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SafetyFirstBulkProjectile), /*bTraceComplex*/false, this);
+		if (AActor* owner = m_Owner[i].Get())
+		{
+			queryParams.AddIgnoredActor(owner);
+			if (ASafetyFirstWeapon* weapon = Cast<ASafetyFirstWeapon>(owner))
+			{
+				queryParams.AddIgnoredActor(weapon->GetWeaponOwner());
+			}
+		}
+
+		m_Trace[i] = world->AsyncSweepByChannel(EAsyncTraceType::Single, vStart, vEnd, ProjectileChannel, FCollisionShape::MakeSphere(m_Radius[i]), queryParams);
+	}
+}
+
+void ASafetyFirstBulkProjectileManager::UpdateInstances(float _fBehindSeconds)
+{
+	const int32 iNum = m_PosX.Num();
+
+	while (m_InstancedMeshComponent->GetInstanceCount() > iNum)
+	{
+		m_InstancedMeshComponent->RemoveInstance(m_InstancedMeshComponent->GetInstanceCount() - 1);
+	}
+	while (m_InstancedMeshComponent->GetInstanceCount() < iNum)
+	{
+		m_InstancedMeshComponent->AddInstanceWorldSpace(FTransform::Identity);
+	}
+
+	for (int32 i = 0; i < iNum; ++i)
+	{
+		// Bullets fly straight, going back along the velocity is the same as blending the last two steps
+		const FVector vLocation = FVector(m_PosX[i], m_PosY[i], m_PosZ[i]) - FVector(m_VelX[i], m_VelY[i], m_VelZ[i]) * _fBehindSeconds;
+		const FTransform transform(m_Rotation[i], vLocation, m_vMeshScale);
+		m_InstancedMeshComponent->UpdateInstanceTransform(i, transform, /*bWorldSpace*/true, /*bMarkRenderStateDirty*/false, /*bTeleport*/true);
+	}
+
+	// One render state update for the whole batch
+	m_InstancedMeshComponent->MarkRenderStateDirty();
+}
+
+void ASafetyFirstBulkProjectileManager::RemoveBullet(int32 _iIndex)
+{
+	m_PosX.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_PosY.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_PosZ.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_VelX.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_VelY.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_VelZ.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_LifeLeft.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_Radius.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_Damage.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_Rotation.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_Owner.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	m_Trace.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+
+	const int32 iLast = m_Dead.Num() - 1;
+	m_Dead[_iIndex] = m_Dead[iLast];
+	m_Dead.RemoveAt(iLast);
+
+	DEC_DWORD_STAT(STAT_SafetyFirst_BulkLive);
+	SafetyFirstCounters::AddLiveProjectiles(-1);
+}
+
+void ASafetyFirstBulkProjectileManager::HandleHit(int32 _iIndex, const FHitResult& _Hit)
+{
+	const FVector vVelocity(m_VelX[_iIndex], m_VelY[_iIndex], m_VelZ[_iIndex]);
+
+	// Same rule as ASafetyFirstProjectile::OnHit: damage and the impulse on physics bodies are resolved after physics
+	AActor* otherActor = _Hit.GetActor();
+	UPrimitiveComponent* otherComp = _Hit.GetComponent();
+	if (!m_DamageManager.IsValid())
+	{
+		m_DamageManager = ASafetyFirstDamageManager::Get(GetWorld());
+	}
+	if (otherActor != nullptr)
+	{
+		if (m_DamageManager.IsValid())
+		{
+			m_DamageManager->AddHit(otherActor, otherComp, _Hit.Location, vVelocity * 20.0f, m_Damage[_iIndex], m_Owner[_iIndex].Get());
+		}
+		else if ((otherComp != nullptr) && otherComp->IsSimulatingPhysics())
+		{
+			otherComp->AddImpulseAtLocation(vVelocity * 20.0f, _Hit.Location);
+		}
+		SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::Hit, otherActor, _Hit.ImpactPoint, m_Damage[_iIndex]);
+	}
+
+	if (!m_ImpactEffects.IsValid())
+	{
+		m_ImpactEffects = ASafetyFirstImpactEffects::Get(GetWorld());
+	}
+	if (m_ImpactEffects.IsValid())
+	{
+		m_ImpactEffects->AddImpact(ESafetyFirstImpactType::Projectile, _Hit.ImpactPoint, _Hit.ImpactNormal);
+	}
+
+	m_OnBulletHit.Broadcast(_Hit, vVelocity);
+	m_Dead[_iIndex] = true;
+	INC_DWORD_STAT(STAT_SafetyFirst_BulkHits);
+}
@@ -0,0 +1,97 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "WorldCollision.h"
+#include "SafetyFirstBulkProjectileManager.generated.h"
+
+class ASafetyFirstProjectile;
+class UInstancedStaticMeshComponent;
+
+/**
+ * Simulates "bulk" projectiles without one actor per bullet.
+ * Bullets live in structure-of-arrays buffers, are integrated in one vectorized pass per ASafetyFirstFixedStep step,
+ * swept against the world with one batch of async traces on the Projectile channel and rendered through a single
+ * instanced static mesh, between their last two steps.
+ * Speed, lifespan, mesh and collision radius are read from the defaults of the fired ASafetyFirstProjectile class.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstBulkProjectileManager : public AActor
+{
+	GENERATED_BODY()
+
+	/** Renders every live bullet */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Projectile, meta = (AllowPrivateAccess = "true"))
+	UInstancedStaticMeshComponent* m_InstancedMeshComponent;
+
+public:
+	ASafetyFirstBulkProjectileManager();
+
+	/** Returns the manager of the world, spawning it if needed */
+	static ASafetyFirstBulkProjectileManager* Get(UWorld* _World);
+
+	/** True when weapons should fire bulk projectiles even if they did not opt in */
+	static bool IsForcedOn();
+
+	/** Fires one bullet using the parameters of the projectile class, returns false if the manager is full */
+	bool Fire(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass, const FVector& _vLocation, const FRotator& _Rotation, AActor* _Owner);
+
+	/** Broadcast after a bullet hit something and queued its damage and impulse, with the hit and the bullet velocity */
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FOnBulkProjectileHit, const FHitResult&, const FVector&);
+	FOnBulkProjectileHit m_OnBulletHit;
+
+	int32 GetNumLiveBullets() const { return m_PosX.Num(); }
+
+	virtual void Tick(float _fDt) override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+
+	/** Hard limit on simultaneous bullets, extra shots are dropped */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxBullets = 8192;
+
+private:
+	void ResolveTraces();
+	void Integrate(float _fDt);
+	void SubmitTraces(float _fDt);
+	/** Draws the bullets _fBehindSeconds back along their velocity, between the last two steps */
+	void UpdateInstances(float _fBehindSeconds);
+	void RemoveBullet(int32 _iIndex);
+	void HandleHit(int32 _iIndex, const FHitResult& _Hit);
+
+	/**
+	 * On a server, tests a bullet of a remote player against the lag compensated actors as that player saw them.
+	 * Drops the trace hit if it is on a compensated actor, and returns true with _OutHit if the rewound hit comes first.
+	 */
+	bool RewindTrace(int32 _iIndex, const FTraceDatum& _Datum, const FHitResult*& _InOutTraceHit, FHitResult& _OutHit);
+
+	// Structure of arrays, all indexed by bullet
+	TArray<float> m_PosX;
+	TArray<float> m_PosY;
+	TArray<float> m_PosZ;
+	TArray<float> m_VelX;
+	TArray<float> m_VelY;
+	TArray<float> m_VelZ;
+	TArray<float> m_LifeLeft;
+	TArray<float> m_Radius;
+	TArray<float> m_Damage;
+	TArray<FQuat> m_Rotation;
+	TArray<TWeakObjectPtr<AActor>> m_Owner;
+	TArray<FTraceHandle> m_Trace;
+
+	/** Marks bullets to remove at the end of the resolve pass */
+	TBitArray<> m_Dead;
+
+	/** Scale of the mesh of the first fired class, the instanced mesh can only show one */
+	FVector m_vMeshScale = FVector::OneVector;
+
+	TWeakObjectPtr<class ASafetyFirstImpactEffects> m_ImpactEffects;
+
+	TWeakObjectPtr<class ASafetyFirstDamageManager> m_DamageManager;
+
+	TWeakObjectPtr<class ASafetyFirstLagCompensation> m_LagCompensation;
+
+	/** Clock of the integration steps, the bullets move once per frame without it */
+	TWeakObjectPtr<class ASafetyFirstFixedStep> m_FixedStep;
+};
@@ -0,0 +1,631 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstCollision2D.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "PhysicsEngine/BodySetup.h"
+
+DECLARE_CYCLE_STAT(TEXT("Collision 2D bake"), STAT_SafetyFirst_Collision2DBake, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpCollision2DStatsCmd(
+	TEXT("SafetyFirst.Collision2D.Stats"),
+	TEXT("Logs the shapes and cells baked by the 2D movement solver"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstCollision2D* collision = ASafetyFirstCollision2D::Get(_World))
+		{
+			collision->DumpStats();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GBenchCollision2DCmd(
+	TEXT("SafetyFirst.Collision2D.Bench"),
+	TEXT("Compares the cost of a move through the 2D solver and through PhysX sweeps. Arguments: [Agents] [MovesPerAgent]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& _Args, UWorld* _World)
+	{
+		const int32 iAgents = _Args.Num() > 0 ? FCString::Atoi(*_Args[0]) : 200;
+		const int32 iMoves = _Args.Num() > 1 ? FCString::Atoi(*_Args[1]) : 50;
+		const FSafetyFirstMoveCost cost = ASafetyFirstCollision2D::MeasureMoveCost(_World, iAgents, iMoves);
+		UE_LOG(LogSafetyFirst, Display, TEXT("Collision 2D: %d moves, solver %.3f us per move, sweeps %.3f us per move"),
+			cost.m_iMoves, cost.m_fSolverMicroseconds, cost.m_fSweepMicroseconds);
+	}));
+
+namespace
+{
+	/** Padding shapes sit here, far from anything a mover can reach */
+	const float FarAway = 1.0e7f;
+
+	/** Upper bound of the steps of one move, long moves get a coarser split */
+	const int32 MaxSteps = 16;
+
+	bool IsUpright(const FQuat& _Rotation)
+	{
+		return FMath::Abs(_Rotation.GetAxisZ().Z) > 0.99f;
+	}
+}
+
+FBox2D ASafetyFirstCollision2D::FBakedShape::GetBounds() const
+{
+	if (m_bCircle)
+	{
+		return FBox2D(m_vCenter - FVector2D(m_vHalfSize.X, m_vHalfSize.X), m_vCenter + FVector2D(m_vHalfSize.X, m_vHalfSize.X));
+	}
+
+	const FVector2D vExtent(
+		FMath::Abs(m_vAxis.X) * m_vHalfSize.X + FMath::Abs(m_vAxis.Y) * m_vHalfSize.Y,
+		FMath::Abs(m_vAxis.Y) * m_vHalfSize.X + FMath::Abs(m_vAxis.X) * m_vHalfSize.Y);
+	return FBox2D(m_vCenter - vExtent, m_vCenter + vExtent);
+}
+
+ASafetyFirstCollision2D::ASafetyFirstCollision2D()
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+ASafetyFirstCollision2D* ASafetyFirstCollision2D::Get(UWorld* _World)
+{
+	if (!GetDefault<ASafetyFirstCollision2D>()->m_bEnabled)
+	{
+		return nullptr;
+	}
+	return FindOrSpawnWorldManager<ASafetyFirstCollision2D>(_World);
+}
+
+void ASafetyFirstCollision2D::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	Super::BeginPlay();
+	Bake();
+}
+
+void ASafetyFirstCollision2D::Bake()
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_Collision2DBake, Collision2DBake);
+
+	int32 iNumComponents = 0;
+	m_Shapes.Reset();
+	GatherShapes(nullptr, m_Shapes, iNumComponents);
+	BuildCells(m_Shapes);
+
+	UE_LOG(LogSafetyFirst, Log, TEXT("Collision 2D baked: %d components, %d circles, %d boxes, %dx%d cells"),
+		iNumComponents, m_iNumCircles, m_iNumBoxes, m_iSizeX, m_iSizeY);
+}
+
+void ASafetyFirstCollision2D::Rebake(const FBox2D& _Bounds)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_Collision2DBake, Collision2DBake);
+
+	// A shape belongs to the area holding its center, so a blocker across two areas is neither lost nor doubled
+	const int32 iPreviousShapes = m_Shapes.Num();
+	m_Shapes.RemoveAllSwap([&_Bounds](const FBakedShape& _Shape)
+	{
+		return _Bounds.IsInside(_Shape.m_vCenter);
+	}, /*bAllowShrinking*/false);
+	const int32 iRemoved = iPreviousShapes - m_Shapes.Num();
+
+	TArray<FBakedShape> shapes;
+	int32 iNumComponents = 0;
+	GatherShapes(&_Bounds, shapes, iNumComponents);
+	int32 iAdded = 0;
+	for (const FBakedShape& shape : shapes)
+	{
+		if (_Bounds.IsInside(shape.m_vCenter))
+		{
+			m_Shapes.Add(shape);
+			++iAdded;
+		}
+	}
+
+	if (iRemoved > 0 || iAdded > 0)
+	{
+		BuildCells(m_Shapes);
+	}
+
+	UE_LOG(LogSafetyFirst, Log, TEXT("Collision 2D rebaked (%.0f, %.0f) to (%.0f, %.0f): %d shapes removed, %d added"),
+		_Bounds.Min.X, _Bounds.Min.Y, _Bounds.Max.X, _Bounds.Max.Y, iRemoved, iAdded);
+}
+
+void ASafetyFirstCollision2D::GatherShapes(const FBox2D* _Bounds, TArray<FBakedShape>& _OutShapes, int32& _OutNumComponents) const
+{
+	_OutNumComponents = 0;
+	int32 iNumSkipped = 0;
+
+	const auto OverlapsSlab = [this](float _fMinZ, float _fMaxZ)
+	{
+		return _fMaxZ >= m_fMinZ && _fMinZ <= m_fMaxZ;
+	};
+	const auto AddCircle = [&_OutShapes](const FVector& _vCenter, float _fRadius)
+	{
+		FBakedShape& shape = _OutShapes[_OutShapes.AddUninitialized()];
+		shape.m_vCenter = FVector2D(_vCenter.X, _vCenter.Y);
+		shape.m_vAxis = FVector2D(1.0f, 0.0f);
+		shape.m_vHalfSize = FVector2D(_fRadius, _fRadius);
+		shape.m_bCircle = true;
+	};
+	const auto AddBox = [&_OutShapes](const FVector& _vCenter, const FVector& _vAxisX, const FVector2D& _vHalfSize)
+	{
+		FBakedShape& shape = _OutShapes[_OutShapes.AddUninitialized()];
+		shape.m_vCenter = FVector2D(_vCenter.X, _vCenter.Y);
+		shape.m_vAxis = FVector2D(_vAxisX.X, _vAxisX.Y).GetSafeNormal();
+		shape.m_vHalfSize = _vHalfSize;
+		shape.m_bCircle = false;
+	};
+
+	// A whole bake walks every actor, an area only asks the physics scene for what overlaps its slab
+	TArray<UPrimitiveComponent*> components;
+	if (_Bounds == nullptr)
+	{
+		for (TActorIterator<AActor> it(GetWorld()); it; ++it)
+		{
+			TInlineComponentArray<UPrimitiveComponent*> actorComponents(*it);
+			components.Append(actorComponents);
+		}
+	}
+	else
+	{
+		TArray<FOverlapResult> overlaps;
+		const FVector vCenter(_Bounds->GetCenter(), (m_fMinZ + m_fMaxZ) * 0.5f);
+		const FVector vExtent(_Bounds->GetExtent(), FMath::Max((m_fMaxZ - m_fMinZ) * 0.5f, 1.0f));
+		GetWorld()->OverlapMultiByChannel(overlaps, vCenter, FQuat::Identity, ECC_Pawn, FCollisionShape::MakeBox(vExtent), FCollisionQueryParams(SCENE_QUERY_STAT(SafetyFirstCollision2DRebake), /*bTraceComplex*/false));
+		for (const FOverlapResult& overlap : overlaps)
+		{
+			if (UPrimitiveComponent* component = overlap.Component.Get())
+			{
+				components.AddUnique(component);
+			}
+		}
+	}
+
+	for (UPrimitiveComponent* component : components)
+	{
+		if (component->Mobility != EComponentMobility::Static || !component->IsQueryCollisionEnabled()
+			|| component->GetCollisionResponseToChannel(ECC_Pawn) != ECR_Block)
+		{
+			continue;
+		}
+
+		const FBox bounds = component->Bounds.GetBox();
+		if (!OverlapsSlab(bounds.Min.Z, bounds.Max.Z))
+		{
+			continue;
+		}
+
+		// Landscapes and other bodies without a body setup are floors, not blockers
+		const UBodySetup* bodySetup = component->GetBodySetup();
+		if (bodySetup == nullptr)
+		{
+			++iNumSkipped;
+			continue;
+		}
+
+		++_OutNumComponents;
+		const FTransform transform = component->GetComponentTransform();
+		const FVector vScale = transform.GetScale3D().GetAbs();
+		const FKAggregateGeom& geometry = bodySetup->AggGeom;
+		const int32 iFirstShape = _OutShapes.Num();
+		bool bUseBounds = geometry.GetElementCount() == 0;
+
+		for (const FKSphereElem& sphere : geometry.SphereElems)
+		{
+			const FVector vCenter = transform.TransformPosition(sphere.Center);
+			const float fRadius = sphere.Radius * vScale.GetMax();
+			if (OverlapsSlab(vCenter.Z - fRadius, vCenter.Z + fRadius))
+			{
+				AddCircle(vCenter, fRadius);
+			}
+		}
+
+		for (const FKSphylElem& capsule : geometry.SphylElems)
+		{
+			const FQuat rotation = transform.GetRotation() * capsule.Rotation.Quaternion();
+			bUseBounds |= !IsUpright(rotation);
+
+			const FVector vCenter = transform.TransformPosition(capsule.Center);
+			const float fRadius = capsule.Radius * FMath::Max(vScale.X, vScale.Y);
+			const float fHalfHeight = capsule.Length * 0.5f * vScale.Z + fRadius;
+			if (OverlapsSlab(vCenter.Z - fHalfHeight, vCenter.Z + fHalfHeight))
+			{
+				AddCircle(vCenter, fRadius);
+			}
+		}
+
+		for (const FKBoxElem& box : geometry.BoxElems)
+		{
+			const FQuat rotation = transform.GetRotation() * box.Rotation.Quaternion();
+			bUseBounds |= !IsUpright(rotation);
+
+			const FVector vCenter = transform.TransformPosition(box.Center);
+			const float fHalfHeight = box.Z * 0.5f * vScale.Z;
+			if (OverlapsSlab(vCenter.Z - fHalfHeight, vCenter.Z + fHalfHeight))
+			{
+				AddBox(vCenter, rotation.GetAxisX(), FVector2D(box.X * 0.5f * vScale.X, box.Y * 0.5f * vScale.Y));
+			}
+		}
+
+		// Convex hulls are approximated by their local box
+		for (const FKConvexElem& convex : geometry.ConvexElems)
+		{
+			const FTransform elementTransform = convex.GetTransform() * transform;
+			bUseBounds |= !IsUpright(elementTransform.GetRotation());
+
+			const FVector vCenter = elementTransform.TransformPosition(convex.ElemBox.GetCenter());
+			const FVector vHalfSize = convex.ElemBox.GetExtent() * elementTransform.GetScale3D().GetAbs();
+			if (OverlapsSlab(vCenter.Z - vHalfSize.Z, vCenter.Z + vHalfSize.Z))
+			{
+				AddBox(vCenter, elementTransform.GetRotation().GetAxisX(), FVector2D(vHalfSize.X, vHalfSize.Y));
+			}
+		}
+
+		// Tilted elements and complex only collision keep the component bounds, which is conservative
+		if (bUseBounds)
+		{
+			_OutShapes.SetNum(iFirstShape, /*bAllowShrinking*/false);
+			AddBox(bounds.GetCenter(), FVector::ForwardVector, FVector2D(bounds.GetExtent().X, bounds.GetExtent().Y));
+		}
+	}
+
+	if (iNumSkipped > 0)
+	{
+		UE_LOG(LogSafetyFirst, Log, TEXT("Collision 2D: %d static components without body setup left to PhysX"), iNumSkipped);
+	}
+}
+
+void ASafetyFirstCollision2D::BuildCells(const TArray<FBakedShape>& _Shapes)
+{
+	m_Cells.Reset();
+	m_CircleX.Reset();
+	m_CircleY.Reset();
+	m_CircleRadius.Reset();
+	m_BoxX.Reset();
+	m_BoxY.Reset();
+	m_BoxAxisX.Reset();
+	m_BoxAxisY.Reset();
+	m_BoxHalfX.Reset();
+	m_BoxHalfY.Reset();
+	m_iNumCircles = 0;
+	m_iNumBoxes = 0;
+	m_iSizeX = 0;
+	m_iSizeY = 0;
+
+	if (_Shapes.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<FBox2D> shapeBounds;
+	shapeBounds.Reserve(_Shapes.Num());
+	FBox2D worldBounds(ForceInit);
+	for (const FBakedShape& shape : _Shapes)
+	{
+		shapeBounds.Add(shape.GetBounds());
+		worldBounds += shapeBounds.Last();
+	}
+
+	// Huge levels get bigger cells rather than an unbounded grid
+	const FVector2D vWorldSize = worldBounds.GetSize();
+	const float fCellSize = FMath::Max3(m_fCellSize, vWorldSize.X / 1024.0f, vWorldSize.Y / 1024.0f);
+	m_fInvCellSize = 1.0f / fCellSize;
+	m_vOrigin = worldBounds.Min;
+	m_iSizeX = FMath::Max(FMath::CeilToInt(vWorldSize.X * m_fInvCellSize), 1);
+	m_iSizeY = FMath::Max(FMath::CeilToInt(vWorldSize.Y * m_fInvCellSize), 1);
+
+	// Shapes are copied in every cell they overlap, so a cell is one contiguous run per type
+	TArray<TArray<int32>> cellCircles;
+	TArray<TArray<int32>> cellBoxes;
+	cellCircles.SetNum(m_iSizeX * m_iSizeY);
+	cellBoxes.SetNum(m_iSizeX * m_iSizeY);
+	for (int32 i = 0; i < _Shapes.Num(); ++i)
+	{
+		const int32 iMinX = FMath::Clamp(FMath::FloorToInt((shapeBounds[i].Min.X - m_vOrigin.X) * m_fInvCellSize), 0, m_iSizeX - 1);
+		const int32 iMinY = FMath::Clamp(FMath::FloorToInt((shapeBounds[i].Min.Y - m_vOrigin.Y) * m_fInvCellSize), 0, m_iSizeY - 1);
+		const int32 iMaxX = FMath::Clamp(FMath::FloorToInt((shapeBounds[i].Max.X - m_vOrigin.X) * m_fInvCellSize), 0, m_iSizeX - 1);
+		const int32 iMaxY = FMath::Clamp(FMath::FloorToInt((shapeBounds[i].Max.Y - m_vOrigin.Y) * m_fInvCellSize), 0, m_iSizeY - 1);
+		for (int32 y = iMinY; y <= iMaxY; ++y)
+		{
+			for (int32 x = iMinX; x <= iMaxX; ++x)
+			{
+				(_Shapes[i].m_bCircle ? cellCircles : cellBoxes)[y * m_iSizeX + x].Add(i);
+			}
+		}
+		(_Shapes[i].m_bCircle ? m_iNumCircles : m_iNumBoxes)++;
+	}
+
+	m_Cells.SetNum(m_iSizeX * m_iSizeY);
+	for (int32 c = 0; c < m_Cells.Num(); ++c)
+	{
+		FCell& cell = m_Cells[c];
+
+		cell.m_iFirstCircle = m_CircleX.Num();
+		cell.m_iNumCircles = Align(cellCircles[c].Num(), 4);
+		for (int32 j = 0; j < cell.m_iNumCircles; ++j)
+		{
+			const bool bPadding = j >= cellCircles[c].Num();
+			const FBakedShape* shape = bPadding ? nullptr : &_Shapes[cellCircles[c][j]];
+			m_CircleX.Add(bPadding ? FarAway : shape->m_vCenter.X);
+			m_CircleY.Add(bPadding ? FarAway : shape->m_vCenter.Y);
+			m_CircleRadius.Add(bPadding ? 0.0f : shape->m_vHalfSize.X);
+		}
+
+		cell.m_iFirstBox = m_BoxX.Num();
+		cell.m_iNumBoxes = Align(cellBoxes[c].Num(), 4);
+		for (int32 j = 0; j < cell.m_iNumBoxes; ++j)
+		{
+			const bool bPadding = j >= cellBoxes[c].Num();
+			const FBakedShape* shape = bPadding ? nullptr : &_Shapes[cellBoxes[c][j]];
+			m_BoxX.Add(bPadding ? FarAway : shape->m_vCenter.X);
+			m_BoxY.Add(bPadding ? FarAway : shape->m_vCenter.Y);
+			m_BoxAxisX.Add(bPadding ? 1.0f : shape->m_vAxis.X);
+			m_BoxAxisY.Add(bPadding ? 0.0f : shape->m_vAxis.Y);
+			m_BoxHalfX.Add(bPadding ? 0.0f : shape->m_vHalfSize.X);
+			m_BoxHalfY.Add(bPadding ? 0.0f : shape->m_vHalfSize.Y);
+		}
+	}
+}
+
+FVector ASafetyFirstCollision2D::ResolveMove(const FVector& _vStart, const FVector& _vDelta, float _fRadius, FVector* _OutHitNormal) const
+{
+	if (_OutHitNormal != nullptr)
+	{
+		*_OutHitNormal = FVector::ZeroVector;
+	}
+	if (m_Cells.Num() == 0)
+	{
+		return _vStart + _vDelta;
+	}
+
+	// Steps shorter than half the radius cannot tunnel through a shape
+	const float fRadius = FMath::Max(_fRadius, 1.0f);
+	const FVector2D vDelta(_vDelta.X, _vDelta.Y);
+	const int32 iSteps = FMath::Clamp(FMath::CeilToInt(vDelta.Size() / (fRadius * 0.5f)), 1, MaxSteps);
+	const FVector2D vStep = vDelta / iSteps;
+
+	FVector2D vPosition(_vStart.X, _vStart.Y);
+	for (int32 s = 0; s < iSteps; ++s)
+	{
+		vPosition += vStep;
+
+		// Pushing out along the contact normal keeps the tangential part of the step, which slides
+		for (int32 i = 0; i < m_iMaxIterations; ++i)
+		{
+			FContact contact;
+			if (!FindDeepestContact(vPosition, fRadius, contact))
+			{
+				break;
+			}
+
+			vPosition += contact.m_vNormal * (contact.m_fDepth + m_fSkinWidth);
+			if (_OutHitNormal != nullptr)
+			{
+				*_OutHitNormal = FVector(contact.m_vNormal, 0.0f);
+			}
+		}
+	}
+
+	return FVector(vPosition.X, vPosition.Y, _vStart.Z + _vDelta.Z);
+}
+
+bool ASafetyFirstCollision2D::FindDeepestContact(const FVector2D& _vCenter, float _fRadius, FContact& _OutContact) const
+{
+	const int32 iMinX = FMath::Max(FMath::FloorToInt((_vCenter.X - _fRadius - m_vOrigin.X) * m_fInvCellSize), 0);
+	const int32 iMinY = FMath::Max(FMath::FloorToInt((_vCenter.Y - _fRadius - m_vOrigin.Y) * m_fInvCellSize), 0);
+	const int32 iMaxX = FMath::Min(FMath::FloorToInt((_vCenter.X + _fRadius - m_vOrigin.X) * m_fInvCellSize), m_iSizeX - 1);
+	const int32 iMaxY = FMath::Min(FMath::FloorToInt((_vCenter.Y + _fRadius - m_vOrigin.Y) * m_fInvCellSize), m_iSizeY - 1);
+
+	_OutContact.m_vNormal = FVector2D::ZeroVector;
+	_OutContact.m_fDepth = 0.0f;
+	for (int32 y = iMinY; y <= iMaxY; ++y)
+	{
+		for (int32 x = iMinX; x <= iMaxX; ++x)
+		{
+			// A shape spanning several cells is tested once per cell, it only finds the same contact again
+			const FCell& cell = m_Cells[y * m_iSizeX + x];
+			TestCircles(cell, _vCenter, _fRadius, _OutContact);
+			TestBoxes(cell, _vCenter, _fRadius, _OutContact);
+		}
+	}
+	return _OutContact.m_fDepth > 0.0f;
+}
+
+void ASafetyFirstCollision2D::TestCircles(const FCell& _Cell, const FVector2D& _vCenter, float _fRadius, FContact& _InOutContact) const
+{
+	const float* circleX = m_CircleX.GetData();
+	const float* circleY = m_CircleY.GetData();
+	const float* circleRadius = m_CircleRadius.GetData();
+
+	const VectorRegister vCenterX = VectorSetFloat1(_vCenter.X);
+	const VectorRegister vCenterY = VectorSetFloat1(_vCenter.Y);
+	const VectorRegister vRadius = VectorSetFloat1(_fRadius);
+
+	const int32 iEnd = _Cell.m_iFirstCircle + _Cell.m_iNumCircles;
+	for (int32 i = _Cell.m_iFirstCircle; i < iEnd; i += 4)
+	{
+		// Four circles at once, most groups are rejected here
+		const VectorRegister vDX = VectorSubtract(vCenterX, VectorLoadAligned(circleX + i));
+		const VectorRegister vDY = VectorSubtract(vCenterY, VectorLoadAligned(circleY + i));
+		const VectorRegister vDistSq = VectorMultiplyAdd(vDX, vDX, VectorMultiply(vDY, vDY));
+		const VectorRegister vReach = VectorAdd(vRadius, VectorLoadAligned(circleRadius + i));
+		const int32 iHits = VectorMaskBits(VectorCompareGT(VectorMultiply(vReach, vReach), vDistSq));
+		if (iHits == 0)
+		{
+			continue;
+		}
+
+		for (int32 iLane = 0; iLane < 4; ++iLane)
+		{
+			if ((iHits & (1 << iLane)) == 0)
+			{
+				continue;
+			}
+
+			const int32 j = i + iLane;
+			const FVector2D vAway(_vCenter.X - circleX[j], _vCenter.Y - circleY[j]);
+			const float fDist = vAway.Size();
+			const float fDepth = _fRadius + circleRadius[j] - fDist;
+			if (fDepth > _InOutContact.m_fDepth)
+			{
+				_InOutContact.m_fDepth = fDepth;
+				_InOutContact.m_vNormal = fDist > KINDA_SMALL_NUMBER ? vAway / fDist : FVector2D(1.0f, 0.0f);
+			}
+		}
+	}
+}
+
+void ASafetyFirstCollision2D::TestBoxes(const FCell& _Cell, const FVector2D& _vCenter, float _fRadius, FContact& _InOutContact) const
+{
+	const float* boxX = m_BoxX.GetData();
+	const float* boxY = m_BoxY.GetData();
+	const float* axisX = m_BoxAxisX.GetData();
+	const float* axisY = m_BoxAxisY.GetData();
+	const float* halfX = m_BoxHalfX.GetData();
+	const float* halfY = m_BoxHalfY.GetData();
+
+	const VectorRegister vCenterX = VectorSetFloat1(_vCenter.X);
+	const VectorRegister vCenterY = VectorSetFloat1(_vCenter.Y);
+	const VectorRegister vRadiusSq = VectorSetFloat1(_fRadius * _fRadius);
+
+	const int32 iEnd = _Cell.m_iFirstBox + _Cell.m_iNumBoxes;
+	for (int32 i = _Cell.m_iFirstBox; i < iEnd; i += 4)
+	{
+		// Circle center in the frame of each box, then distance to its clamp on the box
+		const VectorRegister vDX = VectorSubtract(vCenterX, VectorLoadAligned(boxX + i));
+		const VectorRegister vDY = VectorSubtract(vCenterY, VectorLoadAligned(boxY + i));
+		const VectorRegister vAxisX = VectorLoadAligned(axisX + i);
+		const VectorRegister vAxisY = VectorLoadAligned(axisY + i);
+		const VectorRegister vLocalX = VectorMultiplyAdd(vDX, vAxisX, VectorMultiply(vDY, vAxisY));
+		const VectorRegister vLocalY = VectorSubtract(VectorMultiply(vDY, vAxisX), VectorMultiply(vDX, vAxisY));
+		const VectorRegister vHalfX = VectorLoadAligned(halfX + i);
+		const VectorRegister vHalfY = VectorLoadAligned(halfY + i);
+		const VectorRegister vOutX = VectorSubtract(vLocalX, VectorMin(VectorMax(vLocalX, VectorNegate(vHalfX)), vHalfX));
+		const VectorRegister vOutY = VectorSubtract(vLocalY, VectorMin(VectorMax(vLocalY, VectorNegate(vHalfY)), vHalfY));
+		const VectorRegister vDistSq = VectorMultiplyAdd(vOutX, vOutX, VectorMultiply(vOutY, vOutY));
+		const int32 iHits = VectorMaskBits(VectorCompareGT(vRadiusSq, vDistSq));
+		if (iHits == 0)
+		{
+			continue;
+		}
+
+		for (int32 iLane = 0; iLane < 4; ++iLane)
+		{
+			if ((iHits & (1 << iLane)) == 0)
+			{
+				continue;
+			}
+
+			const int32 j = i + iLane;
+			const float fDX = _vCenter.X - boxX[j];
+			const float fDY = _vCenter.Y - boxY[j];
+			const float fLocalX = fDX * axisX[j] + fDY * axisY[j];
+			const float fLocalY = fDY * axisX[j] - fDX * axisY[j];
+			const float fOutX = fLocalX - FMath::Clamp(fLocalX, -halfX[j], halfX[j]);
+			const float fOutY = fLocalY - FMath::Clamp(fLocalY, -halfY[j], halfY[j]);
+			const float fDist = FMath::Sqrt(fOutX * fOutX + fOutY * fOutY);
+
+			FVector2D vLocalNormal;
+			float fDepth;
+			if (fDist > KINDA_SMALL_NUMBER)
+			{
+				vLocalNormal = FVector2D(fOutX, fOutY) / fDist;
+				fDepth = _fRadius - fDist;
+			}
+			else
+			{
+				// Center inside the box, leave through the closest side
+				const float fPenetrationX = halfX[j] - FMath::Abs(fLocalX);
+				const float fPenetrationY = halfY[j] - FMath::Abs(fLocalY);
+				vLocalNormal = fPenetrationX < fPenetrationY ? FVector2D(FMath::Sign(fLocalX) >= 0.0f ? 1.0f : -1.0f, 0.0f) : FVector2D(0.0f, FMath::Sign(fLocalY) >= 0.0f ? 1.0f : -1.0f);
+				fDepth = _fRadius + FMath::Min(fPenetrationX, fPenetrationY);
+			}
+
+			if (fDepth > _InOutContact.m_fDepth)
+			{
+				_InOutContact.m_fDepth = fDepth;
+				_InOutContact.m_vNormal = FVector2D(
+					vLocalNormal.X * axisX[j] - vLocalNormal.Y * axisY[j],
+					vLocalNormal.X * axisY[j] + vLocalNormal.Y * axisX[j]);
+			}
+		}
+	}
+}
+
+void ASafetyFirstCollision2D::DumpStats() const
+{
+	const int32 iNumFloats = m_CircleX.Num() * 3 + m_BoxX.Num() * 6;
+	UE_LOG(LogSafetyFirst, Display, TEXT("Collision 2D: %d circles, %d boxes, %dx%d cells of %.0f, %d padded copies, %.1f KB"),
+		m_iNumCircles, m_iNumBoxes, m_iSizeX, m_iSizeY, m_fInvCellSize > 0.0f ? 1.0f / m_fInvCellSize : 0.0f,
+		m_CircleX.Num() + m_BoxX.Num(), (iNumFloats * sizeof(float) + m_Cells.Num() * sizeof(FCell)) / 1024.0f);
+}
+
+FSafetyFirstMoveCost ASafetyFirstCollision2D::MeasureMoveCost(UWorld* _World, int32 _iAgents, int32 _iMovesPerAgent, float _fRadius)
+{
+	FSafetyFirstMoveCost cost;
+
+	// Measured even when the solver is disabled, to decide whether to enable it
+	ASafetyFirstCollision2D* solver = FindOrSpawnWorldManager<ASafetyFirstCollision2D>(_World);
+	if (solver == nullptr || _iAgents <= 0 || _iMovesPerAgent <= 0)
+	{
+		return cost;
+	}
+
+	const FBox2D area = solver->m_Cells.Num() > 0
+		? FBox2D(solver->m_vOrigin, solver->m_vOrigin + FVector2D(solver->m_iSizeX, solver->m_iSizeY) / solver->m_fInvCellSize)
+		: FBox2D(FVector2D(-5000.0f, -5000.0f), FVector2D(5000.0f, 5000.0f));
+	const float fZ = (solver->m_fMinZ + solver->m_fMaxZ) * 0.5f;
+
+	// Same agents and moves for both, a pawn at 1000 units per second and 60 fps
+	FRandomStream random(0x5AFE);
+	TArray<FVector> starts;
+	TArray<FVector> deltas;
+	for (int32 i = 0; i < _iAgents; ++i)
+	{
+		starts.Add(FVector(random.FRandRange(area.Min.X, area.Max.X), random.FRandRange(area.Min.Y, area.Max.Y), fZ));
+		const float fAngle = random.FRandRange(0.0f, 2.0f * PI);
+		deltas.Add(FVector(FMath::Cos(fAngle), FMath::Sin(fAngle), 0.0f) * (1000.0f / 60.0f));
+	}
+
+	TArray<FVector> positions = starts;
+	const double fSolverStart = FPlatformTime::Seconds();
+	for (int32 m = 0; m < _iMovesPerAgent; ++m)
+	{
+		for (int32 i = 0; i < _iAgents; ++i)
+		{
+			positions[i] = solver->ResolveMove(positions[i], deltas[i], _fRadius);
+		}
+	}
+	const double fSolverSeconds = FPlatformTime::Seconds() - fSolverStart;
+
+	// The sweeps of ASafetyFirstPawn::ApplyMovement, without the overlap updates MoveComponent adds on top
+	const FCollisionShape sphere = FCollisionShape::MakeSphere(_fRadius);
+	const FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SafetyFirstCollision2DBench), /*bTraceComplex*/false);
+	positions = starts;
+	const double fSweepStart = FPlatformTime::Seconds();
+	for (int32 m = 0; m < _iMovesPerAgent; ++m)
+	{
+		for (int32 i = 0; i < _iAgents; ++i)
+		{
+			FHitResult hit;
+			const FVector vEnd = positions[i] + deltas[i];
+			if (_World->SweepSingleByChannel(hit, positions[i], vEnd, FQuat::Identity, ECC_Pawn, sphere, queryParams) && hit.bBlockingHit)
+			{
+				const FVector vDeflection = FVector::VectorPlaneProject(deltas[i], hit.Normal.GetSafeNormal2D()) * (1.0f - hit.Time);
+				FHitResult deflectionHit;
+				_World->SweepSingleByChannel(deflectionHit, hit.Location, hit.Location + vDeflection, FQuat::Identity, ECC_Pawn, sphere, queryParams);
+				positions[i] = deflectionHit.bBlockingHit ? deflectionHit.Location : hit.Location + vDeflection;
+			}
+			else
+			{
+				positions[i] = vEnd;
+			}
+		}
+	}
+	const double fSweepSeconds = FPlatformTime::Seconds() - fSweepStart;
+
+	cost.m_iMoves = _iAgents * _iMovesPerAgent;
+	cost.m_fSolverMicroseconds = (float)(fSolverSeconds * 1000000.0 / cost.m_iMoves);
+	cost.m_fSweepMicroseconds = (float)(fSweepSeconds * 1000000.0 / cost.m_iMoves);
+	return cost;
+}
@@ -0,0 +1,137 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstCollision2D.generated.h"
+
+/** Average cost of one move, measured by ASafetyFirstCollision2D::MeasureMoveCost */
+struct FSafetyFirstMoveCost
+{
+	int32 m_iMoves = 0;
+	float m_fSolverMicroseconds = 0.0f;
+	float m_fSweepMicroseconds = 0.0f;
+};
+
+/**
+ * Kinematic movement on the play plane against the static blockers of the level.
+ * Static primitives blocking pawns are baked once into circles and boxes (AABBs are boxes with an identity axis)
+ * stored per grid cell in SIMD friendly arrays. A move is split in steps shorter than the mover radius and each step
+ * is pushed out of the deepest contact, which slides along walls. PhysX is only swept against dynamic bodies.
+ * Opt-in with m_bEnabled, the pawns and the crowd fall back to full sweeps otherwise.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstCollision2D : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstCollision2D();
+
+	/** Returns the solver of the world, spawning and baking it if needed. Null when the solver is disabled */
+	static ASafetyFirstCollision2D* Get(UWorld* _World);
+
+	/**
+	 * Moves a circle of the given radius by _vDelta on the play plane, Z is left untouched.
+	 * Returns the resolved location. Only reads baked data, safe to call from worker threads.
+	 */
+	FVector ResolveMove(const FVector& _vStart, const FVector& _vDelta, float _fRadius, FVector* _OutHitNormal = nullptr) const;
+
+	/** Bakes the static blockers of the whole world */
+	void Bake();
+
+	/** Bakes again the blockers centered in _Bounds only, for an area streamed in or out after the first bake */
+	void Rebake(const FBox2D& _Bounds);
+
+	void DumpStats() const;
+
+	/** Times random moves of _iAgents agents through the solver and through the equivalent PhysX sweeps */
+	static FSafetyFirstMoveCost MeasureMoveCost(UWorld* _World, int32 _iAgents, int32 _iMovesPerAgent, float _fRadius = 50.0f);
+
+	virtual void BeginPlay() override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	bool m_bEnabled = false;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCellSize = 400.0f;
+
+	/** Only blockers overlapping this height range are baked, the floor stays below it */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMinZ = 20.0f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxZ = 200.0f;
+
+	/** Push outs per step, a mover wedged in a corner needs two */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxIterations = 4;
+
+	/** Distance kept from the blockers after a push out */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fSkinWidth = 0.5f;
+
+private:
+	/** Shape before it is copied into the cells */
+	struct FBakedShape
+	{
+		FVector2D m_vCenter;
+		/** Unit X axis of a box, unused by circles */
+		FVector2D m_vAxis;
+		/** Half size of a box, X is the radius of a circle */
+		FVector2D m_vHalfSize;
+		bool m_bCircle;
+
+		FBox2D GetBounds() const;
+	};
+
+	/** Range of each shape type in the SoA arrays, padded to a multiple of 4 */
+	struct FCell
+	{
+		int32 m_iFirstCircle = 0;
+		int32 m_iNumCircles = 0;
+		int32 m_iFirstBox = 0;
+		int32 m_iNumBoxes = 0;
+	};
+
+	struct FContact
+	{
+		FVector2D m_vNormal;
+		float m_fDepth;
+	};
+
+	/** Gathers the shapes of every static blocker, or of the ones overlapping _Bounds when given */
+	void GatherShapes(const FBox2D* _Bounds, TArray<FBakedShape>& _OutShapes, int32& _OutNumComponents) const;
+	void BuildCells(const TArray<FBakedShape>& _Shapes);
+
+	/** Deepest contact of a circle against the shapes of the cells it overlaps */
+	bool FindDeepestContact(const FVector2D& _vCenter, float _fRadius, FContact& _OutContact) const;
+	void TestCircles(const FCell& _Cell, const FVector2D& _vCenter, float _fRadius, FContact& _InOutContact) const;
+	void TestBoxes(const FCell& _Cell, const FVector2D& _vCenter, float _fRadius, FContact& _InOutContact) const;
+
+	/** Every baked shape, kept so a rebake only gathers its own area again */
+	TArray<FBakedShape> m_Shapes;
+
+	int32 m_iSizeX = 0;
+	int32 m_iSizeY = 0;
+	FVector2D m_vOrigin = FVector2D::ZeroVector;
+	float m_fInvCellSize = 0.0f;
+	TArray<FCell> m_Cells;
+
+	// Circles, structure of arrays
+	TArray<float, TAlignedHeapAllocator<16>> m_CircleX;
+	TArray<float, TAlignedHeapAllocator<16>> m_CircleY;
+	TArray<float, TAlignedHeapAllocator<16>> m_CircleRadius;
+
+	// Boxes, structure of arrays
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxX;
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxY;
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxAxisX;
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxAxisY;
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxHalfX;
+	TArray<float, TAlignedHeapAllocator<16>> m_BoxHalfY;
+
+	int32 m_iNumCircles = 0;
+	int32 m_iNumBoxes = 0;
+};
@@ -0,0 +1,232 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstAnimationBudget.h"
+#include "SafetyFirstCrowdManager.h"
+#include "SafetyFirstDamageManager.h"
+#include "SafetyFirstLagCompensation.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPerception.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "SafetyFirstSpawnDirector.h"
+#include "SafetyFirstTelemetry.h"
+#include "Net/UnrealNetwork.h"
+
+ASafetyFirstCrowdAgent::ASafetyFirstCrowdAgent()
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	m_RootSceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneRootComponent"));
+	m_RootSceneComponent->SetMobility(EComponentMobility::Movable);
+	RootComponent = m_RootSceneComponent;
+
+	// The crowd manager moves us, no need to tick
+	PrimaryActorTick.bCanEverTick = false;
+
+	// The server simulates, damages and recycles the enemies, clients follow
+	bReplicates = true;
+	bReplicateMovement = true;
+}
+
+void ASafetyFirstCrowdAgent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ASafetyFirstCrowdAgent, m_bCrowdActive);
+}
+
+void ASafetyFirstCrowdAgent::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	Super::BeginPlay();
+
+	m_CrowdManager = ASafetyFirstCrowdManager::Get(GetWorld());
+	if (m_CrowdManager.IsValid())
+	{
+		m_CrowdManager->RegisterAgent(this);
+	}
+
+	m_DamageManager = ASafetyFirstDamageManager::Get(GetWorld());
+	if (m_DamageManager.IsValid())
+	{
+		m_DamageManager->RegisterHealth(this);
+	}
+
+	m_LagCompensation = ASafetyFirstLagCompensation::Get(GetWorld());
+	if (m_LagCompensation.IsValid())
+	{
+		m_LagCompensation->Register(this);
+	}
+
+	m_Perception = ASafetyFirstPerception::Get(GetWorld());
+	if (m_Perception.IsValid())
+	{
+		m_Perception->Register(this);
+	}
+
+	// Movement comes from the crowd, significance slows down the meshes and animations of the agent
+	m_SignificanceManager = ASafetyFirstSignificanceManager::Get(GetWorld());
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Register(this, ESafetyFirstSignificanceType::Enemy);
+	}
+
+	m_AnimationBudget = ASafetyFirstAnimationBudget::Get(GetWorld());
+	if (m_AnimationBudget.IsValid())
+	{
+		m_AnimationBudget->Register(this);
+	}
+}
+
+void ASafetyFirstCrowdAgent::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	if (m_CrowdManager.IsValid())
+	{
+		m_CrowdManager->UnregisterAgent(this);
+	}
+
+	if (m_DamageManager.IsValid())
+	{
+		m_DamageManager->UnregisterHealth(this);
+	}
+
+	if (m_LagCompensation.IsValid())
+	{
+		m_LagCompensation->Unregister(this);
+	}
+
+	if (m_Perception.IsValid())
+	{
+		m_Perception->Unregister(this);
+	}
+
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Unregister(this);
+	}
+
+	if (m_AnimationBudget.IsValid())
+	{
+		m_AnimationBudget->Unregister(this);
+	}
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstCrowdAgent::SetCrowdActive(bool _bActive)
+{
+	m_bCrowdActive = _bActive;
+
+	if (m_CrowdManager.IsValid())
+	{
+		if (_bActive)
+		{
+			m_CrowdManager->RegisterAgent(this);
+		}
+		else
+		{
+			m_CrowdManager->UnregisterAgent(this);
+		}
+	}
+
+	// Parked agents cannot be hit, and come back at full health with no history
+	if (m_DamageManager.IsValid())
+	{
+		if (_bActive)
+		{
+			m_DamageManager->RegisterHealth(this);
+		}
+		else
+		{
+			m_DamageManager->UnregisterHealth(this);
+		}
+	}
+
+	if (m_LagCompensation.IsValid())
+	{
+		if (_bActive)
+		{
+			m_LagCompensation->Register(this);
+		}
+		else
+		{
+			m_LagCompensation->Unregister(this);
+		}
+	}
+
+	// Parked agents see nothing, and forget what they saw
+	if (m_Perception.IsValid())
+	{
+		if (_bActive)
+		{
+			m_Perception->Register(this);
+		}
+		else
+		{
+			m_Perception->Unregister(this);
+		}
+	}
+
+	// Parked agents stop copying or lending a pose
+	if (m_AnimationBudget.IsValid())
+	{
+		if (_bActive)
+		{
+			m_AnimationBudget->Register(this);
+		}
+		else
+		{
+			m_AnimationBudget->Unregister(this);
+		}
+	}
+}
+
+float ASafetyFirstCrowdAgent::GetHealth() const
+{
+	return m_DamageManager.IsValid() ? m_DamageManager->GetHealth(this) : m_fMaxHealth;
+}
+
+void ASafetyFirstCrowdAgent::HandleKilled(AActor* _Source)
+{
+	SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::Death, this, GetActorLocation());
+	MulticastKilled(_Source);
+
+	if (m_bRecycleWhenKilled && !IsPendingKillPending())
+	{
+		ASafetyFirstSpawnDirector::RecycleEnemy(this);
+	}
+}
+
+void ASafetyFirstCrowdAgent::MulticastDamaged_Implementation(float _fDamage, float _fHealth, AActor* _Source)
+{
+	BPE_Damaged(_fDamage, _fHealth, _Source);
+}
+
+void ASafetyFirstCrowdAgent::MulticastKilled_Implementation(AActor* _Source)
+{
+	m_OnKilled.Broadcast(this, _Source);
+}
+
+void ASafetyFirstCrowdAgent::OnRep_CrowdActive()
+{
+	// Hidden state replicates on its own, the rest of the parking is local
+	SetActorEnableCollision(m_bCrowdActive);
+	SetCrowdActive(m_bCrowdActive);
+}
+
+void ASafetyFirstCrowdAgent::RequestSight(AActor* _Target)
+{
+	if (m_Perception.IsValid())
+	{
+		m_Perception->RequestSight(this, _Target);
+	}
+}
+
+bool ASafetyFirstCrowdAgent::CanSeeTarget() const
+{
+	return m_Perception.IsValid() && m_Perception->CanSee(this);
+}
+
+FVector ASafetyFirstCrowdAgent::GetCrowdVelocity() const
+{
+	return m_CrowdManager.IsValid() ? m_CrowdManager->GetAgentVelocity(this) : FVector::ZeroVector;
+}
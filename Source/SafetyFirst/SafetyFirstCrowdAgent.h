@@ -0,0 +1,147 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstCrowdAgent.generated.h"
+
+/**
+ * Enemy that follows the closest player without ticking itself.
+ * Steering and separation are computed for every agent at once by ASafetyFirstCrowdManager,
+ * Blueprints subclass it for visuals and react to the events below.
+ */
+UCLASS(Blueprintable)
+class ASafetyFirstCrowdAgent : public AActor
+{
+	GENERATED_BODY()
+
+	/** scene root component */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Crowd, meta = (AllowPrivateAccess = "true"))
+	USceneComponent* m_RootSceneComponent;
+
+public:
+	ASafetyFirstCrowdAgent();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Max speed toward the target, in units per second */
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fMaxSpeed = 400.0f;
+
+	/** How fast the velocity reaches the desired one, in 1/s */
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fSteeringRate = 6.0f;
+
+	/** Other agents closer than this push this one away */
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fSeparationRadius = 120.0f;
+
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fSeparationWeight = 1.5f;
+
+	/** The agent stops steering toward the target when it is this close */
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fStopDistance = 100.0f;
+
+	/** Radius against static blockers, only used when ASafetyFirstCollision2D is enabled */
+	UPROPERTY(Category = Crowd, EditAnywhere, BlueprintReadOnly)
+	float m_fCollisionRadius = 40.0f;
+
+	/** Called when the agent gets within m_fStopDistance of its target */
+	UFUNCTION(BlueprintImplementableEvent, Category = Crowd)
+	void BPE_TargetReached(APawn* _Target);
+
+	/** Called when the agent leaves m_fStopDistance of its target */
+	UFUNCTION(BlueprintImplementableEvent, Category = Crowd)
+	void BPE_TargetLost();
+
+	/** Health given each time the agent enters play or leaves its pool */
+	UPROPERTY(Category = Damage, EditAnywhere, BlueprintReadOnly)
+	float m_fMaxHealth = 30.0f;
+
+	/** Killed agents go back to the pool of their spawn director, or are destroyed */
+	UPROPERTY(Category = Damage, EditAnywhere, BlueprintReadOnly)
+	bool m_bRecycleWhenKilled = true;
+
+	/** Called once per frame with the damage taken during the frame, _Source dealt the last hit and is null if it is gone */
+	UFUNCTION(BlueprintImplementableEvent, Category = Damage)
+	void BPE_Damaged(float _fDamage, float _fHealth, AActor* _Source);
+
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnKilled, ASafetyFirstCrowdAgent*, _Agent, AActor*, _Source);
+
+	/** Broadcast when the health reaches 0, before the agent is recycled */
+	UPROPERTY(BlueprintAssignable, Category = Damage)
+	FOnKilled m_OnKilled;
+
+	UFUNCTION(BlueprintCallable, Category = Damage)
+	float GetHealth() const;
+
+	/** Queues a line of sight test toward _Target, the result comes a frame or more later through CanSeeTarget */
+	UFUNCTION(BlueprintCallable, Category = Perception)
+	void RequestSight(AActor* _Target);
+
+	/** Result of the last line of sight test, false until one is done */
+	UFUNCTION(BlueprintCallable, Category = Perception)
+	bool CanSeeTarget() const;
+
+	/** Called when a line of sight test finds the opposite of the previous one */
+	UFUNCTION(BlueprintImplementableEvent, Category = Perception)
+	void BPE_SightChanged(bool _bVisible);
+
+	/** Adds or removes the agent from the crowd simulation, used by pools to park dead enemies */
+	void SetCrowdActive(bool _bActive);
+
+	/** Velocity computed by the crowd on the last update */
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	FVector GetCrowdVelocity() const;
+
+private:
+	friend class ASafetyFirstAnimationBudget;
+	friend class ASafetyFirstCrowdManager;
+	friend class ASafetyFirstDamageManager;
+	friend class ASafetyFirstPerception;
+
+	/** Called by the damage manager on the server after the notifications of the frame */
+	void HandleKilled(AActor* _Source);
+
+	/** Damage is dealt by the server only, every machine gets the notification. _Source is null where it does not replicate */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastDamaged(float _fDamage, float _fHealth, AActor* _Source);
+
+	UFUNCTION(NetMulticast, Reliable)
+	void MulticastKilled(AActor* _Source);
+
+	UFUNCTION()
+	void OnRep_CrowdActive();
+
+	/** False while the agent is parked in a pool, clients park their copy with it */
+	UPROPERTY(ReplicatedUsing = OnRep_CrowdActive)
+	bool m_bCrowdActive = true;
+
+	TWeakObjectPtr<class ASafetyFirstCrowdManager> m_CrowdManager;
+
+	TWeakObjectPtr<class ASafetyFirstDamageManager> m_DamageManager;
+
+	TWeakObjectPtr<class ASafetyFirstLagCompensation> m_LagCompensation;
+
+	TWeakObjectPtr<class ASafetyFirstPerception> m_Perception;
+
+	TWeakObjectPtr<class ASafetyFirstSignificanceManager> m_SignificanceManager;
+
+	TWeakObjectPtr<class ASafetyFirstAnimationBudget> m_AnimationBudget;
+
+	/** Index in the arrays of the crowd manager, INDEX_NONE when not registered */
+	int32 m_iCrowdIndex = INDEX_NONE;
+
+	/** Index in the health of the damage manager, INDEX_NONE when not registered */
+	int32 m_iHealthIndex = INDEX_NONE;
+
+	/** Slot in the perception, INDEX_NONE when not registered */
+	int32 m_iPerceptionIndex = INDEX_NONE;
+
+	/** Index in the entries of the animation budget, INDEX_NONE when not registered */
+	int32 m_iAnimationIndex = INDEX_NONE;
+};
@@ -0,0 +1,326 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstCrowdManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCollision2D.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstFlowField.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstWorldManager.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crowd update"), STAT_SafetyFirst_CrowdUpdate, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Crowd write back"), STAT_SafetyFirst_CrowdWriteBack, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Crowd agents"), STAT_SafetyFirst_CrowdAgents, STATGROUP_SafetyFirst);
+
+ASafetyFirstCrowdManager::ASafetyFirstCrowdManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+ASafetyFirstCrowdManager* ASafetyFirstCrowdManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstCrowdManager>(_World);
+}
+
+void ASafetyFirstCrowdManager::RegisterAgent(ASafetyFirstCrowdAgent* _Agent)
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	if (_Agent == nullptr || _Agent->m_iCrowdIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	_Agent->m_iCrowdIndex = m_Agents.Add(_Agent);
+	m_Positions.Add(_Agent->GetActorLocation());
+	m_Velocities.Add(FVector::ZeroVector);
+	m_NewPositions.AddZeroed();
+	m_NewVelocities.AddZeroed();
+	m_MaxSpeed.Add(_Agent->m_fMaxSpeed);
+	m_SteeringRate.Add(_Agent->m_fSteeringRate);
+	m_SeparationRadius.Add(_Agent->m_fSeparationRadius);
+	m_SeparationWeight.Add(_Agent->m_fSeparationWeight);
+	m_StopDistance.Add(_Agent->m_fStopDistance);
+	m_CollisionRadius.Add(_Agent->m_fCollisionRadius);
+	m_TargetIndex.Add(INDEX_NONE);
+	m_bAtTarget.Add(false);
+	m_bWasAtTarget.Add(false);
+
+	INC_DWORD_STAT(STAT_SafetyFirst_CrowdAgents);
+}
+
+void ASafetyFirstCrowdManager::UnregisterAgent(ASafetyFirstCrowdAgent* _Agent)
+{
+	if (_Agent == nullptr || !m_Agents.IsValidIndex(_Agent->m_iCrowdIndex) || m_Agents[_Agent->m_iCrowdIndex] != _Agent)
+	{
+		return;
+	}
+
+	const int32 iIndex = _Agent->m_iCrowdIndex;
+	m_Agents.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_Positions.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_Velocities.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_NewPositions.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_NewVelocities.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_MaxSpeed.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_SteeringRate.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_SeparationRadius.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_SeparationWeight.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_StopDistance.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_CollisionRadius.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_TargetIndex.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_bAtTarget.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_bWasAtTarget.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+
+	if (m_Agents.IsValidIndex(iIndex))
+	{
+		m_Agents[iIndex]->m_iCrowdIndex = iIndex;
+	}
+	_Agent->m_iCrowdIndex = INDEX_NONE;
+
+	DEC_DWORD_STAT(STAT_SafetyFirst_CrowdAgents);
+}
+
+FVector ASafetyFirstCrowdManager::GetAgentVelocity(const ASafetyFirstCrowdAgent* _Agent) const
+{
+	return (_Agent != nullptr && m_Velocities.IsValidIndex(_Agent->m_iCrowdIndex)) ? m_Velocities[_Agent->m_iCrowdIndex] : FVector::ZeroVector;
+}
+
+void ASafetyFirstCrowdManager::Tick(float _fDt)
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	Super::Tick(_fDt);
+
+	const int32 iNumAgents = m_Agents.Num();
+	if (iNumAgents == 0)
+	{
+		m_AimTargets.Reset();
+		return;
+	}
+	if (_fDt <= 0.0f)
+	{
+		return;
+	}
+
+	{
+		SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_CrowdUpdate, CrowdUpdate);
+
+		// Blueprints and spawners may have moved agents since the last update
+		for (int32 i = 0; i < iNumAgents; ++i)
+		{
+			m_Positions[i] = m_Agents[i]->GetActorLocation();
+		}
+
+		GatherTargets();
+		BuildSpatialHash();
+
+		if (m_bUseFlowField && !m_FlowField.IsValid())
+		{
+			m_FlowField = ASafetyFirstFlowField::Get(GetWorld());
+		}
+		if (!m_Collision2D.IsValid())
+		{
+			m_Collision2D = ASafetyFirstCollision2D::Get(GetWorld());
+		}
+
+		ParallelFor(iNumAgents, [this, _fDt](int32 _iIndex)
+		{
+			ComputeSteering(_iIndex, _fDt);
+		}, /*bForceSingleThread*/iNumAgents < m_iMinAgentsForParallel);
+
+		Swap(m_Velocities, m_NewVelocities);
+	}
+
+	WriteBack();
+}
+
+void ASafetyFirstCrowdManager::GatherTargets()
+{
+	m_Targets.Reset();
+	m_TargetPositions.Reset();
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		APlayerController* controller = it->Get();
+		if (ASafetyFirstPawn* pawn = controller != nullptr ? Cast<ASafetyFirstPawn>(controller->GetPawn()) : nullptr)
+		{
+			m_Targets.Add(pawn);
+			m_TargetPositions.Add(pawn->GetActorLocation());
+		}
+	}
+}
+
+uint32 ASafetyFirstCrowdManager::HashCell(int32 _iCellX, int32 _iCellY) const
+{
+	return ((uint32)_iCellX * 73856093u ^ (uint32)_iCellY * 19349663u) & m_uBucketMask;
+}
+
+void ASafetyFirstCrowdManager::BuildSpatialHash()
+{
+	const int32 iNumAgents = m_Agents.Num();
+	const uint32 uNumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(iNumAgents * 2, 64));
+	m_uBucketMask = uNumBuckets - 1;
+	const float fInvCellSize = 1.0f / FMath::Max(m_fCellSize, 1.0f);
+
+	m_AgentBucket.SetNumUninitialized(iNumAgents, /*bAllowShrinking*/false);
+	m_CellStart.Reset();
+	m_CellStart.AddZeroed(uNumBuckets + 1);
+
+	// Counting sort of the agents by bucket
+	for (int32 i = 0; i < iNumAgents; ++i)
+	{
+		const uint32 uBucket = HashCell(FMath::FloorToInt(m_Positions[i].X * fInvCellSize), FMath::FloorToInt(m_Positions[i].Y * fInvCellSize));
+		m_AgentBucket[i] = uBucket;
+		++m_CellStart[uBucket + 1];
+	}
+	for (uint32 b = 1; b <= uNumBuckets; ++b)
+	{
+		m_CellStart[b] += m_CellStart[b - 1];
+	}
+
+	m_SortedAgents.SetNumUninitialized(iNumAgents, /*bAllowShrinking*/false);
+	m_BucketCursor.Reset();
+	m_BucketCursor.Append(m_CellStart.GetData(), uNumBuckets);
+	for (int32 i = 0; i < iNumAgents; ++i)
+	{
+		m_SortedAgents[m_BucketCursor[m_AgentBucket[i]]++] = i;
+	}
+}
+
+void ASafetyFirstCrowdManager::ComputeSteering(int32 _iIndex, float _fDt)
+{
+	const FVector vPosition = m_Positions[_iIndex];
+
+	// Closest player
+	int32 iTarget = INDEX_NONE;
+	float fBestDistSq = MAX_flt;
+	for (int32 t = 0; t < m_TargetPositions.Num(); ++t)
+	{
+		const float fDistSq = FVector::DistSquared2D(vPosition, m_TargetPositions[t]);
+		if (fDistSq < fBestDistSq)
+		{
+			fBestDistSq = fDistSq;
+			iTarget = t;
+		}
+	}
+
+	FVector vDesired = FVector::ZeroVector;
+	bool bAtTarget = false;
+	if (iTarget != INDEX_NONE)
+	{
+		const float fStopDistance = m_StopDistance[_iIndex];
+		bAtTarget = fBestDistSq <= fStopDistance * fStopDistance;
+		if (!bAtTarget)
+		{
+			// The flow field has no direction on the target cell itself, head straight there
+			FVector vDirection;
+			const ASafetyFirstFlowField* flowField = m_bUseFlowField ? m_FlowField.Get() : nullptr;
+			if (flowField == nullptr || !flowField->SampleDirection(vPosition, vDirection))
+			{
+				vDirection = (m_TargetPositions[iTarget] - vPosition).GetSafeNormal2D();
+			}
+			vDesired = vDirection * m_MaxSpeed[_iIndex];
+		}
+	}
+
+	// Separation from the agents of the 3x3 surrounding cells
+	const float fRadius = m_SeparationRadius[_iIndex];
+	const float fRadiusSq = fRadius * fRadius;
+	const float fInvCellSize = 1.0f / FMath::Max(m_fCellSize, 1.0f);
+	const int32 iCellX = FMath::FloorToInt(vPosition.X * fInvCellSize);
+	const int32 iCellY = FMath::FloorToInt(vPosition.Y * fInvCellSize);
+
+	FVector vSeparation = FVector::ZeroVector;
+	int32 iNeighbours = 0;
+	for (int32 dy = -1; dy <= 1 && iNeighbours < m_iMaxNeighbours; ++dy)
+	{
+		for (int32 dx = -1; dx <= 1 && iNeighbours < m_iMaxNeighbours; ++dx)
+		{
+			const uint32 uBucket = HashCell(iCellX + dx, iCellY + dy);
+			for (int32 s = m_CellStart[uBucket]; s < m_CellStart[uBucket + 1]; ++s)
+			{
+				const int32 iOther = m_SortedAgents[s];
+				if (iOther == _iIndex)
+				{
+					continue;
+				}
+
+				// Hash collisions bring far agents in the same bucket, the distance test discards them
+				const FVector vAway = FVector(vPosition.X - m_Positions[iOther].X, vPosition.Y - m_Positions[iOther].Y, 0.0f);
+				const float fDistSq = vAway.SizeSquared();
+				if (fDistSq < fRadiusSq && fDistSq > KINDA_SMALL_NUMBER)
+				{
+					const float fDist = FMath::Sqrt(fDistSq);
+					vSeparation += vAway * ((fRadius - fDist) / (fRadius * fDist));
+					if (++iNeighbours >= m_iMaxNeighbours)
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	vDesired += vSeparation * (m_SeparationWeight[_iIndex] * m_MaxSpeed[_iIndex]);
+	vDesired = vDesired.GetClampedToMaxSize2D(m_MaxSpeed[_iIndex]);
+
+	const float fAlpha = FMath::Clamp(m_SteeringRate[_iIndex] * _fDt, 0.0f, 1.0f);
+	const FVector vVelocity = FMath::Lerp(m_Velocities[_iIndex], vDesired, fAlpha);
+
+	m_NewVelocities[_iIndex] = vVelocity;
+	const ASafetyFirstCollision2D* collision = m_Collision2D.Get();
+	m_NewPositions[_iIndex] = collision != nullptr ? collision->ResolveMove(vPosition, vVelocity * _fDt, m_CollisionRadius[_iIndex]) : vPosition + vVelocity * _fDt;
+	m_TargetIndex[_iIndex] = iTarget;
+	m_bAtTarget[_iIndex] = bAtTarget;
+}
+
+void ASafetyFirstCrowdManager::WriteBack()
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_CrowdWriteBack, CrowdWriteBack);
+
+	// Agents may unregister from their events, iterate on a copy
+	TArray<ASafetyFirstCrowdAgent*, TInlineAllocator<16>> reached;
+	TArray<ASafetyFirstCrowdAgent*, TInlineAllocator<16>> lost;
+
+	const int32 iNumAimTargets = FMath::Min(m_Agents.Num(), m_iMaxAimTargets);
+	m_AimTargets.Reset();
+
+	for (int32 i = 0; i < m_Agents.Num(); ++i)
+	{
+		// Clients show the replicated movement of the server agents
+		ASafetyFirstCrowdAgent* agent = m_Agents[i];
+		const bool bMoved = agent->HasAuthority();
+		if (i < iNumAimTargets)
+		{
+			m_AimTargets.Add(bMoved ? m_NewPositions[i] : agent->GetActorLocation());
+		}
+
+		if (bMoved)
+		{
+			const FVector& vVelocity = m_Velocities[i];
+			const FRotator rotation = vVelocity.SizeSquared2D() > KINDA_SMALL_NUMBER ? FRotator(0.0f, vVelocity.Rotation().Yaw, 0.0f) : agent->GetActorRotation();
+			agent->SetActorLocationAndRotation(m_NewPositions[i], rotation);
+		}
+
+		if (m_bAtTarget[i] != m_bWasAtTarget[i])
+		{
+			m_bWasAtTarget[i] = m_bAtTarget[i];
+			(m_bAtTarget[i] ? reached : lost).Add(agent);
+		}
+	}
+
+	m_AimTargets.Finish();
+
+	for (ASafetyFirstCrowdAgent* agent : reached)
+	{
+		const int32 iTarget = m_TargetIndex.IsValidIndex(agent->m_iCrowdIndex) ? m_TargetIndex[agent->m_iCrowdIndex] : INDEX_NONE;
+		agent->BPE_TargetReached(m_Targets.IsValidIndex(iTarget) ? m_Targets[iTarget].Get() : nullptr);
+	}
+	for (ASafetyFirstCrowdAgent* agent : lost)
+	{
+		agent->BPE_TargetLost();
+	}
+}
@@ -0,0 +1,101 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstAimAssist.h"
+#include "SafetyFirstCrowdManager.generated.h"
+
+class ASafetyFirstCrowdAgent;
+
+/**
+ * Updates every ASafetyFirstCrowdAgent of the world in one pass.
+ * Agent state is kept in contiguous arrays, neighbours are found through a uniform spatial hash rebuilt each frame,
+ * steering is computed in a ParallelFor and the resulting transforms are written back in one loop.
+ * Agents slide along static blockers when ASafetyFirstCollision2D is enabled, and pass through them otherwise.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstCrowdManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstCrowdManager();
+
+	/** Returns the crowd manager of the world, spawning it if needed */
+	static ASafetyFirstCrowdManager* Get(UWorld* _World);
+
+	void RegisterAgent(ASafetyFirstCrowdAgent* _Agent);
+	void UnregisterAgent(ASafetyFirstCrowdAgent* _Agent);
+
+	FVector GetAgentVelocity(const ASafetyFirstCrowdAgent* _Agent) const;
+	int32 GetNumAgents() const { return m_Agents.Num(); }
+
+	/** Locations of the agents after the last update, for the aim assist of the pawns */
+	const FSafetyFirstAimTargets& GetAimTargets() const { return m_AimTargets; }
+
+	virtual void Tick(float _fDt) override;
+
+	/** Size of a cell of the spatial hash, should be at least the largest separation radius */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCellSize = 150.0f;
+
+	/** Neighbours considered for separation, extra ones are ignored */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxNeighbours = 16;
+
+	/** Agents follow the flow field around static obstacles instead of heading straight at the player */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	bool m_bUseFlowField = true;
+
+	/** Below this number of agents the update stays on the game thread */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMinAgentsForParallel = 64;
+
+	/** Agents past this number are not aim assist targets, bounds the cost of a query */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxAimTargets = 2048;
+
+private:
+	void GatherTargets();
+	void BuildSpatialHash();
+	void ComputeSteering(int32 _iIndex, float _fDt);
+	void WriteBack();
+
+	uint32 HashCell(int32 _iCellX, int32 _iCellY) const;
+
+	UPROPERTY()
+	TArray<ASafetyFirstCrowdAgent*> m_Agents;
+
+	TWeakObjectPtr<class ASafetyFirstFlowField> m_FlowField;
+	TWeakObjectPtr<class ASafetyFirstCollision2D> m_Collision2D;
+
+	// Agent state, indexed like m_Agents
+	TArray<FVector> m_Positions;
+	TArray<FVector> m_Velocities;
+	TArray<FVector> m_NewPositions;
+	TArray<FVector> m_NewVelocities;
+	TArray<float> m_MaxSpeed;
+	TArray<float> m_SteeringRate;
+	TArray<float> m_SeparationRadius;
+	TArray<float> m_SeparationWeight;
+	TArray<float> m_StopDistance;
+	TArray<float> m_CollisionRadius;
+	TArray<int32> m_TargetIndex;
+	TArray<bool> m_bAtTarget;
+	TArray<bool> m_bWasAtTarget;
+
+	// Player pawns the agents follow
+	TArray<FVector> m_TargetPositions;
+	TArray<TWeakObjectPtr<APawn>> m_Targets;
+
+	// Spatial hash: agents sorted by bucket, m_CellStart[b] .. m_CellStart[b + 1] are the agents of bucket b
+	TArray<int32> m_CellStart;
+	TArray<int32> m_SortedAgents;
+	TArray<uint32> m_AgentBucket;
+	TArray<int32> m_BucketCursor;
+	uint32 m_uBucketMask = 0;
+
+	FSafetyFirstAimTargets m_AimTargets;
+};
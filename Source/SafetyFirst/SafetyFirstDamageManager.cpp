@@ -0,0 +1,254 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstDamageManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Async/ParallelFor.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Damage resolve"), STAT_SafetyFirst_DamageResolve, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Damage hits"), STAT_SafetyFirst_DamageHits, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Damage kills"), STAT_SafetyFirst_DamageKills, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Damage health slots"), STAT_SafetyFirst_DamageSlots, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpDamageStatsCmd(
+	TEXT("SafetyFirst.Damage.Stats"),
+	TEXT("Logs the hits resolved, damage dealt and enemies killed since the last call"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstDamageManager* manager = ASafetyFirstDamageManager::Get(_World))
+		{
+			manager->DumpStats();
+		}
+	}));
+
+ASafetyFirstDamageManager::ASafetyFirstDamageManager()
+{
+	// Hit callbacks run during physics, the queue is resolved once they are all in, only while hits are queued
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+}
+
+ASafetyFirstDamageManager* ASafetyFirstDamageManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstDamageManager>(_World);
+}
+
+void ASafetyFirstDamageManager::AddHit(AActor* _Target, UPrimitiveComponent* _Component, const FVector& _vLocation, const FVector& _vImpulse, float _fDamage, AActor* _Source)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	// Every machine simulates its own projectiles, only the hits of the server deal damage. Impulses stay local
+	const ASafetyFirstCrowdAgent* agent = GetNetMode() != NM_Client ? Cast<ASafetyFirstCrowdAgent>(_Target) : nullptr;
+	const int32 iHealthIndex = (agent != nullptr && _fDamage > 0.0f && m_Agents.IsValidIndex(agent->m_iHealthIndex)) ? agent->m_iHealthIndex : INDEX_NONE;
+	const bool bPhysics = _Component != nullptr && _Component->IsSimulatingPhysics();
+	if (iHealthIndex == INDEX_NONE && !bPhysics)
+	{
+		return;
+	}
+
+	FHitRecord hit;
+	hit.m_vLocation = _vLocation;
+	hit.m_vImpulse = _vImpulse;
+	hit.m_Component = bPhysics ? _Component : nullptr;
+	hit.m_Source = _Source;
+	hit.m_iHealthIndex = iHealthIndex;
+	hit.m_uHealthSerial = iHealthIndex != INDEX_NONE ? m_HealthSerial[iHealthIndex] : 0;
+	hit.m_fDamage = _fDamage;
+	m_Hits.Add(hit);
+
+	SetActorTickEnabled(true);
+}
+
+void ASafetyFirstDamageManager::RegisterHealth(ASafetyFirstCrowdAgent* _Agent)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Agent == nullptr || _Agent->m_iHealthIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	_Agent->m_iHealthIndex = m_Agents.Add(_Agent);
+	m_Health.Add(_Agent->m_fMaxHealth);
+	m_HealthSerial.Add(++m_uNextSerial);
+
+	INC_DWORD_STAT(STAT_SafetyFirst_DamageSlots);
+}
+
+void ASafetyFirstDamageManager::UnregisterHealth(ASafetyFirstCrowdAgent* _Agent)
+{
+	if (_Agent == nullptr || !m_Agents.IsValidIndex(_Agent->m_iHealthIndex) || m_Agents[_Agent->m_iHealthIndex] != _Agent)
+	{
+		return;
+	}
+
+	const int32 iIndex = _Agent->m_iHealthIndex;
+	m_Agents.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_Health.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	m_HealthSerial.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+
+	if (m_Agents.IsValidIndex(iIndex))
+	{
+		m_Agents[iIndex]->m_iHealthIndex = iIndex;
+	}
+	_Agent->m_iHealthIndex = INDEX_NONE;
+
+	DEC_DWORD_STAT(STAT_SafetyFirst_DamageSlots);
+}
+
+float ASafetyFirstDamageManager::GetHealth(const ASafetyFirstCrowdAgent* _Agent) const
+{
+	return (_Agent != nullptr && m_Health.IsValidIndex(_Agent->m_iHealthIndex)) ? m_Health[_Agent->m_iHealthIndex] : 0.0f;
+}
+
+void ASafetyFirstDamageManager::Tick(float _fDt)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_DamageResolve, DamageResolve);
+
+	Super::Tick(_fDt);
+
+	// Hits queued by the notifications below belong to the next frame
+	Swap(m_Hits, m_ResolvingHits);
+	m_Hits.Reset();
+
+	ApplyImpulses();
+	GatherEnemyHits();
+
+	const int32 iNumEnemies = m_EnemyHits.Num();
+	ParallelFor(iNumEnemies, [this](int32 _iIndex)
+	{
+		ApplyDamage(m_EnemyHits[_iIndex]);
+	}, /*bForceSingleThread*/iNumEnemies < m_iMinEnemiesForParallel);
+
+	Notify();
+
+	m_iHitsResolved += m_ResolvingHits.Num();
+	INC_DWORD_STAT_BY(STAT_SafetyFirst_DamageHits, m_ResolvingHits.Num());
+	m_ResolvingHits.Reset();
+
+	SetActorTickEnabled(m_Hits.Num() > 0);
+}
+
+void ASafetyFirstDamageManager::ApplyImpulses()
+{
+	for (const FHitRecord& hit : m_ResolvingHits)
+	{
+		UPrimitiveComponent* component = hit.m_Component.Get();
+		if (component != nullptr && component->IsSimulatingPhysics())
+		{
+			component->AddImpulseAtLocation(hit.m_vImpulse, hit.m_vLocation);
+		}
+	}
+}
+
+void ASafetyFirstDamageManager::GatherEnemyHits()
+{
+	// Sorting by slot puts the hits of one enemy next to each other, so each enemy is written by one task only
+	m_SortedHits.Reset();
+	for (int32 i = 0; i < m_ResolvingHits.Num(); ++i)
+	{
+		const FHitRecord& hit = m_ResolvingHits[i];
+		if (m_HealthSerial.IsValidIndex(hit.m_iHealthIndex) && m_HealthSerial[hit.m_iHealthIndex] == hit.m_uHealthSerial)
+		{
+			m_SortedHits.Add(((uint64)hit.m_iHealthIndex << 32) | (uint64)i);
+		}
+	}
+	m_SortedHits.Sort();
+
+	m_EnemyHits.Reset();
+	for (int32 i = 0; i < m_SortedHits.Num(); ++i)
+	{
+		if (i == 0 || (m_SortedHits[i] >> 32) != (m_SortedHits[i - 1] >> 32))
+		{
+			FEnemyHits& enemyHits = m_EnemyHits[m_EnemyHits.AddUninitialized()];
+			enemyHits.m_iFirst = i;
+			enemyHits.m_iCount = 0;
+			enemyHits.m_fDamage = 0.0f;
+			enemyHits.m_bKilled = false;
+		}
+		++m_EnemyHits.Last().m_iCount;
+	}
+}
+
+void ASafetyFirstDamageManager::ApplyDamage(FEnemyHits& _EnemyHits)
+{
+	const int32 iHealthIndex = (int32)(m_SortedHits[_EnemyHits.m_iFirst] >> 32);
+	const float fHealth = m_Health[iHealthIndex];
+	if (fHealth <= 0.0f)
+	{
+		return;
+	}
+
+	float fDamage = 0.0f;
+	for (int32 i = _EnemyHits.m_iFirst; i < _EnemyHits.m_iFirst + _EnemyHits.m_iCount; ++i)
+	{
+		fDamage += m_ResolvingHits[(int32)(m_SortedHits[i] & 0xffffffff)].m_fDamage;
+	}
+
+	m_Health[iHealthIndex] = FMath::Max(fHealth - fDamage, 0.0f);
+	_EnemyHits.m_fDamage = FMath::Min(fDamage, fHealth);
+	_EnemyHits.m_bKilled = fDamage >= fHealth;
+}
+
+void ASafetyFirstDamageManager::Notify()
+{
+	// Blueprints may destroy or recycle enemies, which moves the health slots: read everything before calling them
+	struct FDamageEvent
+	{
+		ASafetyFirstCrowdAgent* m_Agent;
+		AActor* m_Source;
+		float m_fDamage;
+		float m_fHealth;
+		bool m_bKilled;
+	};
+
+	TSafetyFirstFrameArray<FDamageEvent> events;
+	for (const FEnemyHits& enemyHits : m_EnemyHits)
+	{
+		if (enemyHits.m_fDamage <= 0.0f)
+		{
+			continue;
+		}
+
+		// The last hit of the frame gets the credit
+		const uint64 uLastHit = m_SortedHits[enemyHits.m_iFirst + enemyHits.m_iCount - 1];
+		const int32 iHealthIndex = (int32)(uLastHit >> 32);
+
+		FDamageEvent& damageEvent = events[events.AddUninitialized()];
+		damageEvent.m_Agent = m_Agents[iHealthIndex];
+		damageEvent.m_Source = m_ResolvingHits[(int32)(uLastHit & 0xffffffff)].m_Source.Get();
+		damageEvent.m_fDamage = enemyHits.m_fDamage;
+		damageEvent.m_fHealth = m_Health[iHealthIndex];
+		damageEvent.m_bKilled = enemyHits.m_bKilled;
+
+		m_fDamageDealt += enemyHits.m_fDamage;
+	}
+
+	for (const FDamageEvent& damageEvent : events)
+	{
+		if (IsValid(damageEvent.m_Agent))
+		{
+			damageEvent.m_Agent->MulticastDamaged(damageEvent.m_fDamage, damageEvent.m_fHealth, damageEvent.m_Source);
+		}
+	}
+
+	for (const FDamageEvent& damageEvent : events)
+	{
+		if (damageEvent.m_bKilled && IsValid(damageEvent.m_Agent))
+		{
+			++m_iKills;
+			INC_DWORD_STAT(STAT_SafetyFirst_DamageKills);
+			damageEvent.m_Agent->HandleKilled(damageEvent.m_Source);
+		}
+	}
+}
+
+void ASafetyFirstDamageManager::DumpStats() const
+{
+	UE_LOG(LogSafetyFirst, Display, TEXT("Damage: %d enemies with health, %d hits resolved, %.1f damage dealt, %d kills"),
+		m_Agents.Num(), m_iHitsResolved, m_fDamageDealt, m_iKills);
+}
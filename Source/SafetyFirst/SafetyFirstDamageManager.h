@@ -0,0 +1,97 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstDamageManager.generated.h"
+
+class ASafetyFirstCrowdAgent;
+class UPrimitiveComponent;
+
+/**
+ * Resolves the hits of projectiles and bulk bullets once per frame, after physics.
+ * Hit callbacks only append a hit record. The resolve pass applies the impulses, sums the damage of every enemy in a
+ * ParallelFor over the enemies that were hit, then sends the Blueprint notifications and recycles the killed enemies.
+ * Enemy health is kept in a dense array indexed by ASafetyFirstCrowdAgent::m_iHealthIndex. Damage is only dealt on the
+ * server, clients get the notifications and the deaths from the agents.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstDamageManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstDamageManager();
+
+	/** Returns the damage manager of the world, spawning it if needed */
+	static ASafetyFirstDamageManager* Get(UWorld* _World);
+
+	/**
+	 * Queues a hit on _Target, resolved after physics.
+	 * _vImpulse is applied at _vLocation if _Component simulates physics, _fDamage is dealt if _Target is a registered enemy.
+	 */
+	void AddHit(AActor* _Target, UPrimitiveComponent* _Component, const FVector& _vLocation, const FVector& _vImpulse, float _fDamage, AActor* _Source);
+
+	/** Gives the agent a health slot at its max health, called when it enters play or leaves its pool */
+	void RegisterHealth(ASafetyFirstCrowdAgent* _Agent);
+	void UnregisterHealth(ASafetyFirstCrowdAgent* _Agent);
+
+	float GetHealth(const ASafetyFirstCrowdAgent* _Agent) const;
+
+	void DumpStats() const;
+
+	virtual void Tick(float _fDt) override;
+
+	/** Below this number of enemies hit in a frame the damage stays on the game thread */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMinEnemiesForParallel = 64;
+
+private:
+	/** One queued hit, the target is its health slot so the resolve pass never touches the actor */
+	struct FHitRecord
+	{
+		FVector m_vLocation;
+		FVector m_vImpulse;
+		TWeakObjectPtr<UPrimitiveComponent> m_Component;
+		TWeakObjectPtr<AActor> m_Source;
+		int32 m_iHealthIndex;
+		uint32 m_uHealthSerial;
+		float m_fDamage;
+	};
+
+	/** Consecutive hits of m_SortedHits on the same enemy */
+	struct FEnemyHits
+	{
+		int32 m_iFirst;
+		int32 m_iCount;
+		float m_fDamage;
+		bool m_bKilled;
+	};
+
+	void ApplyImpulses();
+	void GatherEnemyHits();
+	void ApplyDamage(FEnemyHits& _EnemyHits);
+	void Notify();
+
+	/** Hits of this frame, swapped with m_ResolvingHits by the resolve pass */
+	TArray<FHitRecord> m_Hits;
+	TArray<FHitRecord> m_ResolvingHits;
+
+	// Hits on enemies sorted by health slot (slot in the high bits, hit in the low bits), and their runs
+	TArray<uint64> m_SortedHits;
+	TArray<FEnemyHits> m_EnemyHits;
+
+	// Health slots
+	UPROPERTY()
+	TArray<ASafetyFirstCrowdAgent*> m_Agents;
+	TArray<float> m_Health;
+	/** Changes each time a slot is given, hits queued for a previous owner of the slot are dropped */
+	TArray<uint32> m_HealthSerial;
+	uint32 m_uNextSerial = 0;
+
+	// Counts since the last dump
+	int32 m_iHitsResolved = 0;
+	int32 m_iKills = 0;
+	float m_fDamageDealt = 0.0f;
+};
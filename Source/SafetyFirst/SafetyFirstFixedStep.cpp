@@ -0,0 +1,94 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstFixedStep.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Fixed steps this frame"), STAT_SafetyFirst_FixedSteps, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpFixedStepStatsCmd(
+	TEXT("SafetyFirst.FixedStep.Stats"),
+	TEXT("Logs the step rate, the steps per frame and the time dropped after hitches"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstFixedStep* fixedStep = ASafetyFirstFixedStep::Get(_World))
+		{
+			fixedStep->DumpStats();
+		}
+	}));
+
+ASafetyFirstFixedStep::ASafetyFirstFixedStep()
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+ASafetyFirstFixedStep* ASafetyFirstFixedStep::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstFixedStep>(_World);
+}
+
+int32 ASafetyFirstFixedStep::GetNumSteps()
+{
+	Advance();
+	return m_iSteps;
+}
+
+float ASafetyFirstFixedStep::GetStepSeconds()
+{
+	Advance();
+	return m_fStepSeconds;
+}
+
+float ASafetyFirstFixedStep::GetAlpha()
+{
+	Advance();
+	return m_fAlpha;
+}
+
+void ASafetyFirstFixedStep::Advance()
+{
+	if (m_uFrame == GFrameCounter)
+	{
+		return;
+	}
+	m_uFrame = GFrameCounter;
+
+	const float fFrameSeconds = GetWorld()->GetDeltaSeconds();
+	if (!IsEnabled())
+	{
+		m_iSteps = 1;
+		m_fStepSeconds = fFrameSeconds;
+		m_fAlpha = 1.0f;
+	}
+	else
+	{
+		m_fStepSeconds = 1.0f / m_fStepRate;
+		m_fAccumulator += fFrameSeconds;
+		m_iSteps = FMath::FloorToInt(m_fAccumulator / m_fStepSeconds);
+		if (m_iSteps > m_iMaxStepsPerFrame)
+		{
+			m_fDroppedSeconds += (m_iSteps - m_iMaxStepsPerFrame) * m_fStepSeconds;
+			m_iSteps = m_iMaxStepsPerFrame;
+			m_fAccumulator = FMath::Fmod(m_fAccumulator, m_fStepSeconds) + m_iSteps * m_fStepSeconds;
+		}
+		m_fAccumulator -= m_iSteps * m_fStepSeconds;
+		m_fAlpha = FMath::Clamp(m_fAccumulator / m_fStepSeconds, 0.0f, 1.0f);
+	}
+
+	++m_iFrames;
+	m_iTotalSteps += m_iSteps;
+	m_iFramesWithoutStep += m_iSteps == 0 ? 1 : 0;
+	m_iMaxSteps = FMath::Max(m_iMaxSteps, m_iSteps);
+
+	SET_DWORD_STAT(STAT_SafetyFirst_FixedSteps, m_iSteps);
+	CSV_CUSTOM_STAT(SafetyFirst, FixedSteps, m_iSteps, ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstFixedStep::DumpStats() const
+{
+	const int32 iFrames = FMath::Max(m_iFrames, 1);
+	UE_LOG(LogSafetyFirst, Display, TEXT("FixedStep: %.0f Hz, %.2f steps per frame, %d max, %d of %d frames without a step, %.2f s dropped after hitches"),
+		m_fStepRate, (float)m_iTotalSteps / iFrames, m_iMaxSteps, m_iFramesWithoutStep, m_iFrames, m_fDroppedSeconds);
+}
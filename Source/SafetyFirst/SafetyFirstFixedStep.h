@@ -0,0 +1,67 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstFixedStep.generated.h"
+
+/**
+ * Clock of the fixed step simulation.
+ * Pawn movement, weapon recoil and bulk projectiles advance by steps of 1 / m_fStepRate seconds, as many as the frame
+ * time accumulated, so they give the same results at any frame rate. Frames between two steps run no simulation and
+ * only place the visuals between the last two steps with GetAlpha.
+ * The clock does not tick, the first user of a frame advances it.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstFixedStep : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstFixedStep();
+
+	/** Returns the clock of the world, spawning it if needed */
+	static ASafetyFirstFixedStep* Get(UWorld* _World);
+
+	/** Steps to simulate this frame, 0 when the frame is shorter than a step */
+	int32 GetNumSteps();
+
+	/** Duration of one step, the frame time when the fixed step is disabled */
+	float GetStepSeconds();
+
+	/** How far the frame is between the step before the last one and the last one, to interpolate the visuals. 1 when disabled */
+	float GetAlpha();
+
+	bool IsEnabled() const { return m_fStepRate > 0.0f; }
+
+	/** Drops the time accumulated toward the next step, so input recordings and their playback step at the same frames */
+	void ResetAccumulator() { m_fAccumulator = 0.0f; }
+
+	void DumpStats() const;
+
+	/** Steps per second, 0 simulates once per frame with the frame time */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fStepRate = 60.0f;
+
+	/** Time past this many steps in a frame is dropped, a hitch slows the game down instead of piling up steps */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxStepsPerFrame = 4;
+
+private:
+	/** Consumes the time of the frame into steps, once per frame */
+	void Advance();
+
+	uint64 m_uFrame = 0;
+	float m_fAccumulator = 0.0f;
+	float m_fStepSeconds = 0.0f;
+	float m_fAlpha = 0.0f;
+	int32 m_iSteps = 0;
+
+	// Since play started
+	int32 m_iFrames = 0;
+	int32 m_iTotalSteps = 0;
+	int32 m_iFramesWithoutStep = 0;
+	int32 m_iMaxSteps = 0;
+	float m_fDroppedSeconds = 0.0f;
+};
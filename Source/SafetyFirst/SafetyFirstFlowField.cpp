@@ -0,0 +1,387 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstFlowField.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstWorldManager.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flow field bake"), STAT_SafetyFirst_FlowFieldBake, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Flow field build (worker)"), STAT_SafetyFirst_FlowFieldBuild, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flow field rebuilds"), STAT_SafetyFirst_FlowFieldRebuilds, STATGROUP_SafetyFirst);
+
+namespace SafetyFirstFlowField
+{
+	// 8-neighbourhood, orthogonal moves first
+	static const int32 NeighbourX[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+	static const int32 NeighbourY[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+	static const uint32 NeighbourCost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+	static const float InvSqrt2 = 0.70710678f;
+	static const FVector NeighbourDirection[8] =
+	{
+		FVector(1.0f, 0.0f, 0.0f), FVector(-1.0f, 0.0f, 0.0f), FVector(0.0f, 1.0f, 0.0f), FVector(0.0f, -1.0f, 0.0f),
+		FVector(InvSqrt2, InvSqrt2, 0.0f), FVector(InvSqrt2, -InvSqrt2, 0.0f),
+		FVector(-InvSqrt2, InvSqrt2, 0.0f), FVector(-InvSqrt2, -InvSqrt2, 0.0f),
+	};
+	static const uint32 Unreached = MAX_uint32;
+}
+
+ASafetyFirstFlowField::ASafetyFirstFlowField()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+ASafetyFirstFlowField* ASafetyFirstFlowField::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstFlowField>(_World);
+}
+
+void ASafetyFirstFlowField::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	Super::BeginPlay();
+
+	m_iSizeX = FMath::Max(FMath::CeilToInt(2.0f * m_vHalfExtent.X / m_fCellSize), 1);
+	m_iSizeY = FMath::Max(FMath::CeilToInt(2.0f * m_vHalfExtent.Y / m_fCellSize), 1);
+	m_vOrigin = -m_vHalfExtent;
+
+	// Baked by Tick a few rows at a time, the full grid is thousands of overlap queries
+	m_Blocked.SetNumZeroed(m_iSizeX * m_iSizeY);
+	m_iBakedRows = 0;
+	m_iNumBlocked = 0;
+}
+
+void ASafetyFirstFlowField::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	// The task reads our members, it must be done before we go away
+	if (m_BuildTask.IsValid())
+	{
+		m_BuildTask.Wait();
+	}
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+int32 ASafetyFirstFlowField::BakeStaticCollision(int32 _iMinX, int32 _iMinY, int32 _iMaxX, int32 _iMaxY)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_FlowFieldBake, FlowFieldBake);
+
+	UWorld* world = GetWorld();
+	const float fHalfCell = FMath::Max(m_fCellSize * 0.5f - m_fProbeMargin, 1.0f);
+	const FCollisionShape probe = FCollisionShape::MakeBox(FVector(fHalfCell, fHalfCell, m_fProbeHeight * 0.5f));
+	const FCollisionObjectQueryParams staticObjects(ECC_WorldStatic);
+	const FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SafetyFirstFlowFieldBake), /*bTraceComplex*/false);
+
+	int32 iNumBlocked = 0;
+	for (int32 y = _iMinY; y <= _iMaxY; ++y)
+	{
+		for (int32 x = _iMinX; x <= _iMaxX; ++x)
+		{
+			const FVector vCenter(m_vOrigin.X + (x + 0.5f) * m_fCellSize, m_vOrigin.Y + (y + 0.5f) * m_fCellSize, m_fProbeHeight * 0.5f);
+			const bool bBlocked = world->OverlapAnyTestByObjectType(vCenter, FQuat::Identity, staticObjects, probe, queryParams);
+			m_Blocked[y * m_iSizeX + x] = bBlocked;
+			iNumBlocked += bBlocked ? 1 : 0;
+		}
+	}
+	return iNumBlocked;
+}
+
+void ASafetyFirstFlowField::RebakeStaticCollision(const FBox2D& _Bounds)
+{
+	m_PendingRebakes.Add(_Bounds);
+}
+
+void ASafetyFirstFlowField::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+
+	// Publish a finished build
+	if (m_BuildTask.IsValid() && m_BuildTask.IsReady())
+	{
+		m_BuildTask = TFuture<void>();
+		m_iFrontBuffer = 1 - m_iFrontBuffer;
+		m_BuiltTargetCells = m_BuildingTargetCells;
+		m_bHasField = true;
+	}
+
+	// Initial bake, nothing is built before the whole mask is known
+	if (!IsBaked())
+	{
+		const int32 iRows = FMath::Max(FMath::DivideAndRoundUp(m_iBakeCellsPerFrame, m_iSizeX), 1);
+		const int32 iLastRow = FMath::Min(m_iBakedRows + iRows, m_iSizeY) - 1;
+		m_iNumBlocked += BakeStaticCollision(0, m_iBakedRows, m_iSizeX - 1, iLastRow);
+		m_iBakedRows = iLastRow + 1;
+		if (IsBaked())
+		{
+			UE_LOG(LogSafetyFirst, Log, TEXT("Flow field baked: %dx%d cells, %d blocked"), m_iSizeX, m_iSizeY, m_iNumBlocked);
+		}
+		return;
+	}
+
+	// The build reads the mask on a worker, streamed props are baked in between two builds
+	if (!m_BuildTask.IsValid() && m_PendingRebakes.Num() > 0)
+	{
+		for (const FBox2D& bounds : m_PendingRebakes)
+		{
+			// One more cell around, props on the edge of the area overlap the cells next to it
+			const int32 iMinX = FMath::Clamp(FMath::FloorToInt((bounds.Min.X - m_vOrigin.X) / m_fCellSize) - 1, 0, m_iSizeX - 1);
+			const int32 iMinY = FMath::Clamp(FMath::FloorToInt((bounds.Min.Y - m_vOrigin.Y) / m_fCellSize) - 1, 0, m_iSizeY - 1);
+			const int32 iMaxX = FMath::Clamp(FMath::FloorToInt((bounds.Max.X - m_vOrigin.X) / m_fCellSize) + 1, 0, m_iSizeX - 1);
+			const int32 iMaxY = FMath::Clamp(FMath::FloorToInt((bounds.Max.Y - m_vOrigin.Y) / m_fCellSize) + 1, 0, m_iSizeY - 1);
+			BakeStaticCollision(iMinX, iMinY, iMaxX, iMaxY);
+		}
+		m_PendingRebakes.Reset();
+
+		// Forces a build with the new mask even if no pawn moved
+		m_BuiltTargetCells.Reset();
+	}
+
+	// Start a new one only when a pawn changed cell or the mask changed, and the back buffer is free
+	if (!m_BuildTask.IsValid())
+	{
+		TArray<int32> targetCells;
+		if (GatherTargetCells(targetCells) && targetCells != m_BuiltTargetCells)
+		{
+			LaunchBuild(targetCells);
+		}
+	}
+}
+
+bool ASafetyFirstFlowField::GatherTargetCells(TArray<int32>& _OutCells) const
+{
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		APlayerController* controller = it->Get();
+		if (ASafetyFirstPawn* pawn = controller != nullptr ? Cast<ASafetyFirstPawn>(controller->GetPawn()) : nullptr)
+		{
+			const int32 iCell = ToCellIndex(pawn->GetActorLocation());
+			if (iCell != INDEX_NONE)
+			{
+				_OutCells.AddUnique(iCell);
+			}
+		}
+	}
+
+	_OutCells.Sort();
+	return _OutCells.Num() > 0;
+}
+
+void ASafetyFirstFlowField::LaunchBuild(const TArray<int32>& _TargetCells)
+{
+	INC_DWORD_STAT(STAT_SafetyFirst_FlowFieldRebuilds);
+
+	m_BuildingTargetCells = _TargetCells;
+	FFieldBuffer* backBuffer = &m_Buffers[1 - m_iFrontBuffer];
+	const TArray<int32>* targetCells = &m_BuildingTargetCells;
+
+	m_BuildTask = Async<void>(EAsyncExecution::ThreadPool, [this, targetCells, backBuffer]()
+	{
+		BuildField(*targetCells, *backBuffer);
+	});
+}
+
+void ASafetyFirstFlowField::BuildField(const TArray<int32>& _TargetCells, FFieldBuffer& _OutBuffer) const
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_FlowFieldBuild, FlowFieldBuild);
+	using namespace SafetyFirstFlowField;
+
+	const int32 iNumCells = m_iSizeX * m_iSizeY;
+	_OutBuffer.m_Cost.Init(Unreached, iNumCells);
+	_OutBuffer.m_Direction.Init(NoDirection, iNumCells);
+
+	// Multi-source Dijkstra from every target cell, the heap holds (cost, cell)
+	typedef TPair<uint32, int32> FOpenCell;
+	TArray<FOpenCell> open;
+	open.Reserve(iNumCells / 4);
+	const auto lessCost = [](const FOpenCell& _A, const FOpenCell& _B) { return _A.Key < _B.Key; };
+
+	for (int32 iCell : _TargetCells)
+	{
+		_OutBuffer.m_Cost[iCell] = 0;
+		open.HeapPush(FOpenCell(0, iCell), lessCost);
+	}
+
+	while (open.Num() > 0)
+	{
+		FOpenCell current;
+		open.HeapPop(current, lessCost, /*bAllowShrinking*/false);
+		if (current.Key > _OutBuffer.m_Cost[current.Value])
+		{
+			continue;
+		}
+
+		const int32 x = current.Value % m_iSizeX;
+		const int32 y = current.Value / m_iSizeX;
+		for (int32 n = 0; n < 8; ++n)
+		{
+			const int32 nx = x + NeighbourX[n];
+			const int32 ny = y + NeighbourY[n];
+			if (nx < 0 || ny < 0 || nx >= m_iSizeX || ny >= m_iSizeY)
+			{
+				continue;
+			}
+
+			const int32 iNeighbour = ny * m_iSizeX + nx;
+			// No corner cutting: a diagonal needs both orthogonal cells open
+			if (m_Blocked[iNeighbour] || (n >= 4 && (m_Blocked[y * m_iSizeX + nx] || m_Blocked[ny * m_iSizeX + x])))
+			{
+				continue;
+			}
+
+			const uint32 uCost = current.Key + NeighbourCost[n];
+			if (uCost < _OutBuffer.m_Cost[iNeighbour])
+			{
+				_OutBuffer.m_Cost[iNeighbour] = uCost;
+				open.HeapPush(FOpenCell(uCost, iNeighbour), lessCost);
+			}
+		}
+	}
+
+	// Each reached cell points to its cheapest neighbour
+	for (int32 iCell = 0; iCell < iNumCells; ++iCell)
+	{
+		const uint32 uCost = _OutBuffer.m_Cost[iCell];
+		if (uCost == 0 || uCost == Unreached)
+		{
+			continue;
+		}
+
+		const int32 x = iCell % m_iSizeX;
+		const int32 y = iCell / m_iSizeX;
+		uint32 uBestCost = uCost;
+		for (int32 n = 0; n < 8; ++n)
+		{
+			const int32 nx = x + NeighbourX[n];
+			const int32 ny = y + NeighbourY[n];
+			if (nx < 0 || ny < 0 || nx >= m_iSizeX || ny >= m_iSizeY)
+			{
+				continue;
+			}
+			if (n >= 4 && (m_Blocked[y * m_iSizeX + nx] || m_Blocked[ny * m_iSizeX + x]))
+			{
+				continue;
+			}
+
+			const uint32 uNeighbourCost = _OutBuffer.m_Cost[ny * m_iSizeX + nx];
+			if (uNeighbourCost < uBestCost)
+			{
+				uBestCost = uNeighbourCost;
+				_OutBuffer.m_Direction[iCell] = (uint8)n;
+			}
+		}
+	}
+}
+
+int32 ASafetyFirstFlowField::ToCellIndex(const FVector& _vLocation) const
+{
+	const int32 x = FMath::FloorToInt((_vLocation.X - m_vOrigin.X) / m_fCellSize);
+	const int32 y = FMath::FloorToInt((_vLocation.Y - m_vOrigin.Y) / m_fCellSize);
+	if (x < 0 || y < 0 || x >= m_iSizeX || y >= m_iSizeY)
+	{
+		return INDEX_NONE;
+	}
+	return y * m_iSizeX + x;
+}
+
+bool ASafetyFirstFlowField::SampleDirection(const FVector& _vLocation, FVector& _vOutDirection) const
+{
+	if (!m_bHasField)
+	{
+		return false;
+	}
+
+	const int32 iCell = ToCellIndex(_vLocation);
+	if (iCell == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const uint8 uDirection = m_Buffers[m_iFrontBuffer].m_Direction[iCell];
+	if (uDirection == NoDirection)
+	{
+		return false;
+	}
+
+	_vOutDirection = SafetyFirstFlowField::NeighbourDirection[uDirection];
+	return true;
+}
+
+/**
+ * SafetyFirst.Bench.FlowField [NumAgents=10000]
+ * Compares sampling the flow field with the per-agent approach it replaces: steering straight at the closest player
+ * plus one blocking line trace toward it to know whether the way is clear.
+ */
+static void BenchmarkFlowField(const TArray<FString>& _Args, UWorld* _World)
+{
+	ASafetyFirstFlowField* field = ASafetyFirstFlowField::Get(_World);
+	if (field == nullptr || !field->IsReady())
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Flow field benchmark: the field is not built yet, try again once a player is spawned"));
+		return;
+	}
+
+	const int32 iNumAgents = _Args.Num() > 0 ? FMath::Max(FCString::Atoi(*_Args[0]), 1) : 10000;
+
+	TArray<FVector> targets;
+	for (FConstPlayerControllerIterator it = _World->GetPlayerControllerIterator(); it; ++it)
+	{
+		if (APawn* pawn = it->Get() != nullptr ? it->Get()->GetPawn() : nullptr)
+		{
+			targets.Add(pawn->GetActorLocation());
+		}
+	}
+	if (targets.Num() == 0)
+	{
+		return;
+	}
+
+	FRandomStream random(0x5AFE);
+	TArray<FVector> agents;
+	agents.Reserve(iNumAgents);
+	for (int32 i = 0; i < iNumAgents; ++i)
+	{
+		agents.Add(FVector(random.FRandRange(-field->m_vHalfExtent.X, field->m_vHalfExtent.X), random.FRandRange(-field->m_vHalfExtent.Y, field->m_vHalfExtent.Y), 50.0f));
+	}
+
+	FVector vChecksum = FVector::ZeroVector;
+	const double dFieldStart = FPlatformTime::Seconds();
+	for (const FVector& vAgent : agents)
+	{
+		FVector vDirection;
+		if (field->SampleDirection(vAgent, vDirection))
+		{
+			vChecksum += vDirection;
+		}
+	}
+	const double dFieldSeconds = FPlatformTime::Seconds() - dFieldStart;
+
+	const FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SafetyFirstFlowFieldBench), /*bTraceComplex*/false);
+	int32 iClear = 0;
+	const double dDirectStart = FPlatformTime::Seconds();
+	for (const FVector& vAgent : agents)
+	{
+		const FVector* closest = &targets[0];
+		for (const FVector& vTarget : targets)
+		{
+			closest = FVector::DistSquared2D(vAgent, vTarget) < FVector::DistSquared2D(vAgent, *closest) ? &vTarget : closest;
+		}
+		vChecksum += (*closest - vAgent).GetSafeNormal2D();
+		iClear += _World->LineTraceTestByChannel(vAgent, FVector(closest->X, closest->Y, vAgent.Z), ECC_Visibility, queryParams) ? 0 : 1;
+	}
+	const double dDirectSeconds = FPlatformTime::Seconds() - dDirectStart;
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Flow field benchmark, %d agents, %d targets (checksum %s):"), iNumAgents, targets.Num(), *vChecksum.ToString());
+	UE_LOG(LogSafetyFirst, Display, TEXT("  flow field:     %.0f agents/ms"), iNumAgents / FMath::Max(dFieldSeconds * 1000.0, 1e-6));
+	UE_LOG(LogSafetyFirst, Display, TEXT("  direct + trace: %.0f agents/ms (%d with a clear line)"), iNumAgents / FMath::Max(dDirectSeconds * 1000.0, 1e-6), iClear);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GBenchmarkFlowFieldCmd(
+	TEXT("SafetyFirst.Bench.FlowField"),
+	TEXT("Measures agents per ms for flow field sampling against direct steering with a line trace. Args: [NumAgents=10000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkFlowField));
@@ -0,0 +1,104 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Async/Future.h"
+#include "SafetyFirstFlowField.generated.h"
+
+/**
+ * Grid flow field leading every cell of the arena to the closest player pawn.
+ * Static collision is baked into a blocked mask a few rows per frame from the map load, then again over the areas whose
+ * props streamed in or out. The
+ * field is rebuilt on a background task only when a pawn enters a new cell or the mask changed, and the result is
+ * double-buffered, so any number of agents can sample a direction in O(1).
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstFlowField : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstFlowField();
+
+	/** Returns the flow field of the world, spawning it if needed */
+	static ASafetyFirstFlowField* Get(UWorld* _World);
+
+	/**
+	 * Writes the direction to follow from this location on the play plane.
+	 * Returns false outside the field, on blocked cells, on target cells and before the first build.
+	 */
+	bool SampleDirection(const FVector& _vLocation, FVector& _vOutDirection) const;
+
+	/** True once the whole grid has been baked */
+	bool IsBaked() const { return m_iBakedRows >= m_iSizeY; }
+
+	/** True once a field has been published */
+	bool IsReady() const { return m_bHasField; }
+
+	/** Bakes the static collision again over the area, once no build reads the mask, and rebuilds the field */
+	void RebakeStaticCollision(const FBox2D& _Bounds);
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCellSize = 100.0f;
+
+	/** Half size of the covered area, centered on the world origin */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FVector2D m_vHalfExtent = FVector2D(5000.0f, 5000.0f);
+
+	/** Height of the box probing static collision, starting at Z = 0 */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fProbeHeight = 200.0f;
+
+	/** Shrinks the probe so thin gaps between props stay open */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fProbeMargin = 10.0f;
+
+	/** Overlap queries of the initial bake per frame, rounded up to whole rows */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iBakeCellsPerFrame = 1024;
+
+private:
+	struct FFieldBuffer
+	{
+		/** Index in the neighbour table, or NoDirection */
+		TArray<uint8> m_Direction;
+		TArray<uint32> m_Cost;
+	};
+
+	static const uint8 NoDirection = 0xFF;
+
+	/** Bakes the cells from _iMinX, _iMinY to _iMaxX, _iMaxY included, returns the number of blocked cells among them */
+	int32 BakeStaticCollision(int32 _iMinX, int32 _iMinY, int32 _iMaxX, int32 _iMaxY);
+	bool GatherTargetCells(TArray<int32>& _OutCells) const;
+	void LaunchBuild(const TArray<int32>& _TargetCells);
+
+	/** Runs on a worker thread, only reads m_Blocked and the grid size */
+	void BuildField(const TArray<int32>& _TargetCells, FFieldBuffer& _OutBuffer) const;
+
+	int32 ToCellIndex(const FVector& _vLocation) const;
+
+	int32 m_iSizeX = 0;
+	int32 m_iSizeY = 0;
+	FVector2D m_vOrigin = FVector2D::ZeroVector;
+	TArray<bool> m_Blocked;
+	/** Rows of the initial bake done so far, the field is built once they all are */
+	int32 m_iBakedRows = 0;
+	int32 m_iNumBlocked = 0;
+
+	/** Areas to bake again, applied between two builds */
+	TArray<FBox2D> m_PendingRebakes;
+
+	FFieldBuffer m_Buffers[2];
+	int32 m_iFrontBuffer = 0;
+	bool m_bHasField = false;
+
+	TFuture<void> m_BuildTask;
+	TArray<int32> m_BuiltTargetCells;
+	TArray<int32> m_BuildingTargetCells;
+};
@@ -2,6 +2,28 @@
 
 #include "SafetyFirstGameMode.h"
 #include "SafetyFirstPawn.h"
+#include "SafetyFirstBenchmark.h"
+#include "SafetyFirstFlowField.h"
+#include "SafetyFirstInputRecorder.h"
+#include "SafetyFirst.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "TimerManager.h"
+
+static FAutoConsoleCommandWithWorld GNetReportCmd(
+	TEXT("SafetyFirst.Net.Report"),
+	TEXT("Logs the bytes per second exchanged with every connected player, on the server"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstGameMode* gameMode = _World->GetAuthGameMode<ASafetyFirstGameMode>())
+		{
+			gameMode->LogNetReport();
+		}
+	}));
 
 ASafetyFirstGameMode::ASafetyFirstGameMode()
 {
@@ -9,3 +31,55 @@ ASafetyFirstGameMode::ASafetyFirstGameMode()
 	DefaultPawnClass = ASafetyFirstPawn::StaticClass();
 }
 
+void ASafetyFirstGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	// -SafetyFirstBench on the command line turns the session into a benchmark run
+	ASafetyFirstBenchmark::StartFromCommandLine(GetWorld());
+
+	// -SafetyFirstRecord=<path> or -SafetyFirstReplay=<path> records or replays the local input
+	ASafetyFirstInputRecorder::StartFromCommandLine(GetWorld());
+
+	// Starts baking the arena for the flow field with the map, rather than when the first enemy moves
+	ASafetyFirstFlowField::Get(GetWorld());
+
+	float fReportInterval = 0.0f;
+	if (FParse::Value(FCommandLine::Get(), TEXT("SafetyFirstNetReport="), fReportInterval) && fReportInterval > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(m_NetReportTimer, this, &ASafetyFirstGameMode::LogNetReport, fReportInterval, /*bLoop*/true);
+	}
+}
+
+void ASafetyFirstGameMode::LogNetReport()
+{
+	int32 iTotalOut = 0;
+	int32 iTotalIn = 0;
+	int32 iPlayers = 0;
+
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		const APlayerController* controller = it->Get();
+		UNetConnection* connection = controller != nullptr ? controller->GetNetConnection() : nullptr;
+		if (connection == nullptr)
+		{
+			continue;
+		}
+
+		const FString name = controller->PlayerState != nullptr ? controller->PlayerState->GetPlayerName() : controller->GetName();
+		UE_LOG(LogSafetyFirst, Log, TEXT("Net: %-20s out %7d B/s  in %7d B/s  lost out %d in %d"), *name,
+			connection->OutBytesPerSecond, connection->InBytesPerSecond, connection->OutPacketsLost, connection->InPacketsLost);
+
+		iTotalOut += connection->OutBytesPerSecond;
+		iTotalIn += connection->InBytesPerSecond;
+		++iPlayers;
+	}
+
+	if (iPlayers > 0)
+	{
+		UE_LOG(LogSafetyFirst, Log, TEXT("Net: %d players, out %d B/s (%d per player), in %d B/s"), iPlayers, iTotalOut, iTotalOut / iPlayers, iTotalIn);
+	}
+
+	CSV_CUSTOM_STAT(SafetyFirst, NetOutBytesPerSecond, iTotalOut, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, NetInBytesPerSecond, iTotalIn, ECsvCustomStatOp::Set);
+}
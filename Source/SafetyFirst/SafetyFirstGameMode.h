@@ -13,6 +13,21 @@ class ASafetyFirstGameMode : public AGameModeBase
 
 public:
 	ASafetyFirstGameMode();
+
+	virtual void StartPlay() override;
+
+	/**
+	 * Logs the bytes per second sent to and received from every connected player.
+	 * Runs every N seconds with -SafetyFirstNetReport=N, or once with the SafetyFirst.Net.Report console command.
+	 * Local test on one box, one dedicated server and two clients:
+	 *   UE4Editor SafetyFirst.uproject /Game/TwinStickCPP/Maps/TwinStickExampleMap -server -log -SafetyFirstNetReport=1
+	 *   UE4Editor SafetyFirst.uproject 127.0.0.1 -game -windowed -ResX=960 -ResY=540 -log
+	 * "Net PktLag=100" and "Net PktLoss=5" in a client console exercise prediction and reconciliation.
+	 */
+	void LogNetReport();
+
+private:
+	FTimerHandle m_NetReportTimer;
 };
 
 
@@ -0,0 +1,197 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstImpactEffects.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstPreload.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Impact effects"), STAT_SafetyFirst_ImpactEffects, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact bursts"), STAT_SafetyFirst_ImpactBursts, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact hits merged"), STAT_SafetyFirst_ImpactMerged, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact bursts off screen"), STAT_SafetyFirst_ImpactOffscreen, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact bursts over budget"), STAT_SafetyFirst_ImpactOverBudget, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpImpactStatsCmd(
+	TEXT("SafetyFirst.Impacts.Stats"),
+	TEXT("Logs the impact bursts played, merged and dropped since the last call"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstImpactEffects* effects = ASafetyFirstImpactEffects::Get(_World))
+		{
+			effects->DumpStats();
+		}
+	}));
+
+ASafetyFirstImpactEffects::ASafetyFirstImpactEffects()
+{
+	// Resolves the hits of the frame once gameplay and physics are done, only while some are queued
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	m_ProjectileEffect = FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Sparks.P_Sparks"));
+}
+
+ASafetyFirstImpactEffects* ASafetyFirstImpactEffects::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstImpactEffects>(_World);
+}
+
+void ASafetyFirstImpactEffects::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Effects);
+	Super::BeginPlay();
+
+	// A dedicated server renders nothing, it keeps empty pools
+	m_iPoolSize = GetNetMode() != NM_DedicatedServer ? FMath::Max(m_iPoolSizePerEffect, 1) : 0;
+
+	UParticleSystem* templates[(int32)ESafetyFirstImpactType::Count] =
+	{
+		m_iPoolSize > 0 ? SafetyFirstPreload::Resolve(m_ProjectileEffect) : nullptr,
+	};
+
+	m_Components.Reserve(m_iPoolSize * (int32)ESafetyFirstImpactType::Count);
+	for (UParticleSystem* effect : templates)
+	{
+		for (int32 i = 0; i < m_iPoolSize; ++i)
+		{
+			UParticleSystemComponent* component = NewObject<UParticleSystemComponent>(this);
+			component->bAutoActivate = false;
+			component->bAutoDestroy = false;
+			component->SetTemplate(effect);
+			component->RegisterComponent();
+			m_Components.Add(component);
+		}
+	}
+}
+
+void ASafetyFirstImpactEffects::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	m_Pending.Reset();
+	for (UParticleSystemComponent* component : m_Components)
+	{
+		if (component != nullptr)
+		{
+			component->DeactivateSystem();
+		}
+	}
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstImpactEffects::AddImpact(ESafetyFirstImpactType _eType, const FVector& _vLocation, const FVector& _vNormal)
+{
+	SAFETYFIRST_LLM_SCOPE(Effects);
+	if (m_iPoolSize == 0)
+	{
+		return;
+	}
+
+	// Hits landing on a queued burst only make it bigger
+	const float fMergeRadiusSq = m_fMergeRadius * m_fMergeRadius;
+	for (FImpact& impact : m_Pending)
+	{
+		if (impact.m_eType == _eType && FVector::DistSquared(impact.m_vLocation, _vLocation) <= fMergeRadiusSq)
+		{
+			impact.m_vLocation = (impact.m_vLocation * impact.m_iCount + _vLocation) / (impact.m_iCount + 1);
+			++impact.m_iCount;
+			++m_iMerged;
+			INC_DWORD_STAT(STAT_SafetyFirst_ImpactMerged);
+			return;
+		}
+	}
+
+	FImpact impact;
+	impact.m_vLocation = _vLocation;
+	impact.m_vNormal = _vNormal;
+	impact.m_eType = _eType;
+	impact.m_iCount = 1;
+	m_Pending.Add(impact);
+	SetActorTickEnabled(true);
+}
+
+void ASafetyFirstImpactEffects::Tick(float _fDt)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_ImpactEffects, ImpactEffects);
+
+	Super::Tick(_fDt);
+
+	TSafetyFirstFrameArray<FSafetyFirstView> views;
+	GatherLocalViews(GetWorld(), m_fViewMarginDegrees, views);
+
+	int32 iBudget = m_iMaxBurstsPerFrame;
+	for (const FImpact& impact : m_Pending)
+	{
+		if (!IsVisible(impact.m_vLocation, views))
+		{
+			++m_iOffscreen;
+			INC_DWORD_STAT(STAT_SafetyFirst_ImpactOffscreen);
+			continue;
+		}
+
+		UParticleSystemComponent* component = iBudget > 0 ? FindFreeComponent(impact.m_eType) : nullptr;
+		if (component == nullptr)
+		{
+			++m_iOverBudget;
+			INC_DWORD_STAT(STAT_SafetyFirst_ImpactOverBudget);
+			continue;
+		}
+
+		const float fScale = FMath::Min(1.0f + (impact.m_iCount - 1) * m_fMergeScaleStep, m_fMaxBurstScale);
+		component->SetWorldLocationAndRotation(impact.m_vLocation, impact.m_vNormal.Rotation());
+		component->SetWorldScale3D(FVector(fScale));
+		component->SetFloatParameter(m_HitCountParameter, (float)impact.m_iCount);
+		component->ActivateSystem(/*bFlagAsJustAttached*/false);
+
+		--iBudget;
+		++m_iBursts;
+		INC_DWORD_STAT(STAT_SafetyFirst_ImpactBursts);
+	}
+
+	m_Pending.Reset();
+	SetActorTickEnabled(false);
+}
+
+UParticleSystemComponent* ASafetyFirstImpactEffects::FindFreeComponent(ESafetyFirstImpactType _eType) const
+{
+	const int32 iFirst = (int32)_eType * m_iPoolSize;
+	for (int32 i = iFirst; i < iFirst + m_iPoolSize; ++i)
+	{
+		UParticleSystemComponent* component = m_Components[i];
+		if (component->Template != nullptr && !component->IsActive())
+		{
+			return component;
+		}
+	}
+	return nullptr;
+}
+
+bool ASafetyFirstImpactEffects::IsVisible(const FVector& _vLocation, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const
+{
+	const float fMaxDistanceSq = m_fMaxDistance * m_fMaxDistance;
+	for (const FSafetyFirstView& view : _Views)
+	{
+		const FVector vToImpact = _vLocation - view.m_vLocation;
+		if (vToImpact.SizeSquared() <= fMaxDistanceSq && (vToImpact | view.m_vDirection) >= view.m_fCosHalfAngle * vToImpact.Size())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ASafetyFirstImpactEffects::DumpStats() const
+{
+	int32 iActive = 0;
+	for (const UParticleSystemComponent* component : m_Components)
+	{
+		iActive += component->IsActive() ? 1 : 0;
+	}
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Impacts: %d/%d components active, %d bursts, %d hits merged, %d off screen, %d over budget"),
+		iActive, m_Components.Num(), m_iBursts, m_iMerged, m_iOffscreen, m_iOverBudget);
+}
@@ -0,0 +1,106 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "SafetyFirstImpactEffects.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+
+/** Kind of impact, each one has its own effect and pool */
+UENUM()
+enum class ESafetyFirstImpactType : uint8
+{
+	Projectile,
+	Count UMETA(Hidden),
+};
+
+/**
+ * Plays the impact effects of projectile hits from pools of particle system components.
+ * Hits are queued and resolved once per frame after the gameplay: hits close to each other become one burst,
+ * bursts far from or behind every local view are dropped, and so are the ones over the frame budget or the pool.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstImpactEffects : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstImpactEffects();
+
+	/** Returns the impact effects of the world, spawning them if needed */
+	static ASafetyFirstImpactEffects* Get(UWorld* _World);
+
+	/** Queues an impact, played at the end of the frame */
+	void AddImpact(ESafetyFirstImpactType _eType, const FVector& _vLocation, const FVector& _vNormal);
+
+	void DumpStats() const;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	TSoftObjectPtr<UParticleSystem> m_ProjectileEffect;
+
+	/** Components created up front per effect */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iPoolSizePerEffect = 16;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxBurstsPerFrame = 8;
+
+	/** Hits of the same type closer than this in one frame share a burst */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMergeRadius = 150.0f;
+
+	/** Scale added to a burst for each merged hit, up to m_fMaxBurstScale */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMergeScaleStep = 0.15f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxBurstScale = 2.0f;
+
+	/** Float instance parameter receiving the number of merged hits, for templates that read it */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FName m_HitCountParameter = TEXT("HitCount");
+
+	/** Bursts further than this from every view are dropped */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxDistance = 6000.0f;
+
+	/** Added to the half field of view of each local player before dropping a burst as off screen */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fViewMarginDegrees = 10.0f;
+
+private:
+	struct FImpact
+	{
+		FVector m_vLocation;
+		FVector m_vNormal;
+		ESafetyFirstImpactType m_eType;
+		int32 m_iCount;
+	};
+
+
+	bool IsVisible(const FVector& _vLocation, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const;
+	UParticleSystemComponent* FindFreeComponent(ESafetyFirstImpactType _eType) const;
+
+	/** Pools of every type back to back, m_iPoolSize components each */
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> m_Components;
+	int32 m_iPoolSize = 0;
+
+	/** Hits of this frame */
+	TArray<FImpact> m_Pending;
+
+	// Counts since the last dump
+	int32 m_iBursts = 0;
+	int32 m_iMerged = 0;
+	int32 m_iOffscreen = 0;
+	int32 m_iOverBudget = 0;
+};
@@ -0,0 +1,499 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstInputRecorder.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstFixedStep.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Containers/Queue.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+/** Writes the encoded chunks to the recording file away from the game thread */
+class FSafetyFirstRecordWriter : public FRunnable
+{
+public:
+	explicit FSafetyFirstRecordWriter(FArchive* _File)
+		: m_File(_File)
+		, m_WakeUp(FPlatformProcess::GetSynchEventFromPool())
+	{
+		m_Thread = FRunnableThread::Create(this, TEXT("SafetyFirstInputRecorder"), 0, TPri_BelowNormal);
+	}
+
+	/** Writes everything still queued, then closes the file */
+	virtual ~FSafetyFirstRecordWriter()
+	{
+		m_bStopping = true;
+		m_WakeUp->Trigger();
+		m_Thread->WaitForCompletion();
+		delete m_Thread;
+		FPlatformProcess::ReturnSynchEventToPool(m_WakeUp);
+
+		m_File->Close();
+		delete m_File;
+	}
+
+	void Enqueue(TArray<uint8>&& _Chunk)
+	{
+		m_Chunks.Enqueue(MoveTemp(_Chunk));
+		m_WakeUp->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		for (;;)
+		{
+			// Read the flag before draining, chunks queued before the stop are always written
+			const bool bStopping = m_bStopping;
+
+			TArray<uint8> chunk;
+			while (m_Chunks.Dequeue(chunk))
+			{
+				m_File->Serialize(chunk.GetData(), chunk.Num());
+			}
+
+			if (bStopping)
+			{
+				break;
+			}
+			m_WakeUp->Wait();
+		}
+
+		m_File->Flush();
+		return 0;
+	}
+
+private:
+	FArchive* m_File;
+	FEvent* m_WakeUp;
+	FRunnableThread* m_Thread = nullptr;
+	TQueue<TArray<uint8>, EQueueMode::Spsc> m_Chunks;
+	FThreadSafeBool m_bStopping;
+};
+
+static TWeakObjectPtr<ASafetyFirstInputRecorder> GActiveInputRecorder;
+
+static FAutoConsoleCommandWithWorldAndArgs GInputRecordCmd(
+	TEXT("SafetyFirst.Input.Record"),
+	TEXT("Records the local player input to a file. Arguments: [Path], Saved/InputRecordings/<date>.sfir by default"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& _Args, UWorld* _World)
+	{
+		if (ASafetyFirstInputRecorder* recorder = ASafetyFirstInputRecorder::Get(_World))
+		{
+			recorder->StartRecording(_Args.Num() > 0 ? _Args[0] : FString());
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GInputReplayCmd(
+	TEXT("SafetyFirst.Input.Replay"),
+	TEXT("Plays back an input recording. Arguments: Path"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& _Args, UWorld* _World)
+	{
+		ASafetyFirstInputRecorder* recorder = ASafetyFirstInputRecorder::Get(_World);
+		if (recorder != nullptr && _Args.Num() > 0)
+		{
+			recorder->StartPlayback(_Args[0], /*bExitWhenDone*/false);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld GInputStopCmd(
+	TEXT("SafetyFirst.Input.Stop"),
+	TEXT("Stops the input recording or playback"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstInputRecorder* recorder = ASafetyFirstInputRecorder::GetActive(_World))
+		{
+			recorder->Stop();
+		}
+	}));
+
+ASafetyFirstInputRecorder::ASafetyFirstInputRecorder()
+{
+	// Only ticks during playback, to read the next frame once the current one is done
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+}
+
+ASafetyFirstInputRecorder::~ASafetyFirstInputRecorder()
+{
+}
+
+ASafetyFirstInputRecorder* ASafetyFirstInputRecorder::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstInputRecorder>(_World);
+}
+
+ASafetyFirstInputRecorder* ASafetyFirstInputRecorder::GetActive(UWorld* _World)
+{
+	ASafetyFirstInputRecorder* recorder = GActiveInputRecorder.Get();
+	if (recorder != nullptr && recorder->GetWorld() == _World && (recorder->IsRecording() || recorder->IsPlaying()))
+	{
+		return recorder;
+	}
+	return nullptr;
+}
+
+void ASafetyFirstInputRecorder::StartFromCommandLine(UWorld* _World)
+{
+	FString path;
+	if (FParse::Value(FCommandLine::Get(), TEXT("SafetyFirstReplay="), path))
+	{
+		if (ASafetyFirstInputRecorder* recorder = Get(_World))
+		{
+			recorder->StartPlayback(path, FParse::Param(FCommandLine::Get(), TEXT("SafetyFirstReplayExit")));
+		}
+	}
+	else if (FParse::Value(FCommandLine::Get(), TEXT("SafetyFirstRecord="), path))
+	{
+		if (ASafetyFirstInputRecorder* recorder = Get(_World))
+		{
+			recorder->StartRecording(path);
+		}
+	}
+}
+
+bool ASafetyFirstInputRecorder::StartRecording(const FString& _Path)
+{
+	Stop();
+
+	m_Path = !_Path.IsEmpty() ? _Path : FPaths::ProjectSavedDir() / TEXT("InputRecordings") / (FDateTime::Now().ToString() + TEXT(".sfir"));
+	FArchive* file = IFileManager::Get().CreateFileWriter(*m_Path);
+	if (file == nullptr)
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Input recorder: could not create %s"), *m_Path);
+		return false;
+	}
+
+	// Gameplay randomness restarts from a seed the playback can restore
+	int32 iSeed = (int32)FPlatformTime::Cycles();
+	FMath::RandInit(iSeed);
+	FMath::SRandInit(iSeed);
+	if (ASafetyFirstFixedStep* fixedStep = ASafetyFirstFixedStep::Get(GetWorld()))
+	{
+		fixedStep->ResetAccumulator();
+	}
+
+	m_Chunk.Reset(ChunkSize);
+	FMemoryWriter header(m_Chunk);
+	uint32 uMagic = Magic;
+	uint32 uVersion = Version;
+	FString mapName = GetWorld()->GetMapName();
+	header << uMagic << uVersion << iSeed << mapName;
+
+	m_Players.Reset();
+	m_iLastDtMicroseconds = 0;
+	m_uLastRecordedFrame = MAX_uint64;
+	m_iFrames = 0;
+	m_iBytes = 0;
+	m_Writer = MakeUnique<FSafetyFirstRecordWriter>(file);
+	GActiveInputRecorder = this;
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Input recorder: recording to %s, seed %d"), *m_Path, iSeed);
+	return true;
+}
+
+void ASafetyFirstInputRecorder::RecordInput(int32 _iPlayer, float _fDt, const FSafetyFirstRecordedInput& _Input)
+{
+	if (!IsRecording() || _iPlayer < 0)
+	{
+		return;
+	}
+
+	if (GFrameCounter != m_uLastRecordedFrame)
+	{
+		if (m_Chunk.Num() >= ChunkSize)
+		{
+			FlushChunk();
+		}
+
+		m_uLastRecordedFrame = GFrameCounter;
+		const int32 iDtMicroseconds = FMath::RoundToInt(_fDt * 1000000.0f);
+		m_Chunk.Add(FrameTag);
+		WriteSignedVarint(m_Chunk, iDtMicroseconds - m_iLastDtMicroseconds);
+		m_iLastDtMicroseconds = iDtMicroseconds;
+		++m_iFrames;
+	}
+
+	if (_iPlayer >= m_Players.Num())
+	{
+		m_Players.SetNum(_iPlayer + 1);
+	}
+	FPlayerState& player = m_Players[_iPlayer];
+
+	int32 values[FSafetyFirstRecordedInput::NumAxes];
+	uint8 uMask = 0;
+	for (int32 i = 0; i < FSafetyFirstRecordedInput::NumAxes; ++i)
+	{
+		values[i] = FMath::RoundToInt(_Input.m_Axes[i] * AxisScale);
+		uMask |= values[i] != player.m_Axes[i] ? (1 << i) : 0;
+	}
+	uMask |= _Input.m_bPickUpPressed ? (1 << 5) : 0;
+	uMask |= _Input.m_bPickUpReleased ? (1 << 6) : 0;
+
+	// Unchanged input is not written, playback keeps the previous values
+	if (uMask == 0)
+	{
+		return;
+	}
+
+	m_Chunk.Add(InputTag);
+	WriteVarint(m_Chunk, _iPlayer);
+	m_Chunk.Add(uMask);
+	for (int32 i = 0; i < FSafetyFirstRecordedInput::NumAxes; ++i)
+	{
+		if (uMask & (1 << i))
+		{
+			WriteSignedVarint(m_Chunk, values[i] - player.m_Axes[i]);
+			player.m_Axes[i] = values[i];
+		}
+	}
+}
+
+void ASafetyFirstInputRecorder::FlushChunk()
+{
+	if (m_Chunk.Num() > 0)
+	{
+		m_iBytes += m_Chunk.Num();
+		m_Writer->Enqueue(MoveTemp(m_Chunk));
+		m_Chunk.Reset(ChunkSize);
+	}
+}
+
+bool ASafetyFirstInputRecorder::StartPlayback(const FString& _Path, bool _bExitWhenDone)
+{
+	Stop();
+
+	m_Reader = TUniquePtr<FArchive>(IFileManager::Get().CreateFileReader(*_Path));
+	if (!m_Reader.IsValid())
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Input recorder: could not open %s"), *_Path);
+		return false;
+	}
+
+	uint32 uMagic = 0;
+	uint32 uVersion = 0;
+	int32 iSeed = 0;
+	FString mapName;
+	*m_Reader << uMagic << uVersion;
+	if (uMagic != Magic || uVersion != Version)
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Input recorder: %s is not a version %u input recording"), *_Path, Version);
+		m_Reader.Reset();
+		return false;
+	}
+	*m_Reader << iSeed << mapName;
+
+	if (mapName != GetWorld()->GetMapName())
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Input recorder: %s was recorded on %s, playing it on %s"), *_Path, *mapName, *GetWorld()->GetMapName());
+	}
+
+	FMath::RandInit(iSeed);
+	FMath::SRandInit(iSeed);
+	if (ASafetyFirstFixedStep* fixedStep = ASafetyFirstFixedStep::Get(GetWorld()))
+	{
+		fixedStep->ResetAccumulator();
+	}
+
+	m_Path = _Path;
+	m_Players.Reset();
+	m_iLastDtMicroseconds = 0;
+	m_iFrames = 0;
+	m_bFrameTagPending = false;
+	m_bReachedEnd = false;
+	m_bExitWhenDone = _bExitWhenDone;
+	GActiveInputRecorder = this;
+
+	// Frames run with the recorded delta times, the first one is the next engine frame
+	m_bPreviousFixedTimeStep = FApp::UseFixedTimeStep();
+	FApp::SetUseFixedTimeStep(true);
+	m_uPlaybackFrame = GFrameCounter + 1;
+	if (!ReadNextFrame())
+	{
+		Stop();
+		return false;
+	}
+
+	SetActorTickEnabled(true);
+	UE_LOG(LogSafetyFirst, Display, TEXT("Input recorder: playing %s, seed %d"), *_Path, iSeed);
+	return true;
+}
+
+bool ASafetyFirstInputRecorder::ReadNextFrame()
+{
+	if (m_bReachedEnd)
+	{
+		return false;
+	}
+
+	if (!m_bFrameTagPending)
+	{
+		uint8 uTag = EndTag;
+		if (!m_Reader->AtEnd())
+		{
+			*m_Reader << uTag;
+		}
+		if (uTag != FrameTag)
+		{
+			return false;
+		}
+	}
+	m_bFrameTagPending = false;
+
+	m_iLastDtMicroseconds += ReadSignedVarint();
+	FApp::SetFixedDeltaTime(FMath::Max(m_iLastDtMicroseconds, 1) * 0.000001);
+	++m_iFrames;
+
+	// Pickup events only last one frame
+	for (FPlayerState& player : m_Players)
+	{
+		player.m_Input.m_bPickUpPressed = false;
+		player.m_Input.m_bPickUpReleased = false;
+	}
+
+	while (!m_Reader->AtEnd())
+	{
+		uint8 uTag = EndTag;
+		*m_Reader << uTag;
+		if (uTag == FrameTag)
+		{
+			m_bFrameTagPending = true;
+			return true;
+		}
+		if (uTag != InputTag)
+		{
+			break;
+		}
+
+		const int32 iPlayer = (int32)ReadVarint();
+		uint8 uMask = 0;
+		*m_Reader << uMask;
+		if (iPlayer >= m_Players.Num())
+		{
+			m_Players.SetNum(iPlayer + 1);
+		}
+
+		FPlayerState& player = m_Players[iPlayer];
+		for (int32 i = 0; i < FSafetyFirstRecordedInput::NumAxes; ++i)
+		{
+			if (uMask & (1 << i))
+			{
+				player.m_Axes[i] += ReadSignedVarint();
+				player.m_Input.m_Axes[i] = player.m_Axes[i] / AxisScale;
+			}
+		}
+		player.m_Input.m_bPickUpPressed = (uMask & (1 << 5)) != 0;
+		player.m_Input.m_bPickUpReleased = (uMask & (1 << 6)) != 0;
+		player.m_bHasInput = true;
+	}
+
+	// End of the stream, or a recording cut short by a crash: this frame is the last one
+	m_bReachedEnd = true;
+	return true;
+}
+
+bool ASafetyFirstInputRecorder::GetPlaybackInput(int32 _iPlayer, FSafetyFirstRecordedInput& _OutInput) const
+{
+	if (!IsPlaying() || GFrameCounter < m_uPlaybackFrame || !m_Players.IsValidIndex(_iPlayer) || !m_Players[_iPlayer].m_bHasInput)
+	{
+		return false;
+	}
+
+	_OutInput = m_Players[_iPlayer].m_Input;
+	return true;
+}
+
+void ASafetyFirstInputRecorder::Tick(float _fDt)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	Super::Tick(_fDt);
+
+	if (IsPlaying() && GFrameCounter >= m_uPlaybackFrame)
+	{
+		if (ReadNextFrame())
+		{
+			m_uPlaybackFrame = GFrameCounter + 1;
+		}
+		else
+		{
+			Stop();
+		}
+	}
+}
+
+void ASafetyFirstInputRecorder::Stop()
+{
+	if (IsRecording())
+	{
+		m_Chunk.Add(EndTag);
+		FlushChunk();
+		m_Writer.Reset();
+		UE_LOG(LogSafetyFirst, Display, TEXT("Input recorder: %d frames, %lld bytes written to %s"), m_iFrames, m_iBytes, *m_Path);
+	}
+
+	if (IsPlaying())
+	{
+		m_Reader.Reset();
+		FApp::SetUseFixedTimeStep(m_bPreviousFixedTimeStep);
+		SetActorTickEnabled(false);
+		UE_LOG(LogSafetyFirst, Display, TEXT("Input recorder: played %d frames of %s"), m_iFrames, *m_Path);
+
+		if (m_bExitWhenDone)
+		{
+			FPlatformMisc::RequestExit(/*Force*/false);
+		}
+	}
+}
+
+void ASafetyFirstInputRecorder::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	Stop();
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstInputRecorder::WriteVarint(TArray<uint8>& _Buffer, uint32 _uValue)
+{
+	while (_uValue >= 0x80)
+	{
+		_Buffer.Add((uint8)(_uValue | 0x80));
+		_uValue >>= 7;
+	}
+	_Buffer.Add((uint8)_uValue);
+}
+
+void ASafetyFirstInputRecorder::WriteSignedVarint(TArray<uint8>& _Buffer, int32 _iValue)
+{
+	// Zigzag, small negative deltas stay small
+	WriteVarint(_Buffer, ((uint32)_iValue << 1) ^ (uint32)(_iValue >> 31));
+}
+
+uint32 ASafetyFirstInputRecorder::ReadVarint()
+{
+	uint32 uValue = 0;
+	for (int32 iShift = 0; iShift < 35 && !m_Reader->AtEnd(); iShift += 7)
+	{
+		uint8 uByte = 0;
+		*m_Reader << uByte;
+		uValue |= (uint32)(uByte & 0x7F) << iShift;
+		if ((uByte & 0x80) == 0)
+		{
+			break;
+		}
+	}
+	return uValue;
+}
+
+int32 ASafetyFirstInputRecorder::ReadSignedVarint()
+{
+	const uint32 uValue = ReadVarint();
+	return (int32)(uValue >> 1) ^ -(int32)(uValue & 1);
+}
@@ -0,0 +1,122 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstInputRecorder.generated.h"
+
+/** Input of one local player for one frame, as read by ASafetyFirstPawn */
+struct FSafetyFirstRecordedInput
+{
+	enum EAxis
+	{
+		MoveForward,
+		MoveRight,
+		FireForward,
+		FireRight,
+		Fire,
+		NumAxes,
+	};
+
+	float m_Axes[NumAxes] = {};
+	bool m_bPickUpPressed = false;
+	bool m_bPickUpReleased = false;
+};
+
+/**
+ * Records the input of the local pawns to a compact binary stream, and plays it back frame by frame with the
+ * recorded delta times and random seed, e.g. headless to profile a reported hitch:
+ *   UE4Editor SafetyFirst.uproject -game -SafetyFirstRecord=Saved/InputRecordings/hitch.sfir
+ *   UE4Editor SafetyFirst.uproject -game -nullrhi -unattended -SafetyFirstReplay=Saved/InputRecordings/hitch.sfir -SafetyFirstReplayExit
+ * Stream: header (magic, version, seed, map) then per frame a zigzag varint of the delta time change in microseconds,
+ * followed by one record per local player whose input changed, with a mask of the changed values and their varint deltas.
+ * Encoded chunks are written to disk by a background thread.
+ */
+UCLASS(notplaceable, Transient)
+class ASafetyFirstInputRecorder : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstInputRecorder();
+	virtual ~ASafetyFirstInputRecorder();
+
+	/** Starts recording or playback if the command line asks for it */
+	static void StartFromCommandLine(UWorld* _World);
+
+	/** Returns the recorder of the world while it records or plays, null otherwise */
+	static ASafetyFirstInputRecorder* GetActive(UWorld* _World);
+
+	/** Returns the recorder of the world, spawning it if needed */
+	static ASafetyFirstInputRecorder* Get(UWorld* _World);
+
+	bool StartRecording(const FString& _Path);
+	bool StartPlayback(const FString& _Path, bool _bExitWhenDone);
+	void Stop();
+
+	bool IsRecording() const { return m_Writer.IsValid(); }
+	bool IsPlaying() const { return m_Reader.IsValid(); }
+
+	/** Called by the pawns once per frame while recording, with the frame time whatever the fixed steps of the frame */
+	void RecordInput(int32 _iPlayer, float _fDt, const FSafetyFirstRecordedInput& _Input);
+
+	/** Input of the player for the current playback frame, returns false if the player has none */
+	bool GetPlaybackInput(int32 _iPlayer, FSafetyFirstRecordedInput& _OutInput) const;
+
+	virtual void Tick(float _fDt) override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+
+private:
+	enum ERecordTag : uint8
+	{
+		FrameTag = 0,
+		InputTag = 1,
+		EndTag = 2,
+	};
+
+	static const uint32 Magic = 0x52494653; // "SFIR"
+	static const uint32 Version = 1;
+
+	/** Axis values are stored in 1/AxisScale steps */
+	static constexpr float AxisScale = 8192.0f;
+
+	static const int32 ChunkSize = 16 * 1024;
+
+	/** Quantized axes and pending pickup events of one player */
+	struct FPlayerState
+	{
+		int32 m_Axes[FSafetyFirstRecordedInput::NumAxes] = {};
+		FSafetyFirstRecordedInput m_Input;
+		bool m_bHasInput = false;
+	};
+
+	void FlushChunk();
+	bool ReadNextFrame();
+
+	static void WriteVarint(TArray<uint8>& _Buffer, uint32 _uValue);
+	static void WriteSignedVarint(TArray<uint8>& _Buffer, int32 _iValue);
+	uint32 ReadVarint();
+	int32 ReadSignedVarint();
+
+	/** Background writer, owns the file */
+	TUniquePtr<class FSafetyFirstRecordWriter> m_Writer;
+	TArray<uint8> m_Chunk;
+	uint64 m_uLastRecordedFrame = MAX_uint64;
+
+	TUniquePtr<FArchive> m_Reader;
+	/** Frame at which the decoded inputs apply, the next one is read at the end of it */
+	uint64 m_uPlaybackFrame = 0;
+	bool m_bFrameTagPending = false;
+	bool m_bReachedEnd = false;
+	bool m_bExitWhenDone = false;
+	bool m_bPreviousFixedTimeStep = false;
+
+	/** Last encoded or decoded values, everything is delta encoded against them */
+	TArray<FPlayerState> m_Players;
+	int32 m_iLastDtMicroseconds = 0;
+
+	int32 m_iFrames = 0;
+	int64 m_iBytes = 0;
+	FString m_Path;
+};
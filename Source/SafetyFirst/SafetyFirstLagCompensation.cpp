@@ -0,0 +1,397 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstLagCompensation.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag compensation record"), STAT_SafetyFirst_LagRecord, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Lag compensation sweep"), STAT_SafetyFirst_LagSweep, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Lag compensated actors"), STAT_SafetyFirst_LagActors, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lag compensated sweeps"), STAT_SafetyFirst_LagSweeps, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpLagCompensationStatsCmd(
+	TEXT("SafetyFirst.LagComp.Stats"),
+	TEXT("Logs the memory of the history and the cost of recording and sweeping since the last call"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstLagCompensation* lagCompensation = ASafetyFirstLagCompensation::Get(_World))
+		{
+			lagCompensation->DumpStats();
+		}
+	}));
+
+static FAutoConsoleCommand GBenchLagCompensationCmd(
+	TEXT("SafetyFirst.LagComp.Bench"),
+	TEXT("Measures the memory of a full history and the cost of rewound sweeps. Arguments: [Agents] [Players] [ShotsPerPlayer]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& _Args)
+	{
+		const int32 iAgents = _Args.Num() > 0 ? FCString::Atoi(*_Args[0]) : 500;
+		const int32 iPlayers = _Args.Num() > 1 ? FCString::Atoi(*_Args[1]) : 8;
+		const int32 iShots = _Args.Num() > 2 ? FCString::Atoi(*_Args[2]) : 10;
+		const FSafetyFirstRewindCost cost = ASafetyFirstLagCompensation::MeasureRewindCost(iAgents, iPlayers, iShots);
+		UE_LOG(LogSafetyFirst, Display, TEXT("Lag compensation: %d agents and %d players, %.1f KB of history, record %.3f us per frame, %d sweeps at %.3f us each"),
+			iAgents, iPlayers, cost.m_uMemoryBytes / 1024.0f, cost.m_fRecordMicroseconds, cost.m_iQueries, cost.m_fQueryMicroseconds);
+	}));
+
+void FSafetyFirstLagHistory::Init(int32 _iMaxSlots, int32 _iMaxFrames)
+{
+	m_iMaxSlots = FMath::Max(_iMaxSlots, 1);
+	m_iMaxFrames = FMath::Max(_iMaxFrames, 2);
+	m_iNewestFrame = INDEX_NONE;
+	m_iNumFrames = 0;
+	m_uFrameCounter = 0;
+
+	m_X.SetNumZeroed(m_iMaxSlots * m_iMaxFrames);
+	m_Y.SetNumZeroed(m_iMaxSlots * m_iMaxFrames);
+	m_Z.SetNumZeroed(m_iMaxSlots * m_iMaxFrames);
+	m_FrameTime.SetNumZeroed(m_iMaxFrames);
+	m_FrameNumber.SetNumZeroed(m_iMaxFrames);
+
+	m_Radius.SetNumZeroed(m_iMaxSlots);
+	m_HalfHeight.SetNumZeroed(m_iMaxSlots);
+	m_FirstFrame.SetNumZeroed(m_iMaxSlots);
+	m_Used.Init(false, m_iMaxSlots);
+	m_FreeSlots.Reset(m_iMaxSlots);
+	m_iNumSlots = 0;
+}
+
+int32 FSafetyFirstLagHistory::AddSlot(float _fRadius, float _fHalfHeight)
+{
+	int32 iSlot = INDEX_NONE;
+	if (m_FreeSlots.Num() > 0)
+	{
+		iSlot = m_FreeSlots.Pop(/*bAllowShrinking*/false);
+	}
+	else if (m_iNumSlots < m_iMaxSlots)
+	{
+		iSlot = m_iNumSlots++;
+	}
+	else
+	{
+		return INDEX_NONE;
+	}
+
+	m_Radius[iSlot] = _fRadius;
+	m_HalfHeight[iSlot] = _fHalfHeight;
+	m_FirstFrame[iSlot] = m_uFrameCounter + 1;
+	m_Used[iSlot] = true;
+	return iSlot;
+}
+
+void FSafetyFirstLagHistory::RemoveSlot(int32 _iSlot)
+{
+	if (_iSlot >= 0 && _iSlot < m_iNumSlots && m_Used[_iSlot])
+	{
+		m_Used[_iSlot] = false;
+		m_FreeSlots.Add(_iSlot);
+	}
+}
+
+void FSafetyFirstLagHistory::BeginFrame(float _fTime)
+{
+	m_iNewestFrame = (m_iNewestFrame + 1) % m_iMaxFrames;
+	m_iNumFrames = FMath::Min(m_iNumFrames + 1, m_iMaxFrames);
+	m_FrameTime[m_iNewestFrame] = _fTime;
+	m_FrameNumber[m_iNewestFrame] = ++m_uFrameCounter;
+}
+
+void FSafetyFirstLagHistory::SetPosition(int32 _iSlot, const FVector& _vLocation)
+{
+	const int32 iIndex = m_iNewestFrame * m_iMaxSlots + _iSlot;
+	m_X[iIndex] = _vLocation.X;
+	m_Y[iIndex] = _vLocation.Y;
+	m_Z[iIndex] = _vLocation.Z;
+}
+
+float FSafetyFirstLagHistory::GetOldestTime() const
+{
+	return m_iNumFrames > 0 ? m_FrameTime[(m_iNewestFrame - m_iNumFrames + 1 + m_iMaxFrames) % m_iMaxFrames] : 0.0f;
+}
+
+bool FSafetyFirstLagHistory::Sweep(float _fTime, const FVector& _vStart, const FVector& _vEnd, float _fRadius, int32 _iIgnoreSlot, int32& _iOutSlot, float& _fOutFraction) const
+{
+	if (m_iNumFrames == 0)
+	{
+		return false;
+	}
+
+	// Newest frame at or before the time, blended toward the one after it
+	int32 iOlder = m_iNewestFrame;
+	int32 iNewer = m_iNewestFrame;
+	for (int32 i = 0; i < m_iNumFrames; ++i)
+	{
+		iOlder = (m_iNewestFrame - i + m_iMaxFrames) % m_iMaxFrames;
+		if (m_FrameTime[iOlder] <= _fTime)
+		{
+			break;
+		}
+		iNewer = iOlder;
+	}
+
+	const float fSpan = m_FrameTime[iNewer] - m_FrameTime[iOlder];
+	const float fAlpha = fSpan > 0.0f ? FMath::Clamp((_fTime - m_FrameTime[iOlder]) / fSpan, 0.0f, 1.0f) : 0.0f;
+	const uint32 uOlderNumber = m_FrameNumber[iOlder];
+
+	const float* RESTRICT olderX = m_X.GetData() + iOlder * m_iMaxSlots;
+	const float* RESTRICT olderY = m_Y.GetData() + iOlder * m_iMaxSlots;
+	const float* RESTRICT olderZ = m_Z.GetData() + iOlder * m_iMaxSlots;
+	const float* RESTRICT newerX = m_X.GetData() + iNewer * m_iMaxSlots;
+	const float* RESTRICT newerY = m_Y.GetData() + iNewer * m_iMaxSlots;
+	const float* RESTRICT newerZ = m_Z.GetData() + iNewer * m_iMaxSlots;
+
+	// Swept sphere against vertical cylinders: circle entry on the plane, then the height at the entry
+	const FVector vDelta = _vEnd - _vStart;
+	const float fDeltaSq2D = vDelta.X * vDelta.X + vDelta.Y * vDelta.Y;
+	float fBest = 1.0f;
+	int32 iBest = INDEX_NONE;
+	for (int32 i = 0; i < m_iNumSlots; ++i)
+	{
+		if (!m_Used[i] || i == _iIgnoreSlot || m_FirstFrame[i] > uOlderNumber)
+		{
+			continue;
+		}
+
+		const float fCenterX = olderX[i] + (newerX[i] - olderX[i]) * fAlpha;
+		const float fCenterY = olderY[i] + (newerY[i] - olderY[i]) * fAlpha;
+		const float fRadius = m_Radius[i] + _fRadius;
+		const float fToStartX = _vStart.X - fCenterX;
+		const float fToStartY = _vStart.Y - fCenterY;
+		const float fC = fToStartX * fToStartX + fToStartY * fToStartY - fRadius * fRadius;
+
+		float fFraction = 0.0f;
+		if (fC > 0.0f)
+		{
+			const float fHalfB = fToStartX * vDelta.X + fToStartY * vDelta.Y;
+			const float fDiscriminant = fHalfB * fHalfB - fDeltaSq2D * fC;
+			if (fHalfB >= 0.0f || fDiscriminant < 0.0f)
+			{
+				continue;
+			}
+			fFraction = (-fHalfB - FMath::Sqrt(fDiscriminant)) / fDeltaSq2D;
+		}
+		if (fFraction > fBest)
+		{
+			continue;
+		}
+
+		const float fCenterZ = olderZ[i] + (newerZ[i] - olderZ[i]) * fAlpha;
+		if (FMath::Abs(_vStart.Z + vDelta.Z * fFraction - fCenterZ) <= m_HalfHeight[i] + _fRadius)
+		{
+			fBest = fFraction;
+			iBest = i;
+		}
+	}
+
+	_iOutSlot = iBest;
+	_fOutFraction = fBest;
+	return iBest != INDEX_NONE;
+}
+
+SIZE_T FSafetyFirstLagHistory::GetAllocatedSize() const
+{
+	return m_X.GetAllocatedSize() + m_Y.GetAllocatedSize() + m_Z.GetAllocatedSize()
+		+ m_FrameTime.GetAllocatedSize() + m_FrameNumber.GetAllocatedSize()
+		+ m_Radius.GetAllocatedSize() + m_HalfHeight.GetAllocatedSize() + m_FirstFrame.GetAllocatedSize()
+		+ m_Used.GetAllocatedSize() + m_FreeSlots.GetAllocatedSize();
+}
+
+ASafetyFirstLagCompensation::ASafetyFirstLagCompensation()
+{
+	// Records once everything moved this frame
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+}
+
+ASafetyFirstLagCompensation* ASafetyFirstLagCompensation::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstLagCompensation>(_World);
+}
+
+void ASafetyFirstLagCompensation::PostInitializeComponents()
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	Super::PostInitializeComponents();
+
+	// Allocated on spawn, actors spawning the manager from their BeginPlay register before its own BeginPlay runs.
+	// Clients and standalone games never rewind anything
+	const ENetMode eNetMode = GetNetMode();
+	if (eNetMode == NM_DedicatedServer || eNetMode == NM_ListenServer)
+	{
+		m_History.Init(m_iMaxActors, m_iMaxFrames);
+		m_Actors.SetNum(m_iMaxActors);
+		SetActorTickEnabled(true);
+	}
+}
+
+bool ASafetyFirstLagCompensation::Register(AActor* _Actor)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Actor == nullptr || m_SlotOf.Contains(_Actor))
+	{
+		return false;
+	}
+	if (m_Actors.Num() == 0)
+	{
+		UE_LOG(LogSafetyFirst, Verbose, TEXT("Lag compensation: %s not registered, only servers rewind"), *_Actor->GetName());
+		return false;
+	}
+
+	FVector vOrigin;
+	FVector vExtent;
+	_Actor->GetActorBounds(/*bOnlyCollidingComponents*/true, vOrigin, vExtent);
+	const bool bHasBounds = !vExtent.IsNearlyZero();
+	const int32 iSlot = m_History.AddSlot(bHasBounds ? FMath::Max(vExtent.X, vExtent.Y) : m_fDefaultRadius, bHasBounds ? vExtent.Z : m_fDefaultRadius);
+	if (iSlot == INDEX_NONE)
+	{
+		UE_LOG(LogSafetyFirst, Warning, TEXT("Lag compensation: no slot left for %s, raise m_iMaxActors"), *_Actor->GetName());
+		return false;
+	}
+
+	m_Actors[iSlot] = _Actor;
+	m_SlotOf.Add(_Actor, iSlot);
+	INC_DWORD_STAT(STAT_SafetyFirst_LagActors);
+	return true;
+}
+
+void ASafetyFirstLagCompensation::Unregister(AActor* _Actor)
+{
+	int32 iSlot = INDEX_NONE;
+	if (m_SlotOf.RemoveAndCopyValue(_Actor, iSlot))
+	{
+		m_History.RemoveSlot(iSlot);
+		m_Actors[iSlot] = nullptr;
+		DEC_DWORD_STAT(STAT_SafetyFirst_LagActors);
+	}
+}
+
+void ASafetyFirstLagCompensation::Tick(float _fDt)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_LagRecord, LagRecord);
+
+	Super::Tick(_fDt);
+
+	const double fStart = FPlatformTime::Seconds();
+	m_History.BeginFrame(GetWorld()->GetTimeSeconds());
+	for (int32 i = 0; i < m_History.GetNumSlots(); ++i)
+	{
+		// Removed slots keep their last position, they are skipped by the sweeps
+		if (const AActor* actor = m_Actors[i].Get())
+		{
+			m_History.SetPosition(i, actor->GetActorLocation());
+		}
+	}
+	m_fRecordSeconds += FPlatformTime::Seconds() - fStart;
+	++m_iRecordedFrames;
+}
+
+bool ASafetyFirstLagCompensation::GetRewindTime(const APawn* _Shooter, float& _fOutTime) const
+{
+	if (_Shooter == nullptr || m_Actors.Num() == 0 || _Shooter->IsLocallyControlled() || _Shooter->PlayerState == nullptr)
+	{
+		return false;
+	}
+
+	// The shooter saw the server state of half a round trip ago, plus its own interpolation delay
+	const float fRewind = FMath::Min(_Shooter->PlayerState->ExactPing * 0.0005f + m_fInterpolationDelay, m_fMaxRewindSeconds);
+	_fOutTime = FMath::Max(GetWorld()->GetTimeSeconds() - fRewind, m_History.GetOldestTime());
+	return true;
+}
+
+AActor* ASafetyFirstLagCompensation::RewindSweep(float _fTime, const FVector& _vStart, const FVector& _vEnd, float _fRadius, const AActor* _Ignore, float& _fOutFraction)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_LagSweep, LagSweep);
+	INC_DWORD_STAT(STAT_SafetyFirst_LagSweeps);
+
+	const int32* ignoreSlot = m_SlotOf.Find(_Ignore);
+	const double fStart = FPlatformTime::Seconds();
+	int32 iSlot = INDEX_NONE;
+	const bool bHit = m_History.Sweep(_fTime, _vStart, _vEnd, _fRadius, ignoreSlot != nullptr ? *ignoreSlot : INDEX_NONE, iSlot, _fOutFraction);
+	m_fQuerySeconds += FPlatformTime::Seconds() - fStart;
+	++m_iQueries;
+
+	return bHit ? m_Actors[iSlot].Get() : nullptr;
+}
+
+void ASafetyFirstLagCompensation::DumpStats() const
+{
+	UE_LOG(LogSafetyFirst, Display, TEXT("Lag compensation: %d actors, %d frames, %.1f KB, record %.3f us per frame, %d sweeps at %.3f us each"),
+		m_SlotOf.Num(), m_History.GetNumFrames(), m_History.GetAllocatedSize() / 1024.0f,
+		m_iRecordedFrames > 0 ? (float)(m_fRecordSeconds * 1000000.0 / m_iRecordedFrames) : 0.0f,
+		m_iQueries, m_iQueries > 0 ? (float)(m_fQuerySeconds * 1000000.0 / m_iQueries) : 0.0f);
+}
+
+FSafetyFirstRewindCost ASafetyFirstLagCompensation::MeasureRewindCost(int32 _iAgents, int32 _iPlayers, int32 _iShotsPerPlayer)
+{
+	FSafetyFirstRewindCost cost;
+	const int32 iActors = FMath::Max(_iAgents + _iPlayers, 1);
+	const int32 iShots = FMath::Max(_iPlayers * _iShotsPerPlayer, 1);
+	const ASafetyFirstLagCompensation* defaults = GetDefault<ASafetyFirstLagCompensation>();
+	const float fFrameTime = 1.0f / 30.0f;
+
+	FSafetyFirstLagHistory history;
+	history.Init(iActors, defaults->m_iMaxFrames);
+	for (int32 i = 0; i < iActors; ++i)
+	{
+		history.AddSlot(40.0f, 90.0f);
+	}
+
+	// Agents wander in an arena the size of the example map, players are the last slots
+	FRandomStream random(0x5AFE);
+	TArray<FVector> positions;
+	TArray<FVector> velocities;
+	for (int32 i = 0; i < iActors; ++i)
+	{
+		positions.Add(FVector(random.FRandRange(-3000.0f, 3000.0f), random.FRandRange(-3000.0f, 3000.0f), 100.0f));
+		velocities.Add(FVector(random.FRandRange(-400.0f, 400.0f), random.FRandRange(-400.0f, 400.0f), 0.0f));
+	}
+
+	const double fRecordStart = FPlatformTime::Seconds();
+	for (int32 f = 0; f < defaults->m_iMaxFrames; ++f)
+	{
+		history.BeginFrame(f * fFrameTime);
+		for (int32 i = 0; i < iActors; ++i)
+		{
+			positions[i] += velocities[i] * fFrameTime;
+			history.SetPosition(i, positions[i]);
+		}
+	}
+	const double fRecordSeconds = FPlatformTime::Seconds() - fRecordStart;
+
+	// Every player shoots from where it is, toward a random agent, at a random point of the history
+	TArray<FVector> starts;
+	TArray<FVector> ends;
+	TArray<float> times;
+	for (int32 s = 0; s < iShots; ++s)
+	{
+		const int32 iPlayer = _iPlayers > 0 ? _iAgents + s % _iPlayers : 0;
+		const FVector vTarget = positions[random.RandHelper(FMath::Max(_iAgents, 1))];
+		starts.Add(positions[iPlayer]);
+		ends.Add(positions[iPlayer] + (vTarget - positions[iPlayer]).GetSafeNormal() * 2000.0f);
+		times.Add(random.FRandRange(history.GetOldestTime(), (defaults->m_iMaxFrames - 1) * fFrameTime));
+	}
+
+	int32 iHits = 0;
+	const double fQueryStart = FPlatformTime::Seconds();
+	for (int32 s = 0; s < iShots; ++s)
+	{
+		int32 iSlot;
+		float fFraction;
+		const int32 iPlayer = _iPlayers > 0 ? _iAgents + s % _iPlayers : INDEX_NONE;
+		iHits += history.Sweep(times[s], starts[s], ends[s], 10.0f, iPlayer, iSlot, fFraction) ? 1 : 0;
+	}
+	const double fQuerySeconds = FPlatformTime::Seconds() - fQueryStart;
+
+	UE_LOG(LogSafetyFirst, Verbose, TEXT("Lag compensation bench: %d of %d sweeps hit"), iHits, iShots);
+
+	cost.m_iQueries = iShots;
+	cost.m_fQueryMicroseconds = (float)(fQuerySeconds * 1000000.0 / iShots);
+	cost.m_fRecordMicroseconds = (float)(fRecordSeconds * 1000000.0 / defaults->m_iMaxFrames);
+	cost.m_uMemoryBytes = history.GetAllocatedSize();
+	return cost;
+}
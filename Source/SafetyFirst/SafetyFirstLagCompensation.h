@@ -0,0 +1,143 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstLagCompensation.generated.h"
+
+/** Memory and average cost of one rewound sweep, measured by ASafetyFirstLagCompensation::MeasureRewindCost */
+struct FSafetyFirstRewindCost
+{
+	int32 m_iQueries = 0;
+	float m_fQueryMicroseconds = 0.0f;
+	float m_fRecordMicroseconds = 0.0f;
+	SIZE_T m_uMemoryBytes = 0;
+};
+
+/**
+ * Fixed size history of the positions of many actors, one frame per server tick.
+ * Positions are stored as structure of arrays, frame by frame, so a rewound test reads two contiguous runs of floats.
+ * The bounds of an actor are a vertical cylinder set once when its slot is given. Nothing is allocated after Init.
+ */
+class FSafetyFirstLagHistory
+{
+public:
+	void Init(int32 _iMaxSlots, int32 _iMaxFrames);
+
+	/** Returns the slot of a new actor, INDEX_NONE when full. Frames recorded before this call are never tested for it */
+	int32 AddSlot(float _fRadius, float _fHalfHeight);
+	void RemoveSlot(int32 _iSlot);
+
+	/** Starts the frame of _fTime, then every used slot must get its position */
+	void BeginFrame(float _fTime);
+	void SetPosition(int32 _iSlot, const FVector& _vLocation);
+
+	/**
+	 * Sweeps a sphere from _vStart to _vEnd against the slots as they were at _fTime, between the two recorded frames around it.
+	 * Returns the first slot hit and the fraction of the segment where it is hit, false if nothing is hit.
+	 */
+	bool Sweep(float _fTime, const FVector& _vStart, const FVector& _vEnd, float _fRadius, int32 _iIgnoreSlot, int32& _iOutSlot, float& _fOutFraction) const;
+
+	/** Oldest time a sweep can rewind to */
+	float GetOldestTime() const;
+	int32 GetNumFrames() const { return m_iNumFrames; }
+	int32 GetNumSlots() const { return m_iNumSlots; }
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	int32 m_iMaxSlots = 0;
+	int32 m_iMaxFrames = 0;
+
+	/** Ring of frames, m_iNewestFrame is the last one begun */
+	int32 m_iNewestFrame = INDEX_NONE;
+	int32 m_iNumFrames = 0;
+	uint32 m_uFrameCounter = 0;
+
+	// Indexed by frame * m_iMaxSlots + slot
+	TArray<float, TAlignedHeapAllocator<16>> m_X;
+	TArray<float, TAlignedHeapAllocator<16>> m_Y;
+	TArray<float, TAlignedHeapAllocator<16>> m_Z;
+
+	// Indexed by frame
+	TArray<float> m_FrameTime;
+	TArray<uint32> m_FrameNumber;
+
+	// Indexed by slot, m_iNumSlots is one past the highest slot ever used
+	TArray<float> m_Radius;
+	TArray<float> m_HalfHeight;
+	TArray<uint32> m_FirstFrame;
+	TBitArray<> m_Used;
+	TArray<int32> m_FreeSlots;
+	int32 m_iNumSlots = 0;
+};
+
+/**
+ * Server side lag compensation for the hits of remote players.
+ * Damageable actors register once, their locations are recorded into a FSafetyFirstLagHistory after every server tick,
+ * and shots of a remote player are swept against the history at the time that player saw, without moving any actor.
+ * Only records on listen and dedicated servers.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstLagCompensation : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstLagCompensation();
+
+	/** Returns the lag compensation of the world, spawning it if needed */
+	static ASafetyFirstLagCompensation* Get(UWorld* _World);
+
+	/** Records the actor from now on, with its colliding bounds as a vertical cylinder. Returns false on clients, standalone, or when full */
+	bool Register(AActor* _Actor);
+	void Unregister(AActor* _Actor);
+
+	bool IsCompensated(const AActor* _Actor) const { return m_SlotOf.Contains(_Actor); }
+
+	/** True when hits of _Shooter should be rewound, with the server time its player saw */
+	bool GetRewindTime(const APawn* _Shooter, float& _fOutTime) const;
+
+	/** Sweeps a sphere against the registered actors as they were at _fTime. _Ignore is skipped, usually the shooter */
+	AActor* RewindSweep(float _fTime, const FVector& _vStart, const FVector& _vEnd, float _fRadius, const AActor* _Ignore, float& _fOutFraction);
+
+	void DumpStats() const;
+
+	/** Fills a history with _iAgents moving agents and _iPlayers pawns, then times _iShotsPerPlayer rewound sweeps per player */
+	static FSafetyFirstRewindCost MeasureRewindCost(int32 _iAgents, int32 _iPlayers, int32 _iShotsPerPlayer);
+
+	virtual void PostInitializeComponents() override;
+	virtual void Tick(float _fDt) override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxActors = 1024;
+
+	/** Frames kept, at the server tick rate this bounds the rewind */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxFrames = 32;
+
+	/** Longest rewind, pings above it are compensated up to it only */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxRewindSeconds = 0.25f;
+
+	/** Added to half the round trip, how far behind the server the client shows the other actors */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fInterpolationDelay = 0.0f;
+
+	/** Bounds of actors without colliding components */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fDefaultRadius = 50.0f;
+
+private:
+	FSafetyFirstLagHistory m_History;
+
+	/** Indexed by history slot */
+	TArray<TWeakObjectPtr<AActor>> m_Actors;
+	TMap<const AActor*, int32> m_SlotOf;
+
+	// Since the last dump
+	int32 m_iQueries = 0;
+	double m_fQuerySeconds = 0.0;
+	double m_fRecordSeconds = 0.0;
+	int32 m_iRecordedFrames = 0;
+};
@@ -0,0 +1,254 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstLevelStreaming.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCollision2D.h"
+#include "SafetyFirstFlowField.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/PackageName.h"
+
+DECLARE_CYCLE_STAT(TEXT("Level streaming"), STAT_SafetyFirst_LevelStreaming, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Streaming cells visible"), STAT_SafetyFirst_StreamingCells, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streaming stall frames"), STAT_SafetyFirst_StreamingStall, STATGROUP_SafetyFirst);
+DECLARE_MEMORY_STAT(TEXT("Resident memory"), STAT_SafetyFirst_ResidentMemory, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpStreamingStatsCmd(
+	TEXT("SafetyFirst.Streaming.Stats"),
+	TEXT("Logs the streamed cells, their load times, the frames a pawn waited for one and the resident memory"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstLevelStreaming* streaming = ASafetyFirstLevelStreaming::Get(_World))
+		{
+			streaming->DumpStats();
+		}
+	}));
+
+ASafetyFirstLevelStreaming::ASafetyFirstLevelStreaming()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+}
+
+ASafetyFirstLevelStreaming* ASafetyFirstLevelStreaming::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstLevelStreaming>(_World);
+}
+
+void ASafetyFirstLevelStreaming::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Maps without cells keep everything resident, nothing to do
+	GatherCells();
+	SetActorTickEnabled(m_Cells.Num() > 0);
+	if (m_Cells.Num() > 0)
+	{
+		LogResidentMemory(TEXT("started"), nullptr);
+	}
+}
+
+void ASafetyFirstLevelStreaming::GatherCells()
+{
+	static const FString CellTag(TEXT("_Cell_"));
+
+	m_Cells.Reset();
+	for (ULevelStreaming* level : GetWorld()->GetStreamingLevels())
+	{
+		if (level == nullptr)
+		{
+			continue;
+		}
+
+		// PIE prefixes the package names, the cell coordinates are always at the end
+		const FString name = FPackageName::GetShortName(level->GetWorldAssetPackageFName());
+		const int32 iTag = name.Find(CellTag, ESearchCase::IgnoreCase, ESearchDir::FromEnd);
+		FString cellX;
+		FString cellY;
+		if (iTag == INDEX_NONE || !name.Mid(iTag + CellTag.Len()).Split(TEXT("_"), &cellX, &cellY) || !cellX.IsNumeric() || !cellY.IsNumeric())
+		{
+			continue;
+		}
+
+		const FVector2D vCell((float)FCString::Atoi(*cellX), (float)FCString::Atoi(*cellY));
+
+		FCell cell;
+		cell.m_Level = level;
+		cell.m_Bounds = FBox2D(m_vOrigin + vCell * m_fCellSize, m_vOrigin + (vCell + FVector2D(1.0f, 1.0f)) * m_fCellSize);
+		cell.m_bWanted = level->ShouldBeLoaded();
+		cell.m_bWasVisible = level->IsLevelVisible();
+		cell.m_iPins = 0;
+		cell.m_fRequestTime = 0.0;
+		m_Cells.Add(cell);
+	}
+
+	UE_LOG(LogSafetyFirst, Log, TEXT("Streaming: %d cells of %.0f units"), m_Cells.Num(), m_fCellSize);
+}
+
+void ASafetyFirstLevelStreaming::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_LevelStreaming, LevelStreaming);
+
+	TSafetyFirstFrameArray<FVector2D> pawnLocations;
+	for (TActorIterator<ASafetyFirstPawn> it(GetWorld()); it; ++it)
+	{
+		pawnLocations.Add(FVector2D(it->GetActorLocation()));
+	}
+
+	ASafetyFirstFlowField* flowField = nullptr;
+	ASafetyFirstCollision2D* collision2D = nullptr;
+	bool bStalled = false;
+	int32 iVisible = 0;
+	for (FCell& cell : m_Cells)
+	{
+		bool bCellChanged = false;
+		UpdateCell(cell, pawnLocations, bCellChanged, bStalled);
+		iVisible += cell.m_bWasVisible ? 1 : 0;
+
+		// The crowd paths around the props of the cell, or through the space they left
+		if (bCellChanged)
+		{
+			flowField = flowField != nullptr ? flowField : ASafetyFirstFlowField::Get(GetWorld());
+			if (flowField != nullptr)
+			{
+				flowField->RebakeStaticCollision(cell.m_Bounds);
+			}
+
+			// Static blockers came or went with the cell
+			collision2D = collision2D != nullptr ? collision2D : ASafetyFirstCollision2D::Get(GetWorld());
+			if (collision2D != nullptr)
+			{
+				collision2D->Rebake(cell.m_Bounds);
+			}
+		}
+	}
+
+	if (bStalled)
+	{
+		++m_iStallFrames;
+		m_fStallSeconds += _fDt;
+		INC_DWORD_STAT(STAT_SafetyFirst_StreamingStall);
+	}
+
+	SET_DWORD_STAT(STAT_SafetyFirst_StreamingCells, iVisible);
+	CSV_CUSTOM_STAT(SafetyFirst, StreamingCells, iVisible, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, StreamingStall, bStalled ? 1 : 0, ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstLevelStreaming::UpdateCell(FCell& _Cell, const TSafetyFirstFrameArray<FVector2D>& _PawnLocations, bool& _bOutChanged, bool& _bOutStalled)
+{
+	ULevelStreaming* level = _Cell.m_Level.Get();
+	if (level == nullptr)
+	{
+		return;
+	}
+
+	float fClosestSq = BIG_NUMBER;
+	for (const FVector2D& vLocation : _PawnLocations)
+	{
+		fClosestSq = FMath::Min(fClosestSq, _Cell.m_Bounds.ComputeSquaredDistanceToPoint(vLocation));
+	}
+
+	// Two distances, so a pawn on the edge of the load distance does not load and unload the cell every frame
+	const bool bWanted = _Cell.m_iPins > 0 || fClosestSq < FMath::Square(m_fLoadDistance)
+		|| (_Cell.m_bWanted && fClosestSq < FMath::Square(m_fUnloadDistance));
+	if (bWanted != _Cell.m_bWanted)
+	{
+		_Cell.m_bWanted = bWanted;
+		level->SetShouldBeLoaded(bWanted);
+		level->SetShouldBeVisible(bWanted);
+
+		if (bWanted)
+		{
+			_Cell.m_fRequestTime = FPlatformTime::Seconds();
+		}
+		else
+		{
+			++m_iUnloads;
+			LogResidentMemory(TEXT("unloading"), level);
+		}
+	}
+
+	const bool bVisible = level->IsLevelVisible();
+	if (bVisible != _Cell.m_bWasVisible)
+	{
+		_Cell.m_bWasVisible = bVisible;
+		_bOutChanged = true;
+
+		if (bVisible && _Cell.m_fRequestTime > 0.0)
+		{
+			const double fLoadSeconds = FPlatformTime::Seconds() - _Cell.m_fRequestTime;
+			m_fLoadSeconds += fLoadSeconds;
+			m_fMaxLoadSeconds = FMath::Max(m_fMaxLoadSeconds, fLoadSeconds);
+			++m_iLoads;
+			_Cell.m_fRequestTime = 0.0;
+			LogResidentMemory(*FString::Printf(TEXT("loaded in %.0f ms"), fLoadSeconds * 1000.0), level);
+		}
+	}
+
+	// A pawn inside a cell that is not there yet plays on an empty floor
+	if (fClosestSq <= 0.0f && !bVisible)
+	{
+		_bOutStalled = true;
+	}
+}
+
+ASafetyFirstLevelStreaming::FCell* ASafetyFirstLevelStreaming::FindCell(const ULevel* _Level)
+{
+	if (_Level == nullptr)
+	{
+		return nullptr;
+	}
+
+	return m_Cells.FindByPredicate([_Level](const FCell& _Cell)
+	{
+		return _Cell.m_Level.IsValid() && _Cell.m_Level->GetLoadedLevel() == _Level;
+	});
+}
+
+void ASafetyFirstLevelStreaming::PinLevel(const ULevel* _Level)
+{
+	if (FCell* cell = FindCell(_Level))
+	{
+		++cell->m_iPins;
+	}
+}
+
+void ASafetyFirstLevelStreaming::UnpinLevel(const ULevel* _Level)
+{
+	FCell* cell = FindCell(_Level);
+	if (cell != nullptr && cell->m_iPins > 0)
+	{
+		--cell->m_iPins;
+	}
+}
+
+void ASafetyFirstLevelStreaming::LogResidentMemory(const TCHAR* _Event, const ULevelStreaming* _Level) const
+{
+	const FPlatformMemoryStats memoryStats = FPlatformMemory::GetStats();
+	SET_MEMORY_STAT(STAT_SafetyFirst_ResidentMemory, memoryStats.UsedPhysical);
+	CSV_CUSTOM_STAT(SafetyFirst, ResidentMB, memoryStats.UsedPhysical / (1024.0f * 1024.0f), ECsvCustomStatOp::Set);
+
+	UE_LOG(LogSafetyFirst, Log, TEXT("Streaming: %s %s, resident memory %.1f MB"),
+		_Level != nullptr ? *FPackageName::GetShortName(_Level->GetWorldAssetPackageFName()) : TEXT("cells"), _Event,
+		memoryStats.UsedPhysical / (1024.0f * 1024.0f));
+}
+
+void ASafetyFirstLevelStreaming::DumpStats() const
+{
+	int32 iVisible = 0;
+	for (const FCell& cell : m_Cells)
+	{
+		iVisible += cell.m_bWasVisible ? 1 : 0;
+	}
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Streaming: %d of %d cells visible, %d loads at %.0f ms average and %.0f ms max, %d unloads, %d stall frames for %.2f s"),
+		iVisible, m_Cells.Num(), m_iLoads, m_iLoads > 0 ? (float)(m_fLoadSeconds * 1000.0 / m_iLoads) : 0.0f, (float)(m_fMaxLoadSeconds * 1000.0),
+		m_iUnloads, m_iStallFrames, m_fStallSeconds);
+	LogResidentMemory(TEXT("now"), nullptr);
+}
@@ -0,0 +1,86 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstLevelStreaming.generated.h"
+
+class ULevelStreaming;
+
+/**
+ * Streams the arena in square cells around the ASafetyFirstPawns.
+ * Each cell is a sublevel of the persistent map named <Map>_Cell_<X>_<Y>, with the Blueprint streaming method, holding
+ * the props of the square X, Y of a grid of m_fCellSize starting at m_vOrigin. A cell is loaded asynchronously when a
+ * pawn comes within m_fLoadDistance of it, and unloaded once every pawn is further than m_fUnloadDistance.
+ * Gameplay actors spawned at runtime live in the persistent level, so they survive the cells they cross. A weapon placed
+ * in a cell pins it once a pawn picks the weapon up, the cell then stays loaded for as long as the weapon is in play.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstLevelStreaming : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstLevelStreaming();
+
+	/** Returns the streaming of the world, spawning it if needed */
+	static ASafetyFirstLevelStreaming* Get(UWorld* _World);
+
+	/** Keeps the cell holding _Level loaded until it is unpinned as many times, for actors of a cell used away from it */
+	void PinLevel(const ULevel* _Level);
+	void UnpinLevel(const ULevel* _Level);
+
+	void DumpStats() const;
+
+	virtual void BeginPlay() override;
+	virtual void Tick(float _fDt) override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCellSize = 2500.0f;
+
+	/** Corner of the cell 0, 0 */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FVector2D m_vOrigin = FVector2D(-5000.0f, -5000.0f);
+
+	/** A cell starts loading when a pawn is closer than this to its edge */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fLoadDistance = 3000.0f;
+
+	/** A loaded cell unloads when every pawn is further than this from its edge, larger than m_fLoadDistance */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fUnloadDistance = 4000.0f;
+
+private:
+	struct FCell
+	{
+		TWeakObjectPtr<ULevelStreaming> m_Level;
+		FBox2D m_Bounds;
+		bool m_bWanted;
+		bool m_bWasVisible;
+		int32 m_iPins;
+		/** Time the load was requested, to report how long it took */
+		double m_fRequestTime;
+	};
+
+	/** Finds the cells among the streaming levels of the world */
+	void GatherCells();
+
+	/** Requests the load or unload of the cell, sets _bOutChanged when it appeared or disappeared, _bOutStalled when a pawn waits for it */
+	void UpdateCell(FCell& _Cell, const TSafetyFirstFrameArray<FVector2D>& _PawnLocations, bool& _bOutChanged, bool& _bOutStalled);
+
+	FCell* FindCell(const ULevel* _Level);
+
+	void LogResidentMemory(const TCHAR* _Event, const ULevelStreaming* _Level) const;
+
+	TArray<FCell> m_Cells;
+
+	// Since play started
+	int32 m_iLoads = 0;
+	int32 m_iUnloads = 0;
+	int32 m_iStallFrames = 0;
+	float m_fStallSeconds = 0.0f;
+	double m_fLoadSeconds = 0.0;
+	double m_fMaxLoadSeconds = 0.0;
+};
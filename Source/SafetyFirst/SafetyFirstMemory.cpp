@@ -0,0 +1,167 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstMemory.h"
+#include "SafetyFirst.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Optional.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Memory tags over budget"), STAT_SafetyFirst_MemoryOverBudget, STATGROUP_SafetyFirst);
+DECLARE_MEMORY_STAT(TEXT("Frame allocator peak"), STAT_SafetyFirst_FrameAllocatorPeak, STATGROUP_SafetyFirst);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst"), STAT_SafetyFirstLLM, STATGROUP_LLM);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Projectiles"), STAT_SafetyFirstProjectilesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Weapons"), STAT_SafetyFirstWeaponsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Pawns"), STAT_SafetyFirstPawnsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Enemies"), STAT_SafetyFirstEnemiesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Audio"), STAT_SafetyFirstAudioLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Effects"), STAT_SafetyFirstEffectsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("SafetyFirst Managers"), STAT_SafetyFirstManagersLLM, STATGROUP_LLMFULL);
+#endif
+
+static FAutoConsoleCommand GDumpMemoryStatsCmd(
+	TEXT("SafetyFirst.Memory.Stats"),
+	TEXT("Logs the tracked amount and budget of every memory tag of the module, needs -llm"),
+	FConsoleCommandDelegate::CreateStatic(&SafetyFirstMemory::DumpStats));
+
+namespace SafetyFirstMemory
+{
+	static FMemStackBase s_FrameStack;
+	static TOptional<FMemMark> s_FrameMark;
+	static int32 s_iFramePeakBytes = 0;
+
+	static FDelegateHandle s_EndFrameHandle;
+	static FDelegateHandle s_TickerHandle;
+
+	static const TCHAR* s_TagNames[] =
+	{
+		TEXT("Projectiles"),
+		TEXT("Weapons"),
+		TEXT("Pawns"),
+		TEXT("Enemies"),
+		TEXT("Audio"),
+		TEXT("Effects"),
+		TEXT("Managers"),
+	};
+	static_assert(ARRAY_COUNT(s_TagNames) == (int32)ESafetyFirstMemoryTag::Count, "One name per memory tag");
+
+	/** Set while a tag is over its budget, so crossing it is logged once */
+	static bool s_bOverBudget[(int32)ESafetyFirstMemoryTag::Count] = {};
+
+	FMemStackBase& GetFrameStack()
+	{
+		return s_FrameStack;
+	}
+
+	/** Gives back everything the frame allocated */
+	static void OnEndFrame()
+	{
+		const int32 iBytes = s_FrameStack.GetByteCount();
+		if (iBytes > s_iFramePeakBytes)
+		{
+			s_iFramePeakBytes = iBytes;
+			SET_MEMORY_STAT(STAT_SafetyFirst_FrameAllocatorPeak, s_iFramePeakBytes);
+		}
+		CSV_CUSTOM_STAT(SafetyFirst, FrameAllocatorKB, iBytes / 1024.0f, ECsvCustomStatOp::Set);
+
+		s_FrameMark.Reset();
+		s_FrameMark.Emplace(s_FrameStack);
+	}
+
+	static bool IsTracking()
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		return FLowLevelMemTracker::IsEnabled();
+#else
+		return false;
+#endif
+	}
+
+	static int64 GetTrackedBytes(ESafetyFirstMemoryTag _eTag)
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		return FLowLevelMemTracker::Get().GetTagAmountForTracker(ELLMTracker::Default, ToLLMTag(_eTag));
+#else
+		return 0;
+#endif
+	}
+
+	static bool CheckBudgets(float _fDt)
+	{
+		if (!IsTracking())
+		{
+			return true;
+		}
+
+		int32 iOverBudget = 0;
+		for (const FSafetyFirstMemoryBudget& budget : GetDefault<USafetyFirstMemoryBudgets>()->m_Budgets)
+		{
+			if (budget.m_fMegabytes <= 0.0f || budget.m_eTag >= ESafetyFirstMemoryTag::Count)
+			{
+				continue;
+			}
+
+			const float fMegabytes = GetTrackedBytes(budget.m_eTag) / (1024.0f * 1024.0f);
+			const bool bOver = fMegabytes > budget.m_fMegabytes;
+			bool& bWasOver = s_bOverBudget[(int32)budget.m_eTag];
+			if (bOver && !bWasOver)
+			{
+				UE_LOG(LogSafetyFirst, Warning, TEXT("Memory: %s uses %.2f MB, over its budget of %.2f MB"),
+					s_TagNames[(int32)budget.m_eTag], fMegabytes, budget.m_fMegabytes);
+			}
+			bWasOver = bOver;
+			iOverBudget += bOver ? 1 : 0;
+		}
+
+		SET_DWORD_STAT(STAT_SafetyFirst_MemoryOverBudget, iOverBudget);
+		CSV_CUSTOM_STAT(SafetyFirst, MemoryTagsOverBudget, iOverBudget, ECsvCustomStatOp::Set);
+		return true;
+	}
+
+	void DumpStats()
+	{
+		if (!IsTracking())
+		{
+			UE_LOG(LogSafetyFirst, Display, TEXT("Memory: the low level memory tracker is off, run with -llm"));
+		}
+
+		const USafetyFirstMemoryBudgets* budgets = GetDefault<USafetyFirstMemoryBudgets>();
+		for (int32 i = 0; i < (int32)ESafetyFirstMemoryTag::Count; ++i)
+		{
+			const ESafetyFirstMemoryTag eTag = (ESafetyFirstMemoryTag)i;
+			const FSafetyFirstMemoryBudget* budget = budgets->m_Budgets.FindByPredicate([eTag](const FSafetyFirstMemoryBudget& _Budget) { return _Budget.m_eTag == eTag; });
+			UE_LOG(LogSafetyFirst, Display, TEXT("Memory: %-12s %8.2f MB, budget %s"),
+				s_TagNames[i], GetTrackedBytes(eTag) / (1024.0f * 1024.0f),
+				budget != nullptr && budget->m_fMegabytes > 0.0f ? *FString::Printf(TEXT("%.2f MB"), budget->m_fMegabytes) : TEXT("none"));
+		}
+		UE_LOG(LogSafetyFirst, Display, TEXT("Memory: frame allocator peak %.1f KB"), s_iFramePeakBytes / 1024.0f);
+	}
+
+	void Startup()
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		const FName summaryStat = GET_STATFNAME(STAT_SafetyFirstLLM);
+		FLowLevelMemTracker& tracker = FLowLevelMemTracker::Get();
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Projectiles), TEXT("SafetyFirst Projectiles"), GET_STATFNAME(STAT_SafetyFirstProjectilesLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Weapons), TEXT("SafetyFirst Weapons"), GET_STATFNAME(STAT_SafetyFirstWeaponsLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Pawns), TEXT("SafetyFirst Pawns"), GET_STATFNAME(STAT_SafetyFirstPawnsLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Enemies), TEXT("SafetyFirst Enemies"), GET_STATFNAME(STAT_SafetyFirstEnemiesLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Audio), TEXT("SafetyFirst Audio"), GET_STATFNAME(STAT_SafetyFirstAudioLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Effects), TEXT("SafetyFirst Effects"), GET_STATFNAME(STAT_SafetyFirstEffectsLLM), summaryStat);
+		tracker.RegisterProjectTag((int32)ToLLMTag(ESafetyFirstMemoryTag::Managers), TEXT("SafetyFirst Managers"), GET_STATFNAME(STAT_SafetyFirstManagersLLM), summaryStat);
+#endif
+
+		s_FrameMark.Emplace(s_FrameStack);
+		s_EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+		s_TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&CheckBudgets), GetDefault<USafetyFirstMemoryBudgets>()->m_fCheckInterval);
+	}
+
+	void Shutdown()
+	{
+		FCoreDelegates::OnEndFrame.Remove(s_EndFrameHandle);
+		FTicker::GetCoreTicker().RemoveTicker(s_TickerHandle);
+		s_FrameMark.Reset();
+	}
+}
@@ -0,0 +1,183 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/MemStack.h"
+#include "UObject/Object.h"
+#include "SafetyFirstMemory.generated.h"
+
+/** Low level memory tracker tags of the module, each one is a project tag of its own */
+UENUM()
+enum class ESafetyFirstMemoryTag : uint8
+{
+	Projectiles,
+	Weapons,
+	Pawns,
+	/** Crowd agents, enemy Blueprints and the AI managers moving them */
+	Enemies,
+	Audio,
+	Effects,
+	/** Other world managers: damage, lag compensation, grids, significance, recording */
+	Managers,
+	Count UMETA(Hidden),
+};
+
+/** Tags the allocations of the scope, only compiled in when the low level memory tracker is */
+#define SAFETYFIRST_LLM_SCOPE(_Tag) LLM_SCOPE(SafetyFirstMemory::ToLLMTag(ESafetyFirstMemoryTag::_Tag))
+
+USTRUCT()
+struct FSafetyFirstMemoryBudget
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	ESafetyFirstMemoryTag m_eTag = ESafetyFirstMemoryTag::Managers;
+
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	float m_fMegabytes = 0.0f;
+};
+
+/**
+ * Memory budgets, read from the [/Script/SafetyFirst.SafetyFirstMemoryBudgets] section of DefaultGame.ini.
+ * The amount of each tag is checked at a fixed interval while the game runs with -llm, a tag over its budget is logged
+ * when it crosses it and counted in the SafetyFirst stat group and CSV category until it goes back under.
+ */
+UCLASS(config=Game)
+class USafetyFirstMemoryBudgets : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	TArray<FSafetyFirstMemoryBudget> m_Budgets;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCheckInterval = 1.0f;
+};
+
+namespace SafetyFirstMemory
+{
+	/** Registers the tags and starts the budget checks, called by the module */
+	void Startup();
+	void Shutdown();
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	inline ELLMTag ToLLMTag(ESafetyFirstMemoryTag _eTag)
+	{
+		return (ELLMTag)((int32)ELLMTag::ProjectTagStart + (int32)_eTag);
+	}
+#endif
+
+	/** Logs the tracked amount and the budget of every tag */
+	void DumpStats();
+
+	/** Game thread stack emptied at the end of every frame, backs FSafetyFirstFrameAllocator */
+	FMemStackBase& GetFrameStack();
+}
+
+/**
+ * Container allocator taking its memory from the frame stack of SafetyFirstMemory, for transient gameplay data such as
+ * hit lists and query results. Growing only bumps a pointer, nothing is ever freed before the end of the frame:
+ * containers using it must be game thread locals that do not outlive the frame.
+ */
+class FSafetyFirstFrameAllocator
+{
+public:
+	typedef int32 SizeType;
+
+	enum { NeedsElementType = false };
+	enum { RequireRangeCheck = true };
+
+	class ForAnyElementType
+	{
+	public:
+		ForAnyElementType()
+			: m_Data(nullptr)
+		{
+		}
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& _Other)
+		{
+			checkSlow(this != &_Other);
+			m_Data = _Other.m_Data;
+			_Other.m_Data = nullptr;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return m_Data;
+		}
+
+		void ResizeAllocation(SizeType _PreviousNumElements, SizeType _NumElements, SIZE_T _NumBytesPerElement)
+		{
+			check(IsInGameThread());
+			FScriptContainerElement* oldData = m_Data;
+			if (_NumElements > 0)
+			{
+				m_Data = (FScriptContainerElement*)SafetyFirstMemory::GetFrameStack().PushBytes((int32)(_NumElements * _NumBytesPerElement), 16);
+				if (oldData != nullptr && _PreviousNumElements > 0)
+				{
+					FMemory::Memcpy(m_Data, oldData, FMath::Min(_NumElements, _PreviousNumElements) * _NumBytesPerElement);
+				}
+			}
+			else
+			{
+				// The frame stack reclaims the old block, an empty array must not keep pointing at it
+				m_Data = nullptr;
+			}
+		}
+
+		FORCEINLINE SizeType CalculateSlackReserve(SizeType _NumElements, SIZE_T _NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(_NumElements, _NumBytesPerElement, /*bAllowQuantize*/false, 16);
+		}
+
+		FORCEINLINE SizeType CalculateSlackShrink(SizeType _NumElements, SizeType _NumAllocatedElements, SIZE_T _NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(_NumElements, _NumAllocatedElements, _NumBytesPerElement, /*bAllowQuantize*/false, 16);
+		}
+
+		FORCEINLINE SizeType CalculateSlackGrow(SizeType _NumElements, SizeType _NumAllocatedElements, SIZE_T _NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(_NumElements, _NumAllocatedElements, _NumBytesPerElement, /*bAllowQuantize*/false, 16);
+		}
+
+		SIZE_T GetAllocatedSize(SizeType _NumAllocatedElements, SIZE_T _NumBytesPerElement) const
+		{
+			return _NumAllocatedElements * _NumBytesPerElement;
+		}
+
+		bool HasAllocation()
+		{
+			return m_Data != nullptr;
+		}
+
+	private:
+		ForAnyElementType(const ForAnyElementType&);
+		ForAnyElementType& operator=(const ForAnyElementType&);
+
+		FScriptContainerElement* m_Data;
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+};
+
+template<>
+struct TAllocatorTraits<FSafetyFirstFrameAllocator> : TAllocatorTraitsBase<FSafetyFirstFrameAllocator>
+{
+	enum { SupportsMove = true };
+};
+
+/** Array living until the end of the frame, see FSafetyFirstFrameAllocator */
+template<typename T>
+using TSafetyFirstFrameArray = TArray<T, FSafetyFirstFrameAllocator>;
@@ -0,0 +1,86 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstNetTypes.h"
+
+void FSafetyFirstPawnInput::SetMove(float _fForward, float _fRight)
+{
+	m_iForward = (int8)FMath::RoundToInt(FMath::Clamp(_fForward, -1.0f, 1.0f) * 127.0f);
+	m_iRight = (int8)FMath::RoundToInt(FMath::Clamp(_fRight, -1.0f, 1.0f) * 127.0f);
+}
+
+void FSafetyFirstPawnInput::SetFireDirection(const FVector& _vDirection)
+{
+	m_uFireYaw = FRotator::CompressAxisToShort(_vDirection.Rotation().Yaw);
+}
+
+void FSafetyFirstPawnInput::SetDeltaTime(float _fDt)
+{
+	m_uDeltaMs = (uint8)FMath::Clamp(FMath::RoundToInt(_fDt * 1000.0f), 1, 255);
+}
+
+bool FSafetyFirstPawnMovePacket::NetSerialize(FArchive& _Ar, class UPackageMap* _Map, bool& _bOutSuccess)
+{
+	// A packet always holds at least one move
+	uint8 uNumMoves = (uint8)FMath::Max(m_Moves.Num() - 1, 0);
+	_Ar.SerializeBits(&uNumMoves, 3);
+	++uNumMoves;
+	if (_Ar.IsLoading())
+	{
+		if (uNumMoves > MaxMoves)
+		{
+			_bOutSuccess = false;
+			return true;
+		}
+		m_Moves.SetNum(uNumMoves);
+	}
+	else if (m_Moves.Num() == 0)
+	{
+		_bOutSuccess = false;
+		return true;
+	}
+
+	for (int32 i = 0; i < uNumMoves; ++i)
+	{
+		FSafetyFirstPawnInput& move = m_Moves[i];
+		_Ar.SerializeBits(&move.m_uFlags, 2);
+
+		if (i == 0)
+		{
+			_Ar << move.m_uSequence << move.m_iForward << move.m_iRight << move.m_uFireYaw << move.m_uDeltaMs;
+			continue;
+		}
+
+		const FSafetyFirstPawnInput& previous = m_Moves[i - 1];
+		uint8 bMoveChanged = move.m_iForward != previous.m_iForward || move.m_iRight != previous.m_iRight;
+		uint8 bYawChanged = move.m_uFireYaw != previous.m_uFireYaw;
+		uint8 bDeltaChanged = move.m_uDeltaMs != previous.m_uDeltaMs;
+		_Ar.SerializeBits(&bMoveChanged, 1);
+		_Ar.SerializeBits(&bYawChanged, 1);
+		_Ar.SerializeBits(&bDeltaChanged, 1);
+
+		if (_Ar.IsLoading())
+		{
+			move.m_uSequence = previous.m_uSequence + 1;
+			move.m_iForward = previous.m_iForward;
+			move.m_iRight = previous.m_iRight;
+			move.m_uFireYaw = previous.m_uFireYaw;
+			move.m_uDeltaMs = previous.m_uDeltaMs;
+		}
+
+		if (bMoveChanged)
+		{
+			_Ar << move.m_iForward << move.m_iRight;
+		}
+		if (bYawChanged)
+		{
+			_Ar << move.m_uFireYaw;
+		}
+		if (bDeltaChanged)
+		{
+			_Ar << move.m_uDeltaMs;
+		}
+	}
+
+	_bOutSuccess = !_Ar.IsError();
+	return true;
+}
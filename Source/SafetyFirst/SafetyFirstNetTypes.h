@@ -0,0 +1,118 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "SafetyFirstNetTypes.generated.h"
+
+/** One frame of pawn input, quantized so that the client predicts with exactly what the server receives */
+USTRUCT()
+struct FSafetyFirstPawnInput
+{
+	GENERATED_BODY()
+
+	enum EFlags : uint8
+	{
+		Fire = 1 << 0,
+		WantPickup = 1 << 1,
+	};
+
+	/** Wraps around, compare with IsNewerSequence */
+	uint16 m_uSequence = 0;
+
+	/** Move stick, -127..127 */
+	int8 m_iForward = 0;
+	int8 m_iRight = 0;
+
+	/** Yaw of the fire direction, FRotator::CompressAxisToShort */
+	uint16 m_uFireYaw = 0;
+
+	uint8 m_uFlags = 0;
+
+	/** Frame time in milliseconds */
+	uint8 m_uDeltaMs = 0;
+
+	void SetMove(float _fForward, float _fRight);
+	void SetFireDirection(const FVector& _vDirection);
+	void SetDeltaTime(float _fDt);
+
+	FVector GetMove() const { return FVector(m_iForward / 127.0f, m_iRight / 127.0f, 0.0f); }
+	FVector GetFireDirection() const { return FRotator(0.0f, FRotator::DecompressAxisFromShort(m_uFireYaw), 0.0f).Vector(); }
+	float GetDeltaTime() const { return m_uDeltaMs * 0.001f; }
+	bool HasFlag(EFlags _eFlag) const { return (m_uFlags & _eFlag) != 0; }
+
+	static bool IsNewerSequence(uint16 _uA, uint16 _uB) { return (int16)(_uA - _uB) > 0; }
+};
+
+/**
+ * Inputs of the steps of one frame, topped up with the last unacknowledged ones, sent to the server in one unreliable
+ * RPC so a lost packet is covered by the next one.
+ * Moves are consecutive: only the first one carries its sequence and the others only send the fields that changed.
+ */
+USTRUCT()
+struct FSafetyFirstPawnMovePacket
+{
+	GENERATED_BODY()
+
+	/** Sent as the count minus one on 3 bits */
+	static const int32 MaxMoves = 8;
+
+	TArray<FSafetyFirstPawnInput, TFixedAllocator<MaxMoves>> m_Moves;
+
+	bool NetSerialize(FArchive& _Ar, class UPackageMap* _Map, bool& _bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FSafetyFirstPawnMovePacket> : public TStructOpsTypeTraitsBase2<FSafetyFirstPawnMovePacket>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/** Authoritative pawn movement, property replication only sends the fields that changed since the last update */
+USTRUCT()
+struct FSafetyFirstPawnNetState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 m_vLocation = FVector::ZeroVector;
+
+	/** Smoothed movement of the last frame, see ASafetyFirstPawn::ApplyMovement */
+	UPROPERTY()
+	FVector_NetQuantize100 m_vMovement = FVector::ZeroVector;
+
+	UPROPERTY()
+	uint16 m_uYaw = 0;
+
+	/** Last client input applied by the server */
+	UPROPERTY()
+	uint16 m_uAckSequence = 0;
+};
+
+/** Server side weapon throw, enough for every client to replay the flight */
+USTRUCT()
+struct FSafetyFirstWeaponThrow
+{
+	GENERATED_BODY()
+
+	/** Bumped on each throw so that two identical throws still replicate */
+	UPROPERTY()
+	uint8 m_uCount = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize10 m_vStart = FVector::ZeroVector;
+
+	UPROPERTY()
+	FVector_NetQuantizeNormal m_vDirection = FVector::ZeroVector;
+
+	UPROPERTY()
+	uint16 m_uStartYaw = 0;
+
+	/** Server world time of the throw, lets late joiners start the flight where it is */
+	UPROPERTY()
+	float m_fServerTime = 0.0f;
+};
@@ -1,8 +1,20 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
 #include "SafetyFirstPawn.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCollision2D.h"
+#include "SafetyFirstCrowdManager.h"
+#include "SafetyFirstFixedStep.h"
+#include "SafetyFirstInputRecorder.h"
+#include "SafetyFirstLagCompensation.h"
+#include "SafetyFirstLevelStreaming.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPreload.h"
 #include "SafetyFirstProjectile.h"
+#include "SafetyFirstProximityGrid.h"
+#include "SafetyFirstTelemetry.h"
 #include "TimerManager.h"
+#include "Net/UnrealNetwork.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Camera/CameraComponent.h"
 #include "Components/StaticMeshComponent.h"
@@ -13,6 +25,10 @@
 #include "Kismet/GameplayStatics.h"
 #include "Sound/SoundBase.h"
 
+DECLARE_CYCLE_STAT(TEXT("Pawn tick"), STAT_SafetyFirst_PawnTick, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Pawn retrieve weapon"), STAT_SafetyFirst_RetrieveWeapon, STATGROUP_SafetyFirst);
+DECLARE_CYCLE_STAT(TEXT("Pawn overlap"), STAT_SafetyFirst_PawnOverlap, STATGROUP_SafetyFirst);
+
 const FName ASafetyFirstPawn::MoveForwardBinding("MoveForward");
 const FName ASafetyFirstPawn::MoveRightBinding("MoveRight");
 const FName ASafetyFirstPawn::FireForwardBinding("FireForward");
@@ -23,29 +39,33 @@ const FName ASafetyFirstPawn::PickUpBinding("PickUp");
 
 ASafetyFirstPawn::ASafetyFirstPawn()
 {	
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> ShipMesh(TEXT("/Game/TwinStick/Meshes/TwinStickUFO.TwinStickUFO"));
+	SAFETYFIRST_LLM_SCOPE(Pawns);
+	// Assets are soft references set on the components in BeginPlay, the preload manifest streams them with the map
+	m_ShipMeshAsset = FSoftObjectPath(TEXT("/Game/TwinStick/Meshes/TwinStickUFO.TwinStickUFO"));
+	m_FireDirMeshAsset = FSoftObjectPath(TEXT("/Game/StarterContent/Shapes/Shape_Cone.Shape_Cone"));
+	m_FireSoundAsset = FSoftObjectPath(TEXT("/Game/TwinStick/Audio/TwinStickFire.TwinStickFire"));
+
 	// Create the mesh component
 	ShipMeshComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ShipMesh"));
 	RootComponent = ShipMeshComponent;
 	ShipMeshComponent->SetCollisionProfileName(UCollisionProfile::Pawn_ProfileName);
-	ShipMeshComponent->SetStaticMesh(ShipMesh.Object);
+	ShipMeshComponent->bHiddenInGame = true;
+
+	ShipVisualComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ShipVisual"));
+	ShipVisualComponent->SetupAttachment(ShipMeshComponent);
+	ShipVisualComponent->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
 	
 
 	// Create the fire Direction component
 	FireDirComponent = CreateDefaultSubobject<USceneComponent>(TEXT("FireDir"));
 	
 
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> FireDirMesh(TEXT("/Game/StarterContent/Shapes/Shape_Cone.Shape_Cone"));
 	// Create the fire direction mesh component
 	FireDirMeshComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("FireDirMesh"));
 	FireDirMeshComponent->SetupAttachment(FireDirComponent);
 	FireDirMeshComponent->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
-	FireDirMeshComponent->SetStaticMesh(FireDirMesh.Object);
 
-
-	// Cache our sound effect
-	static ConstructorHelpers::FObjectFinder<USoundBase> FireAudio(TEXT("/Game/TwinStick/Audio/TwinStickFire.TwinStickFire"));
-	FireSound = FireAudio.Object;
+	FireSound = nullptr;
 
 	// Create a camera boom...
 	//CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
@@ -66,6 +86,11 @@ ASafetyFirstPawn::ASafetyFirstPawn()
 	GunOffset = FVector(90.f, 0.f, 0.f);
 	FireRate = 0.1f;
 
+	// Movement is replicated as quantized state with client prediction, see ServerMove and OnRep_ServerState
+	bReplicates = true;
+	bReplicateMovement = false;
+	NetUpdateFrequency = 30.0f;
+
 
 }
 
@@ -85,8 +110,33 @@ void ASafetyFirstPawn::SetupPlayerInputComponent(class UInputComponent* PlayerIn
 
 void ASafetyFirstPawn::BeginPlay()
 {
+	SAFETYFIRST_LLM_SCOPE(Pawns);
+	// Blueprints may set their own assets, the soft defaults only fill the gaps
+	if (ShipMeshComponent->GetStaticMesh() == nullptr)
+	{
+		ShipMeshComponent->SetStaticMesh(SafetyFirstPreload::Resolve(m_ShipMeshAsset));
+	}
+	if (ShipVisualComponent->GetStaticMesh() == nullptr)
+	{
+		ShipVisualComponent->SetStaticMesh(ShipMeshComponent->GetStaticMesh());
+		for (int32 iMaterial = 0; iMaterial < ShipMeshComponent->GetNumMaterials(); ++iMaterial)
+		{
+			ShipVisualComponent->SetMaterial(iMaterial, ShipMeshComponent->GetMaterial(iMaterial));
+		}
+	}
+	if (FireDirMeshComponent->GetStaticMesh() == nullptr)
+	{
+		FireDirMeshComponent->SetStaticMesh(SafetyFirstPreload::Resolve(m_FireDirMeshAsset));
+	}
+	if (FireSound == nullptr)
+	{
+		FireSound = SafetyFirstPreload::Resolve(m_FireSoundAsset);
+	}
+
 	Super::BeginPlay();
-	if (m_WeaponClass != nullptr)
+
+	// Clients get their weapon from the server through m_ReplicatedWeapon
+	if (m_WeaponClass != nullptr && HasAuthority())
 	{
 		FActorSpawnParameters spawnInfo;
 		spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
@@ -98,37 +148,271 @@ void ASafetyFirstPawn::BeginPlay()
 	}
 
 	m_vFireDirection = GetActorForwardVector();
-	
+
+	m_fPickupRadius = ShipMeshComponent->Bounds.BoxExtent.Size2D();
+
+	m_Collision2D = ASafetyFirstCollision2D::Get(GetWorld());
+	if (m_Collision2D.IsValid())
+	{
+		// Static blockers are resolved on the plane, the sweeps only need to see dynamic bodies
+		ShipMeshComponent->SetCollisionResponseToChannel(ECC_WorldStatic, ECR_Ignore);
+		if (m_fCollisionRadius <= 0.0f)
+		{
+			m_fCollisionRadius = FMath::Max(ShipMeshComponent->Bounds.BoxExtent.X, ShipMeshComponent->Bounds.BoxExtent.Y);
+		}
+	}
+	m_ProximityGrid = ASafetyFirstProximityGrid::Get(GetWorld());
+	if (m_ProximityGrid.IsValid())
+	{
+		m_iProximityHandle = m_ProximityGrid->Register(this, ESafetyFirstGridLayer::Pawn);
+	}
+
+	if (HasAuthority())
+	{
+		PublishServerState();
+	}
+
+	// Only records on servers, where remote players shoot at this pawn as they saw it
+	m_LagCompensation = ASafetyFirstLagCompensation::Get(GetWorld());
+	if (m_LagCompensation.IsValid())
+	{
+		m_LagCompensation->Register(this);
+	}
+
+	// Streams the cells of the arena around the pawns, when the map has any
+	ASafetyFirstLevelStreaming::Get(GetWorld());
+
+	m_FixedStep = ASafetyFirstFixedStep::Get(GetWorld());
+	m_vPreviousStepLocation = GetActorLocation();
+}
+
+void ASafetyFirstPawn::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	if (m_ProximityGrid.IsValid())
+	{
+		m_ProximityGrid->Unregister(m_iProximityHandle);
+	}
+	m_iProximityHandle = INDEX_NONE;
+
+	if (m_LagCompensation.IsValid())
+	{
+		m_LagCompensation->Unregister(this);
+	}
+
+	Super::EndPlay(_EndPlayReason);
 }
 
 
 void ASafetyFirstPawn::Tick(float _fDt)
 {
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_PawnTick, PawnTick);
+
 	Super::Tick(_fDt);
 
-	// Find movement direction
-	const float ForwardValue = GetInputAxisValue(MoveForwardBinding);
-	const float RightValue = GetInputAxisValue(MoveRightBinding);
+	if (IsLocallyControlled())
+	{
+		// Frames shorter than a step only move the drawn ship between the last two steps
+		ASafetyFirstFixedStep* fixedStep = m_FixedStep.Get();
+		const int32 iSteps = fixedStep != nullptr ? fixedStep->GetNumSteps() : 1;
+		const float fStepSeconds = fixedStep != nullptr ? fixedStep->GetStepSeconds() : _fDt;
+
+		// Input is read and recorded once per frame with the frame time, even without a step, so a playback running
+		// the same frame times through the same clock steps identically
+		FSafetyFirstRecordedInput raw;
+		ReadRawInput(_fDt, raw);
+
+		// A trigger pulled in a frame without a step fires on the next step, even if it is released by then. Pickup
+		// presses already wait for a step in m_bWantPickup
+		m_bFireLatched |= raw.m_Axes[FSafetyFirstRecordedInput::Fire] > 0.0f;
+		for (int32 iStep = 0; iStep < iSteps; ++iStep)
+		{
+			m_vPreviousStepLocation = GetActorLocation();
+			StepLocal(raw, fStepSeconds);
+		}
+
+		if (iSteps > 0 && HasAuthority())
+		{
+			PublishServerState();
+		}
+		else if (m_iUnsentMoves > 0)
+		{
+			SendPendingMoves();
+		}
+
+		if (fixedStep != nullptr && fixedStep->IsEnabled())
+		{
+			InterpolateStepLocation(fixedStep->GetAlpha());
+		}
+		else if (!ShipVisualComponent->RelativeLocation.IsZero())
+		{
+			ShipVisualComponent->SetRelativeLocation(FVector::ZeroVector);
+		}
+	}
+	else if (!HasAuthority())
+	{
+		SmoothSimulatedProxy(_fDt);
+	}
+	// Pawns of remote players only move on the server when their inputs arrive, see ServerMove
+}
+
+void ASafetyFirstPawn::StepLocal(const FSafetyFirstRecordedInput& _Raw, float _fDt)
+{
+	const FSafetyFirstPawnInput input = GatherInput(_Raw, _fDt);
+	if (HasAuthority())
+	{
+		SimulateMove(input);
+		m_uLastProcessedSequence = input.m_uSequence;
+	}
+	else
+	{
+		PredictMove(input);
+	}
+
+	if (m_bWantPickup)
+	{
+		m_fPickupLifeSpan -= _fDt;
+		if (m_fPickupLifeSpan <= 0.0f)
+		{
+			m_bWantPickup = false;
+		}
+	}
+}
+
+void ASafetyFirstPawn::InterpolateStepLocation(float _fAlpha)
+{
+	// Only the drawn ship lags, collision, lag compensation, targeting and pickups use the simulated location
+	ShipVisualComponent->SetWorldLocation(FMath::Lerp(m_vPreviousStepLocation, GetActorLocation(), _fAlpha));
+}
+
+FSafetyFirstPawnInput ASafetyFirstPawn::GatherInput(const FSafetyFirstRecordedInput& _Raw, float _fDt)
+{
+	FSafetyFirstPawnInput input;
+	input.m_uSequence = m_uNextSequence++;
+	input.SetMove(_Raw.m_Axes[FSafetyFirstRecordedInput::MoveForward], _Raw.m_Axes[FSafetyFirstRecordedInput::MoveRight]);
+	input.SetDeltaTime(_fDt);
 
-	
-	
 	// Create fire direction vector
-	const float FireForwardValue = GetInputAxisValue(FireForwardBinding);
-	const float FireRightValue = GetInputAxisValue(FireRightBinding);
+	const float FireForwardValue = _Raw.m_Axes[FSafetyFirstRecordedInput::FireForward];
+	const float FireRightValue = _Raw.m_Axes[FSafetyFirstRecordedInput::FireRight];
 	if (FVector(FireForwardValue, FireRightValue, 0.f).SizeSquared() > m_fDeadZoneRightStick * m_fDeadZoneRightStick)
 	{
 		m_vFireDirection = FVector(FireForwardValue, FireRightValue, 0.f).GetSafeNormal2D();
+		if (m_bAimAssist)
+		{
+			m_vFireDirection = ApplyAimAssist(m_vFireDirection);
+		}
 	}
-	
-	FRotator FireDirRotator = m_vFireDirection.Rotation();
+	input.SetFireDirection(m_vFireDirection);
+
+	if (_Raw.m_Axes[FSafetyFirstRecordedInput::Fire] > 0.0f || m_bFireLatched)
+	{
+		input.m_uFlags |= FSafetyFirstPawnInput::Fire;
+	}
+	m_bFireLatched = false;
+	if (m_bWantPickup)
+	{
+		input.m_uFlags |= FSafetyFirstPawnInput::WantPickup;
+	}
+	return input;
+}
+
+FVector ASafetyFirstPawn::ApplyAimAssist(const FVector& _vStickDirection)
+{
+	if (!m_CrowdManager.IsValid())
+	{
+		m_CrowdManager = ASafetyFirstCrowdManager::Get(GetWorld());
+		if (!m_CrowdManager.IsValid())
+		{
+			return _vStickDirection;
+		}
+	}
+
+	// The assisted direction goes in the input, so the server and the recorder see the same shot as the player
+	const FSafetyFirstAimTargets& targets = m_CrowdManager->GetAimTargets();
+	const FVector2D vOrigin(GetActorLocation());
+	const float fCosHalfAngle = FMath::Cos(FMath::DegreesToRadians(FMath::Clamp(m_fAimAssistHalfAngle, 0.0f, 90.0f)));
+	const int32 iBest = targets.FindBest(vOrigin, FVector2D(_vStickDirection), fCosHalfAngle, m_fAimAssistRange, m_fAimAssistDistanceWeight);
+	if (iBest == INDEX_NONE)
+	{
+		return _vStickDirection;
+	}
+
+	const FVector2D vToTarget = (targets.GetLocation(iBest) - vOrigin).GetSafeNormal();
+	return FVector(vToTarget.X, vToTarget.Y, 0.0f);
+}
+
+void ASafetyFirstPawn::ReadRawInput(float _fDt, FSafetyFirstRecordedInput& _OutInput)
+{
+	ASafetyFirstInputRecorder* recorder = ASafetyFirstInputRecorder::GetActive(GetWorld());
+	const int32 iPlayer = recorder != nullptr ? UGameplayStatics::GetPlayerControllerID(Cast<APlayerController>(GetController())) : INDEX_NONE;
+
+	if (recorder != nullptr && recorder->IsPlaying())
+	{
+		// The recorded pickup presses replace the ones of the bindings
+		if (recorder->GetPlaybackInput(iPlayer, _OutInput))
+		{
+			if (_OutInput.m_bPickUpPressed)
+			{
+				PickUpPressed();
+			}
+			if (_OutInput.m_bPickUpReleased)
+			{
+				PickUpReleased();
+			}
+		}
+		m_bPickUpPressedEvent = false;
+		m_bPickUpReleasedEvent = false;
+		return;
+	}
+
+	if (m_bHasScriptedInput)
+	{
+		FMemory::Memcpy(_OutInput.m_Axes, m_ScriptedInput.m_Axes, sizeof(_OutInput.m_Axes));
+	}
+	else
+	{
+		_OutInput.m_Axes[FSafetyFirstRecordedInput::MoveForward] = GetInputAxisValue(MoveForwardBinding);
+		_OutInput.m_Axes[FSafetyFirstRecordedInput::MoveRight] = GetInputAxisValue(MoveRightBinding);
+		_OutInput.m_Axes[FSafetyFirstRecordedInput::FireForward] = GetInputAxisValue(FireForwardBinding);
+		_OutInput.m_Axes[FSafetyFirstRecordedInput::FireRight] = GetInputAxisValue(FireRightBinding);
+		_OutInput.m_Axes[FSafetyFirstRecordedInput::Fire] = GetInputAxisValue(FireBinding);
+	}
+	_OutInput.m_bPickUpPressed = m_bPickUpPressedEvent;
+	_OutInput.m_bPickUpReleased = m_bPickUpReleasedEvent;
+	m_bPickUpPressedEvent = false;
+	m_bPickUpReleasedEvent = false;
 
-	FireDirComponent->SetWorldRotation(FireDirRotator);
+	if (recorder != nullptr)
+	{
+		recorder->RecordInput(iPlayer, _fDt, _OutInput);
+	}
+}
 
+FVector ASafetyFirstPawn::SimulateMove(const FSafetyFirstPawnInput& _Input)
+{
+	m_vFireDirection = _Input.GetFireDirection();
+	FireDirComponent->SetWorldRotation(m_vFireDirection.Rotation());
+	m_bWantPickup = _Input.HasFlag(FSafetyFirstPawnInput::WantPickup);
+
+	const FVector vRecoil = UpdateFire(_Input.HasFlag(FSafetyFirstPawnInput::Fire));
+	ApplyMovement(_Input, vRecoil);
+
+	if (m_ProximityGrid.IsValid())
+	{
+		m_ProximityGrid->UpdateLocation(m_iProximityHandle, GetActorLocation());
+	}
+
+	UpdatePickup();
+	return vRecoil;
+}
+
+FVector ASafetyFirstPawn::UpdateFire(bool _bFire)
+{
 	FVector vRecoil = FVector::ZeroVector;
-	
+
 	if (m_Weapon.IsValid())
 	{
-		if (GetInputAxisValue(FireBinding) > 0.0f)
+		if (_bFire)
 		{
 			if (!m_bHasFirePressed)
 			{
@@ -140,9 +424,14 @@ void ASafetyFirstPawn::Tick(float _fDt)
 					m_Weapon->DetachFromActor(detachmentRules);
 					m_Weapon->SetWeaponOwner(nullptr);
 					m_OnFire.Broadcast(m_Weapon.Get(), m_vFireDirection);
+					SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::WeaponEject, this, GetActorLocation());
 					m_Weapon->RecoilLauncher(m_vFireDirection);
 					vRecoil = m_vFireDirection * m_Weapon->GetRecoilPower()*-1.0f;
 					m_Weapon = nullptr;
+					if (HasAuthority())
+					{
+						m_ReplicatedWeapon = nullptr;
+					}
 				}
 			}
 		}
@@ -150,28 +439,269 @@ void ASafetyFirstPawn::Tick(float _fDt)
 		{
 			m_bHasFirePressed = false;
 		}
-	}	
+	}
 
+	return vRecoil;
+}
+
+void ASafetyFirstPawn::ApplyMovement(const FSafetyFirstPawnInput& _Input, const FVector& _vRecoil)
+{
 	// Clamp max size so that (X=1, Y=1) doesn't cause faster movement in diagonal directions
-	const FVector MoveDirection = FVector(ForwardValue, RightValue, 0.f).GetClampedToMaxSize(1.0f);
+	const FVector MoveDirection = _Input.GetMove().GetClampedToMaxSize(1.0f);
 
 	// Calculate  movement
-	m_Movement = FMath::Lerp(m_Movement, (MoveDirection * MoveSpeed + vRecoil) * _fDt, MoveSpeedLerp);
+	m_Movement = FMath::Lerp(m_Movement, (MoveDirection * MoveSpeed + _vRecoil) * _Input.GetDeltaTime(), MoveSpeedLerp);
 
-	
+	const FRotator FireDirRotator = _Input.GetFireDirection().Rotation();
+
+	FVector Move = m_Movement;
+	if (const ASafetyFirstCollision2D* Collision2D = m_Collision2D.Get())
+	{
+		const FVector Start = GetActorLocation();
+		Move = Collision2D->ResolveMove(Start, m_Movement, m_fCollisionRadius) - Start;
+	}
 
 	// If non-zero size, move this actor
 	FHitResult Hit(1.f);
-	RootComponent->MoveComponent(m_Movement, FireDirRotator, true, &Hit);
+	RootComponent->MoveComponent(Move, FireDirRotator, true, &Hit);
 
 	if (Hit.IsValidBlockingHit())
 	{
 		const FVector Normal2D = Hit.Normal.GetSafeNormal2D();
-		const FVector Deflection = FVector::VectorPlaneProject(m_Movement, Normal2D) * (1.f - Hit.Time);
+		const FVector Deflection = FVector::VectorPlaneProject(Move, Normal2D) * (1.f - Hit.Time);
 		RootComponent->MoveComponent(Deflection, FireDirRotator, true);
 	}
+}
+
+void ASafetyFirstPawn::PredictMove(const FSafetyFirstPawnInput& _Input)
+{
+	ASafetyFirstWeapon* weaponBefore = m_Weapon.Get();
+
+	FSavedMove move;
+	move.m_Input = _Input;
+	move.m_vRecoil = SimulateMove(_Input);
+	move.m_vResultLocation = GetActorLocation();
+	move.m_bChangedWeapon = m_Weapon.Get() != weaponBefore;
+
+	if (m_PendingMoves.Num() >= MaxPendingMoves)
+	{
+		m_PendingMoves.RemoveAt(0, 1, /*bAllowShrinking*/false);
+	}
+	m_PendingMoves.Add(move);
+	++m_iUnsentMoves;
+}
+
+void ASafetyFirstPawn::SendPendingMoves()
+{
+	// One packet with the moves of the frame, topped up with the last unacknowledged ones so a lost packet is covered by
+	// the next one. Only a frame with more steps than a packet holds needs more than one
+	const int32 iNumMoves = m_PendingMoves.Num();
+	int32 iFirstUnsent = FMath::Max(iNumMoves - m_iUnsentMoves, 0);
+	while (iFirstUnsent < iNumMoves)
+	{
+		const int32 iEnd = FMath::Min(iFirstUnsent + FSafetyFirstPawnMovePacket::MaxMoves, iNumMoves);
+		FSafetyFirstPawnMovePacket packet;
+		for (int32 i = FMath::Max(iEnd - FSafetyFirstPawnMovePacket::MaxMoves, 0); i < iEnd; ++i)
+		{
+			packet.m_Moves.Add(m_PendingMoves[i].m_Input);
+		}
+		ServerMove(packet);
+		iFirstUnsent = iEnd;
+	}
+	m_iUnsentMoves = 0;
+}
+
+bool ASafetyFirstPawn::ServerMove_Validate(const FSafetyFirstPawnMovePacket& _Packet)
+{
+	return _Packet.m_Moves.Num() > 0;
+}
+
+void ASafetyFirstPawn::ServerMove_Implementation(const FSafetyFirstPawnMovePacket& _Packet)
+{
+	// Clients cannot move or fire faster than the server clock: moves past the time elapsed since the last packet are
+	// trimmed, then dropped, and the correction brings the client back
+	const float fServerTime = GetWorld()->GetTimeSeconds();
+	m_fMoveTimeBudget = m_fLastMoveServerTime >= 0.0f ? m_fMoveTimeBudget + (fServerTime - m_fLastMoveServerTime) : m_fNetMaxMoveTimeBudget;
+	m_fMoveTimeBudget = FMath::Min(m_fMoveTimeBudget, m_fNetMaxMoveTimeBudget);
+	m_fLastMoveServerTime = fServerTime;
+
+	for (const FSafetyFirstPawnInput& input : _Packet.m_Moves)
+	{
+		if (!FSafetyFirstPawnInput::IsNewerSequence(input.m_uSequence, m_uLastProcessedSequence))
+		{
+			continue;
+		}
+
+		// Acknowledged even when dropped, so the client stops resending it and takes the correction
+		m_uLastProcessedSequence = input.m_uSequence;
+		const float fDt = FMath::Min3(input.GetDeltaTime(), m_fNetMaxMoveDelta, m_fMoveTimeBudget);
+		if (fDt < 0.001f)
+		{
+			continue;
+		}
+
+		FSafetyFirstPawnInput clamped = input;
+		clamped.SetDeltaTime(fDt);
+		SimulateMove(clamped);
+		m_fMoveTimeBudget -= clamped.GetDeltaTime();
+	}
+
+	PublishServerState();
+}
+
+void ASafetyFirstPawn::PublishServerState()
+{
+	m_ServerState.m_vLocation = GetActorLocation();
+	m_ServerState.m_vMovement = m_Movement;
+	m_ServerState.m_uYaw = FRotator::CompressAxisToShort(m_vFireDirection.Rotation().Yaw);
+	m_ServerState.m_uAckSequence = m_uLastProcessedSequence;
+}
+
+void ASafetyFirstPawn::OnRep_ServerState()
+{
+	m_bHasServerState = true;
+
+	if (!IsLocallyControlled())
+	{
+		// Location is smoothed in Tick
+		FireDirComponent->SetWorldRotation(FRotator(0.0f, FRotator::DecompressAxisFromShort(m_ServerState.m_uYaw), 0.0f));
+		return;
+	}
+
+	int32 iAcked = INDEX_NONE;
+	for (int32 i = 0; i < m_PendingMoves.Num() && !FSafetyFirstPawnInput::IsNewerSequence(m_PendingMoves[i].m_Input.m_uSequence, m_ServerState.m_uAckSequence); ++i)
+	{
+		iAcked = i;
+	}
+
+	const float fThresholdSquared = FMath::Square(m_fNetCorrectionThreshold);
+	bool bPredictionValid = true;
+	if (iAcked != INDEX_NONE)
+	{
+		bPredictionValid = FVector::DistSquared(m_PendingMoves[iAcked].m_vResultLocation, m_ServerState.m_vLocation) <= fThresholdSquared;
+		m_PendingMoves.RemoveAt(0, iAcked + 1, /*bAllowShrinking*/false);
+	}
+	else if (m_PendingMoves.Num() == 0)
+	{
+		bPredictionValid = FVector::DistSquared(GetActorLocation(), m_ServerState.m_vLocation) <= fThresholdSquared;
+	}
+
+	if (!bPredictionValid)
+	{
+		// Back to the server state, then replay what it has not seen yet
+		SetActorLocation(m_ServerState.m_vLocation, /*bSweep*/false, nullptr, ETeleportType::TeleportPhysics);
+		m_Movement = m_ServerState.m_vMovement;
+		for (FSavedMove& move : m_PendingMoves)
+		{
+			ApplyMovement(move.m_Input, move.m_vRecoil);
+			move.m_vResultLocation = GetActorLocation();
+		}
+
+		if (m_ProximityGrid.IsValid())
+		{
+			m_ProximityGrid->UpdateLocation(m_iProximityHandle, GetActorLocation());
+		}
+	}
+
+	ReconcileWeapon();
+}
+
+void ASafetyFirstPawn::OnRep_Weapon()
+{
+	ReconcileWeapon();
+}
+
+void ASafetyFirstPawn::ReconcileWeapon()
+{
+	ASafetyFirstWeapon* serverWeapon = m_ReplicatedWeapon;
+	if (serverWeapon == m_Weapon.Get())
+	{
+		return;
+	}
+
+	// The server has not seen our own throws and pickups yet
+	if (IsLocallyControlled() && m_PendingMoves.ContainsByPredicate([](const FSavedMove& _Move) { return _Move.m_bChangedWeapon; }))
+	{
+		return;
+	}
+
+	if (m_Weapon.IsValid() && m_Weapon->GetWeaponOwner() == this)
+	{
+		FDetachmentTransformRules detachmentRules(/*InLocationRule*/EDetachmentRule::KeepWorld, /*InRotationRule*/EDetachmentRule::KeepWorld, /*InScaleRule*/EDetachmentRule::KeepWorld, /*bInCallModify*/true);
+		m_Weapon->DetachFromActor(detachmentRules);
+		m_Weapon->SetWeaponOwner(nullptr);
+	}
+	m_Weapon = nullptr;
+
+	if (serverWeapon != nullptr)
+	{
+		RetrieveWeapon(serverWeapon);
+	}
+}
+
+void ASafetyFirstPawn::SmoothSimulatedProxy(float _fDt)
+{
+	if (!m_bHasServerState)
+	{
+		return;
+	}
+
+	const FVector vLocation = FMath::VInterpTo(GetActorLocation(), m_ServerState.m_vLocation, _fDt, m_fNetSmoothingSpeed);
+	const FRotator rotation(0.0f, FRotator::DecompressAxisFromShort(m_ServerState.m_uYaw), 0.0f);
+	SetActorLocationAndRotation(vLocation, rotation);
+
+	if (m_ProximityGrid.IsValid())
+	{
+		m_ProximityGrid->UpdateLocation(m_iProximityHandle, vLocation);
+	}
+}
+
+void ASafetyFirstPawn::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ASafetyFirstPawn, m_ServerState);
+	DOREPLIFETIME(ASafetyFirstPawn, m_ReplicatedWeapon);
+}
+
+
+void ASafetyFirstPawn::RetrieveWeapon(ASafetyFirstWeapon* _weapon)
+{
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_RetrieveWeapon, RetrieveWeapon);
+
+	if (_weapon != nullptr)
+	{
+		m_Weapon = _weapon;
+		m_Weapon->SetWeaponOwner(this);
+		// A weapon placed in a streamed cell would be destroyed with it, wherever it is dropped
+		_weapon->PinLevel();
+		FAttachmentTransformRules transformRules(/*InLocationRule*/EAttachmentRule::KeepRelative, /*InRotationRule*/EAttachmentRule::SnapToTarget, /*InScaleRule*/EAttachmentRule::KeepWorld, /*bInWeldSimulatedBodies*/false);
+		m_Weapon->AttachToActor(this, transformRules);
+		m_Weapon->SetActorRelativeLocation(m_vWeaponAttachmentOffset);
+		SafetyFirstCounters::AddPickup();
+		SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::Pickup, this, GetActorLocation());
+
+		if (HasAuthority())
+		{
+			m_ReplicatedWeapon = _weapon;
+		}
+	}
+}
 
+void ASafetyFirstPawn::UpdatePickup()
+{
+	if (ASafetyFirstProximityGrid::UseOverlapPickup() || !m_ProximityGrid.IsValid())
+	{
+		UpdatePickupFromOverlap();
+	}
+	else
+	{
+		UpdatePickupFromGrid();
+	}
+}
 
+void ASafetyFirstPawn::UpdatePickupFromOverlap()
+{
 	if (m_WeaponPickup.IsValid())
 	{
 		if (m_WeaponPickup->CanBePickedUp() && m_bWantPickup)
@@ -186,34 +716,37 @@ void ASafetyFirstPawn::Tick(float _fDt)
 			m_WeaponPickup = nullptr;
 		}
 	}
+}
 
-
+void ASafetyFirstPawn::UpdatePickupFromGrid()
+{
 	if (m_bWantPickup)
 	{
-		m_fPickupLifeSpan -= _fDt;
-		if (m_fPickupLifeSpan <= 0.0f)
+		if (ASafetyFirstWeapon* weapon = m_ProximityGrid->FindNearestPickup(GetActorLocation(), m_fPickupRadius))
 		{
+			RetrieveWeapon(weapon);
 			m_bWantPickup = false;
 		}
 	}
-	
 }
 
-
-void ASafetyFirstPawn::RetrieveWeapon(ASafetyFirstWeapon* _weapon)
+void ASafetyFirstPawn::SetScriptedInput(const FSafetyFirstRecordedInput& _Input)
 {
-	if (_weapon != nullptr)
+	m_ScriptedInput = _Input;
+	m_bHasScriptedInput = true;
+	if (_Input.m_bPickUpPressed)
 	{
-		m_Weapon = _weapon;
-		m_Weapon->SetWeaponOwner(this);
-		FAttachmentTransformRules transformRules(/*InLocationRule*/EAttachmentRule::KeepRelative, /*InRotationRule*/EAttachmentRule::SnapToTarget, /*InScaleRule*/EAttachmentRule::KeepWorld, /*bInWeldSimulatedBodies*/false);
-		m_Weapon->AttachToActor(this, transformRules);
-		m_Weapon->SetActorRelativeLocation(m_vWeaponAttachmentOffset);
+		PickUpPressed();
+	}
+	if (_Input.m_bPickUpReleased)
+	{
+		PickUpReleased();
 	}
 }
 
 void ASafetyFirstPawn::PickUpPressed()
 {
+	m_bPickUpPressedEvent = true;
 	if (!m_bPickupPressed)
 	{
 		m_bPickupPressed = true;
@@ -224,12 +757,15 @@ void ASafetyFirstPawn::PickUpPressed()
 
 void ASafetyFirstPawn::PickUpReleased()
 {
+	m_bPickUpReleasedEvent = true;
 	m_bPickupPressed = false;
 	m_bWantPickup = true;
 }
 
 void ASafetyFirstPawn::NotifyActorBeginOverlap(AActor* _otherActor)
 {
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_PawnOverlap, PawnOverlap);
+
 	Super::NotifyActorBeginOverlap(_otherActor);
 	if (ASafetyFirstWeapon* weapon = Cast<ASafetyFirstWeapon>(_otherActor))
 	{
@@ -243,6 +779,8 @@ void ASafetyFirstPawn::NotifyActorBeginOverlap(AActor* _otherActor)
 
 void ASafetyFirstPawn::NotifyActorEndOverlap(AActor* _otherActor)
 {
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_PawnOverlap, PawnOverlap);
+
 	Super::NotifyActorEndOverlap(_otherActor);
 	if (ASafetyFirstWeapon* weapon = Cast<ASafetyFirstWeapon>(_otherActor))
 	{
@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "SafetyFirstWeapon.h"
+#include "SafetyFirstNetTypes.h"
+#include "SafetyFirstInputRecorder.h"
 
 #include "SafetyFirstPawn.generated.h"
 
@@ -17,6 +19,10 @@ class ASafetyFirstPawn : public APawn
 	UPROPERTY(Category = Mesh, VisibleDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	class UStaticMeshComponent* ShipMeshComponent;
 
+	/* Draws the ship mesh, between the last two fixed steps while the collision stays at the last one */
+	UPROPERTY(Category = Mesh, VisibleDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	class UStaticMeshComponent* ShipVisualComponent;
+
 	/* The fire dir */
 	UPROPERTY(Category = Mesh, VisibleDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	class USceneComponent* FireDirComponent;
@@ -55,6 +61,16 @@ public:
 	UPROPERTY(Category = Audio, EditAnywhere, BlueprintReadWrite)
 	class USoundBase* FireSound;
 
+	/** Defaults of the meshes and FireSound when they are not set, loaded with the map by the preload manifest */
+	UPROPERTY(Category = Mesh, EditDefaultsOnly)
+	TSoftObjectPtr<class UStaticMesh> m_ShipMeshAsset;
+
+	UPROPERTY(Category = Mesh, EditDefaultsOnly)
+	TSoftObjectPtr<class UStaticMesh> m_FireDirMeshAsset;
+
+	UPROPERTY(Category = Audio, EditDefaultsOnly)
+	TSoftObjectPtr<class USoundBase> m_FireSoundAsset;
+
 	UPROPERTY(EditAnywhere, meta = (Category ="Safety First ", DisplayName = "weapon class"))
 	TSubclassOf<ASafetyFirstWeapon> m_WeaponClass;
 
@@ -64,9 +80,24 @@ public:
 	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", DisplayName = "deadZone right stick"))
 	float m_fDeadZoneRightStick = 0.2f;
 
+	/** Snaps the fire direction to the best enemy inside the aim assist cone */
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First "))
+	bool m_bAimAssist = false;
+
+	/** Half angle of the aim assist cone around the stick direction, in degrees, capped at 90 */
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", ClampMin = "0", ClampMax = "90", EditCondition = "m_bAimAssist"))
+	float m_fAimAssistHalfAngle = 15.0f;
+
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", EditCondition = "m_bAimAssist"))
+	float m_fAimAssistRange = 1500.0f;
+
+	/** How much closer enemies are preferred over enemies nearer the stick direction */
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", EditCondition = "m_bAimAssist"))
+	float m_fAimAssistDistanceWeight = 0.5f;
+
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnFire, ASafetyFirstWeapon*, _WeaponLaunched, FVector, _vFireDirection);
 
-	UPROPERTY(BlueprintAssignable, Category = Fire)
+	UPROPERTY(BlueprintAssignable, Category = Fire)
 	FOnFire m_OnFire;
 
 	UFUNCTION(BlueprintImplementableEvent, Category = "Spawn")
@@ -75,13 +106,38 @@ public:
 
 	// Begin Actor Interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
 	virtual void Tick(float _fDt) override;
 	virtual void SetupPlayerInputComponent(class UInputComponent* InputComponent) override;
 
 	void NotifyActorBeginOverlap(AActor* _otherActor) override;
 	void NotifyActorEndOverlap(AActor* _otherActor) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	// End Actor Interface
 
+	/** Server corrections smaller than this keep the predicted location */
+	UPROPERTY(Category = Network, EditAnywhere, BlueprintReadWrite)
+	float m_fNetCorrectionThreshold = 5.0f;
+
+	/** How fast the pawns of other players catch up with their replicated location */
+	UPROPERTY(Category = Network, EditAnywhere, BlueprintReadWrite)
+	float m_fNetSmoothingSpeed = 15.0f;
+
+	/** Longest move the server simulates for a client, longer ones are cut to it */
+	UPROPERTY(Category = Network, EditAnywhere, BlueprintReadWrite)
+	float m_fNetMaxMoveDelta = 0.1f;
+
+	/** Client time the server lets accumulate ahead of its own, to absorb jitter and resent moves */
+	UPROPERTY(Category = Network, EditAnywhere, BlueprintReadWrite)
+	float m_fNetMaxMoveTimeBudget = 0.25f;
+
+	/** Radius of the pawn for ASafetyFirstCollision2D, 0 takes it from the mesh bounds */
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First "))
+	float m_fCollisionRadius = 0.0f;
+
+	/** Replaces the bound axes from now on, e.g. for the benchmark bot. The pickup presses in it act like the bound ones */
+	void SetScriptedInput(const FSafetyFirstRecordedInput& _Input);
+
 	// Static names for axis bindings
 	static const FName MoveForwardBinding;
 	static const FName MoveRightBinding;
@@ -96,15 +152,73 @@ private:
 
 	TWeakObjectPtr<ASafetyFirstWeapon> m_Weapon;
 
+	/** Resolves static blockers when the 2D solver is enabled */
+	TWeakObjectPtr<class ASafetyFirstCollision2D> m_Collision2D;
+
 	bool m_bHasFirePressed = false;
+	/** Trigger pulled since the last step, so a frame without a step does not lose the shot */
+	bool m_bFireLatched = false;
 	bool m_bPickupPressed = false;
 	bool m_bWantPickup = false;
+	/** Pickup presses since the last input was gathered, for the input recorder */
+	bool m_bPickUpPressedEvent = false;
+	bool m_bPickUpReleasedEvent = false;
+	/** Axes set by SetScriptedInput, read instead of the bindings */
+	FSafetyFirstRecordedInput m_ScriptedInput;
+	bool m_bHasScriptedInput = false;
 	float m_fDurationOfPickupLifeSpan = 0.2f;
 	float m_fPickupLifeSpan = 0.0f;
 
 	FVector m_Movement;
 	TWeakObjectPtr<ASafetyFirstWeapon> m_WeaponPickup;
 
+	TWeakObjectPtr<class ASafetyFirstProximityGrid> m_ProximityGrid;
+
+	TWeakObjectPtr<class ASafetyFirstLagCompensation> m_LagCompensation;
+
+	/** Packs the enemy locations the aim assist is tested against */
+	TWeakObjectPtr<class ASafetyFirstCrowdManager> m_CrowdManager;
+
+	/** Clock of the movement steps, the pawn moves once per frame without it */
+	TWeakObjectPtr<class ASafetyFirstFixedStep> m_FixedStep;
+
+	/** Location before the last step, the ship is drawn between it and the actor location until the next step */
+	FVector m_vPreviousStepLocation;
+
+	int32 m_iProximityHandle = INDEX_NONE;
+
+	/* Radius of the ship on the play plane, used to reach weapon pickup zones */
+	float m_fPickupRadius = 0.0f;
+
+	/** Input predicted by the owning client, kept until the server acknowledges it */
+	struct FSavedMove
+	{
+		FSafetyFirstPawnInput m_Input;
+		FVector m_vRecoil;
+		FVector m_vResultLocation;
+		bool m_bChangedWeapon;
+	};
+
+	static const int32 MaxPendingMoves = 64;
+
+	TArray<FSavedMove> m_PendingMoves;
+	/** Moves predicted this frame, sent together at the end of it */
+	int32 m_iUnsentMoves = 0;
+	uint16 m_uNextSequence = 1;
+	uint16 m_uLastProcessedSequence = 0;
+	bool m_bHasServerState = false;
+
+	/** Server side, client move time left to simulate: grows with the server time, each accepted move spends its delta */
+	float m_fMoveTimeBudget = 0.0f;
+	float m_fLastMoveServerTime = -1.0f;
+
+	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
+	FSafetyFirstPawnNetState m_ServerState;
+
+	/** Weapon held according to the server */
+	UPROPERTY(ReplicatedUsing = OnRep_Weapon)
+	ASafetyFirstWeapon* m_ReplicatedWeapon = nullptr;
+
 public:
 	/** Returns ShipMeshComponent subobject **/
 	FORCEINLINE class UStaticMeshComponent* GetShipMeshComponent() const { return ShipMeshComponent; }
@@ -117,6 +231,48 @@ private:
 
 	void RetrieveWeapon(ASafetyFirstWeapon* _weapon);
 
+	/** One simulation step of the locally controlled pawn from the input of the frame: movement and the pickup window */
+	void StepLocal(const struct FSafetyFirstRecordedInput& _Raw, float _fDt);
+
+	/** Draws the ship between the last two steps, the actor stays at the simulated location */
+	void InterpolateStepLocation(float _fAlpha);
+
+	FSafetyFirstPawnInput GatherInput(const struct FSafetyFirstRecordedInput& _Raw, float _fDt);
+
+	/** Returns the direction to the best enemy inside the aim assist cone of _vStickDirection, or _vStickDirection */
+	FVector ApplyAimAssist(const FVector& _vStickDirection);
+
+	/** Reads the bound axes and pickup presses, or the recorded ones during an input playback. Once per frame, it records them */
+	void ReadRawInput(float _fDt, struct FSafetyFirstRecordedInput& _OutInput);
+
+	/** Runs one input on the pawn: fire, movement then pickup. Returns the recoil applied to the movement */
+	FVector SimulateMove(const FSafetyFirstPawnInput& _Input);
+
+	/** Fires and throws the weapon on a new fire press, returns the recoil */
+	FVector UpdateFire(bool _bFire);
+
+	/** Movement part of an input, the only part replayed when the server corrects us */
+	void ApplyMovement(const FSafetyFirstPawnInput& _Input, const FVector& _vRecoil);
+
+	void PredictMove(const FSafetyFirstPawnInput& _Input);
+	void SendPendingMoves();
+	void PublishServerState();
+	void ReconcileWeapon();
+	void SmoothSimulatedProxy(float _fDt);
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void ServerMove(const FSafetyFirstPawnMovePacket& _Packet);
+
+	UFUNCTION()
+	void OnRep_ServerState();
+
+	UFUNCTION()
+	void OnRep_Weapon();
+
+	void UpdatePickup();
+	void UpdatePickupFromOverlap();
+	void UpdatePickupFromGrid();
+
 	void PickUpReleased();
 	void PickUpPressed();
 };
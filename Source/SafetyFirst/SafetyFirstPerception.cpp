@@ -0,0 +1,260 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstPerception.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Perception"), STAT_SafetyFirst_Perception, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight traces"), STAT_SafetyFirst_SightTraces, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight results reused"), STAT_SafetyFirst_SightReused, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sight requests queued"), STAT_SafetyFirst_SightQueued, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sight latency max (frames)"), STAT_SafetyFirst_SightLatency, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpPerceptionStatsCmd(
+	TEXT("SafetyFirst.Perception.Stats"),
+	TEXT("Logs the sight traces per frame and their latency in frames"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstPerception* perception = ASafetyFirstPerception::Get(_World))
+		{
+			perception->DumpStats();
+		}
+	}));
+
+ASafetyFirstPerception::ASafetyFirstPerception()
+{
+	// Traces submitted in a frame are read back the next one, only while requests are pending
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+}
+
+ASafetyFirstPerception* ASafetyFirstPerception::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstPerception>(_World);
+}
+
+void ASafetyFirstPerception::Register(ASafetyFirstCrowdAgent* _Agent)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Agent == nullptr || _Agent->m_iPerceptionIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	int32 iSlot;
+	if (m_FreeSlots.Num() > 0)
+	{
+		iSlot = m_FreeSlots.Pop(/*bAllowShrinking*/false);
+	}
+	else
+	{
+		iSlot = m_Agents.Add(nullptr);
+		m_Targets.AddDefaulted();
+		m_Serial.Add(0);
+		m_ResultFrame.Add(0);
+		m_Visible.Add(false);
+		m_Queued.Add(false);
+	}
+
+	m_Agents[iSlot] = _Agent;
+	m_Targets[iSlot] = nullptr;
+	m_ResultFrame[iSlot] = 0;
+	m_Visible[iSlot] = false;
+	m_Queued[iSlot] = false;
+	_Agent->m_iPerceptionIndex = iSlot;
+}
+
+void ASafetyFirstPerception::Unregister(ASafetyFirstCrowdAgent* _Agent)
+{
+	if (_Agent == nullptr || !m_Agents.IsValidIndex(_Agent->m_iPerceptionIndex) || m_Agents[_Agent->m_iPerceptionIndex] != _Agent)
+	{
+		return;
+	}
+
+	// Queued requests and traces in flight of the slot are dropped when their serial does not match anymore
+	const int32 iSlot = _Agent->m_iPerceptionIndex;
+	m_Agents[iSlot] = nullptr;
+	m_Targets[iSlot] = nullptr;
+	++m_Serial[iSlot];
+	m_FreeSlots.Add(iSlot);
+	_Agent->m_iPerceptionIndex = INDEX_NONE;
+}
+
+void ASafetyFirstPerception::RequestSight(ASafetyFirstCrowdAgent* _Agent, AActor* _Target)
+{
+	if (_Agent == nullptr || !m_Agents.IsValidIndex(_Agent->m_iPerceptionIndex) || m_Agents[_Agent->m_iPerceptionIndex] != _Agent)
+	{
+		return;
+	}
+
+	const int32 iSlot = _Agent->m_iPerceptionIndex;
+	if (m_Targets[iSlot].Get() != _Target)
+	{
+		// A result about another target says nothing about this one
+		m_Targets[iSlot] = _Target;
+		m_ResultFrame[iSlot] = 0;
+	}
+
+	if (m_Queued[iSlot])
+	{
+		return;
+	}
+
+	FSightRequest request;
+	request.m_iSlot = iSlot;
+	request.m_uSerial = m_Serial[iSlot];
+	request.m_uRequestFrame = GFrameCounter;
+	m_Queue.Add(request);
+	m_Queued[iSlot] = true;
+
+	SetActorTickEnabled(true);
+}
+
+bool ASafetyFirstPerception::CanSee(const ASafetyFirstCrowdAgent* _Agent) const
+{
+	return _Agent != nullptr && m_Agents.IsValidIndex(_Agent->m_iPerceptionIndex) && m_Visible[_Agent->m_iPerceptionIndex];
+}
+
+int32 ASafetyFirstPerception::GetSightAge(const ASafetyFirstCrowdAgent* _Agent) const
+{
+	if (_Agent == nullptr || !m_Agents.IsValidIndex(_Agent->m_iPerceptionIndex) || m_ResultFrame[_Agent->m_iPerceptionIndex] == 0)
+	{
+		return INDEX_NONE;
+	}
+	return (int32)(GFrameCounter - m_ResultFrame[_Agent->m_iPerceptionIndex]);
+}
+
+void ASafetyFirstPerception::Tick(float _fDt)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_Perception, Perception);
+
+	// Traces submitted last frame are ready now
+	ResolveTraces();
+	SubmitTraces();
+
+	++m_iFrames;
+	SET_DWORD_STAT(STAT_SafetyFirst_SightQueued, m_Queue.Num());
+
+	SetActorTickEnabled(m_Queue.Num() > 0 || m_InFlight.Num() > 0);
+}
+
+void ASafetyFirstPerception::ResolveTraces()
+{
+	// Blueprints may unregister or destroy agents from their events, call them once every result is in
+	TSafetyFirstFrameArray<ASafetyFirstCrowdAgent*> changed;
+
+	UWorld* world = GetWorld();
+	FTraceDatum datum;
+	int32 iMaxLatency = 0;
+	for (const FSightTrace& trace : m_InFlight)
+	{
+		if (m_Serial[trace.m_iSlot] != trace.m_uSerial)
+		{
+			continue;
+		}
+
+		const int32 iSlot = trace.m_iSlot;
+		const AActor* target = m_Targets[iSlot].Get();
+		if (!world->QueryTraceData(trace.m_Handle, datum) || target == nullptr)
+		{
+			// Lost with its target or the async trace buffer, the agent has to ask again
+			continue;
+		}
+
+		const FHitResult* hit = FHitResult::GetFirstBlockingHit(datum.OutHits);
+		const bool bVisible = hit == nullptr || hit->GetActor() == target;
+		if (m_Visible[iSlot] != bVisible)
+		{
+			m_Visible[iSlot] = bVisible;
+			changed.Add(m_Agents[iSlot]);
+		}
+		m_ResultFrame[iSlot] = GFrameCounter;
+
+		const int32 iLatency = (int32)(GFrameCounter - trace.m_uRequestFrame);
+		m_uLatencyFrames += iLatency;
+		iMaxLatency = FMath::Max(iMaxLatency, iLatency);
+		m_iMaxLatencyFrames = FMath::Max(m_iMaxLatencyFrames, iLatency);
+		++m_iResolved;
+	}
+	m_InFlight.Reset();
+
+	SET_DWORD_STAT(STAT_SafetyFirst_SightLatency, iMaxLatency);
+	CSV_CUSTOM_STAT(SafetyFirst, SightLatencyFrames, iMaxLatency, ECsvCustomStatOp::Set);
+
+	for (ASafetyFirstCrowdAgent* agent : changed)
+	{
+		if (IsValid(agent))
+		{
+			agent->BPE_SightChanged(CanSee(agent));
+		}
+	}
+}
+
+void ASafetyFirstPerception::SubmitTraces()
+{
+	UWorld* world = GetWorld();
+	const float fNearDistanceSq = FMath::Square(m_fNearDistance);
+	int32 iTraces = 0;
+	int32 iConsumed = 0;
+	for (; iConsumed < m_Queue.Num() && iTraces < m_iMaxTracesPerFrame; ++iConsumed)
+	{
+		const FSightRequest& request = m_Queue[iConsumed];
+		if (m_Serial[request.m_iSlot] != request.m_uSerial)
+		{
+			continue;
+		}
+
+		const int32 iSlot = request.m_iSlot;
+		m_Queued[iSlot] = false;
+
+		const ASafetyFirstCrowdAgent* agent = m_Agents[iSlot];
+		const AActor* target = m_Targets[iSlot].Get();
+		if (target == nullptr)
+		{
+			m_Visible[iSlot] = false;
+			continue;
+		}
+
+		const FVector vEye = agent->GetActorLocation() + FVector(0.0f, 0.0f, m_fEyeHeight);
+		const FVector vTarget = target->GetActorLocation();
+
+		// Far agents keep a recent result, they cannot do much with a fresher one
+		if (m_ResultFrame[iSlot] != 0 && FVector::DistSquared(vEye, vTarget) > fNearDistanceSq && GFrameCounter - m_ResultFrame[iSlot] < (uint64)m_iFarReuseFrames)
+		{
+			++m_iReused;
+			INC_DWORD_STAT(STAT_SafetyFirst_SightReused);
+			continue;
+		}
+
+		FCollisionQueryParams queryParams(SCENE_QUERY_STAT(SafetyFirstSight), /*bTraceComplex*/false, agent);
+
+		FSightTrace trace;
+		trace.m_Handle = world->AsyncLineTraceByChannel(EAsyncTraceType::Single, vEye, vTarget, ECC_Visibility, queryParams);
+		trace.m_iSlot = iSlot;
+		trace.m_uSerial = request.m_uSerial;
+		trace.m_uRequestFrame = request.m_uRequestFrame;
+		m_InFlight.Add(trace);
+		++iTraces;
+	}
+
+	// What the budget left stays at the front, ahead of the requests of the next frames
+	m_Queue.RemoveAt(0, iConsumed, /*bAllowShrinking*/false);
+
+	m_iTraces += iTraces;
+	INC_DWORD_STAT_BY(STAT_SafetyFirst_SightTraces, iTraces);
+	CSV_CUSTOM_STAT(SafetyFirst, SightTraces, iTraces, ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstPerception::DumpStats() const
+{
+	const int32 iFrames = FMath::Max(m_iFrames, 1);
+	UE_LOG(LogSafetyFirst, Display, TEXT("Perception: %d agents, %d queued, %.1f traces and %.1f reused results per frame, latency %.2f frames average, %d max"),
+		m_Agents.Num() - m_FreeSlots.Num(), m_Queue.Num(), (float)m_iTraces / iFrames, (float)m_iReused / iFrames,
+		m_iResolved > 0 ? (float)m_uLatencyFrames / m_iResolved : 0.0f, m_iMaxLatencyFrames);
+}
@@ -0,0 +1,103 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "WorldCollision.h"
+#include "SafetyFirstPerception.generated.h"
+
+class ASafetyFirstCrowdAgent;
+
+/**
+ * Line of sight of the crowd agents, without one blocking trace per agent.
+ * Agents queue sight requests toward a target, the queue is issued as async traces on the Visibility channel, at most
+ * m_iMaxTracesPerFrame per frame in request order so every agent gets its turn, and the results land next frame in one
+ * bit per agent. Agents far from their target keep a recent result instead of tracing again.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstPerception : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstPerception();
+
+	/** Returns the perception of the world, spawning it if needed */
+	static ASafetyFirstPerception* Get(UWorld* _World);
+
+	void Register(ASafetyFirstCrowdAgent* _Agent);
+	void Unregister(ASafetyFirstCrowdAgent* _Agent);
+
+	/** Queues a sight test from the agent to _Target, does nothing if one is already queued */
+	void RequestSight(ASafetyFirstCrowdAgent* _Agent, AActor* _Target);
+
+	/** Result of the last sight test of the agent, false until one is done */
+	bool CanSee(const ASafetyFirstCrowdAgent* _Agent) const;
+
+	/** Frames since the last sight test of the agent was traced, INDEX_NONE if it never was */
+	int32 GetSightAge(const ASafetyFirstCrowdAgent* _Agent) const;
+
+	void DumpStats() const;
+
+	virtual void Tick(float _fDt) override;
+
+	/** Async traces issued per frame, queued requests past it wait for the next frames */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxTracesPerFrame = 128;
+
+	/** Agents further than this from their target may reuse their last result */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fNearDistance = 2000.0f;
+
+	/** Age in frames up to which a far agent reuses its last result */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iFarReuseFrames = 10;
+
+	/** Height of the eyes above the agent location */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fEyeHeight = 50.0f;
+
+private:
+	void ResolveTraces();
+	void SubmitTraces();
+
+	struct FSightRequest
+	{
+		int32 m_iSlot;
+		uint32 m_uSerial;
+		uint64 m_uRequestFrame;
+	};
+
+	struct FSightTrace
+	{
+		FTraceHandle m_Handle;
+		int32 m_iSlot;
+		uint32 m_uSerial;
+		uint64 m_uRequestFrame;
+	};
+
+	/** Indexed by slot, null for free slots */
+	UPROPERTY()
+	TArray<ASafetyFirstCrowdAgent*> m_Agents;
+
+	// Indexed by slot
+	TArray<TWeakObjectPtr<AActor>> m_Targets;
+	TArray<uint32> m_Serial;
+	TArray<uint64> m_ResultFrame;
+	TBitArray<> m_Visible;
+	TBitArray<> m_Queued;
+	TArray<int32> m_FreeSlots;
+
+	/** Oldest request first, so the traces left over by the budget go first next frame */
+	TArray<FSightRequest> m_Queue;
+	TArray<FSightTrace> m_InFlight;
+
+	// Since play started
+	int32 m_iFrames = 0;
+	int32 m_iTraces = 0;
+	int32 m_iReused = 0;
+	int32 m_iResolved = 0;
+	uint64 m_uLatencyFrames = 0;
+	int32 m_iMaxLatencyFrames = 0;
+};
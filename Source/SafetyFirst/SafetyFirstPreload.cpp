@@ -0,0 +1,107 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstPreload.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/PackageName.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace SafetyFirstPreload
+{
+	/** Created at startup, a streamable manager is a GC object and cannot be a static */
+	static TUniquePtr<FStreamableManager> s_Streamable;
+
+	/** Keeps the assets of the current map loaded, the pending one replaces it once loaded */
+	static TSharedPtr<FStreamableHandle> s_ActiveHandle;
+	static TSharedPtr<FStreamableHandle> s_PendingHandle;
+	static int32 s_iPendingAssets = 0;
+
+	static double s_fMapLoadStart = 0.0;
+	static double s_fFirstFrameStart = 0.0;
+	static bool s_bWaitingFirstFrame = false;
+
+	static FDelegateHandle s_PreLoadMapHandle;
+	static FDelegateHandle s_PostLoadMapHandle;
+	static FDelegateHandle s_EndFrameHandle;
+
+	static void OnPreLoadMap(const FString& _MapName)
+	{
+		s_fMapLoadStart = FPlatformTime::Seconds();
+
+		const USafetyFirstPreloadManifest* manifest = GetDefault<USafetyFirstPreloadManifest>();
+		TArray<FSoftObjectPath> assets = manifest->m_CommonAssets;
+		const FString mapShortName = FPackageName::GetShortName(_MapName);
+		for (const FSafetyFirstMapPreload& map : manifest->m_Maps)
+		{
+			if (FPackageName::GetShortName(map.m_Map) == mapShortName)
+			{
+				for (const FSoftObjectPath& asset : map.m_Assets)
+				{
+					assets.AddUnique(asset);
+				}
+			}
+		}
+
+		// Streams while the map package loads, the map load flushes the async loading anyway
+		s_iPendingAssets = assets.Num();
+		s_PendingHandle.Reset();
+		if (assets.Num() > 0)
+		{
+			s_PendingHandle = s_Streamable->RequestAsyncLoad(assets, FStreamableDelegate(), FStreamableManager::AsyncLoadHighPriority);
+		}
+	}
+
+	static void OnPostLoadMap(UWorld* _World)
+	{
+		const double fStart = FPlatformTime::Seconds();
+		if (s_PendingHandle.IsValid())
+		{
+			s_PendingHandle->WaitUntilComplete();
+		}
+		const double fEnd = FPlatformTime::Seconds();
+
+		if (s_ActiveHandle.IsValid())
+		{
+			s_ActiveHandle->ReleaseHandle();
+		}
+		s_ActiveHandle = s_PendingHandle;
+		s_PendingHandle.Reset();
+
+		UE_LOG(LogSafetyFirst, Log, TEXT("Preload: %s loaded in %.1f ms, %.2f s after startup, waited %.1f ms for %d preloaded assets"),
+			_World != nullptr ? *_World->GetMapName() : TEXT("map"), (fEnd - s_fMapLoadStart) * 1000.0, fEnd - GStartTime,
+			(fEnd - fStart) * 1000.0, s_iPendingAssets);
+
+		s_fFirstFrameStart = fEnd;
+		s_bWaitingFirstFrame = true;
+	}
+
+	/** First frame time, so the cost of assets loaded on first use shows up */
+	static void OnEndFrame()
+	{
+		if (s_bWaitingFirstFrame)
+		{
+			s_bWaitingFirstFrame = false;
+			UE_LOG(LogSafetyFirst, Log, TEXT("Preload: first frame after the map load took %.1f ms"), (FPlatformTime::Seconds() - s_fFirstFrameStart) * 1000.0);
+		}
+	}
+
+	void Startup()
+	{
+		s_Streamable = MakeUnique<FStreamableManager>();
+		s_PreLoadMapHandle = FCoreUObjectDelegates::PreLoadMap.AddStatic(&OnPreLoadMap);
+		s_PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddStatic(&OnPostLoadMap);
+		s_EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+	}
+
+	void Shutdown()
+	{
+		FCoreUObjectDelegates::PreLoadMap.Remove(s_PreLoadMapHandle);
+		FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(s_PostLoadMapHandle);
+		FCoreDelegates::OnEndFrame.Remove(s_EndFrameHandle);
+
+		s_ActiveHandle.Reset();
+		s_PendingHandle.Reset();
+		s_Streamable.Reset();
+	}
+}
@@ -0,0 +1,70 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "UObject/SoftObjectPtr.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstPreload.generated.h"
+
+/** Assets streamed in while one map loads */
+USTRUCT()
+struct FSafetyFirstMapPreload
+{
+	GENERATED_BODY()
+
+	/** Map name, with or without its package path */
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	FString m_Map;
+
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	TArray<FSoftObjectPath> m_Assets;
+};
+
+/**
+ * Preload manifest, read from the [/Script/SafetyFirst.SafetyFirstPreloadManifest] section of DefaultGame.ini.
+ * Gameplay classes only hold soft references to their assets, so nothing is loaded when the module starts.
+ * The assets of the manifest are requested asynchronously as soon as a map starts loading, and the map load waits for
+ * them before its first frame.
+ */
+UCLASS(config=Game)
+class USafetyFirstPreloadManifest : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Assets of every map */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	TArray<FSoftObjectPath> m_CommonAssets;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	TArray<FSafetyFirstMapPreload> m_Maps;
+};
+
+namespace SafetyFirstPreload
+{
+	/** Hooks the map load delegates, called by the module */
+	void Startup();
+	void Shutdown();
+
+	/**
+	 * Returns the asset, loading it synchronously if the manifest did not stream it in.
+	 * That happens in PIE, which does not go through the map load delegates, or when the manifest misses the asset.
+	 */
+	template<class T>
+	T* Resolve(const TSoftObjectPtr<T>& _Asset)
+	{
+		if (_Asset.IsNull())
+		{
+			return nullptr;
+		}
+		if (T* asset = _Asset.Get())
+		{
+			return asset;
+		}
+
+		UE_LOG(LogSafetyFirst, Log, TEXT("Preload: %s was not preloaded, loading it synchronously"), *_Asset.ToString());
+		return _Asset.LoadSynchronous();
+	}
+}
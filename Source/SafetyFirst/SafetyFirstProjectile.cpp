@@ -1,20 +1,30 @@
-// Copyright 1998-2018 Epic Games, Inc. All Rights Reserve
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
 #include "SafetyFirstProjectile.h"
+#include "SafetyFirst.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Components/StaticMeshComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Engine/StaticMesh.h"
+#include "SafetyFirstDamageManager.h"
+#include "SafetyFirstImpactEffects.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPreload.h"
+#include "SafetyFirstProjectilePool.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "SafetyFirstTelemetry.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile hit"), STAT_SafetyFirst_ProjectileHit, STATGROUP_SafetyFirst);
 
 ASafetyFirstProjectile::ASafetyFirstProjectile() 
 {
-	// Static reference to the mesh to use for the projectile
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> ProjectileMeshAsset(TEXT("/Game/TwinStick/Meshes/TwinStickProjectile.TwinStickProjectile"));
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	// Soft reference to the mesh to use for the projectile, set in BeginPlay
+	m_ProjectileMeshAsset = FSoftObjectPath(TEXT("/Game/TwinStick/Meshes/TwinStickProjectile.TwinStickProjectile"));
 
 	// Create mesh component for the projectile sphere
 	ProjectileMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ProjectileMesh0"));
-	ProjectileMesh->SetStaticMesh(ProjectileMeshAsset.Object);
 	ProjectileMesh->SetupAttachment(RootComponent);
 	ProjectileMesh->BodyInstance.SetCollisionProfileName("Projectile");
 	ProjectileMesh->OnComponentHit.AddDynamic(this, &ASafetyFirstProjectile::OnHit);		// set up a notification for when this component hits something
@@ -31,15 +41,128 @@ ASafetyFirstProjectile::ASafetyFirstProjectile()
 
 	// Die after 3 seconds by default
 	InitialLifeSpan = 3.0f;
+
+	// Every machine spawns its own projectiles from the weapon fire events
+	bReplicates = false;
 }
 
 void ASafetyFirstProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
-	// Only add impulse and destroy projectile if we hit a physics
-	if ((OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_ProjectileHit, ProjectileHit);
+
+	// Only queue the hit, damage and the impulse on physics bodies are resolved after physics
+	if ((OtherActor != NULL) && (OtherActor != this))
+	{
+		SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::Hit, OtherActor, Hit.ImpactPoint, m_fDamage);
+
+		if (m_DamageManager.IsValid())
+		{
+			m_DamageManager->AddHit(OtherActor, OtherComp, GetActorLocation(), GetVelocity() * 20.0f, m_fDamage, this);
+		}
+		else if ((OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
+		{
+			OtherComp->AddImpulseAtLocation(GetVelocity() * 20.0f, GetActorLocation());
+		}
+	}
+
+	if (m_ImpactEffects.IsValid())
+	{
+		m_ImpactEffects->AddImpact(ESafetyFirstImpactType::Projectile, Hit.ImpactPoint, Hit.ImpactNormal);
+	}
+
+	ReleaseOrDestroy();
+}
+
+UStaticMesh* ASafetyFirstProjectile::GetMeshAsset() const
+{
+	UStaticMesh* mesh = ProjectileMesh->GetStaticMesh();
+	return mesh != nullptr ? mesh : SafetyFirstPreload::Resolve(m_ProjectileMeshAsset);
+}
+
+void ASafetyFirstProjectile::BeginPlay()
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	if (ProjectileMesh->GetStaticMesh() == nullptr)
 	{
-		OtherComp->AddImpulseAtLocation(GetVelocity() * 20.0f, GetActorLocation());
+		ProjectileMesh->SetStaticMesh(SafetyFirstPreload::Resolve(m_ProjectileMeshAsset));
 	}
 
-	Destroy();
+	Super::BeginPlay();
+
+	// Pooled projectiles are spawned live and parked right away
+	SetCountedLive(true);
+
+	// Only the visuals scale with significance, the flight itself is gameplay
+	m_SignificanceManager = ASafetyFirstSignificanceManager::Get(GetWorld());
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Register(this, ESafetyFirstSignificanceType::Projectile);
+	}
+
+	m_ImpactEffects = ASafetyFirstImpactEffects::Get(GetWorld());
+	m_DamageManager = ASafetyFirstDamageManager::Get(GetWorld());
+}
+
+void ASafetyFirstProjectile::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	SetCountedLive(false);
+
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Unregister(this);
+	}
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstProjectile::SetCountedLive(bool _bLive)
+{
+	if (m_bCountedLive != _bLive)
+	{
+		m_bCountedLive = _bLive;
+		SafetyFirstCounters::AddLiveProjectiles(_bLive ? 1 : -1);
+	}
+}
+
+void ASafetyFirstProjectile::ReleaseOrDestroy()
+{
+	if (m_Pool.IsValid())
+	{
+		m_Pool->Release(this);
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+void ASafetyFirstProjectile::ActivateFromPool(const FVector& _vLocation, const FRotator& _Rotation)
+{
+	SetActorLocationAndRotation(_vLocation, _Rotation, /*bSweep*/false, nullptr, ETeleportType::TeleportPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	// The movement component drops its updated component when it stops on a hit
+	ProjectileMovement->SetUpdatedComponent(ProjectileMesh);
+	ProjectileMovement->Velocity = _Rotation.Vector() * ProjectileMovement->InitialSpeed;
+	ProjectileMovement->UpdateComponentVelocity();
+	ProjectileMovement->Activate(/*bReset*/true);
+
+	SetLifeSpan(GetClass()->GetDefaultObject<ASafetyFirstProjectile>()->InitialLifeSpan);
+	SetCountedLive(true);
+}
+
+void ASafetyFirstProjectile::DeactivateToPool()
+{
+	SetLifeSpan(0.0f);
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+	SetCountedLive(false);
+}
+
+void ASafetyFirstProjectile::LifeSpanExpired()
+{
+	ReleaseOrDestroy();
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 class UProjectileMovementComponent;
 class UStaticMeshComponent;
+class ASafetyFirstProjectilePool;
 
 UCLASS(config=Game)
 class ASafetyFirstProjectile : public AActor
@@ -29,9 +30,54 @@ public:
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
+	/** Returns the projectile to its pool, or destroys it if it was not pooled */
+	void ReleaseOrDestroy();
+
+	/** Called by the pool when the projectile is handed out */
+	void ActivateFromPool(const FVector& _vLocation, const FRotator& _Rotation);
+
+	/** Called by the pool when the projectile comes back: movement, collision and rendering are turned off */
+	void DeactivateToPool();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void LifeSpanExpired() override;
+
+	/** Damage dealt to the enemy hit, also used by bulk bullets of this class */
+	UPROPERTY(Category = Damage, EditDefaultsOnly, BlueprintReadOnly)
+	float m_fDamage = 10.0f;
+
+	/** Mesh of ProjectileMesh when it is not set, loaded with the map by the preload manifest */
+	UPROPERTY(EditDefaultsOnly, Category = Projectile)
+	TSoftObjectPtr<class UStaticMesh> m_ProjectileMeshAsset;
+
+	/** Mesh the projectile renders with, also valid on the class defaults */
+	UStaticMesh* GetMeshAsset() const;
+
 	/** Returns ProjectileMesh subobject **/
 	FORCEINLINE UStaticMeshComponent* GetProjectileMesh() const { return ProjectileMesh; }
 	/** Returns ProjectileMovement subobject **/
 	FORCEINLINE UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+private:
+	friend class ASafetyFirstProjectilePool;
+
+	TWeakObjectPtr<ASafetyFirstProjectilePool> m_Pool;
+
+	TWeakObjectPtr<class ASafetyFirstSignificanceManager> m_SignificanceManager;
+
+	TWeakObjectPtr<class ASafetyFirstImpactEffects> m_ImpactEffects;
+
+	TWeakObjectPtr<class ASafetyFirstDamageManager> m_DamageManager;
+
+	/** Index in the active list of the pool, INDEX_NONE while in the free list */
+	int32 m_iPoolActiveIndex = INDEX_NONE;
+
+	/** Increasing number given on each activation, used to find the oldest active projectile */
+	uint32 m_uPoolActivationSerial = 0;
+
+	/** Keeps the live projectile counter in sync across spawn, pooling and destruction */
+	void SetCountedLive(bool _bLive);
+	bool m_bCountedLive = false;
 };
 
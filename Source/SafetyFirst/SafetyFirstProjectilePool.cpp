@@ -0,0 +1,247 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstProjectilePool.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstProjectile.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile pool hits"), STAT_SafetyFirst_PoolHits, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile pool misses"), STAT_SafetyFirst_PoolMisses, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile pool active"), STAT_SafetyFirst_PoolActive, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile pool size"), STAT_SafetyFirst_PoolTotal, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpProjectilePoolStatsCmd(
+	TEXT("SafetyFirst.ProjectilePool.Stats"),
+	TEXT("Logs hit/miss/high-water counters of the projectile pool"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstProjectilePool* pool = ASafetyFirstProjectilePool::Get(_World))
+		{
+			pool->DumpStats();
+		}
+	}));
+
+ASafetyFirstProjectilePool::ASafetyFirstProjectilePool()
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+ASafetyFirstProjectilePool* ASafetyFirstProjectilePool::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstProjectilePool>(_World);
+}
+
+void ASafetyFirstProjectilePool::Prewarm(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass)
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	if (_ProjectileClass == nullptr)
+	{
+		return;
+	}
+
+	FSafetyFirstProjectilePoolBucket& bucket = m_Buckets.FindOrAdd(_ProjectileClass);
+	const int32 iMissing = m_iPrewarmCount - bucket.m_Stats.m_iTotal;
+	if (iMissing > 0)
+	{
+		Grow(_ProjectileClass, bucket, iMissing);
+	}
+}
+
+ASafetyFirstProjectile* ASafetyFirstProjectilePool::Acquire(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass, const FVector& _vLocation, const FRotator& _Rotation)
+{
+	if (_ProjectileClass == nullptr)
+	{
+		return nullptr;
+	}
+
+	FSafetyFirstProjectilePoolBucket& bucket = m_Buckets.FindOrAdd(_ProjectileClass);
+
+	// Drop entries destroyed behind our back (level streaming, editor tools...), the garbage collector nulls the collected ones
+	while (bucket.m_Free.Num() > 0 && (bucket.m_Free.Last() == nullptr || bucket.m_Free.Last()->IsPendingKillPending()))
+	{
+		bucket.m_Free.Pop(/*bAllowShrinking*/false);
+		--bucket.m_Stats.m_iTotal;
+		DEC_DWORD_STAT(STAT_SafetyFirst_PoolTotal);
+	}
+
+	ASafetyFirstProjectile* projectile = nullptr;
+	if (bucket.m_Free.Num() > 0)
+	{
+		++bucket.m_Stats.m_iHits;
+		INC_DWORD_STAT(STAT_SafetyFirst_PoolHits);
+		projectile = bucket.m_Free.Pop(/*bAllowShrinking*/false);
+	}
+	else
+	{
+		++bucket.m_Stats.m_iMisses;
+		INC_DWORD_STAT(STAT_SafetyFirst_PoolMisses);
+
+		const bool bCanGrow = m_eGrowPolicy == ESafetyFirstPoolGrowPolicy::Grow
+			|| (m_eGrowPolicy == ESafetyFirstPoolGrowPolicy::GrowUpToMax && bucket.m_Stats.m_iTotal < m_iMaxPoolSize)
+			|| bucket.m_Active.Num() == 0;
+
+		if (bCanGrow)
+		{
+			int32 iGrowCount = FMath::Max(m_iGrowStep, 1);
+			if (m_eGrowPolicy == ESafetyFirstPoolGrowPolicy::GrowUpToMax)
+			{
+				iGrowCount = FMath::Max(FMath::Min(iGrowCount, m_iMaxPoolSize - bucket.m_Stats.m_iTotal), 1);
+			}
+			Grow(_ProjectileClass, bucket, iGrowCount);
+			if (bucket.m_Free.Num() > 0)
+			{
+				projectile = bucket.m_Free.Pop(/*bAllowShrinking*/false);
+			}
+		}
+		else
+		{
+			projectile = RecycleOldest(bucket);
+		}
+	}
+
+	if (projectile == nullptr)
+	{
+		return nullptr;
+	}
+
+	projectile->m_iPoolActiveIndex = bucket.m_Active.Add(projectile);
+	projectile->m_uPoolActivationSerial = ++m_uActivationSerial;
+	projectile->ActivateFromPool(_vLocation, _Rotation);
+
+	bucket.m_Stats.m_iActive = bucket.m_Active.Num();
+	bucket.m_Stats.m_iHighWater = FMath::Max(bucket.m_Stats.m_iHighWater, bucket.m_Stats.m_iActive);
+	INC_DWORD_STAT(STAT_SafetyFirst_PoolActive);
+
+	return projectile;
+}
+
+void ASafetyFirstProjectilePool::Release(ASafetyFirstProjectile* _Projectile)
+{
+	if (_Projectile == nullptr || _Projectile->m_iPoolActiveIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	FSafetyFirstProjectilePoolBucket* bucket = m_Buckets.Find(_Projectile->GetClass());
+	if (bucket == nullptr)
+	{
+		return;
+	}
+
+	RemoveFromActive(_Projectile, *bucket);
+	_Projectile->DeactivateToPool();
+	bucket->m_Free.Add(_Projectile);
+}
+
+FSafetyFirstPoolStats ASafetyFirstProjectilePool::GetStats(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass) const
+{
+	const FSafetyFirstProjectilePoolBucket* bucket = m_Buckets.Find(_ProjectileClass);
+	return bucket != nullptr ? bucket->m_Stats : FSafetyFirstPoolStats();
+}
+
+void ASafetyFirstProjectilePool::DumpStats() const
+{
+	for (const TPair<UClass*, FSafetyFirstProjectilePoolBucket>& pair : m_Buckets)
+	{
+		const FSafetyFirstPoolStats& stats = pair.Value.m_Stats;
+		UE_LOG(LogSafetyFirst, Log, TEXT("Projectile pool %s: hits %d, misses %d, high-water %d, active %d, total %d"),
+			*GetNameSafe(pair.Key), stats.m_iHits, stats.m_iMisses, stats.m_iHighWater, stats.m_iActive, stats.m_iTotal);
+	}
+}
+
+void ASafetyFirstProjectilePool::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	for (const TPair<UClass*, FSafetyFirstProjectilePoolBucket>& pair : m_Buckets)
+	{
+		DEC_DWORD_STAT_BY(STAT_SafetyFirst_PoolActive, pair.Value.m_Stats.m_iActive);
+		DEC_DWORD_STAT_BY(STAT_SafetyFirst_PoolTotal, pair.Value.m_Stats.m_iTotal);
+	}
+	m_Buckets.Empty();
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+ASafetyFirstProjectile* ASafetyFirstProjectilePool::SpawnPooledProjectile(UClass* _ProjectileClass, FSafetyFirstProjectilePoolBucket& _Bucket)
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	spawnInfo.ObjectFlags |= RF_Transient;
+
+	ASafetyFirstProjectile* projectile = GetWorld()->SpawnActor<ASafetyFirstProjectile>(_ProjectileClass, GetActorLocation(), FRotator::ZeroRotator, spawnInfo);
+	if (projectile != nullptr)
+	{
+		projectile->m_Pool = this;
+		projectile->DeactivateToPool();
+		++_Bucket.m_Stats.m_iTotal;
+		INC_DWORD_STAT(STAT_SafetyFirst_PoolTotal);
+	}
+	return projectile;
+}
+
+ASafetyFirstProjectile* ASafetyFirstProjectilePool::RecycleOldest(FSafetyFirstProjectilePoolBucket& _Bucket)
+{
+	// Only reached on a miss with a capped pool, a linear scan is fine there
+	ASafetyFirstProjectile* oldest = nullptr;
+	for (int32 iActive = _Bucket.m_Active.Num() - 1; iActive >= 0; --iActive)
+	{
+		ASafetyFirstProjectile* projectile = _Bucket.m_Active[iActive];
+		if (projectile == nullptr)
+		{
+			// Collected behind our back, it no longer counts in the pool
+			_Bucket.m_Active.RemoveAtSwap(iActive, 1, /*bAllowShrinking*/false);
+			if (_Bucket.m_Active.IsValidIndex(iActive) && _Bucket.m_Active[iActive] != nullptr)
+			{
+				_Bucket.m_Active[iActive]->m_iPoolActiveIndex = iActive;
+			}
+			_Bucket.m_Stats.m_iActive = _Bucket.m_Active.Num();
+			--_Bucket.m_Stats.m_iTotal;
+			DEC_DWORD_STAT(STAT_SafetyFirst_PoolActive);
+			DEC_DWORD_STAT(STAT_SafetyFirst_PoolTotal);
+			continue;
+		}
+
+		if (oldest == nullptr || projectile->m_uPoolActivationSerial < oldest->m_uPoolActivationSerial)
+		{
+			oldest = projectile;
+		}
+	}
+
+	if (oldest != nullptr)
+	{
+		RemoveFromActive(oldest, _Bucket);
+		oldest->DeactivateToPool();
+	}
+	return oldest;
+}
+
+void ASafetyFirstProjectilePool::Grow(UClass* _ProjectileClass, FSafetyFirstProjectilePoolBucket& _Bucket, int32 _iCount)
+{
+	_Bucket.m_Free.Reserve(_Bucket.m_Free.Num() + _iCount);
+	for (int32 i = 0; i < _iCount; ++i)
+	{
+		if (ASafetyFirstProjectile* projectile = SpawnPooledProjectile(_ProjectileClass, _Bucket))
+		{
+			_Bucket.m_Free.Add(projectile);
+		}
+	}
+}
+
+void ASafetyFirstProjectilePool::RemoveFromActive(ASafetyFirstProjectile* _Projectile, FSafetyFirstProjectilePoolBucket& _Bucket)
+{
+	const int32 iIndex = _Projectile->m_iPoolActiveIndex;
+	check(_Bucket.m_Active.IsValidIndex(iIndex) && _Bucket.m_Active[iIndex] == _Projectile);
+
+	_Bucket.m_Active.RemoveAtSwap(iIndex, 1, /*bAllowShrinking*/false);
+	if (_Bucket.m_Active.IsValidIndex(iIndex) && _Bucket.m_Active[iIndex] != nullptr)
+	{
+		_Bucket.m_Active[iIndex]->m_iPoolActiveIndex = iIndex;
+	}
+	_Projectile->m_iPoolActiveIndex = INDEX_NONE;
+
+	_Bucket.m_Stats.m_iActive = _Bucket.m_Active.Num();
+	DEC_DWORD_STAT(STAT_SafetyFirst_PoolActive);
+}
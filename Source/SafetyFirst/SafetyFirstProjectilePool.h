@@ -0,0 +1,108 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstProjectilePool.generated.h"
+
+class ASafetyFirstProjectile;
+
+/** What the pool does when a class runs out of free projectiles */
+UENUM()
+enum class ESafetyFirstPoolGrowPolicy : uint8
+{
+	/** Spawn m_iGrowStep new projectiles, without limit */
+	Grow,
+	/** Spawn m_iGrowStep new projectiles until m_iMaxPoolSize is reached, then recycle the oldest active one */
+	GrowUpToMax,
+	/** Never spawn after prewarm, always recycle the oldest active projectile */
+	Fixed,
+};
+
+/** Pool counters, cumulated since the pool was created */
+struct FSafetyFirstPoolStats
+{
+	/** Acquisitions served from the free list */
+	int32 m_iHits = 0;
+	/** Acquisitions that had to spawn or recycle */
+	int32 m_iMisses = 0;
+	/** Maximum number of projectiles active at the same time */
+	int32 m_iHighWater = 0;
+	/** Number of projectiles currently out of the pool */
+	int32 m_iActive = 0;
+	/** Number of projectiles owned by the pool, active or not */
+	int32 m_iTotal = 0;
+};
+
+USTRUCT()
+struct FSafetyFirstProjectilePoolBucket
+{
+	GENERATED_BODY()
+
+	/** Deactivated projectiles ready to be handed out */
+	UPROPERTY()
+	TArray<ASafetyFirstProjectile*> m_Free;
+
+	/** Projectiles currently flying, each one knows its index in this array */
+	UPROPERTY()
+	TArray<ASafetyFirstProjectile*> m_Active;
+
+	FSafetyFirstPoolStats m_Stats;
+};
+
+/**
+ * World level pool of projectiles, one bucket per projectile class.
+ * Weapons acquire projectiles from it instead of spawning them, projectiles come back on hit or lifetime expiry.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstProjectilePool : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstProjectilePool();
+
+	/** Returns the pool of the world, spawning it if needed */
+	static ASafetyFirstProjectilePool* Get(UWorld* _World);
+
+	/** Makes sure at least m_iPrewarmCount projectiles of this class are available */
+	void Prewarm(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass);
+
+	/** Hands out an activated projectile, returns null only if the class is null or the spawn failed */
+	ASafetyFirstProjectile* Acquire(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass, const FVector& _vLocation, const FRotator& _Rotation);
+
+	/** Deactivates the projectile and puts it back in the free list */
+	void Release(ASafetyFirstProjectile* _Projectile);
+
+	/** Returns the counters of one class */
+	FSafetyFirstPoolStats GetStats(TSubclassOf<ASafetyFirstProjectile> _ProjectileClass) const;
+
+	/** Writes the counters of all classes to the log */
+	void DumpStats() const;
+
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iPrewarmCount = 32;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	ESafetyFirstPoolGrowPolicy m_eGrowPolicy = ESafetyFirstPoolGrowPolicy::GrowUpToMax;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iGrowStep = 8;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxPoolSize = 512;
+
+private:
+	ASafetyFirstProjectile* SpawnPooledProjectile(UClass* _ProjectileClass, FSafetyFirstProjectilePoolBucket& _Bucket);
+	ASafetyFirstProjectile* RecycleOldest(FSafetyFirstProjectilePoolBucket& _Bucket);
+	void Grow(UClass* _ProjectileClass, FSafetyFirstProjectilePoolBucket& _Bucket, int32 _iCount);
+	void RemoveFromActive(ASafetyFirstProjectile* _Projectile, FSafetyFirstProjectilePoolBucket& _Bucket);
+
+	UPROPERTY()
+	TMap<UClass*, FSafetyFirstProjectilePoolBucket> m_Buckets;
+
+	uint32 m_uActivationSerial = 0;
+};
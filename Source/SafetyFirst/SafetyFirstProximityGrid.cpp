@@ -0,0 +1,193 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstProximityGrid.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstWeapon.h"
+#include "SafetyFirstWorldManager.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Proximity grid entries"), STAT_SafetyFirst_GridEntries, STATGROUP_SafetyFirst);
+
+static int32 GSafetyFirstPickupUseOverlap = 0;
+static FAutoConsoleVariableRef CVarSafetyFirstPickupUseOverlap(
+	TEXT("SafetyFirst.Pickup.UseOverlap"),
+	GSafetyFirstPickupUseOverlap,
+	TEXT("1 finds pickups through the weapon trigger overlaps, 0 through the proximity grid. Read when weapons are thrown."),
+	ECVF_Default);
+
+ASafetyFirstProximityGrid::ASafetyFirstProximityGrid()
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+void ASafetyFirstProximityGrid::PostInitProperties()
+{
+	Super::PostInitProperties();
+	m_Grid = FSafetyFirstSpatialGrid2D(m_fCellSize);
+}
+
+ASafetyFirstProximityGrid* ASafetyFirstProximityGrid::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstProximityGrid>(_World);
+}
+
+bool ASafetyFirstProximityGrid::UseOverlapPickup()
+{
+	return GSafetyFirstPickupUseOverlap != 0;
+}
+
+int32 ASafetyFirstProximityGrid::Register(AActor* _Actor, ESafetyFirstGridLayer _eLayer)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Actor == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 iHandle = m_Grid.Add(_Actor->GetActorLocation(), 0, (uint8)_eLayer);
+	if (iHandle >= m_Actors.Num())
+	{
+		m_Actors.SetNum(iHandle + 1);
+	}
+	m_Actors[iHandle] = _Actor;
+
+	INC_DWORD_STAT(STAT_SafetyFirst_GridEntries);
+	return iHandle;
+}
+
+void ASafetyFirstProximityGrid::UpdateLocation(int32 _iHandle, const FVector& _vLocation)
+{
+	if (m_Grid.IsValidHandle(_iHandle))
+	{
+		m_Grid.Move(_iHandle, _vLocation);
+	}
+}
+
+void ASafetyFirstProximityGrid::Unregister(int32 _iHandle)
+{
+	if (m_Grid.IsValidHandle(_iHandle))
+	{
+		m_Grid.Remove(_iHandle);
+		m_Actors[_iHandle] = nullptr;
+		DEC_DWORD_STAT(STAT_SafetyFirst_GridEntries);
+	}
+}
+
+ASafetyFirstWeapon* ASafetyFirstProximityGrid::FindNearestPickup(const FVector& _vLocation, float _fRadius) const
+{
+	const int32 iHandle = m_Grid.FindNearest(_vLocation, _fRadius + m_fMaxPickupRadius, (uint8)ESafetyFirstGridLayer::Weapon, [this, _fRadius](int32 _iHandle, float _fDistSq)
+	{
+		ASafetyFirstWeapon* weapon = Cast<ASafetyFirstWeapon>(m_Actors[_iHandle].Get());
+		if (weapon == nullptr || !weapon->CanBePickedUp() || weapon->GetWeaponOwner() != nullptr)
+		{
+			return false;
+		}
+		const float fReach = _fRadius + weapon->GetPickupRadius();
+		return _fDistSq <= fReach * fReach;
+	});
+
+	return iHandle != INDEX_NONE ? Cast<ASafetyFirstWeapon>(m_Actors[iHandle].Get()) : nullptr;
+}
+
+void ASafetyFirstProximityGrid::QueryRadius(const FVector& _vLocation, float _fRadius, ESafetyFirstGridLayer _eLayer, TArray<AActor*>& _OutActors) const
+{
+	m_Grid.ForEachInRadius(_vLocation, _fRadius, (uint8)_eLayer, [this, &_OutActors](int32 _iHandle, float _fDistSq)
+	{
+		if (AActor* actor = m_Actors[_iHandle].Get())
+		{
+			_OutActors.Add(actor);
+		}
+	});
+}
+
+/**
+ * SafetyFirst.Bench.Pickup [NumWeapons=1000] [Iterations=60]
+ * Spawns loose weapons around the first player and moves all of them once per iteration,
+ * first with overlap generating triggers (the overlap path), then with grid updates plus one pickup query (the grid path).
+ */
+static void BenchmarkPickup(const TArray<FString>& _Args, UWorld* _World)
+{
+	ASafetyFirstProximityGrid* grid = ASafetyFirstProximityGrid::Get(_World);
+	if (grid == nullptr)
+	{
+		return;
+	}
+
+	const int32 iNumWeapons = _Args.Num() > 0 ? FCString::Atoi(*_Args[0]) : 1000;
+	const int32 iIterations = _Args.Num() > 1 ? FMath::Max(FCString::Atoi(*_Args[1]), 1) : 60;
+
+	ASafetyFirstPawn* pawn = Cast<ASafetyFirstPawn>(UGameplayStatics::GetPlayerPawn(_World, 0));
+	const FVector vCenter = pawn != nullptr ? pawn->GetActorLocation() : FVector::ZeroVector;
+	UClass* weaponClass = (pawn != nullptr && pawn->m_WeaponClass != nullptr) ? pawn->m_WeaponClass.Get() : ASafetyFirstWeapon::StaticClass();
+	const float fHalfExtent = FMath::Sqrt((float)iNumWeapons) * 100.0f;
+
+	FRandomStream random(0x5AFE);
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	TArray<ASafetyFirstWeapon*> weapons;
+	weapons.Reserve(iNumWeapons);
+	for (int32 i = 0; i < iNumWeapons; ++i)
+	{
+		const FVector vLocation = vCenter + FVector(random.FRandRange(-fHalfExtent, fHalfExtent), random.FRandRange(-fHalfExtent, fHalfExtent), 0.0f);
+		if (ASafetyFirstWeapon* weapon = _World->SpawnActor<ASafetyFirstWeapon>(weaponClass, vLocation, FRotator::ZeroRotator, spawnInfo))
+		{
+			weapons.Add(weapon);
+		}
+	}
+
+	const FVector vStep(1.0f, 0.0f, 0.0f);
+
+	// Overlap path: triggers generate overlaps on every move
+	for (ASafetyFirstWeapon* weapon : weapons)
+	{
+		weapon->SetPickupOverlapEnabled(true);
+	}
+	const double dOverlapStart = FPlatformTime::Seconds();
+	for (int32 iteration = 0; iteration < iIterations; ++iteration)
+	{
+		const FVector vOffset = (iteration & 1) ? -vStep : vStep;
+		for (ASafetyFirstWeapon* weapon : weapons)
+		{
+			weapon->SetActorLocation(weapon->GetActorLocation() + vOffset);
+		}
+	}
+	const double dOverlapSeconds = FPlatformTime::Seconds() - dOverlapStart;
+
+	// Grid path: no overlap, grid update and one nearest query per iteration
+	for (ASafetyFirstWeapon* weapon : weapons)
+	{
+		weapon->SetPickupOverlapEnabled(false);
+	}
+	int32 iFound = 0;
+	const double dGridStart = FPlatformTime::Seconds();
+	for (int32 iteration = 0; iteration < iIterations; ++iteration)
+	{
+		const FVector vOffset = (iteration & 1) ? -vStep : vStep;
+		for (ASafetyFirstWeapon* weapon : weapons)
+		{
+			weapon->SetActorLocation(weapon->GetActorLocation() + vOffset);
+			weapon->SyncProximityGrid();
+		}
+		iFound += grid->FindNearestPickup(vCenter, 100.0f) != nullptr ? 1 : 0;
+	}
+	const double dGridSeconds = FPlatformTime::Seconds() - dGridStart;
+
+	for (ASafetyFirstWeapon* weapon : weapons)
+	{
+		weapon->Destroy();
+	}
+
+	UE_LOG(LogSafetyFirst, Display, TEXT("Pickup benchmark, %d weapons, %d iterations:"), weapons.Num(), iIterations);
+	UE_LOG(LogSafetyFirst, Display, TEXT("  overlap path: %.1f us per iteration"), dOverlapSeconds * 1e6 / iIterations);
+	UE_LOG(LogSafetyFirst, Display, TEXT("  grid path:    %.1f us per iteration (%d queries found a weapon)"), dGridSeconds * 1e6 / iIterations, iFound);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GBenchmarkPickupCmd(
+	TEXT("SafetyFirst.Bench.Pickup"),
+	TEXT("Compares overlap based and grid based weapon pickup. Args: [NumWeapons=1000] [Iterations=60]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkPickup));
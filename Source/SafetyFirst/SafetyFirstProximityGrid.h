@@ -0,0 +1,64 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstSpatialGrid2D.h"
+#include "SafetyFirstProximityGrid.generated.h"
+
+class ASafetyFirstWeapon;
+
+/** Kind of actor stored in the proximity grid, queries only look at one layer */
+UENUM()
+enum class ESafetyFirstGridLayer : uint8
+{
+	Weapon,
+	Pawn,
+	Enemy,
+};
+
+/**
+ * World level 2D grid that weapons and pawns register into.
+ * Replaces physics overlap events for weapon pickup: the pawn asks for the nearest weapon it can pick up.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstProximityGrid : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstProximityGrid();
+
+	/** Returns the grid of the world, spawning it if needed */
+	static ASafetyFirstProximityGrid* Get(UWorld* _World);
+
+	/** True when pickup still goes through the trigger overlaps instead of the grid */
+	static bool UseOverlapPickup();
+
+	/** Registers the actor at its current location and returns its handle */
+	int32 Register(AActor* _Actor, ESafetyFirstGridLayer _eLayer);
+	void UpdateLocation(int32 _iHandle, const FVector& _vLocation);
+	void Unregister(int32 _iHandle);
+
+	/** Returns the closest weapon without owner that can be picked up and whose pickup zone touches the circle */
+	ASafetyFirstWeapon* FindNearestPickup(const FVector& _vLocation, float _fRadius) const;
+
+	/** Fills _OutActors with the actors of the layer within the radius */
+	void QueryRadius(const FVector& _vLocation, float _fRadius, ESafetyFirstGridLayer _eLayer, TArray<AActor*>& _OutActors) const;
+
+	virtual void PostInitProperties() override;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fCellSize = 500.0f;
+
+	/** Largest pickup zone of a weapon, bounds the search around the pawn */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMaxPickupRadius = 200.0f;
+
+private:
+	FSafetyFirstSpatialGrid2D m_Grid;
+
+	/** Indexed by grid handle */
+	TArray<TWeakObjectPtr<AActor>> m_Actors;
+};
@@ -0,0 +1,419 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstSignificanceManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstPawn.h"
+#include "SafetyFirstWorldManager.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance update"), STAT_SafetyFirst_Significance, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance high"), STAT_SafetyFirst_SignificanceHigh, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance medium"), STAT_SafetyFirst_SignificanceMedium, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance low"), STAT_SafetyFirst_SignificanceLow, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance dormant"), STAT_SafetyFirst_SignificanceDormant, STATGROUP_SafetyFirst);
+
+static int32 GSafetyFirstSignificanceEnable = 1;
+static FAutoConsoleVariableRef CVarSafetyFirstSignificanceEnable(
+	TEXT("SafetyFirst.Significance.Enable"),
+	GSafetyFirstSignificanceEnable,
+	TEXT("0 keeps every registered actor at High significance, 1 lowers far and off screen actors."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld GDumpSignificanceStatsCmd(
+	TEXT("SafetyFirst.Significance.Stats"),
+	TEXT("Logs the number of registered actors per type and significance"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		if (ASafetyFirstSignificanceManager* manager = ASafetyFirstSignificanceManager::Get(_World))
+		{
+			manager->DumpStats();
+		}
+	}));
+
+ASafetyFirstSignificanceManager::ASafetyFirstSignificanceManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+	FMemory::Memzero(m_Counts);
+}
+
+ASafetyFirstSignificanceManager* ASafetyFirstSignificanceManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstSignificanceManager>(_World);
+}
+
+void ASafetyFirstSignificanceManager::BeginPlay()
+{
+	Super::BeginPlay();
+	SetActorTickInterval(m_fUpdateInterval);
+}
+
+void ASafetyFirstSignificanceManager::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	for (auto it = m_Entries.CreateIterator(); it; ++it)
+	{
+		if (it->m_Actor.IsValid())
+		{
+			Apply(*it, ESafetyFirstSignificance::High);
+		}
+	}
+	m_Entries.Empty();
+	m_Indices.Empty();
+	FMemory::Memzero(m_Counts);
+	PublishCounts();
+
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstSignificanceManager::Register(AActor* _Actor, ESafetyFirstSignificanceType _eType)
+{
+	SAFETYFIRST_LLM_SCOPE(Managers);
+	if (_Actor == nullptr)
+	{
+		return;
+	}
+
+	if (const int32* iExisting = m_Indices.Find(_Actor))
+	{
+		FEntry& entry = m_Entries[*iExisting];
+		if (entry.m_Actor.Get() == _Actor)
+		{
+			if (entry.m_eType != _eType)
+			{
+				Apply(entry, ESafetyFirstSignificance::High);
+				--m_Counts[(int32)entry.m_eType][(int32)ESafetyFirstSignificance::High];
+				entry.m_eType = _eType;
+				++m_Counts[(int32)entry.m_eType][(int32)ESafetyFirstSignificance::High];
+			}
+			return;
+		}
+
+		// A destroyed actor left its address to this one before the next update
+		RemoveEntry(*iExisting);
+	}
+
+	FEntry entry;
+	entry.m_Actor = _Actor;
+	entry.m_Key = _Actor;
+	entry.m_eType = _eType;
+	entry.m_eSignificance = ESafetyFirstSignificance::High;
+	entry.m_fTickInterval = _Actor->PrimaryActorTick.TickInterval;
+	entry.m_bTickEnabled = _Actor->IsActorTickEnabled();
+
+	TInlineComponentArray<UActorComponent*> components(_Actor);
+	for (UActorComponent* component : components)
+	{
+		UPrimitiveComponent* primitive = Cast<UPrimitiveComponent>(component);
+		if (primitive == nullptr && !component->PrimaryComponentTick.bCanEverTick)
+		{
+			continue;
+		}
+
+		FComponentState state;
+		state.m_Component = component;
+		state.m_fTickInterval = component->PrimaryComponentTick.TickInterval;
+		state.m_bTickEnabled = component->IsComponentTickEnabled();
+		state.m_bCastShadow = primitive != nullptr && primitive->CastShadow;
+		state.m_bVisible = primitive != nullptr && primitive->IsVisible();
+		state.m_bManageTick = true;
+		entry.m_Components.Add(state);
+	}
+
+	m_Indices.Add(_Actor, m_Entries.Add(MoveTemp(entry)));
+	++m_Counts[(int32)_eType][(int32)ESafetyFirstSignificance::High];
+}
+
+void ASafetyFirstSignificanceManager::Unregister(AActor* _Actor)
+{
+	const int32* iIndex = m_Indices.Find(_Actor);
+	if (iIndex == nullptr)
+	{
+		return;
+	}
+
+	const int32 iEntry = *iIndex;
+	if (m_Entries[iEntry].m_Actor.Get() == _Actor)
+	{
+		Apply(m_Entries[iEntry], ESafetyFirstSignificance::High);
+	}
+	RemoveEntry(iEntry);
+}
+
+void ASafetyFirstSignificanceManager::ReleaseTick(AActor* _Actor, UActorComponent* _Component)
+{
+	const int32* iIndex = m_Indices.Find(_Actor);
+	if (iIndex == nullptr || m_Entries[*iIndex].m_Actor.Get() != _Actor)
+	{
+		return;
+	}
+
+	FEntry& entry = m_Entries[*iIndex];
+	const bool bParked = entry.m_eSignificance == ESafetyFirstSignificance::Dormant && GetPolicy(entry.m_eType).m_bParkWhenDormant;
+	for (FComponentState& state : entry.m_Components)
+	{
+		if (state.m_Component.Get() != _Component || !state.m_bManageTick)
+		{
+			continue;
+		}
+
+		state.m_bManageTick = false;
+		if (_Component->PrimaryComponentTick.bCanEverTick)
+		{
+			_Component->SetComponentTickInterval(state.m_fTickInterval);
+			if (bParked)
+			{
+				_Component->SetComponentTickEnabled(state.m_bTickEnabled);
+			}
+		}
+	}
+}
+
+void ASafetyFirstSignificanceManager::RemoveEntry(int32 _iIndex)
+{
+	const FEntry& entry = m_Entries[_iIndex];
+	--m_Counts[(int32)entry.m_eType][(int32)entry.m_eSignificance];
+	m_Indices.Remove(entry.m_Key);
+	m_Entries.RemoveAt(_iIndex);
+}
+
+ESafetyFirstSignificance ASafetyFirstSignificanceManager::GetSignificance(const AActor* _Actor) const
+{
+	const int32* iIndex = m_Indices.Find(_Actor);
+	return iIndex != nullptr ? m_Entries[*iIndex].m_eSignificance : ESafetyFirstSignificance::High;
+}
+
+int32 ASafetyFirstSignificanceManager::GetCount(ESafetyFirstSignificanceType _eType, ESafetyFirstSignificance _eSignificance) const
+{
+	return m_Counts[(int32)_eType][(int32)_eSignificance];
+}
+
+const FSafetyFirstSignificancePolicy& ASafetyFirstSignificanceManager::GetPolicy(ESafetyFirstSignificanceType _eType) const
+{
+	switch (_eType)
+	{
+	case ESafetyFirstSignificanceType::Weapon:
+		return m_WeaponPolicy;
+	case ESafetyFirstSignificanceType::Projectile:
+		return m_ProjectilePolicy;
+	default:
+		return m_EnemyPolicy;
+	}
+}
+
+ESafetyFirstSignificance ASafetyFirstSignificanceManager::FromDistance(float _fDistance) const
+{
+	if (_fDistance < m_fHighDistance)
+	{
+		return ESafetyFirstSignificance::High;
+	}
+	if (_fDistance < m_fMediumDistance)
+	{
+		return ESafetyFirstSignificance::Medium;
+	}
+	if (_fDistance < m_fLowDistance)
+	{
+		return ESafetyFirstSignificance::Low;
+	}
+	return ESafetyFirstSignificance::Dormant;
+}
+
+ESafetyFirstSignificance ASafetyFirstSignificanceManager::Evaluate(const FEntry& _Entry, const TSafetyFirstFrameArray<FVector>& _PawnLocations, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const
+{
+	const FVector vLocation = _Entry.m_Actor->GetActorLocation();
+
+	float fDistanceSquared = MAX_flt;
+	for (const FVector& vPawn : _PawnLocations)
+	{
+		fDistanceSquared = FMath::Min(fDistanceSquared, FVector::DistSquared2D(vLocation, vPawn));
+	}
+
+	bool bSeen = _Views.Num() == 0;
+	for (const FSafetyFirstView& view : _Views)
+	{
+		const FVector vToActor = vLocation - view.m_vLocation;
+		if (_PawnLocations.Num() == 0)
+		{
+			fDistanceSquared = FMath::Min(fDistanceSquared, vToActor.SizeSquared());
+		}
+		if (!bSeen && (vToActor | view.m_vDirection) >= view.m_fCosHalfAngle * vToActor.Size())
+		{
+			bSeen = true;
+		}
+	}
+
+	float fDistance = FMath::Sqrt(fDistanceSquared);
+	if (!bSeen)
+	{
+		fDistance *= m_fOffscreenDistanceScale;
+	}
+
+	const ESafetyFirstSignificance eCandidate = FromDistance(fDistance);
+	if (eCandidate <= _Entry.m_eSignificance)
+	{
+		return eCandidate;
+	}
+
+	// Demote only once the actor is clearly past the threshold
+	const ESafetyFirstSignificance eDemoted = FromDistance(fDistance / (1.0f + m_fHysteresis));
+	return eDemoted > _Entry.m_eSignificance ? eDemoted : _Entry.m_eSignificance;
+}
+
+void ASafetyFirstSignificanceManager::Apply(FEntry& _Entry, ESafetyFirstSignificance _eSignificance)
+{
+	AActor* actor = _Entry.m_Actor.Get();
+	const FSafetyFirstSignificancePolicy& policy = GetPolicy(_Entry.m_eType);
+	const bool bDormant = _eSignificance == ESafetyFirstSignificance::Dormant;
+	const bool bWasDormant = _Entry.m_eSignificance == ESafetyFirstSignificance::Dormant;
+
+	if (policy.m_bAdjustTick)
+	{
+		float fMinInterval = 0.0f;
+		if (_eSignificance == ESafetyFirstSignificance::Medium)
+		{
+			fMinInterval = policy.m_fMediumTickInterval;
+		}
+		else if (_eSignificance != ESafetyFirstSignificance::High)
+		{
+			fMinInterval = policy.m_fLowTickInterval;
+		}
+
+		actor->SetActorTickInterval(FMath::Max(_Entry.m_fTickInterval, fMinInterval));
+		for (const FComponentState& state : _Entry.m_Components)
+		{
+			UActorComponent* component = state.m_Component.Get();
+			if (component != nullptr && state.m_bManageTick && component->PrimaryComponentTick.bCanEverTick)
+			{
+				component->SetComponentTickInterval(FMath::Max(state.m_fTickInterval, fMinInterval));
+			}
+		}
+	}
+
+	if (policy.m_bParkWhenDormant && bDormant != bWasDormant)
+	{
+		// Remember what was ticking when parking, whoever disabled a tick in the meantime keeps it disabled
+		if (bDormant)
+		{
+			_Entry.m_bTickEnabled = actor->IsActorTickEnabled();
+		}
+		actor->SetActorTickEnabled(!bDormant && _Entry.m_bTickEnabled);
+
+		for (FComponentState& state : _Entry.m_Components)
+		{
+			UActorComponent* component = state.m_Component.Get();
+			if (component != nullptr && state.m_bManageTick)
+			{
+				if (bDormant)
+				{
+					state.m_bTickEnabled = component->IsComponentTickEnabled();
+				}
+				component->SetComponentTickEnabled(!bDormant && state.m_bTickEnabled);
+			}
+		}
+	}
+
+	if (policy.m_bHideWhenDormant && bDormant != bWasDormant)
+	{
+		for (const FComponentState& state : _Entry.m_Components)
+		{
+			if (UPrimitiveComponent* primitive = Cast<UPrimitiveComponent>(state.m_Component.Get()))
+			{
+				primitive->SetVisibility(!bDormant && state.m_bVisible);
+			}
+		}
+	}
+
+	if (policy.m_bShadowsOnlyWhenHigh)
+	{
+		const bool bHigh = _eSignificance == ESafetyFirstSignificance::High;
+		for (const FComponentState& state : _Entry.m_Components)
+		{
+			if (UPrimitiveComponent* primitive = Cast<UPrimitiveComponent>(state.m_Component.Get()))
+			{
+				if (primitive->CastShadow != (bHigh && state.m_bCastShadow))
+				{
+					primitive->SetCastShadow(bHigh && state.m_bCastShadow);
+				}
+			}
+		}
+	}
+
+	--m_Counts[(int32)_Entry.m_eType][(int32)_Entry.m_eSignificance];
+	++m_Counts[(int32)_Entry.m_eType][(int32)_eSignificance];
+	_Entry.m_eSignificance = _eSignificance;
+}
+
+void ASafetyFirstSignificanceManager::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_Significance, Significance);
+
+	UWorld* world = GetWorld();
+
+	TSafetyFirstFrameArray<FVector> pawnLocations;
+	for (TActorIterator<ASafetyFirstPawn> it(world); it; ++it)
+	{
+		pawnLocations.Add(it->GetActorLocation());
+	}
+
+	TSafetyFirstFrameArray<FSafetyFirstView> views;
+	GatherLocalViews(world, m_fViewMarginDegrees, views);
+
+	const bool bEvaluate = GSafetyFirstSignificanceEnable != 0 && (pawnLocations.Num() > 0 || views.Num() > 0);
+
+	for (auto it = m_Entries.CreateIterator(); it; ++it)
+	{
+		FEntry& entry = *it;
+		if (!entry.m_Actor.IsValid())
+		{
+			RemoveEntry(it.GetIndex());
+			continue;
+		}
+
+		const ESafetyFirstSignificance eSignificance = bEvaluate ? Evaluate(entry, pawnLocations, views) : ESafetyFirstSignificance::High;
+		if (eSignificance != entry.m_eSignificance)
+		{
+			Apply(entry, eSignificance);
+		}
+	}
+
+	PublishCounts();
+}
+
+void ASafetyFirstSignificanceManager::PublishCounts()
+{
+	int32 totals[(int32)ESafetyFirstSignificance::Count] = {};
+	for (int32 iType = 0; iType < (int32)ESafetyFirstSignificanceType::Count; ++iType)
+	{
+		for (int32 iSignificance = 0; iSignificance < (int32)ESafetyFirstSignificance::Count; ++iSignificance)
+		{
+			totals[iSignificance] += m_Counts[iType][iSignificance];
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SafetyFirst_SignificanceHigh, totals[(int32)ESafetyFirstSignificance::High]);
+	SET_DWORD_STAT(STAT_SafetyFirst_SignificanceMedium, totals[(int32)ESafetyFirstSignificance::Medium]);
+	SET_DWORD_STAT(STAT_SafetyFirst_SignificanceLow, totals[(int32)ESafetyFirstSignificance::Low]);
+	SET_DWORD_STAT(STAT_SafetyFirst_SignificanceDormant, totals[(int32)ESafetyFirstSignificance::Dormant]);
+
+	CSV_CUSTOM_STAT(SafetyFirst, SignificanceHigh, totals[(int32)ESafetyFirstSignificance::High], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, SignificanceMedium, totals[(int32)ESafetyFirstSignificance::Medium], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, SignificanceLow, totals[(int32)ESafetyFirstSignificance::Low], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(SafetyFirst, SignificanceDormant, totals[(int32)ESafetyFirstSignificance::Dormant], ECsvCustomStatOp::Set);
+}
+
+void ASafetyFirstSignificanceManager::DumpStats() const
+{
+	static const TCHAR* TypeNames[] = { TEXT("Enemy"), TEXT("Weapon"), TEXT("Projectile") };
+	static_assert(ARRAY_COUNT(TypeNames) == (int32)ESafetyFirstSignificanceType::Count, "One name per significance type");
+
+	UE_LOG(LogSafetyFirst, Log, TEXT("Significance: %d registered actors"), m_Entries.Num());
+	for (int32 iType = 0; iType < (int32)ESafetyFirstSignificanceType::Count; ++iType)
+	{
+		UE_LOG(LogSafetyFirst, Log, TEXT("  %-10s high %5d  medium %5d  low %5d  dormant %5d"), TypeNames[iType],
+			m_Counts[iType][(int32)ESafetyFirstSignificance::High], m_Counts[iType][(int32)ESafetyFirstSignificance::Medium],
+			m_Counts[iType][(int32)ESafetyFirstSignificance::Low], m_Counts[iType][(int32)ESafetyFirstSignificance::Dormant]);
+	}
+}
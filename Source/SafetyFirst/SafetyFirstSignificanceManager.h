@@ -0,0 +1,172 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWorldManager.h"
+#include "SafetyFirstSignificanceManager.generated.h"
+
+/** How much an actor matters to the players, from most to least */
+UENUM()
+enum class ESafetyFirstSignificance : uint8
+{
+	High,
+	Medium,
+	Low,
+	/** Far away and off screen, parked when the policy allows it */
+	Dormant,
+	Count UMETA(Hidden),
+};
+
+/** Kind of registered actor, each one has its own policy */
+UENUM()
+enum class ESafetyFirstSignificanceType : uint8
+{
+	Enemy,
+	Weapon,
+	Projectile,
+	Count UMETA(Hidden),
+};
+
+/** What the significance manager changes on an actor for each significance */
+USTRUCT()
+struct FSafetyFirstSignificancePolicy
+{
+	GENERATED_BODY()
+
+	/** Scales the tick interval of the actor and its ticking components */
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	bool m_bAdjustTick = true;
+
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	float m_fMediumTickInterval = 0.1f;
+
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	float m_fLowTickInterval = 0.25f;
+
+	/** Disables the ticks of the actor and its components while dormant */
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	bool m_bParkWhenDormant = false;
+
+	/** Hides the root component hierarchy while dormant */
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	bool m_bHideWhenDormant = false;
+
+	/** Turns dynamic shadows off below High */
+	UPROPERTY(EditAnywhere, Category = "Safety First ")
+	bool m_bShadowsOnlyWhenHigh = false;
+};
+
+/**
+ * Scores registered actors by their distance to the player pawns and whether a local player view sees them
+ * (one view per splitscreen player), then lowers their tick rate, shadows or parks them through the policy of
+ * their type. Demotions need the actor to go m_fHysteresis further than the threshold, so actors at the
+ * boundary do not pop between two significances.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstSignificanceManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstSignificanceManager();
+
+	/** Returns the manager of the world, spawning it if needed */
+	static ASafetyFirstSignificanceManager* Get(UWorld* _World);
+
+	/** Starts managing the actor, registering it again only changes its type */
+	void Register(AActor* _Actor, ESafetyFirstSignificanceType _eType);
+
+	/** Gives the actor back its original tick, visibility and shadow settings */
+	void Unregister(AActor* _Actor);
+
+	/** Gives the component of a registered actor back its original tick and stops changing it, for components another manager paces */
+	void ReleaseTick(AActor* _Actor, UActorComponent* _Component);
+
+	/** High for actors that are not registered */
+	ESafetyFirstSignificance GetSignificance(const AActor* _Actor) const;
+
+	/** Number of registered actors of the type in the significance */
+	int32 GetCount(ESafetyFirstSignificanceType _eType, ESafetyFirstSignificance _eSignificance) const;
+
+	void DumpStats() const;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	/** Seconds between two evaluations of every registered actor */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fUpdateInterval = 0.2f;
+
+	/** Closer to a pawn than this, an actor is High */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fHighDistance = 2000.0f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fMediumDistance = 4000.0f;
+
+	/** Further than this, an actor is Dormant */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fLowDistance = 8000.0f;
+
+	/** Extra distance ratio needed before an actor is demoted */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fHysteresis = 0.15f;
+
+	/** Distance multiplier for actors outside every local player view */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fOffscreenDistanceScale = 2.0f;
+
+	/** Widens the view cones so actors at the screen edges count as seen */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fViewMarginDegrees = 10.0f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FSafetyFirstSignificancePolicy m_EnemyPolicy;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FSafetyFirstSignificancePolicy m_WeaponPolicy;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	FSafetyFirstSignificancePolicy m_ProjectilePolicy;
+
+private:
+	struct FComponentState
+	{
+		TWeakObjectPtr<UActorComponent> m_Component;
+		float m_fTickInterval;
+		bool m_bTickEnabled;
+		bool m_bCastShadow;
+		bool m_bVisible;
+		/** False once ReleaseTick gave the tick to someone else */
+		bool m_bManageTick;
+	};
+
+	struct FEntry
+	{
+		TWeakObjectPtr<AActor> m_Actor;
+		/** Key in m_Indices, still known once the actor is gone */
+		const AActor* m_Key;
+		ESafetyFirstSignificanceType m_eType;
+		ESafetyFirstSignificance m_eSignificance;
+		float m_fTickInterval;
+		bool m_bTickEnabled;
+		TArray<FComponentState> m_Components;
+	};
+
+
+	const FSafetyFirstSignificancePolicy& GetPolicy(ESafetyFirstSignificanceType _eType) const;
+	ESafetyFirstSignificance FromDistance(float _fDistance) const;
+	ESafetyFirstSignificance Evaluate(const FEntry& _Entry, const TSafetyFirstFrameArray<FVector>& _PawnLocations, const TSafetyFirstFrameArray<FSafetyFirstView>& _Views) const;
+	void Apply(FEntry& _Entry, ESafetyFirstSignificance _eSignificance);
+	void RemoveEntry(int32 _iIndex);
+	void PublishCounts();
+
+	TSparseArray<FEntry> m_Entries;
+	TMap<const AActor*, int32> m_Indices;
+
+	int32 m_Counts[(int32)ESafetyFirstSignificanceType::Count][(int32)ESafetyFirstSignificance::Count];
+};
@@ -0,0 +1,58 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstSpatialGrid2D.h"
+
+FSafetyFirstSpatialGrid2D::FSafetyFirstSpatialGrid2D(float _fCellSize)
+	: m_fInvCellSize(1.0f / FMath::Max(_fCellSize, 1.0f))
+{
+}
+
+int32 FSafetyFirstSpatialGrid2D::Add(const FVector& _vLocation, uint32 _uUserData, uint8 _uLayer)
+{
+	FEntry entry;
+	entry.m_vLocation = FVector2D(_vLocation.X, _vLocation.Y);
+	entry.m_Cell = ToCell(entry.m_vLocation);
+	entry.m_uUserData = _uUserData;
+	entry.m_uLayer = _uLayer;
+
+	const int32 iHandle = m_Entries.Add(entry);
+	AddToCell(iHandle, entry.m_Cell);
+	return iHandle;
+}
+
+void FSafetyFirstSpatialGrid2D::Move(int32 _iHandle, const FVector& _vLocation)
+{
+	FEntry& entry = m_Entries[_iHandle];
+	entry.m_vLocation = FVector2D(_vLocation.X, _vLocation.Y);
+
+	const FIntPoint newCell = ToCell(entry.m_vLocation);
+	if (newCell != entry.m_Cell)
+	{
+		RemoveFromCell(_iHandle, entry.m_Cell);
+		entry.m_Cell = newCell;
+		AddToCell(_iHandle, newCell);
+	}
+}
+
+void FSafetyFirstSpatialGrid2D::Remove(int32 _iHandle)
+{
+	if (m_Entries.IsValidIndex(_iHandle))
+	{
+		RemoveFromCell(_iHandle, m_Entries[_iHandle].m_Cell);
+		m_Entries.RemoveAt(_iHandle);
+	}
+}
+
+void FSafetyFirstSpatialGrid2D::AddToCell(int32 _iHandle, const FIntPoint& _Cell)
+{
+	m_Cells.FindOrAdd(_Cell).Add(_iHandle);
+}
+
+void FSafetyFirstSpatialGrid2D::RemoveFromCell(int32 _iHandle, const FIntPoint& _Cell)
+{
+	if (TArray<int32>* cell = m_Cells.Find(_Cell))
+	{
+		cell->RemoveSingleSwap(_iHandle, /*bAllowShrinking*/false);
+		// Empty cells are kept, an arena only has a bounded number of them and they are likely to be reused
+	}
+}
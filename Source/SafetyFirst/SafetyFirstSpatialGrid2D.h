@@ -0,0 +1,105 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/SparseArray.h"
+
+/**
+ * Uniform 2D grid over the play plane (X, Y), storing one entry per registered object.
+ * Moving an entry inside its cell only writes its position, cell lists change when it crosses a cell border.
+ */
+class FSafetyFirstSpatialGrid2D
+{
+public:
+	explicit FSafetyFirstSpatialGrid2D(float _fCellSize = 500.0f);
+
+	/** Adds an entry and returns its handle */
+	int32 Add(const FVector& _vLocation, uint32 _uUserData, uint8 _uLayer);
+
+	/** Moves an entry */
+	void Move(int32 _iHandle, const FVector& _vLocation);
+
+	/** Removes an entry, the handle can be reused by a later Add */
+	void Remove(int32 _iHandle);
+
+	bool IsValidHandle(int32 _iHandle) const { return m_Entries.IsValidIndex(_iHandle); }
+	uint32 GetUserData(int32 _iHandle) const { return m_Entries[_iHandle].m_uUserData; }
+	FVector2D GetLocation(int32 _iHandle) const { return m_Entries[_iHandle].m_vLocation; }
+	int32 Num() const { return m_Entries.Num(); }
+
+	/** Calls _Visitor(handle, squared distance) for every entry of the layer within the radius */
+	template<typename TVisitor>
+	void ForEachInRadius(const FVector& _vCenter, float _fRadius, uint8 _uLayer, TVisitor&& _Visitor) const
+	{
+		const FVector2D vCenter(_vCenter.X, _vCenter.Y);
+		const float fRadiusSq = _fRadius * _fRadius;
+		const FIntPoint minCell = ToCell(vCenter - FVector2D(_fRadius, _fRadius));
+		const FIntPoint maxCell = ToCell(vCenter + FVector2D(_fRadius, _fRadius));
+
+		for (int32 y = minCell.Y; y <= maxCell.Y; ++y)
+		{
+			for (int32 x = minCell.X; x <= maxCell.X; ++x)
+			{
+				const TArray<int32>* cell = m_Cells.Find(FIntPoint(x, y));
+				if (cell == nullptr)
+				{
+					continue;
+				}
+
+				for (int32 iHandle : *cell)
+				{
+					const FEntry& entry = m_Entries[iHandle];
+					if (entry.m_uLayer != _uLayer)
+					{
+						continue;
+					}
+
+					const float fDistSq = FVector2D::DistSquared(vCenter, entry.m_vLocation);
+					if (fDistSq <= fRadiusSq)
+					{
+						_Visitor(iHandle, fDistSq);
+					}
+				}
+			}
+		}
+	}
+
+	/** Returns the handle of the closest entry of the layer accepted by the predicate, INDEX_NONE if there is none */
+	template<typename TPredicate>
+	int32 FindNearest(const FVector& _vCenter, float _fRadius, uint8 _uLayer, TPredicate&& _Predicate) const
+	{
+		int32 iBest = INDEX_NONE;
+		float fBestDistSq = MAX_flt;
+		ForEachInRadius(_vCenter, _fRadius, _uLayer, [&](int32 _iHandle, float _fDistSq)
+		{
+			if (_fDistSq < fBestDistSq && _Predicate(_iHandle, _fDistSq))
+			{
+				fBestDistSq = _fDistSq;
+				iBest = _iHandle;
+			}
+		});
+		return iBest;
+	}
+
+private:
+	struct FEntry
+	{
+		FVector2D m_vLocation;
+		FIntPoint m_Cell;
+		uint32 m_uUserData;
+		uint8 m_uLayer;
+	};
+
+	FIntPoint ToCell(const FVector2D& _vLocation) const
+	{
+		return FIntPoint(FMath::FloorToInt(_vLocation.X * m_fInvCellSize), FMath::FloorToInt(_vLocation.Y * m_fInvCellSize));
+	}
+
+	void AddToCell(int32 _iHandle, const FIntPoint& _Cell);
+	void RemoveFromCell(int32 _iHandle, const FIntPoint& _Cell);
+
+	float m_fInvCellSize;
+	TSparseArray<FEntry> m_Entries;
+	TMap<FIntPoint, TArray<int32>> m_Cells;
+};
@@ -0,0 +1,358 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstSpawnDirector.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstCrowdAgent.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Spawn director"), STAT_SafetyFirst_SpawnDirector, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemies activated from pool"), STAT_SafetyFirst_EnemyPoolHits, STATGROUP_SafetyFirst);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemies constructed"), STAT_SafetyFirst_EnemyConstructed, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pending enemy spawns"), STAT_SafetyFirst_PendingSpawns, STATGROUP_SafetyFirst);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Spawn cost (ms)"), STAT_SafetyFirst_SpawnCostMs, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommandWithWorld GDumpSpawnDirectorStatsCmd(
+	TEXT("SafetyFirst.SpawnDirector.Stats"),
+	TEXT("Logs per-wave spawn latency and per-frame spawn cost of every spawn director"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* _World)
+	{
+		for (TActorIterator<ASafetyFirstSpawnDirector> it(_World); it; ++it)
+		{
+			it->DumpStats();
+		}
+	}));
+
+ASafetyFirstSpawnDirector::ASafetyFirstSpawnDirector()
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneRootComponent"));
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+void ASafetyFirstSpawnDirector::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Enemies are spawned by the server only
+	if (!HasAuthority())
+	{
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	// Size each pool on the largest wave using the class
+	for (const FSafetyFirstWaveDefinition& wave : m_Waves)
+	{
+		if (wave.m_EnemyClass != nullptr)
+		{
+			int32& iPrewarm = m_PrewarmLeft.FindOrAdd(wave.m_EnemyClass);
+			iPrewarm = FMath::Min(FMath::Max(iPrewarm, wave.m_iCount), m_iMaxPrewarmPerClass);
+		}
+	}
+
+	m_WaveStats.SetNum(m_Waves.Num());
+	if (m_Waves.Num() > 0)
+	{
+		m_iCurrentWave = 0;
+		m_fDelayLeft = m_Waves[0].m_fDelayBeforeWave;
+	}
+}
+
+void ASafetyFirstSpawnDirector::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	DEC_DWORD_STAT_BY(STAT_SafetyFirst_PendingSpawns, m_Queue.Num() - m_iQueueHead);
+	Super::EndPlay(_EndPlayReason);
+}
+
+void ASafetyFirstSpawnDirector::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_SpawnDirector, SpawnDirector);
+
+	const double dStart = FPlatformTime::Seconds();
+	const double dDeadline = dStart + m_fFrameBudgetMs * 0.001;
+	m_iConstructedThisFrame = 0;
+
+	ScheduleSpawns(_fDt);
+	ProcessQueue(dDeadline);
+	Prewarm(dDeadline);
+
+	m_fLastFrameCostMs = (float)((FPlatformTime::Seconds() - dStart) * 1000.0);
+	m_fMaxFrameCostMs = FMath::Max(m_fMaxFrameCostMs, m_fLastFrameCostMs);
+	SET_FLOAT_STAT(STAT_SafetyFirst_SpawnCostMs, m_fLastFrameCostMs);
+}
+
+void ASafetyFirstSpawnDirector::ScheduleSpawns(float _fDt)
+{
+	if (!m_Waves.IsValidIndex(m_iCurrentWave))
+	{
+		return;
+	}
+
+	if (!m_bWaveRunning)
+	{
+		m_fDelayLeft -= _fDt;
+		if (m_fDelayLeft > 0.0f)
+		{
+			return;
+		}
+		StartWave(m_iCurrentWave);
+		if (!m_bWaveRunning)
+		{
+			return;
+		}
+	}
+
+	const FSafetyFirstWaveDefinition& wave = m_Waves[m_iCurrentWave];
+	const float fNow = GetWorld()->GetTimeSeconds();
+	m_fWaveClock += _fDt;
+
+	// Number of spawns due since the wave started, at the wave cadence
+	const int32 iDue = wave.m_fSpawnInterval > 0.0f ? FMath::Min(FMath::FloorToInt(m_fWaveClock / wave.m_fSpawnInterval) + 1, wave.m_iCount) : wave.m_iCount;
+	for (; m_iScheduledInWave < iDue; ++m_iScheduledInWave)
+	{
+		FTransform transform = GetActorTransform();
+		if (wave.m_SpawnPoints.Num() > 0)
+		{
+			if (const AActor* spawnPoint = wave.m_SpawnPoints[m_iScheduledInWave % wave.m_SpawnPoints.Num()])
+			{
+				transform = spawnPoint->GetActorTransform();
+			}
+		}
+
+		FPendingSpawn pending;
+		pending.m_Class = wave.m_EnemyClass;
+		pending.m_Transform = transform;
+		pending.m_fScheduledTime = fNow;
+		pending.m_iWave = m_iCurrentWave;
+		m_Queue.Add(pending);
+		INC_DWORD_STAT(STAT_SafetyFirst_PendingSpawns);
+	}
+}
+
+void ASafetyFirstSpawnDirector::ProcessQueue(double _dDeadline)
+{
+	const float fNow = GetWorld()->GetTimeSeconds();
+	bool bFirst = true;
+
+	while (m_iQueueHead < m_Queue.Num())
+	{
+		// Always serve one request per frame so a tiny budget cannot stall the waves
+		if (!bFirst && FPlatformTime::Seconds() >= _dDeadline)
+		{
+			break;
+		}
+
+		const FPendingSpawn& pending = m_Queue[m_iQueueHead];
+		const bool bPoolEmpty = m_Pools.FindOrAdd(pending.m_Class).m_Free.Num() == 0;
+		if (bPoolEmpty && m_iConstructedThisFrame >= m_iMaxConstructionsPerFrame)
+		{
+			break;
+		}
+
+		AActor* enemy = AcquireEnemy(pending.m_Class, pending.m_Transform);
+		bFirst = false;
+		++m_iQueueHead;
+		DEC_DWORD_STAT(STAT_SafetyFirst_PendingSpawns);
+
+		FWaveStats& stats = m_WaveStats[pending.m_iWave];
+		const float fLatency = fNow - pending.m_fScheduledTime;
+		++stats.m_iSpawned;
+		stats.m_fTotalLatency += fLatency;
+		stats.m_fMaxLatency = FMath::Max(stats.m_fMaxLatency, fLatency);
+
+		if (enemy != nullptr)
+		{
+			BPE_EnemySpawned(enemy, pending.m_iWave);
+		}
+
+		// Last enemy of the running wave: move on to the next one
+		if (m_bWaveRunning && pending.m_iWave == m_iCurrentWave && stats.m_iSpawned >= m_Waves[m_iCurrentWave].m_iCount)
+		{
+			stats.m_fEndTime = fNow;
+			m_bWaveRunning = false;
+			BPE_WaveCompleted(m_iCurrentWave);
+
+			m_iCurrentWave = m_iCurrentWave + 1;
+			if (m_iCurrentWave >= m_Waves.Num() && m_bLoopWaves)
+			{
+				m_iCurrentWave = 0;
+			}
+			if (m_Waves.IsValidIndex(m_iCurrentWave))
+			{
+				m_fDelayLeft = m_Waves[m_iCurrentWave].m_fDelayBeforeWave;
+			}
+		}
+	}
+
+	if (m_iQueueHead >= m_Queue.Num())
+	{
+		m_Queue.Reset();
+		m_iQueueHead = 0;
+	}
+}
+
+void ASafetyFirstSpawnDirector::Prewarm(double _dDeadline)
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	for (TPair<UClass*, int32>& pair : m_PrewarmLeft)
+	{
+		while (pair.Value > 0 && m_iConstructedThisFrame < m_iMaxConstructionsPerFrame && FPlatformTime::Seconds() < _dDeadline)
+		{
+			AActor* enemy = ConstructEnemy(pair.Key, GetActorTransform());
+			--pair.Value;
+			if (enemy != nullptr)
+			{
+				ActivateEnemy(enemy, false);
+				m_Pools.FindOrAdd(pair.Key).m_Free.Add(enemy);
+			}
+		}
+	}
+}
+
+AActor* ASafetyFirstSpawnDirector::AcquireEnemy(UClass* _Class, const FTransform& _Transform)
+{
+	SAFETYFIRST_LLM_SCOPE(Enemies);
+	if (_Class == nullptr)
+	{
+		return nullptr;
+	}
+
+	FSafetyFirstEnemyPoolBucket& bucket = m_Pools.FindOrAdd(_Class);
+	while (bucket.m_Free.Num() > 0)
+	{
+		AActor* enemy = bucket.m_Free.Pop(/*bAllowShrinking*/false);
+		if (enemy != nullptr && !enemy->IsPendingKillPending())
+		{
+			INC_DWORD_STAT(STAT_SafetyFirst_EnemyPoolHits);
+			enemy->SetActorTransform(_Transform, /*bSweep*/false, nullptr, ETeleportType::TeleportPhysics);
+			ActivateEnemy(enemy, true);
+			return enemy;
+		}
+		--bucket.m_iTotal;
+	}
+
+	return ConstructEnemy(_Class, _Transform);
+}
+
+AActor* ASafetyFirstSpawnDirector::ConstructEnemy(UClass* _Class, const FTransform& _Transform)
+{
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	spawnInfo.Owner = this;
+	// The owner level would be a streamed cell when the director is placed in one, and take the pool down with it
+	spawnInfo.OverrideLevel = GetWorld()->PersistentLevel;
+
+	++m_iConstructedThisFrame;
+	INC_DWORD_STAT(STAT_SafetyFirst_EnemyConstructed);
+
+	AActor* enemy = GetWorld()->SpawnActor<AActor>(_Class, _Transform, spawnInfo);
+	if (enemy != nullptr)
+	{
+		++m_Pools.FindOrAdd(_Class).m_iTotal;
+	}
+	return enemy;
+}
+
+void ASafetyFirstSpawnDirector::RecycleEnemy(AActor* _Enemy)
+{
+	if (_Enemy == nullptr)
+	{
+		return;
+	}
+
+	if (ASafetyFirstSpawnDirector* director = Cast<ASafetyFirstSpawnDirector>(_Enemy->GetOwner()))
+	{
+		director->Release(_Enemy);
+	}
+	else
+	{
+		_Enemy->Destroy();
+	}
+}
+
+void ASafetyFirstSpawnDirector::Release(AActor* _Enemy)
+{
+	FSafetyFirstEnemyPoolBucket& bucket = m_Pools.FindOrAdd(_Enemy->GetClass());
+	if (!bucket.m_Free.Contains(_Enemy))
+	{
+		ActivateEnemy(_Enemy, false);
+		bucket.m_Free.Add(_Enemy);
+	}
+}
+
+void ASafetyFirstSpawnDirector::ActivateEnemy(AActor* _Enemy, bool _bActive)
+{
+	if (!m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager = ASafetyFirstSignificanceManager::Get(GetWorld());
+	}
+
+	// Give the enemy its own ticks back before parking it
+	if (!_bActive && m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Unregister(_Enemy);
+	}
+
+	_Enemy->SetActorHiddenInGame(!_bActive);
+	_Enemy->SetActorEnableCollision(_bActive);
+	_Enemy->SetActorTickEnabled(_bActive && _Enemy->PrimaryActorTick.bCanEverTick);
+
+	if (_bActive && m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Register(_Enemy, ESafetyFirstSignificanceType::Enemy);
+	}
+
+	if (ASafetyFirstCrowdAgent* agent = Cast<ASafetyFirstCrowdAgent>(_Enemy))
+	{
+		agent->SetCrowdActive(_bActive);
+	}
+}
+
+void ASafetyFirstSpawnDirector::StartWave(int32 _iWave)
+{
+	m_bWaveRunning = true;
+	m_iScheduledInWave = 0;
+	m_fWaveClock = 0.0f;
+
+	FWaveStats& stats = m_WaveStats[_iWave];
+	stats = FWaveStats();
+	stats.m_fStartTime = GetWorld()->GetTimeSeconds();
+
+	BPE_WaveStarted(_iWave);
+
+	// Nothing will ever be spawned for an empty wave
+	if (m_Waves[_iWave].m_iCount <= 0)
+	{
+		m_bWaveRunning = false;
+		BPE_WaveCompleted(_iWave);
+		m_iCurrentWave = (_iWave + 1 < m_Waves.Num() || !m_bLoopWaves) ? _iWave + 1 : 0;
+		if (m_Waves.IsValidIndex(m_iCurrentWave))
+		{
+			m_fDelayLeft = FMath::Max(m_Waves[m_iCurrentWave].m_fDelayBeforeWave, KINDA_SMALL_NUMBER);
+		}
+	}
+}
+
+void ASafetyFirstSpawnDirector::DumpStats() const
+{
+	UE_LOG(LogSafetyFirst, Log, TEXT("Spawn director %s: last frame %.3f ms, worst frame %.3f ms (budget %.3f ms)"),
+		*GetName(), m_fLastFrameCostMs, m_fMaxFrameCostMs, m_fFrameBudgetMs);
+
+	for (int32 i = 0; i < m_WaveStats.Num(); ++i)
+	{
+		const FWaveStats& stats = m_WaveStats[i];
+		UE_LOG(LogSafetyFirst, Log, TEXT("  wave %d: %d spawned, latency avg %.3f s max %.3f s, duration %.2f s"),
+			i, stats.m_iSpawned, stats.m_iSpawned > 0 ? stats.m_fTotalLatency / stats.m_iSpawned : 0.0f, stats.m_fMaxLatency,
+			stats.m_fEndTime > stats.m_fStartTime ? stats.m_fEndTime - stats.m_fStartTime : 0.0f);
+	}
+
+	for (const TPair<UClass*, FSafetyFirstEnemyPoolBucket>& pair : m_Pools)
+	{
+		UE_LOG(LogSafetyFirst, Log, TEXT("  pool %s: %d free / %d total"), *GetNameSafe(pair.Key), pair.Value.m_Free.Num(), pair.Value.m_iTotal);
+	}
+}
@@ -0,0 +1,144 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstSpawnDirector.generated.h"
+
+USTRUCT(BlueprintType)
+struct FSafetyFirstWaveDefinition
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Wave)
+	TSubclassOf<AActor> m_EnemyClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Wave)
+	int32 m_iCount = 10;
+
+	/** Enemies are spawned on these actors in turn, on the director if empty */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Wave)
+	TArray<AActor*> m_SpawnPoints;
+
+	/** Seconds between two spawns of the wave, 0 spawns the whole wave at once (still time-sliced) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Wave)
+	float m_fSpawnInterval = 0.2f;
+
+	/** Seconds between the end of the previous wave (or BeginPlay) and the start of this one */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Wave)
+	float m_fDelayBeforeWave = 2.0f;
+};
+
+USTRUCT()
+struct FSafetyFirstEnemyPoolBucket
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> m_Free;
+
+	int32 m_iTotal = 0;
+};
+
+/**
+ * Spawns waves of enemies under a per-frame time budget.
+ * Spawn requests are queued at the wave cadence and served from a pool of deactivated enemies, actors are only
+ * constructed when the pool is empty or while prewarming. Killed enemies come back through RecycleEnemy.
+ */
+UCLASS(config=Game, Blueprintable)
+class ASafetyFirstSpawnDirector : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstSpawnDirector();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+	virtual void Tick(float _fDt) override;
+
+	/** Returns a killed enemy to the pool of the director that spawned it, destroys it otherwise */
+	UFUNCTION(BlueprintCallable, Category = "Spawn")
+	static void RecycleEnemy(AActor* _Enemy);
+
+	UFUNCTION(BlueprintImplementableEvent, Category = "Spawn")
+	void BPE_WaveStarted(int32 _iWave);
+
+	UFUNCTION(BlueprintImplementableEvent, Category = "Spawn")
+	void BPE_WaveCompleted(int32 _iWave);
+
+	/** Called for every enemy taken from the pool or spawned, before it is visible */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Spawn")
+	void BPE_EnemySpawned(AActor* _Enemy, int32 _iWave);
+
+	/** Writes per-wave latency and per-frame cost to the log */
+	void DumpStats() const;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Safety First ")
+	TArray<FSafetyFirstWaveDefinition> m_Waves;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Safety First ")
+	bool m_bLoopWaves = false;
+
+	/** Time the director may spend constructing or activating enemies each frame */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fFrameBudgetMs = 1.0f;
+
+	/** Hard cap of actors constructed per frame, whatever the budget */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxConstructionsPerFrame = 4;
+
+	/** Upper bound of the enemies prewarmed per class, the pool is sized on the largest wave of the class */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxPrewarmPerClass = 128;
+
+private:
+	struct FPendingSpawn
+	{
+		UClass* m_Class;
+		FTransform m_Transform;
+		float m_fScheduledTime;
+		int32 m_iWave;
+	};
+
+	struct FWaveStats
+	{
+		int32 m_iSpawned = 0;
+		float m_fMaxLatency = 0.0f;
+		float m_fTotalLatency = 0.0f;
+		float m_fStartTime = 0.0f;
+		float m_fEndTime = 0.0f;
+	};
+
+	void ScheduleSpawns(float _fDt);
+	void ProcessQueue(double _dDeadline);
+	void Prewarm(double _dDeadline);
+	AActor* AcquireEnemy(UClass* _Class, const FTransform& _Transform);
+	AActor* ConstructEnemy(UClass* _Class, const FTransform& _Transform);
+	void Release(AActor* _Enemy);
+	void ActivateEnemy(AActor* _Enemy, bool _bActive);
+	void StartWave(int32 _iWave);
+
+	UPROPERTY()
+	TMap<UClass*, FSafetyFirstEnemyPoolBucket> m_Pools;
+
+	/** Enemies still to prewarm per class */
+	TMap<UClass*, int32> m_PrewarmLeft;
+
+	TArray<FPendingSpawn> m_Queue;
+	int32 m_iQueueHead = 0;
+
+	TWeakObjectPtr<class ASafetyFirstSignificanceManager> m_SignificanceManager;
+
+	int32 m_iCurrentWave = INDEX_NONE;
+	int32 m_iScheduledInWave = 0;
+	float m_fWaveClock = 0.0f;
+	float m_fDelayLeft = 0.0f;
+	bool m_bWaveRunning = false;
+	int32 m_iConstructedThisFrame = 0;
+
+	TArray<FWaveStats> m_WaveStats;
+	float m_fMaxFrameCostMs = 0.0f;
+	float m_fLastFrameCostMs = 0.0f;
+};
@@ -0,0 +1,565 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstTelemetry.h"
+#include "SafetyFirst.h"
+#include "Async/ParallelFor.h"
+#include "GameFramework/Actor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Compression.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Paths.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry records recorded"), STAT_SafetyFirst_TelemetryRecorded, STATGROUP_SafetyFirst);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry records dropped"), STAT_SafetyFirst_TelemetryDropped, STATGROUP_SafetyFirst);
+
+static FAutoConsoleCommand GDumpTelemetryStatsCmd(
+	TEXT("SafetyFirst.Telemetry.Stats"),
+	TEXT("Logs the telemetry records recorded and dropped since the start"),
+	FConsoleCommandDelegate::CreateStatic(&SafetyFirstTelemetry::DumpStats));
+
+static FAutoConsoleCommand GTelemetryBenchCmd(
+	TEXT("SafetyFirst.Telemetry.Bench"),
+	TEXT("Times records pushed from several threads at once. Arguments: [Records] [Threads], 1000000 and 4 by default"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& _Args)
+	{
+		const int32 iRecords = _Args.Num() > 0 ? FCString::Atoi(*_Args[0]) : 1000000;
+		const int32 iThreads = _Args.Num() > 1 ? FCString::Atoi(*_Args[1]) : 4;
+		UE_LOG(LogSafetyFirst, Display, TEXT("Telemetry: %d records from %d threads at %.1f ns each"),
+			iRecords, iThreads, SafetyFirstTelemetry::MeasureRecordCost(iRecords, iThreads));
+	}));
+
+static FAutoConsoleCommand GTelemetryConvertCmd(
+	TEXT("SafetyFirst.Telemetry.ToCsv"),
+	TEXT("Converts a telemetry file to CSV. Arguments: InPath [OutPath], the .csv next to it by default"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& _Args)
+	{
+		if (_Args.Num() > 0)
+		{
+			SafetyFirstTelemetry::ConvertToCsv(_Args[0], _Args.Num() > 1 ? _Args[1] : FPaths::ChangeExtension(_Args[0], TEXT("csv")));
+		}
+	}));
+
+/**
+ * Bounded ring of records with many producers and one consumer, after the bounded queue of Dmitry Vyukov.
+ * Each cell has a sequence number telling the producer of a position that the cell is free, and the consumer that it
+ * is filled. A producer claims its position with one compare and swap and never waits: a full ring fails the push.
+ */
+class FSafetyFirstTelemetryRing
+{
+public:
+	explicit FSafetyFirstTelemetryRing(int32 _iCapacity)
+	{
+		const int32 iCapacity = (int32)FMath::RoundUpToPowerOfTwo(FMath::Max(_iCapacity, 2));
+		m_Cells.SetNumUninitialized(iCapacity);
+		for (int32 i = 0; i < iCapacity; ++i)
+		{
+			m_Cells[i].m_iSequence = i;
+		}
+		m_iMask = iCapacity - 1;
+	}
+
+	bool Push(const FSafetyFirstTelemetryRecord& _Record)
+	{
+		int64 iPosition = FPlatformAtomics::AtomicRead(&m_iPushPosition);
+		for (;;)
+		{
+			FCell& cell = m_Cells[iPosition & m_iMask];
+			const int64 iDiff = FPlatformAtomics::AtomicRead(&cell.m_iSequence) - iPosition;
+			if (iDiff == 0)
+			{
+				const int64 iClaimed = FPlatformAtomics::InterlockedCompareExchange(&m_iPushPosition, iPosition + 1, iPosition);
+				if (iClaimed == iPosition)
+				{
+					cell.m_Record = _Record;
+					FPlatformAtomics::AtomicStore(&cell.m_iSequence, iPosition + 1);
+					return true;
+				}
+				iPosition = iClaimed;
+			}
+			else if (iDiff < 0)
+			{
+				// The writer has not read the cell of the previous lap yet
+				return false;
+			}
+			else
+			{
+				// Another producer claimed the position first
+				iPosition = FPlatformAtomics::AtomicRead(&m_iPushPosition);
+			}
+		}
+	}
+
+	/** Writer thread only */
+	bool Pop(FSafetyFirstTelemetryRecord& _OutRecord)
+	{
+		FCell& cell = m_Cells[m_iPopPosition & m_iMask];
+		if (FPlatformAtomics::AtomicRead(&cell.m_iSequence) != m_iPopPosition + 1)
+		{
+			return false;
+		}
+
+		_OutRecord = cell.m_Record;
+		FPlatformAtomics::AtomicStore(&cell.m_iSequence, m_iPopPosition + m_iMask + 1);
+		++m_iPopPosition;
+		return true;
+	}
+
+	/** Records pushed since the start */
+	int64 GetNumPushed() const
+	{
+		return FPlatformAtomics::AtomicRead(&m_iPushPosition);
+	}
+
+private:
+	struct FCell
+	{
+		volatile int64 m_iSequence;
+		FSafetyFirstTelemetryRecord m_Record;
+	};
+
+	TArray<FCell> m_Cells;
+	int64 m_iMask = 0;
+
+	// Producers and the consumer write their position on lines of their own
+	uint8 m_PushPadding[PLATFORM_CACHE_LINE_SIZE];
+	volatile int64 m_iPushPosition = 0;
+	uint8 m_PopPadding[PLATFORM_CACHE_LINE_SIZE];
+	int64 m_iPopPosition = 0;
+};
+
+namespace SafetyFirstTelemetry
+{
+	static const uint32 Magic = 0x4C544653; // "SFTL"
+	static const uint32 Version = 1;
+
+	/** Records compressed together, a block header is 12 bytes */
+	static const int32 BlockRecords = 4096;
+
+	static const TCHAR* s_EventNames[] =
+	{
+		TEXT("Fire"),
+		TEXT("WeaponEject"),
+		TEXT("Pickup"),
+		TEXT("Hit"),
+		TEXT("Death"),
+		TEXT("Dropped"),
+	};
+	static_assert(ARRAY_COUNT(s_EventNames) == (int32)ESafetyFirstTelemetryEvent::Count, "One name per telemetry event");
+
+	static volatile int64 s_iDropped = 0;
+
+	/** Set while the writer runs, read by every Record */
+	static FSafetyFirstTelemetryRing* s_ActiveRing = nullptr;
+}
+
+/**
+ * Drains the ring at a fixed interval, compresses the records by blocks and writes them to the telemetry files.
+ * File: magic, version, record size, seconds per cycle, cycles at the start, then blocks of record count, compressed
+ * size and records dropped since the previous block, followed by the zlib compressed records.
+ */
+class FSafetyFirstTelemetryWriter : public FRunnable
+{
+public:
+	FSafetyFirstTelemetryWriter(FSafetyFirstTelemetryRing& _Ring, const USafetyFirstTelemetrySettings& _Settings)
+		: m_Ring(_Ring)
+		, m_WakeUp(FPlatformProcess::GetSynchEventFromPool())
+		, m_uFlushMilliseconds((uint32)FMath::Max(FMath::RoundToInt(_Settings.m_fFlushInterval * 1000.0f), 1))
+		, m_iMaxFileBytes(FMath::Max(_Settings.m_iMaxFileKilobytes, 1) * 1024LL)
+		, m_iMaxFiles(FMath::Max(_Settings.m_iMaxFiles, 1))
+		, m_BaseName(SafetyFirstTelemetry::GetDirectory() / FDateTime::Now().ToString())
+		, m_uStartCycles(FPlatformTime::Cycles64())
+	{
+		m_Block.Reserve(SafetyFirstTelemetry::BlockRecords);
+		m_Thread = FRunnableThread::Create(this, TEXT("SafetyFirstTelemetry"), 0, TPri_BelowNormal);
+	}
+
+	/** Writes everything still in the ring, then closes the file */
+	virtual ~FSafetyFirstTelemetryWriter()
+	{
+		m_bStopping = true;
+		m_WakeUp->Trigger();
+		m_Thread->WaitForCompletion();
+		delete m_Thread;
+		FPlatformProcess::ReturnSynchEventToPool(m_WakeUp);
+	}
+
+	virtual uint32 Run() override
+	{
+		for (;;)
+		{
+			// Read the flag before draining, records pushed before the stop are always written
+			const bool bStopping = m_bStopping;
+			Drain();
+			if (bStopping)
+			{
+				break;
+			}
+			m_WakeUp->Wait(m_uFlushMilliseconds);
+		}
+
+		CloseFile();
+		return 0;
+	}
+
+private:
+	void Drain()
+	{
+		for (;;)
+		{
+			m_Block.Reset();
+			FSafetyFirstTelemetryRecord record;
+			while (m_Block.Num() < SafetyFirstTelemetry::BlockRecords && m_Ring.Pop(record))
+			{
+				m_Block.Add(record);
+			}
+
+			if (m_Block.Num() == 0)
+			{
+				return;
+			}
+			WriteBlock();
+		}
+	}
+
+	void WriteBlock()
+	{
+		if ((m_File == nullptr && !m_bOpenFailed) || m_iFileBytes >= m_iMaxFileBytes)
+		{
+			OpenNextFile();
+		}
+		if (m_File == nullptr)
+		{
+			return;
+		}
+
+		const int32 iRawBytes = m_Block.Num() * sizeof(FSafetyFirstTelemetryRecord);
+		int32 iCompressedBytes = FCompression::CompressMemoryBound(COMPRESS_ZLIB, iRawBytes);
+		m_Compressed.SetNumUninitialized(iCompressedBytes, /*bAllowShrinking*/false);
+		if (!FCompression::CompressMemory(COMPRESS_ZLIB, m_Compressed.GetData(), iCompressedBytes, m_Block.GetData(), iRawBytes) || iCompressedBytes >= iRawBytes)
+		{
+			// A compressed size equal to the raw one means raw records
+			iCompressedBytes = iRawBytes;
+			FMemory::Memcpy(m_Compressed.GetData(), m_Block.GetData(), iRawBytes);
+		}
+
+		const int64 iDropped = FPlatformAtomics::AtomicRead(&SafetyFirstTelemetry::s_iDropped);
+		uint32 uRecords = m_Block.Num();
+		uint32 uCompressedBytes = iCompressedBytes;
+		uint32 uDropped = (uint32)(iDropped - m_iDroppedWritten);
+		m_iDroppedWritten = iDropped;
+
+		*m_File << uRecords << uCompressedBytes << uDropped;
+		m_File->Serialize(m_Compressed.GetData(), iCompressedBytes);
+		m_iFileBytes += 3 * sizeof(uint32) + iCompressedBytes;
+	}
+
+	void OpenNextFile()
+	{
+		CloseFile();
+
+		const FString path = FString::Printf(TEXT("%s_%d.sftl"), *m_BaseName, m_iFileIndex++);
+		m_File = IFileManager::Get().CreateFileWriter(*path);
+		if (m_File == nullptr)
+		{
+			UE_LOG(LogSafetyFirst, Warning, TEXT("Telemetry: could not create %s, records are discarded"), *path);
+			m_bOpenFailed = true;
+			return;
+		}
+
+		uint32 uMagic = SafetyFirstTelemetry::Magic;
+		uint32 uVersion = SafetyFirstTelemetry::Version;
+		uint32 uRecordSize = sizeof(FSafetyFirstTelemetryRecord);
+		double fSecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+		uint64 uStartCycles = m_uStartCycles;
+		*m_File << uMagic << uVersion << uRecordSize << fSecondsPerCycle << uStartCycles;
+		m_iFileBytes = 0;
+
+		DeleteOldestFiles();
+	}
+
+	/** Rotation: only the last m_iMaxFiles of the directory are kept, earlier sessions included */
+	void DeleteOldestFiles()
+	{
+		const FString directory = FPaths::GetPath(m_BaseName);
+		TArray<FString> names;
+		IFileManager::Get().FindFiles(names, *directory, TEXT("sftl"));
+		if (names.Num() <= m_iMaxFiles)
+		{
+			return;
+		}
+
+		struct FFile
+		{
+			FString m_Path;
+			FDateTime m_Time;
+		};
+		TArray<FFile> files;
+		files.Reserve(names.Num());
+		for (const FString& name : names)
+		{
+			FFile file;
+			file.m_Path = directory / name;
+			file.m_Time = IFileManager::Get().GetTimeStamp(*file.m_Path);
+			files.Add(file);
+		}
+		files.Sort([](const FFile& _A, const FFile& _B)
+		{
+			return _A.m_Time != _B.m_Time ? _A.m_Time < _B.m_Time : _A.m_Path < _B.m_Path;
+		});
+
+		// The file just opened is the newest, it is never among the deleted ones
+		for (int32 iFile = 0; iFile < files.Num() - m_iMaxFiles; ++iFile)
+		{
+			IFileManager::Get().Delete(*files[iFile].m_Path);
+		}
+	}
+
+	void CloseFile()
+	{
+		if (m_File != nullptr)
+		{
+			m_File->Close();
+			delete m_File;
+			m_File = nullptr;
+		}
+	}
+
+	FSafetyFirstTelemetryRing& m_Ring;
+	FEvent* m_WakeUp;
+	FRunnableThread* m_Thread = nullptr;
+	FThreadSafeBool m_bStopping;
+
+	const uint32 m_uFlushMilliseconds;
+	const int64 m_iMaxFileBytes;
+	const int32 m_iMaxFiles;
+	const FString m_BaseName;
+	const uint64 m_uStartCycles;
+
+	TArray<FSafetyFirstTelemetryRecord> m_Block;
+	TArray<uint8> m_Compressed;
+
+	FArchive* m_File = nullptr;
+	bool m_bOpenFailed = false;
+	int64 m_iFileBytes = 0;
+	int32 m_iFileIndex = 0;
+	int64 m_iDroppedWritten = 0;
+};
+
+namespace SafetyFirstTelemetry
+{
+	static TUniquePtr<FSafetyFirstTelemetryRing> s_Ring;
+	static TUniquePtr<FSafetyFirstTelemetryWriter> s_Writer;
+	static FDelegateHandle s_EndFrameHandle;
+
+	static void OnEndFrame()
+	{
+		const int64 iDropped = GetNumDropped();
+		SET_DWORD_STAT(STAT_SafetyFirst_TelemetryRecorded, (uint32)GetNumRecorded());
+		SET_DWORD_STAT(STAT_SafetyFirst_TelemetryDropped, (uint32)iDropped);
+		CSV_CUSTOM_STAT(SafetyFirst, TelemetryDropped, (int32)iDropped, ECsvCustomStatOp::Set);
+	}
+
+	FString GetDirectory()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("Telemetry");
+	}
+
+	void Startup()
+	{
+		const USafetyFirstTelemetrySettings* settings = GetDefault<USafetyFirstTelemetrySettings>();
+		if ((!settings->m_bEnabled && !FParse::Param(FCommandLine::Get(), TEXT("SafetyFirstTelemetry"))) || IsRunningCommandlet())
+		{
+			return;
+		}
+
+		s_Ring = MakeUnique<FSafetyFirstTelemetryRing>(settings->m_iRingCapacity);
+		s_Writer = MakeUnique<FSafetyFirstTelemetryWriter>(*s_Ring, *settings);
+		s_ActiveRing = s_Ring.Get();
+		s_EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+	}
+
+	void Shutdown()
+	{
+		FCoreDelegates::OnEndFrame.Remove(s_EndFrameHandle);
+		s_ActiveRing = nullptr;
+		FPlatformMisc::MemoryBarrier();
+		s_Writer.Reset();
+		s_Ring.Reset();
+	}
+
+	static void MakeRecord(ESafetyFirstTelemetryEvent _eType, const AActor* _Actor, const FVector& _vLocation, float _fValue, FSafetyFirstTelemetryRecord& _OutRecord)
+	{
+		_OutRecord.m_uCycles = FPlatformTime::Cycles64();
+		_OutRecord.m_uFrame = (uint32)GFrameCounter;
+		_OutRecord.m_eType = _eType;
+		_OutRecord.m_Padding[0] = _OutRecord.m_Padding[1] = _OutRecord.m_Padding[2] = 0;
+		_OutRecord.m_uActor = _Actor != nullptr ? _Actor->GetUniqueID() : 0;
+		_OutRecord.m_fX = _vLocation.X;
+		_OutRecord.m_fY = _vLocation.Y;
+		_OutRecord.m_fValue = _fValue;
+	}
+
+	bool Record(ESafetyFirstTelemetryEvent _eType, const AActor* _Actor, const FVector& _vLocation, float _fValue)
+	{
+		FSafetyFirstTelemetryRing* ring = s_ActiveRing;
+		if (ring == nullptr)
+		{
+			return false;
+		}
+
+		FSafetyFirstTelemetryRecord record;
+		MakeRecord(_eType, _Actor, _vLocation, _fValue, record);
+		if (!ring->Push(record))
+		{
+			FPlatformAtomics::InterlockedIncrement(&s_iDropped);
+			return false;
+		}
+		return true;
+	}
+
+	float MeasureRecordCost(int32 _iRecords, int32 _iThreads)
+	{
+		const int32 iThreads = FMath::Max(_iThreads, 1);
+		const int32 iRecordsPerThread = FMath::Max(_iRecords / iThreads, 1);
+
+		// A ring of its own, large enough that nothing is dropped and nothing has to be drained
+		FSafetyFirstTelemetryRing ring(iRecordsPerThread * iThreads);
+		const uint64 uStart = FPlatformTime::Cycles64();
+		ParallelFor(iThreads, [&ring, iRecordsPerThread](int32 _iThread)
+		{
+			FSafetyFirstTelemetryRecord record;
+			for (int32 i = 0; i < iRecordsPerThread; ++i)
+			{
+				MakeRecord(ESafetyFirstTelemetryEvent::Hit, nullptr, FVector((float)i, (float)_iThread, 0.0f), 1.0f, record);
+				ring.Push(record);
+			}
+		});
+		const double fSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - uStart);
+
+		// Every thread pushed for the whole duration, so this is the time one record costs its producer
+		return (float)(fSeconds * 1.0e9 / iRecordsPerThread);
+	}
+
+	int64 GetNumRecorded()
+	{
+		FSafetyFirstTelemetryRing* ring = s_ActiveRing;
+		return ring != nullptr ? ring->GetNumPushed() : 0;
+	}
+
+	int64 GetNumDropped()
+	{
+		return FPlatformAtomics::AtomicRead(&s_iDropped);
+	}
+
+	void DumpStats()
+	{
+		if (s_ActiveRing == nullptr)
+		{
+			UE_LOG(LogSafetyFirst, Display, TEXT("Telemetry: off, run with -SafetyFirstTelemetry or set m_bEnabled in [/Script/SafetyFirst.SafetyFirstTelemetrySettings]"));
+			return;
+		}
+		UE_LOG(LogSafetyFirst, Display, TEXT("Telemetry: %lld records recorded, %lld dropped, written to %s"),
+			GetNumRecorded(), GetNumDropped(), *GetDirectory());
+	}
+
+	static void WriteUtf8(FArchive& _Writer, FString& _InOutLines)
+	{
+		FTCHARToUTF8 utf8(*_InOutLines);
+		_Writer.Serialize((void*)utf8.Get(), utf8.Length());
+		_InOutLines.Reset();
+	}
+
+	bool ConvertToCsv(const FString& _InPath, const FString& _OutPath)
+	{
+		TUniquePtr<FArchive> reader(IFileManager::Get().CreateFileReader(*_InPath));
+		if (!reader.IsValid())
+		{
+			UE_LOG(LogSafetyFirst, Warning, TEXT("Telemetry: could not open %s"), *_InPath);
+			return false;
+		}
+
+		uint32 uMagic = 0;
+		uint32 uVersion = 0;
+		uint32 uRecordSize = 0;
+		double fSecondsPerCycle = 0.0;
+		uint64 uStartCycles = 0;
+		*reader << uMagic << uVersion << uRecordSize;
+		if (uMagic != Magic || uVersion != Version || uRecordSize != sizeof(FSafetyFirstTelemetryRecord))
+		{
+			UE_LOG(LogSafetyFirst, Warning, TEXT("Telemetry: %s is not a version %u telemetry file"), *_InPath, Version);
+			return false;
+		}
+		*reader << fSecondsPerCycle << uStartCycles;
+
+		TUniquePtr<FArchive> writer(IFileManager::Get().CreateFileWriter(*_OutPath));
+		if (!writer.IsValid())
+		{
+			UE_LOG(LogSafetyFirst, Warning, TEXT("Telemetry: could not create %s"), *_OutPath);
+			return false;
+		}
+
+		TArray<FSafetyFirstTelemetryRecord> records;
+		TArray<uint8> compressed;
+		FString lines = TEXT("seconds,frame,event,actor,x,y,value\n");
+		int64 iRecords = 0;
+		int64 iDropped = 0;
+		bool bTruncated = false;
+		while (!reader->AtEnd())
+		{
+			uint32 uRecords = 0;
+			uint32 uCompressedBytes = 0;
+			uint32 uDropped = 0;
+			*reader << uRecords << uCompressedBytes << uDropped;
+
+			// A file still being written, or cut by a crash, ends in the middle of a block
+			const int32 iRawBytes = uRecords * sizeof(FSafetyFirstTelemetryRecord);
+			if (reader->IsError() || uRecords > (uint32)BlockRecords || (int64)uCompressedBytes > reader->TotalSize() - reader->Tell())
+			{
+				bTruncated = true;
+				break;
+			}
+
+			compressed.SetNumUninitialized(uCompressedBytes, /*bAllowShrinking*/false);
+			reader->Serialize(compressed.GetData(), uCompressedBytes);
+			records.SetNumUninitialized(uRecords, /*bAllowShrinking*/false);
+			if ((int32)uCompressedBytes == iRawBytes)
+			{
+				FMemory::Memcpy(records.GetData(), compressed.GetData(), iRawBytes);
+			}
+			else if (!FCompression::UncompressMemory(COMPRESS_ZLIB, records.GetData(), iRawBytes, compressed.GetData(), uCompressedBytes))
+			{
+				bTruncated = true;
+				break;
+			}
+
+			if (uDropped > 0 && uRecords > 0)
+			{
+				lines += FString::Printf(TEXT("%.6f,%u,%s,,,,%u\n"), (records[0].m_uCycles - uStartCycles) * fSecondsPerCycle,
+					records[0].m_uFrame, s_EventNames[(int32)ESafetyFirstTelemetryEvent::Dropped], uDropped);
+				iDropped += uDropped;
+			}
+
+			for (const FSafetyFirstTelemetryRecord& record : records)
+			{
+				const int32 iType = (int32)record.m_eType;
+				lines += FString::Printf(TEXT("%.6f,%u,%s,%u,%.1f,%.1f,%g\n"), (record.m_uCycles - uStartCycles) * fSecondsPerCycle,
+					record.m_uFrame, iType < (int32)ESafetyFirstTelemetryEvent::Count ? s_EventNames[iType] : TEXT("Unknown"), record.m_uActor,
+					record.m_fX, record.m_fY, record.m_fValue);
+			}
+			iRecords += uRecords;
+
+			// Written by block, a whole session does not have to fit in one string
+			WriteUtf8(*writer, lines);
+		}
+		WriteUtf8(*writer, lines);
+
+		UE_LOG(LogSafetyFirst, Display, TEXT("Telemetry: %lld records and %lld dropped from %s written to %s%s"),
+			iRecords, iDropped, *_InPath, *_OutPath, bTruncated ? TEXT(", the file ends with a partial block") : TEXT(""));
+		return true;
+	}
+}
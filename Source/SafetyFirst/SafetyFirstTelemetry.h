@@ -0,0 +1,99 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "SafetyFirstTelemetry.generated.h"
+
+class AActor;
+
+UENUM()
+enum class ESafetyFirstTelemetryEvent : uint8
+{
+	/** A weapon fired a shot */
+	Fire,
+	/** A pawn threw its weapon, m_OnFire */
+	WeaponEject,
+	Pickup,
+	/** A projectile hit an actor, the value is the damage */
+	Hit,
+	/** An enemy was killed */
+	Death,
+	/** Not recorded, written by the CSV conversion for the events lost before a block */
+	Dropped,
+	Count UMETA(Hidden),
+};
+
+/** One telemetry record, written as is to the files */
+struct FSafetyFirstTelemetryRecord
+{
+	/** FPlatformTime::Cycles64 */
+	uint64 m_uCycles;
+	uint32 m_uFrame;
+	ESafetyFirstTelemetryEvent m_eType;
+	uint8 m_Padding[3];
+	/** GetUniqueID of the actor, 0 for none */
+	uint32 m_uActor;
+	float m_fX;
+	float m_fY;
+	float m_fValue;
+};
+static_assert(sizeof(FSafetyFirstTelemetryRecord) == 32, "Telemetry records are written to the files as is");
+
+/**
+ * Telemetry settings, read from the [/Script/SafetyFirst.SafetyFirstTelemetrySettings] section of DefaultGame.ini.
+ * Off unless m_bEnabled is set or the game runs with -SafetyFirstTelemetry.
+ * Gameplay code on any thread pushes records into a lock-free ring, a background thread compresses them in blocks
+ * into Saved/Telemetry/<date>_<n>.sftl, starting a new file every m_iMaxFileKilobytes and deleting the oldest files
+ * of the directory, whatever their session, past m_iMaxFiles. Records that do not fit in the ring are dropped and counted.
+ * Convert the files with: UE4Editor-Cmd SafetyFirst.uproject -run=SafetyFirstTelemetry [-In=<file>] [-Out=<file>]
+ */
+UCLASS(config=Game)
+class USafetyFirstTelemetrySettings : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	bool m_bEnabled = false;
+
+	/** Records the ring holds, rounded up to a power of two */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iRingCapacity = 65536;
+
+	/** Time between two drains of the ring by the writer thread */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	float m_fFlushInterval = 0.25f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxFileKilobytes = 4096;
+
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iMaxFiles = 8;
+};
+
+namespace SafetyFirstTelemetry
+{
+	/** Starts the writer thread if telemetry is enabled, called by the module */
+	void Startup();
+	void Shutdown();
+
+	/** Queues a record, from any thread. Returns false when telemetry is off, or when the ring is full and the record is dropped */
+	bool Record(ESafetyFirstTelemetryEvent _eType, const AActor* _Actor, const FVector& _vLocation, float _fValue = 0.0f);
+
+	/** Records pushed into the ring and records dropped since the start, written or not */
+	int64 GetNumRecorded();
+	int64 GetNumDropped();
+
+	void DumpStats();
+
+	/** Times _iRecords records pushed from _iThreads threads into a ring of their own, returns the nanoseconds per record */
+	float MeasureRecordCost(int32 _iRecords, int32 _iThreads);
+
+	/** Writes the records of a telemetry file as CSV, with a Dropped line before each block that lost records */
+	bool ConvertToCsv(const FString& _InPath, const FString& _OutPath);
+
+	/** Directory of the telemetry files */
+	FString GetDirectory();
+}
@@ -0,0 +1,46 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstTelemetryCommandlet.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstTelemetry.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+USafetyFirstTelemetryCommandlet::USafetyFirstTelemetryCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 USafetyFirstTelemetryCommandlet::Main(const FString& _Params)
+{
+	FString inPath;
+	FString outPath;
+	if (FParse::Value(*_Params, TEXT("In="), inPath))
+	{
+		if (!FParse::Value(*_Params, TEXT("Out="), outPath))
+		{
+			outPath = FPaths::ChangeExtension(inPath, TEXT("csv"));
+		}
+		return SafetyFirstTelemetry::ConvertToCsv(inPath, outPath) ? 0 : 1;
+	}
+
+	const FString directory = SafetyFirstTelemetry::GetDirectory();
+	TArray<FString> files;
+	IFileManager::Get().FindFiles(files, *(directory / TEXT("*.sftl")), /*Files*/true, /*Directories*/false);
+	if (files.Num() == 0)
+	{
+		UE_LOG(LogSafetyFirst, Display, TEXT("Telemetry: no file in %s"), *directory);
+		return 0;
+	}
+
+	int32 iFailed = 0;
+	for (const FString& file : files)
+	{
+		const FString path = directory / file;
+		iFailed += SafetyFirstTelemetry::ConvertToCsv(path, FPaths::ChangeExtension(path, TEXT("csv"))) ? 0 : 1;
+	}
+	return iFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SafetyFirstTelemetryCommandlet.generated.h"
+
+/**
+ * Converts telemetry files to CSV, without loading a map:
+ *   UE4Editor-Cmd SafetyFirst.uproject -run=SafetyFirstTelemetry [-In=<file>.sftl] [-Out=<file>.csv]
+ * Without -In every file of Saved/Telemetry is converted to a .csv next to it.
+ */
+UCLASS()
+class USafetyFirstTelemetryCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	USafetyFirstTelemetryCommandlet();
+
+	virtual int32 Main(const FString& _Params) override;
+};
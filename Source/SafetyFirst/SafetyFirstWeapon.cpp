@@ -1,16 +1,32 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserve
 
 #include "SafetyFirstWeapon.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstAudioManager.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstTelemetry.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Components/StaticMeshComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Engine/StaticMesh.h"
 #include "SafetyFirstProjectile.h"
+#include "SafetyFirstProjectilePool.h"
+#include "SafetyFirstBulkProjectileManager.h"
+#include "SafetyFirstLevelStreaming.h"
+#include "SafetyFirstProximityGrid.h"
+#include "SafetyFirstWeaponMotionManager.h"
+#include "SafetyFirstSignificanceManager.h"
+#include "Engine/World.h"
 #include "Kismet/GameplayStatics.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Weapon fire shot"), STAT_SafetyFirst_FireShot, STATGROUP_SafetyFirst);
 
 ASafetyFirstWeapon::ASafetyFirstWeapon()
 {
+	SAFETYFIRST_LLM_SCOPE(Weapons);
 	
 	// Create mesh component for the projectile sphere
 	m_RootSceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneRootComponent"));
@@ -24,6 +40,7 @@ ASafetyFirstWeapon::ASafetyFirstWeapon()
 	m_TriggerPickupComponent = CreateDefaultSubobject<UBoxComponent>(TEXT("Trigger pickup"));
 	m_TriggerPickupComponent->SetupAttachment(RootComponent);
 	m_TriggerPickupComponent->SetCollisionProfileName("NoCollision");
+	m_TriggerPickupComponent->SetGenerateOverlapEvents(false);
 
 	m_CollisionComponent = CreateDefaultSubobject<USphereComponent>(TEXT("Collision"));
 	m_CollisionComponent->SetupAttachment(RootComponent);
@@ -42,7 +59,20 @@ ASafetyFirstWeapon::ASafetyFirstWeapon()
 	InitialLifeSpan = 3.0f;
 	*/
 
-	PrimaryActorTick.bCanEverTick = true;
+	// Flights are driven by ASafetyFirstWeaponMotionManager
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Flights are replayed on every machine from m_Throw and attachments follow the pawns, no movement to replicate
+	bReplicates = true;
+	bReplicateMovement = false;
+	NetUpdateFrequency = 10.0f;
+}
+
+void ASafetyFirstWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ASafetyFirstWeapon, m_Throw);
 }
 
 void ASafetyFirstWeapon::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
@@ -56,50 +86,107 @@ void ASafetyFirstWeapon::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor,
 	Destroy();
 }
 
-
-void ASafetyFirstWeapon::Tick(float _fDt)
+void ASafetyFirstWeapon::BeginPlay()
 {
-	if (m_bRecoiling)
+	SAFETYFIRST_LLM_SCOPE(Weapons);
+	Super::BeginPlay();
+
+	m_ProjectilePool = ASafetyFirstProjectilePool::Get(GetWorld());
+	if (m_ProjectilePool.IsValid() && !m_bBulkProjectiles)
 	{
+		m_ProjectilePool->Prewarm(m_ProjectileClass);
+	}
 
-		float fCurRecoilRatio = (m_fRecoilDuration - m_fRecoilTimeLeft) / m_fRecoilDuration;
-		fCurRecoilRatio = FMath::Clamp(fCurRecoilRatio, 0.0f, 1.0f);
-		m_fRecoilTimeLeft -= _fDt;
-		float fNextRecoilRatio = (m_fRecoilDuration - m_fRecoilTimeLeft) / m_fRecoilDuration;
-		fNextRecoilRatio = FMath::Clamp(fNextRecoilRatio, 0.0f, 1.0f);
+	m_ProximityGrid = ASafetyFirstProximityGrid::Get(GetWorld());
+	if (m_ProximityGrid.IsValid())
+	{
+		m_iProximityHandle = m_ProximityGrid->Register(this, ESafetyFirstGridLayer::Weapon);
+	}
 
-		if (FMath::IsNearlyEqual(fNextRecoilRatio, 1.0f))
-		{
-			m_bRecoiling = false;
-		}
+	m_MotionManager = ASafetyFirstWeaponMotionManager::Get(GetWorld());
+	if (m_MotionManager.IsValid())
+	{
+		m_MotionManager->BakeCurve(m_RecoilDynamic);
+	}
 
-		if (m_RecoilDynamic != nullptr)
-		{
-			fCurRecoilRatio = FMath::Clamp(m_RecoilDynamic->GetFloatValue(fCurRecoilRatio), 0.0f, 1.0f);
-			fNextRecoilRatio = FMath::Clamp(m_RecoilDynamic->GetFloatValue(fNextRecoilRatio), 0.0f, 1.0f);
-		}
+	m_SignificanceManager = ASafetyFirstSignificanceManager::Get(GetWorld());
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Register(this, ESafetyFirstSignificanceType::Weapon);
+	}
+}
+
+void ASafetyFirstWeapon::EndPlay(const EEndPlayReason::Type _EndPlayReason)
+{
+	if (m_ProximityGrid.IsValid())
+	{
+		m_ProximityGrid->Unregister(m_iProximityHandle);
+	}
+	m_iProximityHandle = INDEX_NONE;
+
+	EndRecoil();
+
+	if (m_SignificanceManager.IsValid())
+	{
+		m_SignificanceManager->Unregister(this);
+	}
 
+	if (m_LevelStreaming.IsValid())
+	{
+		m_LevelStreaming->UnpinLevel(GetLevel());
+	}
+	m_LevelStreaming = nullptr;
 
-		FVector vFrameMovement = ((fNextRecoilRatio - fCurRecoilRatio) * m_fRecoilDistance) * m_vRecoilDirection;
+	Super::EndPlay(_EndPlayReason);
+}
 
+void ASafetyFirstWeapon::SetPickupOverlapEnabled(bool _bEnabled)
+{
+	m_TriggerPickupComponent->SetGenerateOverlapEvents(_bEnabled);
+	m_TriggerPickupComponent->SetCollisionProfileName(_bEnabled ? "Trigger" : "NoCollision");
+}
 
+void ASafetyFirstWeapon::SyncProximityGrid()
+{
+	if (m_ProximityGrid.IsValid())
+	{
+		m_ProximityGrid->UpdateLocation(m_iProximityHandle, GetActorLocation());
+	}
+}
 
-		SetActorLocation(GetActorLocation() + vFrameMovement);
+void ASafetyFirstWeapon::PinLevel()
+{
+	// Weapons of the persistent level are never unloaded, and a cell is pinned once per weapon
+	if (m_LevelStreaming.IsValid() || GetLevel() == GetWorld()->PersistentLevel)
+	{
+		return;
+	}
 
-		FRotator currentRotation = GetActorRotation();
-		currentRotation.Yaw += m_fRecoilTotalRotationDegree * (fNextRecoilRatio - fCurRecoilRatio);
-		SetActorRotation(currentRotation);
+	m_LevelStreaming = ASafetyFirstLevelStreaming::Get(GetWorld());
+	if (m_LevelStreaming.IsValid())
+	{
+		m_LevelStreaming->PinLevel(GetLevel());
+	}
+}
 
+void ASafetyFirstWeapon::EndRecoil()
+{
+	if (m_MotionManager.IsValid())
+	{
+		m_MotionManager->Stop(this);
+	}
 
-		if (!m_bCanBePickedUp && m_fRecoilDuration - m_fRecoilTimeLeft > m_fDurationAfterWhichWeCanPickUpWeapon)
-		{
-			m_bCanBePickedUp = true;
-		}
+	if (m_bRecoiling)
+	{
+		m_bRecoiling = false;
+		SafetyFirstCounters::AddThrownWeapons(-1);
 	}
 }
 
 bool ASafetyFirstWeapon::FireShot(FVector _vFireDirection)
 {
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_FireShot, FireShot);
+
 	bool bEject = false;
 	// If we are pressing fire stick in a direction
 	if (_vFireDirection.SizeSquared() > 0.0f)
@@ -108,19 +195,17 @@ bool ASafetyFirstWeapon::FireShot(FVector _vFireDirection)
 		// Spawn projectile at an offset from this pawn
 		const FVector vSpawnLocation = m_FirePositionStartComponent->GetComponentLocation();
 
-		UWorld* const World = GetWorld();
-		if (World != NULL && m_ProjectileClass != nullptr)
-		{
-			// spawn the projectile
-			World->SpawnActor<ASafetyFirstProjectile>(m_ProjectileClass, vSpawnLocation, FireRotation);
-		}
+		SpawnProjectile(vSpawnLocation, FireRotation);
+		SafetyFirstTelemetry::Record(ESafetyFirstTelemetryEvent::Fire, m_WeaponOwner.Get(), vSpawnLocation);
 
-		// try and play the sound if specified
-		if (m_FireSound != nullptr)
+		// Every machine simulates its own projectiles, the server only tells the others about the shot
+		if (HasAuthority() && GetNetMode() != NM_Standalone)
 		{
-			UGameplayStatics::PlaySoundAtLocation(this, m_FireSound, GetActorLocation());
+			MulticastFireShot(vSpawnLocation, FRotator::CompressAxisToShort(FireRotation.Yaw), Cast<APawn>(m_WeaponOwner.Get()));
 		}
 
+		PlayFireSound(GetActorLocation());
+
 		bEject = true;
 	}
 
@@ -128,11 +213,137 @@ bool ASafetyFirstWeapon::FireShot(FVector _vFireDirection)
 	return bEject;
 }
 
+void ASafetyFirstWeapon::SpawnProjectile(const FVector& _vLocation, const FRotator& _Rotation)
+{
+	SAFETYFIRST_LLM_SCOPE(Projectiles);
+	UWorld* const World = GetWorld();
+	if (World != NULL && m_ProjectileClass != nullptr)
+	{
+		const bool bBulk = m_bBulkProjectiles || ASafetyFirstBulkProjectileManager::IsForcedOn();
+		if (bBulk && !m_BulkProjectileManager.IsValid())
+		{
+			m_BulkProjectileManager = ASafetyFirstBulkProjectileManager::Get(World);
+		}
+
+		// bulk bullets first, then the pool, spawn the projectile only if there is neither
+		if (bBulk && m_BulkProjectileManager.IsValid())
+		{
+			m_BulkProjectileManager->Fire(m_ProjectileClass, _vLocation, _Rotation, this);
+		}
+		else if (m_ProjectilePool.IsValid())
+		{
+			m_ProjectilePool->Acquire(m_ProjectileClass, _vLocation, _Rotation);
+		}
+		else
+		{
+			World->SpawnActor<ASafetyFirstProjectile>(m_ProjectileClass, _vLocation, _Rotation);
+		}
+	}
+}
+
+void ASafetyFirstWeapon::MulticastFireShot_Implementation(FVector_NetQuantize10 _vLocation, uint16 _uYaw, APawn* _Instigator)
+{
+	// The server already fired and the owning client predicted the shot
+	if (HasAuthority() || (_Instigator != nullptr && _Instigator->IsLocallyControlled()))
+	{
+		return;
+	}
+
+	SpawnProjectile(_vLocation, FRotator(0.0f, FRotator::DecompressAxisFromShort(_uYaw), 0.0f));
+	PlayFireSound(_vLocation);
+}
+
+void ASafetyFirstWeapon::PlayFireSound(const FVector& _vLocation)
+{
+	// try and play the sound if specified
+	if (m_FireSound == nullptr)
+	{
+		return;
+	}
+
+	if (!m_AudioManager.IsValid())
+	{
+		m_AudioManager = ASafetyFirstAudioManager::Get(GetWorld());
+	}
+
+	// The manager pools the voices and drops the shots nobody would hear
+	if (m_AudioManager.IsValid())
+	{
+		m_AudioManager->Play(m_FireSound, _vLocation);
+	}
+	else
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, m_FireSound, _vLocation);
+	}
+}
+
 void ASafetyFirstWeapon::RecoilLauncher(FVector _vFireDirection)
 {
+	const FVector vRecoilDirection = (_vFireDirection * (-1.0f)).GetSafeNormal2D();
+
+	if (HasAuthority())
+	{
+		++m_Throw.m_uCount;
+		m_Throw.m_vStart = GetActorLocation();
+		m_Throw.m_vDirection = vRecoilDirection;
+		m_Throw.m_uStartYaw = FRotator::CompressAxisToShort(GetActorRotation().Yaw);
+		m_Throw.m_fServerTime = GetWorld()->GetTimeSeconds();
+	}
+	else
+	{
+		// Thrown ahead of the server by the owning client, OnRep_Throw confirms it
+		m_bPredictedThrow = true;
+		m_vPredictedThrowStart = GetActorLocation();
+	}
+
+	StartRecoil(vRecoilDirection, 0.0f);
+}
+
+void ASafetyFirstWeapon::OnRep_Throw()
+{
+	if (m_bPredictedThrow)
+	{
+		m_bPredictedThrow = false;
+		if (m_bRecoiling && FVector::DistSquared2D(m_vPredictedThrowStart, m_Throw.m_vStart) <= FMath::Square(m_fNetThrowTolerance))
+		{
+			return;
+		}
+	}
+
+	if (m_WeaponOwner.IsValid())
+	{
+		FDetachmentTransformRules detachmentRules(/*InLocationRule*/EDetachmentRule::KeepWorld, /*InRotationRule*/EDetachmentRule::KeepWorld, /*InScaleRule*/EDetachmentRule::KeepWorld, /*bInCallModify*/true);
+		DetachFromActor(detachmentRules);
+		SetWeaponOwner(nullptr);
+	}
+
+	SetActorLocationAndRotation(m_Throw.m_vStart, FRotator(0.0f, FRotator::DecompressAxisFromShort(m_Throw.m_uStartYaw), 0.0f));
+
+	const AGameStateBase* gameState = GetWorld()->GetGameState();
+	const float fServerTime = gameState != nullptr ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	StartRecoil(m_Throw.m_vDirection, FMath::Max(fServerTime - m_Throw.m_fServerTime, 0.0f));
+}
+
+void ASafetyFirstWeapon::StartRecoil(const FVector& _vRecoilDirection, float _fElapsed)
+{
+	if (!m_bRecoiling)
+	{
+		SafetyFirstCounters::AddThrownWeapons(1);
+	}
 	m_bRecoiling = true;
-	m_vRecoilDirection = (_vFireDirection * (-1.0f)).GetSafeNormal2D();
-	m_fRecoilTimeLeft = m_fRecoilDuration;
+	m_vRecoilDirection = _vRecoilDirection;
 	m_bCanBePickedUp = false;
-	m_TriggerPickupComponent->SetCollisionProfileName("Trigger");
+	if (m_MotionManager.IsValid())
+	{
+		m_MotionManager->Launch(this, m_vRecoilDirection, _fElapsed);
+	}
+	else
+	{
+		// Nothing moves weapons outside game worlds, drop it where it is
+		m_bCanBePickedUp = true;
+		EndRecoil();
+	}
+	// The proximity grid replaces the overlaps unless the overlap path is forced
+	SetPickupOverlapEnabled(ASafetyFirstProximityGrid::UseOverlapPickup());
+	SyncProximityGrid();
 }
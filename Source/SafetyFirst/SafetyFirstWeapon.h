@@ -7,6 +7,7 @@
 #include "SafetyFirstProjectile.h"
 #include "Components/BoxComponent.h"
 #include "Components/SphereComponent.h"
+#include "SafetyFirstNetTypes.h"
 #include "SafetyFirstWeapon.generated.h"
 
 
@@ -28,6 +29,10 @@ private:
 	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", DisplayName = "projectile class"))
 	TSubclassOf<ASafetyFirstProjectile> m_ProjectileClass;
 
+	/** Fire data-oriented bullets simulated by ASafetyFirstBulkProjectileManager instead of projectile actors */
+	UPROPERTY(EditAnywhere, meta = (Category = "Safety First ", DisplayName = "bulk projectiles"))
+	bool m_bBulkProjectiles = false;
+
 	/** scene root component */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Projectile, meta = (AllowPrivateAccess = "true"))
 	UBoxComponent* m_TriggerPickupComponent;
@@ -46,12 +51,55 @@ private:
 
 	FVector m_vRecoilDirection;
 
-	float m_fRecoilTimeLeft = 0.0f;
-
 	bool m_bCanBePickedUp = false;
 
 	TWeakObjectPtr<AActor> m_WeaponOwner; 
 
+	TWeakObjectPtr<class ASafetyFirstProjectilePool> m_ProjectilePool;
+
+	TWeakObjectPtr<class ASafetyFirstBulkProjectileManager> m_BulkProjectileManager;
+
+	TWeakObjectPtr<class ASafetyFirstProximityGrid> m_ProximityGrid;
+
+	int32 m_iProximityHandle = INDEX_NONE;
+
+	friend class ASafetyFirstWeaponMotionManager;
+
+	TWeakObjectPtr<class ASafetyFirstWeaponMotionManager> m_MotionManager;
+
+	TWeakObjectPtr<class ASafetyFirstSignificanceManager> m_SignificanceManager;
+
+	TWeakObjectPtr<class ASafetyFirstAudioManager> m_AudioManager;
+
+	/** Set while the streamed cell the weapon was placed in is pinned by it */
+	TWeakObjectPtr<class ASafetyFirstLevelStreaming> m_LevelStreaming;
+
+	/** Index in the flights of the motion manager, INDEX_NONE when not flying */
+	int32 m_iFlightIndex = INDEX_NONE;
+
+	/** Called when the flight ends or the weapon leaves play */
+	void EndRecoil();
+
+	/** Starts the flight along the recoil direction, _fElapsed seconds into it */
+	void StartRecoil(const FVector& _vRecoilDirection, float _fElapsed);
+
+	/** Spawns a local projectile: bulk bullet, pooled actor or new actor */
+	void SpawnProjectile(const FVector& _vLocation, const FRotator& _Rotation);
+
+	/** Plays m_FireSound through the pooled voices of ASafetyFirstAudioManager */
+	void PlayFireSound(const FVector& _vLocation);
+
+	UFUNCTION()
+	void OnRep_Throw();
+
+	/** Last throw decided by the server */
+	UPROPERTY(ReplicatedUsing = OnRep_Throw)
+	FSafetyFirstWeaponThrow m_Throw;
+
+	/** The owning client threw the weapon before the server confirmed it */
+	bool m_bPredictedThrow = false;
+	FVector m_vPredictedThrowStart = FVector::ZeroVector;
+
 public :
 	/** Sound to play each time we fire */
 	UPROPERTY(Category = Audio, EditAnywhere, BlueprintReadWrite)
@@ -74,6 +122,10 @@ public :
 
 	UPROPERTY(Category = Recoil, EditAnywhere, BlueprintReadOnly)
 	float m_fDurationAfterWhichWeCanPickUpWeapon = 0.8f;
+
+	/** A predicted throw that started further than this from the server one is replayed from the server start */
+	UPROPERTY(Category = Network, EditAnywhere, BlueprintReadOnly)
+	float m_fNetThrowTolerance = 50.0f;
 	
 public:
 	ASafetyFirstWeapon();
@@ -83,18 +135,40 @@ public:
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
 
-	void Tick(float _fDt) override;
+	void BeginPlay() override;
+
+	void EndPlay(const EEndPlayReason::Type _EndPlayReason) override;
+
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 	/* Fire a shot in the specified direction */
 	bool/*bEject*/ FireShot(FVector _vFireDirection);
 
 	void RecoilLauncher(FVector _vFireDirection);
 
+	/** Projectiles are not replicated, the server sends this event so other clients spawn their own */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireShot(FVector_NetQuantize10 _vLocation, uint16 _uYaw, APawn* _Instigator);
+
 	float GetRecoilPower() { return RecoilPower; }
 	bool CanBePickedUp() { return m_bCanBePickedUp; }
+	bool IsRecoiling() const { return m_bRecoiling; }
+	TSubclassOf<ASafetyFirstProjectile> GetProjectileClass() const { return m_ProjectileClass; }
 
 	void SetWeaponOwner(AActor* _weaponOwner) { m_WeaponOwner = _weaponOwner; }
 	AActor* GetWeaponOwner() { return m_WeaponOwner.Get(); }
+
+	/* Radius of the pickup zone on the play plane */
+	float GetPickupRadius() const { return m_TriggerPickupComponent->GetScaledBoxExtent().Size2D(); }
+
+	/* Switches the pickup trigger between overlap generating and no collision */
+	void SetPickupOverlapEnabled(bool _bEnabled);
+
+	/* Pushes the current location to the proximity grid */
+	void SyncProximityGrid();
+
+	/* Keeps the streamed cell the weapon was placed in loaded until the weapon leaves play, so it survives wherever it is dropped */
+	void PinLevel();
 	
 };
 
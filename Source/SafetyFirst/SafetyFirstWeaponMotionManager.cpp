@@ -0,0 +1,170 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "SafetyFirstWeaponMotionManager.h"
+#include "SafetyFirst.h"
+#include "SafetyFirstFixedStep.h"
+#include "SafetyFirstMemory.h"
+#include "SafetyFirstWeapon.h"
+#include "SafetyFirstWorldManager.h"
+#include "Curves/CurveFloat.h"
+
+DECLARE_CYCLE_STAT(TEXT("Weapon motion"), STAT_SafetyFirst_WeaponMotion, STATGROUP_SafetyFirst);
+
+ASafetyFirstWeaponMotionManager::ASafetyFirstWeaponMotionManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+}
+
+ASafetyFirstWeaponMotionManager* ASafetyFirstWeaponMotionManager::Get(UWorld* _World)
+{
+	return FindOrSpawnWorldManager<ASafetyFirstWeaponMotionManager>(_World);
+}
+
+int32 ASafetyFirstWeaponMotionManager::BakeCurve(UCurveFloat* _Curve)
+{
+	SAFETYFIRST_LLM_SCOPE(Weapons);
+	if (_Curve == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	if (const int32* iExisting = m_CurveIndices.Find(_Curve))
+	{
+		return *iExisting;
+	}
+
+	const int32 iNumSamples = FMath::Max(m_iCurveSamples, 2);
+	TArray<float> samples;
+	samples.SetNumUninitialized(iNumSamples);
+	for (int32 i = 0; i < iNumSamples; ++i)
+	{
+		const float fRatio = float(i) / float(iNumSamples - 1);
+		samples[i] = FMath::Clamp(_Curve->GetFloatValue(fRatio), 0.0f, 1.0f);
+	}
+
+	const int32 iIndex = m_Curves.Add(_Curve);
+	m_CurveTables.Add(MoveTemp(samples));
+	m_CurveIndices.Add(_Curve, iIndex);
+	return iIndex;
+}
+
+void ASafetyFirstWeaponMotionManager::Launch(ASafetyFirstWeapon* _Weapon, const FVector& _vDirection, float _fElapsed)
+{
+	SAFETYFIRST_LLM_SCOPE(Weapons);
+	check(_Weapon != nullptr);
+
+	if (_Weapon->m_iFlightIndex == INDEX_NONE)
+	{
+		_Weapon->m_iFlightIndex = m_Flights.AddUninitialized();
+	}
+
+	FFlight& flight = m_Flights[_Weapon->m_iFlightIndex];
+	flight.m_Weapon = _Weapon;
+	flight.m_iCurve = BakeCurve(_Weapon->m_RecoilDynamic);
+	flight.m_fElapsed = _fElapsed;
+	flight.m_fDuration = _Weapon->m_fRecoilDuration;
+	flight.m_fPickupDelay = _Weapon->m_fDurationAfterWhichWeCanPickUpWeapon;
+	flight.m_vStart = _Weapon->GetActorLocation();
+	flight.m_vOffset = _vDirection * _Weapon->m_fRecoilDistance;
+	flight.m_StartRotation = _Weapon->GetActorRotation();
+	flight.m_fYawSpan = _Weapon->m_fRecoilTotalRotationDegree;
+
+	SetActorTickEnabled(true);
+}
+
+void ASafetyFirstWeaponMotionManager::Stop(ASafetyFirstWeapon* _Weapon)
+{
+	if (_Weapon != nullptr && m_Flights.IsValidIndex(_Weapon->m_iFlightIndex))
+	{
+		RemoveFlight(_Weapon->m_iFlightIndex);
+	}
+}
+
+void ASafetyFirstWeaponMotionManager::RemoveFlight(int32 _iIndex)
+{
+	m_Flights[_iIndex].m_Weapon->m_iFlightIndex = INDEX_NONE;
+	m_Flights.RemoveAtSwap(_iIndex, 1, /*bAllowShrinking*/false);
+	if (m_Flights.IsValidIndex(_iIndex))
+	{
+		m_Flights[_iIndex].m_Weapon->m_iFlightIndex = _iIndex;
+	}
+}
+
+float ASafetyFirstWeaponMotionManager::SampleCurve(int32 _iCurve, float _fRatio) const
+{
+	if (_iCurve == INDEX_NONE)
+	{
+		return _fRatio;
+	}
+
+	const TArray<float>& samples = m_CurveTables[_iCurve];
+	const float fPosition = _fRatio * (samples.Num() - 1);
+	const int32 iLow = FMath::Min(FMath::FloorToInt(fPosition), samples.Num() - 2);
+	return FMath::Lerp(samples[iLow], samples[iLow + 1], fPosition - iLow);
+}
+
+float ASafetyFirstWeaponMotionManager::GetRatio(const FFlight& _Flight, float _fElapsed) const
+{
+	return _Flight.m_fDuration > 0.0f ? FMath::Clamp(_fElapsed / _Flight.m_fDuration, 0.0f, 1.0f) : 1.0f;
+}
+
+void ASafetyFirstWeaponMotionManager::Tick(float _fDt)
+{
+	Super::Tick(_fDt);
+	SAFETYFIRST_SCOPE_CYCLE(STAT_SafetyFirst_WeaponMotion, WeaponMotion);
+
+	if (!m_FixedStep.IsValid())
+	{
+		m_FixedStep = ASafetyFirstFixedStep::Get(GetWorld());
+	}
+	ASafetyFirstFixedStep* fixedStep = m_FixedStep.Get();
+	const int32 iSteps = fixedStep != nullptr ? fixedStep->GetNumSteps() : 1;
+	const float fStepSeconds = fixedStep != nullptr ? fixedStep->GetStepSeconds() : _fDt;
+	const float fAlpha = fixedStep != nullptr ? fixedStep->GetAlpha() : 1.0f;
+
+	// Flights advance by whole steps and are drawn up to one step behind, like the pawns
+	const float fBehindSeconds = (1.0f - fAlpha) * fStepSeconds;
+
+	for (int32 i = m_Flights.Num() - 1; i >= 0; --i)
+	{
+		FFlight& flight = m_Flights[i];
+		ASafetyFirstWeapon* weapon = flight.m_Weapon;
+
+		// A weapon caught mid-air now follows its new owner
+		if (weapon->GetWeaponOwner() != nullptr)
+		{
+			weapon->EndRecoil();
+			continue;
+		}
+
+		flight.m_fElapsed += iSteps * fStepSeconds;
+		const float fRatio = GetRatio(flight, flight.m_fElapsed);
+		const bool bLanded = FMath::IsNearlyEqual(fRatio, 1.0f);
+		// Relative to the start of the curve, as the per frame deltas were, so a curve not starting at 0 does not snap the weapon
+		const float fEased = SampleCurve(flight.m_iCurve, bLanded ? 1.0f : GetRatio(flight, flight.m_fElapsed - fBehindSeconds)) - SampleCurve(flight.m_iCurve, 0.0f);
+
+		FRotator rotation = flight.m_StartRotation;
+		rotation.Yaw += flight.m_fYawSpan * fEased;
+		weapon->SetActorLocationAndRotation(flight.m_vStart + flight.m_vOffset * fEased, rotation);
+		if (iSteps > 0)
+		{
+			weapon->SyncProximityGrid();
+		}
+
+		if (!weapon->m_bCanBePickedUp && flight.m_fElapsed > flight.m_fPickupDelay)
+		{
+			weapon->m_bCanBePickedUp = true;
+		}
+
+		if (bLanded)
+		{
+			weapon->EndRecoil();
+		}
+	}
+
+	if (m_Flights.Num() == 0)
+	{
+		SetActorTickEnabled(false);
+	}
+}
@@ -0,0 +1,81 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SafetyFirstWeaponMotionManager.generated.h"
+
+class ASafetyFirstWeapon;
+class UCurveFloat;
+
+/**
+ * Moves every thrown weapon of the world in one pass, so weapons never tick themselves.
+ * Recoil curves are baked into lookup tables once, each flying weapon gets a single combined transform update
+ * per frame and the manager itself only ticks while something is in the air. Flights advance by ASafetyFirstFixedStep
+ * steps, so a weapon lands and can be picked up at the same time at any frame rate.
+ */
+UCLASS(config=Game, notplaceable, Transient)
+class ASafetyFirstWeaponMotionManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASafetyFirstWeaponMotionManager();
+
+	/** Returns the manager of the world, spawning it if needed */
+	static ASafetyFirstWeaponMotionManager* Get(UWorld* _World);
+
+	/** Samples the curve into a lookup table if it was not already, returns its index or INDEX_NONE for a null curve */
+	int32 BakeCurve(UCurveFloat* _Curve);
+
+	/**
+	 * Starts the recoil flight of the weapon along the direction, restarting it if the weapon was already flying.
+	 * _fElapsed skips the start of the flight, for throws replicated late.
+	 */
+	void Launch(ASafetyFirstWeapon* _Weapon, const FVector& _vDirection, float _fElapsed = 0.0f);
+
+	/** Stops the flight of the weapon, does nothing if it is not flying */
+	void Stop(ASafetyFirstWeapon* _Weapon);
+
+	int32 GetNumFlying() const { return m_Flights.Num(); }
+
+	virtual void Tick(float _fDt) override;
+
+	/** Samples per baked curve, over the [0, 1] ratio of the flight */
+	UPROPERTY(config, EditAnywhere, Category = "Safety First ")
+	int32 m_iCurveSamples = 128;
+
+private:
+	struct FFlight
+	{
+		/** Kept valid by the weapon, which stops its flight in EndPlay */
+		ASafetyFirstWeapon* m_Weapon;
+		/** Baked curve, INDEX_NONE for a linear flight */
+		int32 m_iCurve;
+		float m_fElapsed;
+		float m_fDuration;
+		float m_fPickupDelay;
+		FVector m_vStart;
+		/** Direction times distance */
+		FVector m_vOffset;
+		FRotator m_StartRotation;
+		float m_fYawSpan;
+	};
+
+	float SampleCurve(int32 _iCurve, float _fRatio) const;
+	float GetRatio(const FFlight& _Flight, float _fElapsed) const;
+	void RemoveFlight(int32 _iIndex);
+
+	TArray<FFlight> m_Flights;
+
+	/** Keeps the baked curves referenced, m_CurveTables has the samples at the same index */
+	UPROPERTY()
+	TArray<UCurveFloat*> m_Curves;
+
+	TArray<TArray<float>> m_CurveTables;
+	TMap<const UCurveFloat*, int32> m_CurveIndices;
+
+	/** Clock of the flights, they advance once per frame without it */
+	TWeakObjectPtr<class ASafetyFirstFixedStep> m_FixedStep;
+};
@@ -0,0 +1,72 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "SafetyFirstMemory.h"
+
+/**
+ * Returns the manager actor of the given class living in the world, spawning it the first time it is requested.
+ * Managers are transient, so they are never saved with the level. Callers are expected to cache the result.
+ */
+template<class TManager>
+TManager* FindOrSpawnWorldManager(UWorld* _World)
+{
+	if (_World == nullptr || !_World->IsGameWorld() || _World->bIsTearingDown)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<TManager> it(_World); it; ++it)
+	{
+		if (!it->IsPendingKill())
+		{
+			return *it;
+		}
+	}
+
+	FActorSpawnParameters spawnInfo;
+	spawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	spawnInfo.ObjectFlags |= RF_Transient;
+	return _World->SpawnActor<TManager>(TManager::StaticClass(), FTransform::Identity, spawnInfo);
+}
+
+/** Point of view of a local player, for the managers that cull or scale down what nobody sees */
+struct FSafetyFirstView
+{
+	FVector m_vLocation;
+	FVector m_vDirection;
+	/** Half field of view widened by the margin given to GatherLocalViews */
+	float m_fCosHalfAngle;
+	/** Half field of view without the margin, to convert sizes to screen sizes */
+	float m_fTanHalfAngle;
+};
+
+/** Adds one view per local player, so every splitscreen viewport counts */
+inline void GatherLocalViews(UWorld* _World, float _fMarginDegrees, TSafetyFirstFrameArray<FSafetyFirstView>& _OutViews)
+{
+	for (FConstPlayerControllerIterator it = _World->GetPlayerControllerIterator(); it; ++it)
+	{
+		APlayerController* controller = it->Get();
+		if (controller == nullptr || !controller->IsLocalController() || controller->PlayerCameraManager == nullptr)
+		{
+			continue;
+		}
+
+		FVector vViewLocation;
+		FRotator viewRotation;
+		controller->GetPlayerViewPoint(vViewLocation, viewRotation);
+
+		const float fHalfAngle = controller->PlayerCameraManager->GetFOVAngle() * 0.5f;
+		FSafetyFirstView view;
+		view.m_vLocation = vViewLocation;
+		view.m_vDirection = viewRotation.Vector();
+		view.m_fCosHalfAngle = FMath::Cos(FMath::DegreesToRadians(FMath::Min(fHalfAngle + _fMarginDegrees, 180.0f)));
+		view.m_fTanHalfAngle = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(fHalfAngle, 1.0f, 89.0f)));
+		_OutViews.Add(view);
+	}
+}